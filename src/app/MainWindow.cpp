@@ -32,22 +32,25 @@
 #include "FilterOptionsWidget.h"
 #include "FixDpiDialog.h"
 #include "ImageInfo.h"
-#include "ImageMetadataLoader.h"
+#include "ImageMetadataScanner.h"
 #include "ImageViewBase.h"
 #include "LoadFileTask.h"
 #include "LoadFilesStatusDialog.h"
 #include "NewOpenProjectPanel.h"
 #include "OutOfMemoryDialog.h"
 #include "OutOfMemoryHandler.h"
+#include "PageMemoryEstimate.h"
 #include "PageOrientationPropagator.h"
 #include "PageSelectionAccessor.h"
 #include "PageSequence.h"
 #include "ProcessingIndicationWidget.h"
 #include "ProcessingTaskQueue.h"
 #include "ProjectCreationContext.h"
+#include "ProjectJournal.h"
 #include "ProjectOpeningContext.h"
 #include "ProjectPages.h"
 #include "ProjectReader.h"
+#include "ProjectSaver.h"
 #include "ProjectWriter.h"
 #include "RecentProjects.h"
 #include "RelinkingDialog.h"
@@ -111,7 +114,9 @@ MainWindow::MainWindow()
       m_ignoreSelectionChanges(0),
       m_ignorePageOrderingChanges(0),
       m_debug(false),
-      m_closing(false) {
+      m_closing(false),
+      m_projectSaver(std::make_unique<ProjectSaver>()),
+      m_fullSaveNeeded(true) {
   ApplicationSettings& settings = ApplicationSettings::getInstance();
 
   m_maxLogicalThumbSize = settings.getMaxLogicalThumbnailSize();
@@ -122,6 +127,7 @@ MainWindow::MainWindow()
 
   m_autoSaveTimer.setSingleShot(true);
   connect(&m_autoSaveTimer, SIGNAL(timeout()), SLOT(autoSaveProject()));
+  connect(m_projectSaver.get(), SIGNAL(saved(const QString&, bool)), SLOT(projectSaved(const QString&, bool)));
 
   setupUi(this);
   setupIcons();
@@ -375,6 +381,10 @@ void MainWindow::switchToNewProject(const std::shared_ptr<ProjectPages>& pages,
                                     const ProjectReader* projectReader) {
   stopBatchProcessing(CLEAR_MAIN_AREA);
   m_interactiveQueue->cancelAndClear();
+  // The saves in progress hold on to the filters of the old project.
+  m_projectSaver->waitForDone();
+  m_changedImages.clear();
+  m_fullSaveNeeded = true;
 
   if (!outDir.isEmpty()) {
     Utils::maybeCreateCacheDir(outDir);
@@ -428,8 +438,10 @@ void MainWindow::switchToNewProject(const std::shared_ptr<ProjectPages>& pages,
   // so recreate the thumbnail cache.
   if (outDir.isEmpty()) {
     m_thumbnailCache.reset();
+    m_intermediateCache.reset();
   } else {
     m_thumbnailCache = Utils::createThumbnailCache(m_outFileNameGen.outDir());
+    m_intermediateCache = Utils::createIntermediateImageCache(m_outFileNameGen.outDir());
   }
   resetThumbSequence(currentPageOrderProvider());
 
@@ -840,15 +852,21 @@ void MainWindow::removeImageWidget() {
   m_imageWidgetCleanup.clear();
 }
 
+// The thumbnails get invalidated whenever the settings of a page change,
+// so this is also where the changes to save are tracked.
+
 void MainWindow::invalidateThumbnail(const PageId& pageId) {
+  m_changedImages.insert(pageId.imageId());
   m_thumbSequence->invalidateThumbnail(pageId);
 }
 
 void MainWindow::invalidateThumbnail(const PageInfo& pageInfo) {
+  m_changedImages.insert(pageInfo.imageId());
   m_thumbSequence->invalidateThumbnail(pageInfo);
 }
 
 void MainWindow::invalidateAllThumbnails() {
+  m_fullSaveNeeded = true;
   m_thumbSequence->invalidateAllThumbnails();
 }
 
@@ -1019,7 +1037,22 @@ void MainWindow::autoSaveProject() {
     return;
   }
 
-  saveProjectWithFeedback(m_projectFile);
+  auto writer = std::make_unique<ProjectWriter>(m_pages, m_selectedPage, m_outFileNameGen);
+  if (m_fullSaveNeeded) {
+    m_projectSaver->save(std::move(writer), m_projectFile, m_stages->filters());
+  } else {
+    m_projectSaver->saveChanges(std::move(writer), m_changedImages, m_projectFile, m_stages->filters());
+  }
+  m_changedImages.clear();
+  m_fullSaveNeeded = false;
+}
+
+void MainWindow::projectSaved(const QString&, const bool success) {
+  if (!success) {
+    // The changes that didn't make it are no longer tracked.
+    m_fullSaveNeeded = true;
+    QMessageBox::warning(this, tr("Error"), tr("Error saving the project file!"));
+  }
 }
 
 void MainWindow::pageContextMenuRequested(const PageInfo& pageInfo_, const QPoint& screenPos, bool selected) {
@@ -1485,14 +1518,16 @@ void MainWindow::openProject(const QString& projectFile) {
     QMessageBox::warning(this, tr("Error"), tr("Unable to open the project file."));
     return;
   }
+  const QByteArray projectData(file.readAll());
+  file.close();
 
   QDomDocument doc;
-  if (!doc.setContent(&file)) {
+  if (!doc.setContent(projectData)) {
     QMessageBox::warning(this, tr("Error"), tr("The project file is broken."));
     return;
   }
-
-  file.close();
+  // Bring in the changes autosaved since the project file was last written in full.
+  ProjectJournal::replay(projectFile, projectData, doc);
 
   auto* context = new ProjectOpeningContext(this, projectFile, doc);
   connect(context, SIGNAL(done(ProjectOpeningContext*)), SLOT(projectOpened(ProjectOpeningContext*)));
@@ -1543,6 +1578,8 @@ void MainWindow::onSettingsChanged() {
     }
   }
 
+  updateIntermediateCacheSize();
+
   updateThumbnailViewMode();
 
   const QSizeF maxLogicalThumbSize = settings.getMaxLogicalThumbnailSize();
@@ -1751,6 +1788,10 @@ bool MainWindow::closeProjectInteractive() {
     return true;
   }
 
+  // Make the project file reflect the autosaved changes, if any, so it can be compared with the current state.
+  m_projectSaver->waitForDone();
+  ProjectJournal::compact(m_projectFile);
+
   const QFileInfo projectFile(m_projectFile);
   const QFileInfo backupFile(projectFile.absoluteDir(), QString::fromLatin1("Backup.") + projectFile.fileName());
   const QString backupFilePath(backupFile.absoluteFilePath());
@@ -1804,12 +1845,14 @@ void MainWindow::closeProjectWithoutSaving() {
 }
 
 bool MainWindow::saveProjectWithFeedback(const QString& projectFile) {
-  ProjectWriter writer(m_pages, m_selectedPage, m_outFileNameGen);
+  auto writer = std::make_unique<ProjectWriter>(m_pages, m_selectedPage, m_outFileNameGen);
 
-  if (!writer.write(projectFile, m_stages->filters())) {
+  if (!m_projectSaver->saveAndWait(std::move(writer), projectFile, m_stages->filters())) {
     QMessageBox::warning(this, tr("Error"), tr("Error saving the project file!"));
     return false;
   }
+  m_changedImages.clear();
+  m_fullSaveNeeded = false;
   return true;
 }
 
@@ -1890,15 +1933,11 @@ void MainWindow::showInsertFileDialog(BeforeOrAfter beforeOrAfter, const ImageId
   std::vector<QString> loadedFiles;
   std::vector<QString> failedFiles;  // Those we failed to read metadata from.
   // dialog->selectedFiles() returns file list in reverse order.
-  for (int i = files.size() - 1; i >= 0; --i) {
-    const QFileInfo fileInfo(files[i]);
-    ImageFileInfo imageFileInfo(fileInfo, std::vector<ImageMetadata>());
-
-    const ImageMetadataLoader::Status status = ImageMetadataLoader::load(
-        files.at(i), [&](const ImageMetadata& metadata) { imageFileInfo.imageInfo().push_back(metadata); });
-
-    if (status == ImageMetadataLoader::LOADED) {
-      newFiles.push_back(imageFileInfo);
+  const std::vector<QString> filePaths(files.rbegin(), files.rend());
+  for (const ImageMetadataScanner::Result& result : ImageMetadataScanner::scanAndWait(filePaths)) {
+    const QFileInfo fileInfo(result.filePath);
+    if (result.status == ImageMetadataLoader::LOADED) {
+      newFiles.emplace_back(fileInfo, result.perPageMetadata);
       loadedFiles.push_back(fileInfo.absoluteFilePath());
     } else {
       failedFiles.push_back(fileInfo.absoluteFilePath());
@@ -2096,8 +2135,11 @@ BackgroundTaskPtr MainWindow::createCompositeTask(const PageInfo& page,
     debug = false;
   }
   assert(fixOrientationTask);
-  return std::make_shared<LoadFileTask>(batch ? BackgroundTask::BATCH : BackgroundTask::INTERACTIVE, page,
-                                        m_thumbnailCache, m_pages, fixOrientationTask);
+  auto task = std::make_shared<LoadFileTask>(batch ? BackgroundTask::BATCH : BackgroundTask::INTERACTIVE, page,
+                                             m_thumbnailCache, m_intermediateCache, m_pages, fixOrientationTask);
+  task->setEstimatedMemoryUsage(outputTask ? m_stages->outputFilter()->estimateMemoryUsage(page)
+                                           : PageMemoryEstimate::forSource(page.metadata()));
+  return task;
 }  // MainWindow::createCompositeTask
 
 std::shared_ptr<CompositeCacheDrivenTask> MainWindow::createCompositeCacheDrivenTask(const int lastFilterIdx) {
@@ -2223,6 +2265,19 @@ void MainWindow::updateThumbnailViewMode() {
   }
 }
 
+void MainWindow::updateIntermediateCacheSize() {
+  if (m_outFileNameGen.outDir().isEmpty()) {
+    return;
+  }
+  const int maxSizeMb = ApplicationSettings::getInstance().getIntermediateCacheSizeMb();
+  if (m_intermediateCache && (maxSizeMb > 0)) {
+    m_intermediateCache->setMaxSize(qint64(maxSizeMb) * 1024 * 1024);
+  } else {
+    // Enables or disables the cache.  The tasks already created keep the old one.
+    m_intermediateCache = Utils::createIntermediateImageCache(m_outFileNameGen.outDir());
+  }
+}
+
 void MainWindow::updateAutoSaveTimer() {
   if (m_autoSaveTimer.remainingTime() <= 0) {
     m_autoSaveTimer.start(60000);
@@ -13,6 +13,7 @@
 #include <boost/function.hpp>
 #include <memory>
 #include <set>
+#include <unordered_set>
 #include <vector>
 
 #include "AbstractCommand.h"
@@ -20,6 +21,7 @@
 #include "BeforeOrAfter.h"
 #include "FilterResult.h"
 #include "FilterUiInterface.h"
+#include "ImageId.h"
 #include "NonCopyable.h"
 #include "OutputFileNameGenerator.h"
 #include "PageId.h"
@@ -32,6 +34,7 @@
 
 class AbstractFilter;
 class AbstractRelinker;
+class IntermediateImageCache;
 class ThumbnailPixmapCache;
 class ProjectPages;
 class PageSequence;
@@ -56,6 +59,7 @@ class TabbedDebugImages;
 class ProcessingTaskQueue;
 class FixDpiDialog;
 class OutOfMemoryDialog;
+class ProjectSaver;
 class QLineF;
 class QRectF;
 class QLayout;
@@ -95,6 +99,8 @@ class MainWindow : public QMainWindow, private FilterUiInterface, private Ui::Ma
 
   void autoSaveProject();
 
+  void projectSaved(const QString& projectFile, bool success);
+
   void goFirstPage();
 
   void goLastPage();
@@ -307,6 +313,8 @@ class MainWindow : public QMainWindow, private FilterUiInterface, private Ui::Ma
 
   void updateThumbnailViewMode();
 
+  void updateIntermediateCacheSize();
+
   void updateAutoSaveTimer();
 
   PageSequence currentPageSequence();
@@ -319,6 +327,7 @@ class MainWindow : public QMainWindow, private FilterUiInterface, private Ui::Ma
   QString m_projectFile;
   OutputFileNameGenerator m_outFileNameGen;
   std::shared_ptr<ThumbnailPixmapCache> m_thumbnailCache;
+  std::shared_ptr<IntermediateImageCache> m_intermediateCache;
   std::unique_ptr<ThumbnailSequence> m_thumbSequence;
   std::unique_ptr<WorkerThreadPool> m_workerThreadPool;
   std::unique_ptr<ProcessingTaskQueue> m_batchQueue;
@@ -344,6 +353,11 @@ class MainWindow : public QMainWindow, private FilterUiInterface, private Ui::Ma
   bool m_debug;
   bool m_closing;
   QTimer m_autoSaveTimer;
+  std::unique_ptr<ProjectSaver> m_projectSaver;
+  /** The images whose settings changed since the project was last saved. */
+  std::unordered_set<ImageId> m_changedImages;
+  /** Whether the next autosave has to write the whole project rather than just m_changedImages. */
+  bool m_fullSaveNeeded;
   StatusBarPanel* m_statusBarPanel;
   QActionGroup* m_unitsMenuActionGroup;
   QTimer m_maxLogicalThumbSizeUpdater;
@@ -6,13 +6,12 @@
 #include <core/IconProvider.h>
 
 #include <QFileDialog>
+#include <QHash>
 #include <QMessageBox>
 #include <QSettings>
 #include <QSortFilterProxyModel>
 #include <QVector>
-#include <deque>
 
-#include "ImageMetadataLoader.h"
 #include "NonCopyable.h"
 #include "SmartFilenameOrdering.h"
 
@@ -47,8 +46,6 @@ class ProjectFilesDialog::FileList : private QAbstractListModel {
   DECLARE_NON_COPYABLE(FileList)
 
  public:
-  enum LoadStatus { LOAD_OK, LOAD_FAILED, NO_MORE_FILES };
-
   FileList();
 
   ~FileList() override;
@@ -78,9 +75,15 @@ class ProjectFilesDialog::FileList : private QAbstractListModel {
 
   void remove(const QItemSelection& selection);
 
-  void prepareForLoadingFiles();
+  /**
+   * \brief Returns the paths of the files to load, in the visual order.
+   */
+  std::vector<QString> prepareForLoadingFiles();
 
-  LoadStatus loadNextFile();
+  /**
+   * \return false if loading the file failed.
+   */
+  bool fileLoaded(const ImageMetadataScanner::Result& result);
 
  private:
   int rowCount(const QModelIndex& parent) const override;
@@ -90,7 +93,7 @@ class ProjectFilesDialog::FileList : private QAbstractListModel {
   Qt::ItemFlags flags(const QModelIndex& index) const override;
 
   std::vector<Item> m_items;
-  std::deque<int> m_itemsToLoad;
+  QHash<QString, int> m_itemsToLoad;  // file path -> item index
 };
 
 
@@ -163,7 +166,6 @@ ProjectFilesDialog::ProjectFilesDialog(QWidget* parent)
       m_offProjectFilesSorted(std::make_unique<SortedFileList>(*m_offProjectFiles)),
       m_inProjectFiles(std::make_unique<FileList>()),
       m_inProjectFilesSorted(std::make_unique<SortedFileList>(*m_inProjectFiles)),
-      m_loadTimerId(0),
       m_metadataLoadFailed(false),
       m_autoOutDir(true) {
   m_supportedExtensions.insert("png");
@@ -406,7 +408,7 @@ void ProjectFilesDialog::onOK() {
 }  // ProjectFilesDialog::onOK
 
 void ProjectFilesDialog::startLoadingMetadata() {
-  m_inProjectFiles->prepareForLoadingFiles();
+  const std::vector<QString> filePaths(m_inProjectFiles->prepareForLoadingFiles());
 
   progressBar->setMaximum(static_cast<int>(m_inProjectFiles->count()));
   inpDirLine->setEnabled(false);
@@ -422,31 +424,27 @@ void ProjectFilesDialog::startLoadingMetadata() {
   buttonBox->button(QDialogButtonBox::Ok)->setEnabled(false);
   offProjectList->clearSelection();
   inProjectList->clearSelection();
-  m_loadTimerId = startTimer(0);
+  progressBar->setValue(0);
   m_metadataLoadFailed = false;
-}
 
-void ProjectFilesDialog::timerEvent(QTimerEvent* event) {
-  if (event->timerId() != m_loadTimerId) {
-    QWidget::timerEvent(event);
-    return;
-  }
+  m_metadataScanner = std::make_unique<ImageMetadataScanner>();
+  connect(m_metadataScanner.get(), &ImageMetadataScanner::resultsReady, this, &ProjectFilesDialog::metadataLoaded);
+  connect(m_metadataScanner.get(), &ImageMetadataScanner::finished, this, &ProjectFilesDialog::finishLoadingMetadata);
+  m_metadataScanner->scan(filePaths);
+}
 
-  switch (m_inProjectFiles->loadNextFile()) {
-    case FileList::NO_MORE_FILES:
-      finishLoadingMetadata();
-      break;
-    case FileList::LOAD_FAILED:
+void ProjectFilesDialog::metadataLoaded(const std::vector<ImageMetadataScanner::Result>& results) {
+  for (const ImageMetadataScanner::Result& result : results) {
+    if (!m_inProjectFiles->fileLoaded(result)) {
       m_metadataLoadFailed = true;
-      // Fall through.
-    case FileList::LOAD_OK:
-      progressBar->setValue(progressBar->value() + 1);
-      break;
+    }
   }
+  progressBar->setValue(progressBar->value() + static_cast<int>(results.size()));
 }
 
 void ProjectFilesDialog::finishLoadingMetadata() {
-  killTimer(m_loadTimerId);
+  // Can't destroy the scanner from its own signal.
+  m_metadataScanner.release()->deleteLater();
 
   inpDirLine->setEnabled(true);
   inpDirBrowseBtn->setEnabled(true);
@@ -549,8 +547,8 @@ Qt::ItemFlags ProjectFilesDialog::FileList::flags(const QModelIndex& index) cons
   return m_items[index.row()].flags();
 }
 
-void ProjectFilesDialog::FileList::prepareForLoadingFiles() {
-  std::deque<int> itemIndexes;
+std::vector<QString> ProjectFilesDialog::FileList::prepareForLoadingFiles() {
+  std::vector<int> itemIndexes;
   const auto numItems = static_cast<int>(m_items.size());
   for (int i = 0; i < numItems; ++i) {
     itemIndexes.push_back(i);
@@ -559,37 +557,37 @@ void ProjectFilesDialog::FileList::prepareForLoadingFiles() {
   std::sort(itemIndexes.begin(), itemIndexes.end(),
             [&](int lhs, int rhs) { return ItemVisualOrdering()(m_items[lhs], m_items[rhs]); });
 
-  m_itemsToLoad.swap(itemIndexes);
+  std::vector<QString> filePaths;
+  m_itemsToLoad.clear();
+  for (const int itemIdx : itemIndexes) {
+    const QString filePath(m_items[itemIdx].fileInfo().absoluteFilePath());
+    filePaths.push_back(filePath);
+    m_itemsToLoad[filePath] = itemIdx;
+  }
+  return filePaths;
 }
 
-ProjectFilesDialog::FileList::LoadStatus ProjectFilesDialog::FileList::loadNextFile() {
-  if (m_itemsToLoad.empty()) {
-    return NO_MORE_FILES;
+bool ProjectFilesDialog::FileList::fileLoaded(const ImageMetadataScanner::Result& result) {
+  const auto it = m_itemsToLoad.find(result.filePath);
+  if (it == m_itemsToLoad.end()) {
+    return true;
   }
 
-  const int itemIdx = m_itemsToLoad.front();
+  const int itemIdx = it.value();
+  m_itemsToLoad.erase(it);
   Item& item = m_items[itemIdx];
-  std::vector<ImageMetadata> perPageMetadata;
-  const QString filePath(item.fileInfo().absoluteFilePath());
-  const ImageMetadataLoader::Status st = ImageMetadataLoader::load(
-      filePath, [&](const ImageMetadata& metadata) { perPageMetadata.push_back(metadata); });
 
-  LoadStatus status;
-
-  if (st == ImageMetadataLoader::LOADED) {
-    status = LOAD_OK;
-    item.perPageMetadata().swap(perPageMetadata);
+  const bool loaded = (result.status == ImageMetadataLoader::LOADED);
+  if (loaded) {
+    item.perPageMetadata() = result.perPageMetadata;
     item.setStatus(Item::STATUS_LOAD_OK);
   } else {
-    status = LOAD_FAILED;
     item.setStatus(Item::STATUS_LOAD_FAILED);
   }
   const QModelIndex idx(index(itemIdx, 0));
   emit dataChanged(idx, idx);
-
-  m_itemsToLoad.pop_front();
-  return status;
-}  // ProjectFilesDialog::FileList::loadNextFile
+  return loaded;
+}
 
 /*================= ProjectFilesDialog::SortedFileList ===================*/
 
@@ -11,6 +11,7 @@
 #include <vector>
 
 #include "ImageFileInfo.h"
+#include "ImageMetadataScanner.h"
 #include "ui_ProjectFilesDialog.h"
 
 class ProjectFilesDialog : public QDialog, private Ui::ProjectFilesDialog {
@@ -60,7 +61,7 @@ class ProjectFilesDialog : public QDialog, private Ui::ProjectFilesDialog {
 
   void startLoadingMetadata();
 
-  void timerEvent(QTimerEvent* event) override;
+  void metadataLoaded(const std::vector<ImageMetadataScanner::Result>& results);
 
   void finishLoadingMetadata();
 
@@ -71,7 +72,7 @@ class ProjectFilesDialog : public QDialog, private Ui::ProjectFilesDialog {
   std::unique_ptr<SortedFileList> m_offProjectFilesSorted;
   std::unique_ptr<FileList> m_inProjectFiles;
   std::unique_ptr<SortedFileList> m_inProjectFilesSorted;
-  int m_loadTimerId;
+  std::unique_ptr<ImageMetadataScanner> m_metadataScanner;
   bool m_metadataLoadFailed;
   bool m_autoOutDir;
 };
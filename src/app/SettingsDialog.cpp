@@ -4,10 +4,12 @@
 #include "SettingsDialog.h"
 
 #include <core/ApplicationSettings.h>
-#include <tiff.h>
+#include <core/TiffWriter.h>
+#include <tiffio.h>
 
 #include <QtCore/QDir>
 #include <QtWidgets/QMessageBox>
+#include <algorithm>
 #include <cmath>
 
 #include "Application.h"
@@ -42,13 +44,27 @@ SettingsDialog::SettingsDialog(QWidget* parent) : QDialog(parent) {
   ui.tiffCompressionBWBox->addItem(tr("LZW"), COMPRESSION_LZW);
   ui.tiffCompressionBWBox->addItem(tr("Deflate"), COMPRESSION_DEFLATE);
   ui.tiffCompressionBWBox->addItem(tr("CCITT G4"), COMPRESSION_CCITTFAX4);
+#ifdef COMPRESSION_ZSTD
+  if (TIFFIsCODECConfigured(COMPRESSION_ZSTD)) {
+    ui.tiffCompressionBWBox->addItem(tr("ZSTD"), COMPRESSION_ZSTD);
+  }
+#endif
   ui.tiffCompressionBWBox->setCurrentIndex(ui.tiffCompressionBWBox->findData(settings.getTiffBwCompression()));
 
   ui.tiffCompressionColorBox->addItem(tr("None"), COMPRESSION_NONE);
   ui.tiffCompressionColorBox->addItem(tr("LZW"), COMPRESSION_LZW);
   ui.tiffCompressionColorBox->addItem(tr("Deflate"), COMPRESSION_DEFLATE);
   ui.tiffCompressionColorBox->addItem(tr("JPEG"), COMPRESSION_JPEG);
+#ifdef COMPRESSION_ZSTD
+  if (TIFFIsCODECConfigured(COMPRESSION_ZSTD)) {
+    ui.tiffCompressionColorBox->addItem(tr("ZSTD"), COMPRESSION_ZSTD);
+  }
+#endif
   ui.tiffCompressionColorBox->setCurrentIndex(ui.tiffCompressionColorBox->findData(settings.getTiffColorCompression()));
+  updateTiffCompressionLevelRange();
+  ui.tiffCompressionLevelSB->setValue(settings.getTiffCompressionLevel());
+  connect(ui.tiffCompressionBWBox, SIGNAL(currentIndexChanged(int)), SLOT(updateTiffCompressionLevelRange()));
+  connect(ui.tiffCompressionColorBox, SIGNAL(currentIndexChanged(int)), SLOT(updateTiffCompressionLevelRange()));
 
   {
     auto* app = static_cast<Application*>(qApp);
@@ -82,6 +98,8 @@ SettingsDialog::SettingsDialog(QWidget* parent) : QDialog(parent) {
   ui.singleColumnThumbnailsCB->setChecked(settings.isSingleColumnThumbnailDisplayEnabled());
   ui.cancelingSelectionQuestionCB->setChecked(settings.isCancelingSelectionQuestionEnabled());
 
+  ui.intermediateCacheSizeSB->setValue(settings.getIntermediateCacheSizeMb());
+
   connect(ui.buttonBox, SIGNAL(accepted()), SLOT(commitChanges()));
 }
 
@@ -97,6 +115,7 @@ void SettingsDialog::commitChanges() {
 
   settings.setTiffBwCompression(ui.tiffCompressionBWBox->currentData().toInt());
   settings.setTiffColorCompression(ui.tiffCompressionColorBox->currentData().toInt());
+  settings.setTiffCompressionLevel(ui.tiffCompressionLevelSB->value());
   settings.setLanguage(ui.languageBox->currentData().toString());
 
   settings.setDeskewDeviationCoef(ui.deskewDeviationCoefSB->value());
@@ -122,9 +141,22 @@ void SettingsDialog::commitChanges() {
   settings.setSingleColumnThumbnailDisplayEnabled(ui.singleColumnThumbnailsCB->isChecked());
   settings.setCancelingSelectionQuestionEnabled(ui.cancelingSelectionQuestionCB->isChecked());
 
+  settings.setIntermediateCacheSizeMb(ui.intermediateCacheSizeSB->value());
+
   emit settingsChanged();
 }
 
 void SettingsDialog::blackOnWhiteDetectionToggled(bool checked) {
   ui.blackOnWhiteDetectionAtOutputCB->setEnabled(checked);
 }
+
+void SettingsDialog::updateTiffCompressionLevelRange() {
+  // The level is shared by both codecs, each of which clamps it to its own range.
+  const int maxLevel = std::max(TiffWriter::maxCompressionLevel(ui.tiffCompressionBWBox->currentData().toInt()),
+                                TiffWriter::maxCompressionLevel(ui.tiffCompressionColorBox->currentData().toInt()));
+  if (maxLevel > 0) {
+    ui.tiffCompressionLevelSB->setMaximum(maxLevel);
+  }
+  ui.tiffCompressionLevelSB->setEnabled(maxLevel > 0);
+  ui.tiffCompressionLevelLabel->setEnabled(maxLevel > 0);
+}
@@ -23,6 +23,8 @@ class SettingsDialog : public QDialog {
 
   void blackOnWhiteDetectionToggled(bool checked);
 
+  void updateTiffCompressionLevelRange();
+
  private:
   Ui::SettingsDialog ui;
 };
@@ -9,6 +9,7 @@
 #include <core/FontIconPack.h>
 #include <core/IconProvider.h>
 #include <core/StyledIconPack.h>
+#include <foundation/Tracer.h>
 
 #include <QGuiApplication>
 #include <QSettings>
@@ -71,5 +72,7 @@ int main(int argc, char* argv[]) {
   if (args.size() > 1) {
     mainWnd->openProject(args.at(1));
   }
+  // Set SCANTAILOR_TRACE to a file path to record a Chrome trace of the session.
+  const TraceSession traceSession(TraceSession::filePathFromEnvironment());
   return Application::exec();
 }  // main
@@ -0,0 +1,8 @@
+// Copyright (C) 2019  Joseph Artsimovich <joseph.artsimovich@gmail.com>, 4lex4 <4lex49@zoho.com>
+// Use of this source code is governed by the GNU GPLv3 license that can be found in the LICENSE file.
+
+#include "Benchmark.h"
+
+namespace benchmarks {
+Benchmark::Benchmark(const QString& name, const SetupFunction& setup) : m_name(name), m_setup(setup) {}
+}  // namespace benchmarks
@@ -0,0 +1,65 @@
+// Copyright (C) 2019  Joseph Artsimovich <joseph.artsimovich@gmail.com>, 4lex4 <4lex49@zoho.com>
+// Use of this source code is governed by the GNU GPLv3 license that can be found in the LICENSE file.
+
+#ifndef SCANTAILOR_BENCHMARKS_BENCHMARK_H_
+#define SCANTAILOR_BENCHMARKS_BENCHMARK_H_
+
+#include <Dpi.h>
+
+#include <QString>
+#include <functional>
+#include <vector>
+
+namespace benchmarks {
+/**
+ * \brief A timed piece of code together with the preparation of its input.
+ *
+ * The setup function is called once, right before the benchmark is run,
+ * and returns the body to be timed.  This way the inputs of a benchmark
+ * only exist while it's being run and don't distort the memory
+ * measurements of the others.
+ */
+class Benchmark {
+ public:
+  using Body = std::function<void()>;
+
+  struct Setup {
+    /** The code to time.  It's run several times, so it must not consume its inputs. */
+    Body body;
+
+    /** The number of megapixels a single run of the body processes. */
+    double megapixels;
+  };
+
+  using SetupFunction = std::function<Setup(const Dpi& dpi)>;
+
+  Benchmark(const QString& name, const SetupFunction& setup);
+
+  const QString& name() const { return m_name; }
+
+  Setup setUp(const Dpi& dpi) const { return m_setup(dpi); }
+
+ private:
+  QString m_name;
+  SetupFunction m_setup;
+};
+
+
+using BenchmarkList = std::vector<Benchmark>;
+
+/**
+ * \brief Benchmarks of the imageproc library.
+ */
+void addImageprocBenchmarks(BenchmarkList& list);
+
+/**
+ * \brief Benchmarks of the dewarping library.
+ */
+void addDewarpingBenchmarks(BenchmarkList& list);
+
+/**
+ * \brief Benchmarks of the code in core.
+ */
+void addCoreBenchmarks(BenchmarkList& list);
+}  // namespace benchmarks
+#endif  // ifndef SCANTAILOR_BENCHMARKS_BENCHMARK_H_
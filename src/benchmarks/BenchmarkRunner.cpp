@@ -0,0 +1,129 @@
+// Copyright (C) 2019  Joseph Artsimovich <joseph.artsimovich@gmail.com>, 4lex4 <4lex49@zoho.com>
+// Use of this source code is governed by the GNU GPLv3 license that can be found in the LICENSE file.
+
+#include "BenchmarkRunner.h"
+
+#include <QFile>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <numeric>
+#include <vector>
+
+#if defined(_WIN32)
+#include <windows.h>
+// Must come after windows.h
+#include <psapi.h>
+#elif defined(__unix__) || defined(__APPLE__)
+#include <sys/resource.h>
+#endif
+
+namespace benchmarks {
+QJsonObject RunResult::toJson() const {
+  QJsonObject obj;
+  obj["name"] = name;
+  obj["megapixels"] = megapixels;
+  obj["runs"] = runs;
+  obj["min_ms"] = minMs;
+  obj["median_ms"] = medianMs;
+  obj["mean_ms"] = meanMs;
+  obj["stddev_ms"] = stddevMs;
+  obj["mpix_per_sec"] = throughput;
+  obj["peak_rss_kb"] = static_cast<double>(peakRssKb);
+  return obj;
+}
+
+BenchmarkRunner::BenchmarkRunner(const RunOptions& options) : m_options(options) {}
+
+RunResult BenchmarkRunner::run(const Benchmark& benchmark) const {
+  using Clock = std::chrono::steady_clock;
+
+  RunResult result;
+  result.name = benchmark.name();
+
+  std::vector<double> times;
+  {
+    const Benchmark::Setup setup(benchmark.setUp(m_options.dpi));
+    result.megapixels = setup.megapixels;
+
+    for (int i = 0; i < m_options.warmupRuns; ++i) {
+      setup.body();
+    }
+
+    resetPeakRss();
+    double totalSeconds = 0;
+    while (int(times.size()) < m_options.maxRuns) {
+      if ((int(times.size()) >= m_options.minRuns) && (totalSeconds >= m_options.minSeconds)) {
+        break;
+      }
+      const Clock::time_point start = Clock::now();
+      setup.body();
+      const std::chrono::duration<double> elapsed = Clock::now() - start;
+      totalSeconds += elapsed.count();
+      times.push_back(elapsed.count() * 1000.0);
+    }
+    result.peakRssKb = peakRssKb();
+  }
+
+  if (times.empty()) {
+    return result;
+  }
+
+  std::sort(times.begin(), times.end());
+  const size_t n = times.size();
+  result.runs = static_cast<int>(n);
+  result.minMs = times.front();
+  result.medianMs = (n % 2 != 0) ? times[n / 2] : 0.5 * (times[n / 2 - 1] + times[n / 2]);
+  result.meanMs = std::accumulate(times.begin(), times.end(), 0.0) / n;
+  double sqsum = 0;
+  for (const double t : times) {
+    sqsum += (t - result.meanMs) * (t - result.meanMs);
+  }
+  result.stddevMs = (n > 1) ? std::sqrt(sqsum / (n - 1)) : 0.0;
+  if (result.medianMs > 0) {
+    result.throughput = result.megapixels / (result.medianMs / 1000.0);
+  }
+  return result;
+}  // BenchmarkRunner::run
+
+void resetPeakRss() {
+#if defined(__linux__)
+  // Writing 5 to clear_refs resets VmHWM (Linux 4.0+).
+  QFile file("/proc/self/clear_refs");
+  if (file.open(QIODevice::WriteOnly)) {
+    file.write("5");
+  }
+#endif
+}
+
+int64_t peakRssKb() {
+#if defined(__linux__)
+  QFile file("/proc/self/status");
+  if (file.open(QIODevice::ReadOnly)) {
+    while (!file.atEnd()) {
+      const QByteArray line(file.readLine());
+      if (line.startsWith("VmHWM:")) {
+        return line.mid(6).trimmed().split(' ').front().toLongLong();
+      }
+    }
+  }
+  return 0;
+#elif defined(_WIN32)
+  PROCESS_MEMORY_COUNTERS counters;
+  if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+    return static_cast<int64_t>(counters.PeakWorkingSetSize / 1024);
+  }
+  return 0;
+#elif defined(__APPLE__)
+  rusage usage{};
+  getrusage(RUSAGE_SELF, &usage);
+  return usage.ru_maxrss / 1024;  // bytes on macOS
+#elif defined(__unix__)
+  rusage usage{};
+  getrusage(RUSAGE_SELF, &usage);
+  return usage.ru_maxrss;
+#else
+  return 0;
+#endif
+}
+}  // namespace benchmarks
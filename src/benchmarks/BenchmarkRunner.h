@@ -0,0 +1,74 @@
+// Copyright (C) 2019  Joseph Artsimovich <joseph.artsimovich@gmail.com>, 4lex4 <4lex49@zoho.com>
+// Use of this source code is governed by the GNU GPLv3 license that can be found in the LICENSE file.
+
+#ifndef SCANTAILOR_BENCHMARKS_BENCHMARKRUNNER_H_
+#define SCANTAILOR_BENCHMARKS_BENCHMARKRUNNER_H_
+
+#include <QJsonObject>
+#include <QString>
+#include <cstdint>
+
+#include "Benchmark.h"
+
+namespace benchmarks {
+struct RunOptions {
+  Dpi dpi = Dpi(300, 300);
+
+  /** Untimed runs before the timed ones, to warm up the caches and the allocator. */
+  int warmupRuns = 1;
+
+  /** The timed runs continue until both this number of runs and minSeconds are reached ... */
+  int minRuns = 5;
+
+  double minSeconds = 1.0;
+
+  /** ... or until this number of runs is reached. */
+  int maxRuns = 100;
+};
+
+
+struct RunResult {
+  QString name;
+  double megapixels = 0;
+  int runs = 0;
+  double minMs = 0;
+  double medianMs = 0;
+  double meanMs = 0;
+  double stddevMs = 0;
+
+  /** Megapixels per second, based on the median time. */
+  double throughput = 0;
+
+  /**
+   * The peak resident set size of the process while running the benchmark, in kilobytes.
+   * Only Linux allows resetting it between benchmarks.  Elsewhere it's the peak
+   * since the start of the process.
+   */
+  int64_t peakRssKb = 0;
+
+  QJsonObject toJson() const;
+};
+
+
+class BenchmarkRunner {
+ public:
+  explicit BenchmarkRunner(const RunOptions& options);
+
+  RunResult run(const Benchmark& benchmark) const;
+
+ private:
+  RunOptions m_options;
+};
+
+
+/**
+ * \brief Resets the peak resident set size reported by peakRssKb(), if the OS allows that.
+ */
+void resetPeakRss();
+
+/**
+ * \brief The peak resident set size of the process, in kilobytes, or 0 if unknown.
+ */
+int64_t peakRssKb();
+}  // namespace benchmarks
+#endif  // ifndef SCANTAILOR_BENCHMARKS_BENCHMARKRUNNER_H_
@@ -0,0 +1,54 @@
+// Copyright (C) 2019  Joseph Artsimovich <joseph.artsimovich@gmail.com>, 4lex4 <4lex49@zoho.com>
+// Use of this source code is governed by the GNU GPLv3 license that can be found in the LICENSE file.
+
+#include <Despeckle.h>
+#include <NullTaskStatus.h>
+
+#include <memory>
+
+#include "Benchmark.h"
+#include "PageGenerator.h"
+
+using namespace imageproc;
+
+namespace benchmarks {
+namespace {
+Benchmark despeckleBenchmark(const QString& name, const Despeckle::Level level) {
+  return Benchmark(name, [level](const Dpi& dpi) {
+    const PageGenerator generator(dpi);
+    auto page = std::make_shared<BinaryImage>(generator.binaryPage());
+    return Benchmark::Setup{[page, dpi, level]() {
+                              // In-place, so every run has to start from a fresh copy, which is included in the timing.
+                              BinaryImage image(*page);
+                              Despeckle::despeckleInPlace(image, dpi, level, NullTaskStatus());
+                            },
+                            generator.megapixels()};
+  });
+}
+
+Benchmark despeckleAnalysisBenchmark() {
+  return Benchmark("core/DespeckleAnalysis", [](const Dpi& dpi) {
+    const PageGenerator generator(dpi);
+    auto page = std::make_shared<BinaryImage>(generator.binaryPage());
+    return Benchmark::Setup{[page, dpi]() { const DespeckleAnalysis analysis(*page, dpi, NullTaskStatus()); },
+                            generator.megapixels()};
+  });
+}
+
+Benchmark despeckleAnalysisSpecklesBenchmark() {
+  return Benchmark("core/DespeckleAnalysis::speckles", [](const Dpi& dpi) {
+    const PageGenerator generator(dpi);
+    auto analysis = std::make_shared<DespeckleAnalysis>(generator.binaryPage(), dpi, NullTaskStatus());
+    return Benchmark::Setup{[analysis]() { analysis->speckles(0.1 * 10); }, generator.megapixels()};
+  });
+}
+}  // namespace
+
+void addCoreBenchmarks(BenchmarkList& list) {
+  list.push_back(despeckleBenchmark("core/Despeckle::despeckleInPlace/cautious", Despeckle::CAUTIOUS));
+  list.push_back(despeckleBenchmark("core/Despeckle::despeckleInPlace/normal", Despeckle::NORMAL));
+  list.push_back(despeckleBenchmark("core/Despeckle::despeckleInPlace/aggressive", Despeckle::AGGRESSIVE));
+  list.push_back(despeckleAnalysisBenchmark());
+  list.push_back(despeckleAnalysisSpecklesBenchmark());
+}
+}  // namespace benchmarks
@@ -0,0 +1,50 @@
+// Copyright (C) 2019  Joseph Artsimovich <joseph.artsimovich@gmail.com>, 4lex4 <4lex49@zoho.com>
+// Use of this source code is governed by the GNU GPLv3 license that can be found in the LICENSE file.
+
+#include <Constants.h>
+#include <CylindricalSurfaceDewarper.h>
+#include <RasterDewarper.h>
+
+#include <QColor>
+#include <QRectF>
+#include <cmath>
+#include <memory>
+#include <vector>
+
+#include "Benchmark.h"
+#include "PageGenerator.h"
+
+using namespace dewarping;
+
+namespace benchmarks {
+namespace {
+/**
+ * A directrix bulging like the text lines near the spine of an open book.
+ */
+std::vector<QPointF> curvedDirectrix(const QSize& size, const double y, const double sag) {
+  std::vector<QPointF> points;
+  const int numPoints = 32;
+  for (int i = 0; i < numPoints; ++i) {
+    const double t = double(i) / (numPoints - 1);
+    points.emplace_back(t * (size.width() - 1), y + sag * std::sin(t * constants::PI) * (1.0 - t));
+  }
+  return points;
+}
+}  // namespace
+
+void addDewarpingBenchmarks(BenchmarkList& list) {
+  list.emplace_back("dewarping/RasterDewarper::dewarp", [](const Dpi& dpi) {
+    const PageGenerator generator(dpi);
+    auto page = std::make_shared<QImage>(generator.colorPage());
+    const QSize size(page->size());
+    const double sag = 0.03 * size.height();
+    auto dewarper = std::make_shared<CylindricalSurfaceDewarper>(
+        curvedDirectrix(size, 0.05 * size.height(), sag), curvedDirectrix(size, 0.95 * size.height(), -sag), 2.0);
+    return Benchmark::Setup{[page, dewarper, size]() {
+                              RasterDewarper::dewarp(*page, size, *dewarper, QRectF(QPointF(0, 0), QSizeF(size)),
+                                                     Qt::white);
+                            },
+                            generator.megapixels()};
+  });
+}
+}  // namespace benchmarks
@@ -0,0 +1,188 @@
+// Copyright (C) 2019  Joseph Artsimovich <joseph.artsimovich@gmail.com>, 4lex4 <4lex49@zoho.com>
+// Use of this source code is governed by the GNU GPLv3 license that can be found in the LICENSE file.
+
+#include <Binarize.h>
+#include <ColorSegmenter.h>
+#include <ConnectivityMap.h>
+#include <Morphology.h>
+#include <Posterizer.h>
+#include <RasterOp.h>
+#include <SEDM.h>
+#include <SavGolFilter.h>
+#include <SeedFill.h>
+#include <Transform.h>
+
+#include <QTransform>
+#include <algorithm>
+#include <memory>
+
+#include "Benchmark.h"
+#include "PageGenerator.h"
+
+using namespace imageproc;
+
+namespace benchmarks {
+namespace {
+QTransform smallRotation(const QSize& size) {
+  QTransform xform;
+  xform.translate(0.5 * size.width(), 0.5 * size.height());
+  xform.rotate(1.5);
+  xform.translate(-0.5 * size.width(), -0.5 * size.height());
+  return xform;
+}
+}  // namespace
+
+void addImageprocBenchmarks(BenchmarkList& list) {
+  list.emplace_back("imageproc/binarizeSauvola", [](const Dpi& dpi) {
+    const PageGenerator generator(dpi);
+    auto page = std::make_shared<QImage>(generator.grayPage().toQImage());
+    return Benchmark::Setup{[page]() { binarizeSauvola(*page, QSize(51, 51)); }, generator.megapixels()};
+  });
+
+  list.emplace_back("imageproc/binarizeWolf", [](const Dpi& dpi) {
+    const PageGenerator generator(dpi);
+    auto page = std::make_shared<QImage>(generator.grayPage().toQImage());
+    return Benchmark::Setup{[page]() { binarizeWolf(*page, QSize(51, 51)); }, generator.megapixels()};
+  });
+
+  list.emplace_back("imageproc/dilateBrick", [](const Dpi& dpi) {
+    const PageGenerator generator(dpi);
+    auto page = std::make_shared<BinaryImage>(generator.binaryPage());
+    return Benchmark::Setup{[page]() { dilateBrick(*page, Brick(QSize(9, 9))); }, generator.megapixels()};
+  });
+
+  list.emplace_back("imageproc/erodeBrick", [](const Dpi& dpi) {
+    const PageGenerator generator(dpi);
+    auto page = std::make_shared<BinaryImage>(generator.binaryPage());
+    return Benchmark::Setup{[page]() { erodeBrick(*page, Brick(QSize(9, 9))); }, generator.megapixels()};
+  });
+
+  // The bricks select_content::ContentBoxFinder uses, with either morphology backend.
+  for (const MorphologyBackend backend : {MorphologyBackend::WORD_PARALLEL, MorphologyBackend::RASTER_OP}) {
+    const char* name = (backend == MorphologyBackend::WORD_PARALLEL) ? "imageproc/openBrickContentBox"
+                                                                     : "imageproc/openBrickContentBoxRasterOp";
+    list.emplace_back(name, [backend](const Dpi& dpi) {
+      const PageGenerator generator(dpi);
+      auto page = std::make_shared<BinaryImage>(generator.binaryPage());
+      auto body = [page, backend]() {
+        const MorphologyBackend previous = morphologyBackend();
+        setMorphologyBackend(backend);
+        openBrick(*page, QSize(200, 14), BLACK);
+        openBrick(*page, QSize(14, 300), BLACK);
+        setMorphologyBackend(previous);
+      };
+      return Benchmark::Setup{body, generator.megapixels()};
+    });
+  }
+
+  list.emplace_back("imageproc/dilateGray", [](const Dpi& dpi) {
+    const PageGenerator generator(dpi);
+    auto page = std::make_shared<GrayImage>(generator.grayPage());
+    return Benchmark::Setup{[page]() { dilateGray(*page, Brick(QSize(9, 9))); }, generator.megapixels()};
+  });
+
+  list.emplace_back("imageproc/erodeGray35", [](const Dpi& dpi) {
+    const PageGenerator generator(dpi);
+    auto page = std::make_shared<GrayImage>(generator.grayPage());
+    return Benchmark::Setup{[page]() { erodeGray(*page, Brick(QSize(35, 35))); }, generator.megapixels()};
+  });
+
+  list.emplace_back("imageproc/ConnectivityMap", [](const Dpi& dpi) {
+    const PageGenerator generator(dpi);
+    auto page = std::make_shared<BinaryImage>(generator.binaryPage());
+    return Benchmark::Setup{[page]() { ConnectivityMap(*page, CONN8); }, generator.megapixels()};
+  });
+
+  list.emplace_back("imageproc/ColorSegmenter", [](const Dpi& dpi) {
+    const PageGenerator generator(dpi);
+    auto page = std::make_shared<QImage>(generator.colorPage());
+    auto mask = std::make_shared<BinaryImage>(generator.binaryPage());
+    const ColorSegmenter segmenter(dpi, 7);
+    return Benchmark::Setup{[page, mask, segmenter]() { segmenter.segment(*mask, *page); }, generator.megapixels()};
+  });
+
+  list.emplace_back("imageproc/posterize", [](const Dpi& dpi) {
+    const PageGenerator generator(dpi);
+    auto page = std::make_shared<QImage>(generator.colorPage());
+    return Benchmark::Setup{[page]() { Posterizer(8, true).posterize(*page); }, generator.megapixels()};
+  });
+
+  list.emplace_back("imageproc/savGolFilter", [](const Dpi& dpi) {
+    const PageGenerator generator(dpi);
+    auto page = std::make_shared<QImage>(generator.grayPage().toQImage());
+    return Benchmark::Setup{[page]() { savGolFilter(*page, QSize(7, 7), 4, 4); }, generator.megapixels()};
+  });
+
+  list.emplace_back("imageproc/SEDM", [](const Dpi& dpi) {
+    const PageGenerator generator(dpi);
+    auto page = std::make_shared<BinaryImage>(generator.binaryPage());
+    return Benchmark::Setup{[page]() { SEDM(*page, SEDM::DIST_TO_BLACK, SEDM::DIST_TO_ALL_BORDERS); },
+                            generator.megapixels()};
+  });
+
+  list.emplace_back("imageproc/SEDM16", [](const Dpi& dpi) {
+    const PageGenerator generator(dpi);
+    auto page = std::make_shared<BinaryImage>(generator.binaryPage());
+    return Benchmark::Setup{[page]() { SEDM16(*page, SEDM::DIST_TO_BLACK, SEDM::DIST_TO_ALL_BORDERS); },
+                            generator.megapixels()};
+  });
+
+  list.emplace_back("imageproc/seedFill", [](const Dpi& dpi) {
+    const PageGenerator generator(dpi);
+    auto mask = std::make_shared<BinaryImage>(generator.binaryPage());
+    // Seeds in a vertical stripe, to be spread over the connected glyphs.
+    auto seed = std::make_shared<BinaryImage>(mask->size(), WHITE);
+    const QRect stripe(mask->width() / 2, 0, std::max(1, mask->width() / 20), mask->height());
+    rasterOp<RopSrc>(*seed, stripe, *mask, stripe.topLeft());
+    return Benchmark::Setup{[seed, mask]() { seedFill(*seed, *mask, CONN8); }, generator.megapixels()};
+  });
+
+  list.emplace_back("imageproc/seedFillGray", [](const Dpi& dpi) {
+    const PageGenerator generator(dpi);
+    auto mask = std::make_shared<GrayImage>(generator.grayPage());
+    // Darkness spreading inwards from the page borders, like when filling holes.
+    auto seed = std::make_shared<GrayImage>(mask->size());
+    seed->fill(0xff);
+    for (int y = 0; y < seed->height(); ++y) {
+      uint8_t* line = seed->data() + y * seed->stride();
+      if ((y == 0) || (y == seed->height() - 1)) {
+        std::fill(line, line + seed->width(), 0);
+      }
+      line[0] = line[seed->width() - 1] = 0;
+    }
+    return Benchmark::Setup{[seed, mask]() { seedFillGray(*seed, *mask, CONN8); }, generator.megapixels()};
+  });
+
+  list.emplace_back("imageproc/transform", [](const Dpi& dpi) {
+    const PageGenerator generator(dpi);
+    auto page = std::make_shared<QImage>(generator.colorPage());
+    const QTransform xform(smallRotation(page->size()));
+    return Benchmark::Setup{[page, xform]() {
+                              transform(*page, xform, page->rect(), OutsidePixels::assumeColor(Qt::white));
+                            },
+                            generator.megapixels()};
+  });
+
+  list.emplace_back("imageproc/transformScale", [](const Dpi& dpi) {
+    const PageGenerator generator(dpi);
+    auto page = std::make_shared<QImage>(generator.colorPage());
+    QTransform xform;
+    xform.scale(0.5, 0.5);
+    const QRect dstRect(xform.mapRect(QRectF(page->rect())).toRect());
+    return Benchmark::Setup{[page, xform, dstRect]() {
+                              transform(*page, xform, dstRect, OutsidePixels::assumeColor(Qt::white));
+                            },
+                            generator.megapixels()};
+  });
+
+  list.emplace_back("imageproc/transformToGray", [](const Dpi& dpi) {
+    const PageGenerator generator(dpi);
+    auto page = std::make_shared<QImage>(generator.grayPage().toQImage());
+    const QTransform xform(smallRotation(page->size()));
+    return Benchmark::Setup{[page, xform]() {
+                              transformToGray(*page, xform, page->rect(), OutsidePixels::assumeColor(Qt::white));
+                            },
+                            generator.megapixels()};
+  });
+}  // addImageprocBenchmarks
+}  // namespace benchmarks
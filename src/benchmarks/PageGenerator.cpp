@@ -0,0 +1,134 @@
+// Copyright (C) 2019  Joseph Artsimovich <joseph.artsimovich@gmail.com>, 4lex4 <4lex49@zoho.com>
+// Use of this source code is governed by the GNU GPLv3 license that can be found in the LICENSE file.
+
+#include "PageGenerator.h"
+
+#include <Dpi.h>
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+using namespace imageproc;
+
+namespace benchmarks {
+namespace {
+const double A4_WIDTH_INCHES = 210.0 / 25.4;
+const double A4_HEIGHT_INCHES = 297.0 / 25.4;
+
+void fillRect(GrayImage& image, const QRect& rect, const uint8_t value) {
+  const QRect r(rect.intersected(image.rect()));
+  uint8_t* line = image.data() + r.top() * image.stride();
+  for (int y = r.top(); y <= r.bottom(); ++y, line += image.stride()) {
+    std::fill(line + r.left(), line + r.right() + 1, value);
+  }
+}
+}  // namespace
+
+PageGenerator::PageGenerator(const Dpi& dpi, const uint32_t seed)
+    : m_size(static_cast<int>(std::round(A4_WIDTH_INCHES * dpi.horizontal())),
+             static_cast<int>(std::round(A4_HEIGHT_INCHES * dpi.vertical()))),
+      m_dpi(dpi.horizontal()),
+      m_seed(seed) {}
+
+GrayImage PageGenerator::grayPage() const {
+  std::mt19937 rng(m_seed);
+  GrayImage page(m_size);
+  page.fill(0xff);
+
+  const int width = m_size.width();
+  const int height = m_size.height();
+  const int margin = m_dpi;                 // 1 inch
+  const int xHeight = std::max(2, m_dpi / 18);  // about 11pt text
+  const int lineSpacing = xHeight * 3;
+  const int stroke = std::max(1, xHeight / 5);
+
+  // A picture in the upper part of the page.
+  const QRect picture(margin, margin, width - 2 * margin, height / 5);
+  for (int y = picture.top(); y <= picture.bottom(); ++y) {
+    uint8_t* line = page.data() + y * page.stride();
+    for (int x = picture.left(); x <= picture.right(); ++x) {
+      const double v = 0.5 + 0.25 * std::sin(x * 0.02) + 0.25 * std::cos(y * 0.03 + x * 0.005);
+      line[x] = static_cast<uint8_t>(30 + 200 * v);
+    }
+  }
+
+  // Lines of words made of glyph-like strokes.
+  std::uniform_int_distribution<int> glyphWidth(xHeight / 2, xHeight);
+  std::uniform_int_distribution<int> wordLength(2, 9);
+  std::uniform_int_distribution<int> glyphShape(0, 5);
+  for (int baseline = picture.bottom() + lineSpacing * 2; baseline < height - margin; baseline += lineSpacing) {
+    int x = margin;
+    while (x < width - margin - xHeight * 4) {
+      const int numGlyphs = wordLength(rng);
+      for (int i = 0; i < numGlyphs; ++i) {
+        const int w = glyphWidth(rng);
+        const int shape = glyphShape(rng);
+        const int top = (shape == 0) ? baseline - xHeight * 3 / 2 : baseline - xHeight;
+        const int bottom = (shape == 1) ? baseline + xHeight / 2 : baseline;
+        fillRect(page, QRect(x, top, stroke, bottom - top), 20);
+        if (shape != 2) {
+          fillRect(page, QRect(x, baseline - xHeight, w, stroke), 20);
+        }
+        if (shape >= 3) {
+          fillRect(page, QRect(x + w - stroke, baseline - xHeight, stroke, xHeight), 20);
+          fillRect(page, QRect(x, baseline - stroke, w, stroke), 20);
+        }
+        x += w + stroke * 2;
+      }
+      x += xHeight;
+    }
+  }
+
+  // Uneven illumination and sensor noise.
+  std::normal_distribution<double> noise(0.0, 6.0);
+  for (int y = 0; y < height; ++y) {
+    uint8_t* line = page.data() + y * page.stride();
+    for (int x = 0; x < width; ++x) {
+      const double shade = 0.85 + 0.15 * (double(x) / width);
+      const double v = line[x] * shade + noise(rng);
+      line[x] = static_cast<uint8_t>(std::min(255.0, std::max(0.0, v)));
+    }
+  }
+  return page;
+}  // PageGenerator::grayPage
+
+QImage PageGenerator::colorPage() const {
+  const GrayImage gray(grayPage());
+  QImage page(m_size, QImage::Format_RGB32);
+  const int margin = m_dpi;
+  const QRect picture(margin, margin, m_size.width() - 2 * margin, m_size.height() / 5);
+
+  for (int y = 0; y < m_size.height(); ++y) {
+    const uint8_t* grayLine = gray.data() + y * gray.stride();
+    auto* line = reinterpret_cast<QRgb*>(page.scanLine(y));
+    for (int x = 0; x < m_size.width(); ++x) {
+      const int v = grayLine[x];
+      if (picture.contains(x, y)) {
+        line[x] = qRgb(v, (v * 3 / 4 + x) & 0xff, 255 - v / 2);
+      } else {
+        // Slightly yellowish paper.
+        line[x] = qRgb(v, v * 97 / 100, v * 88 / 100);
+      }
+    }
+  }
+  page.setDotsPerMeterX(static_cast<int>(std::round(m_dpi / 0.0254)));
+  page.setDotsPerMeterY(static_cast<int>(std::round(m_dpi / 0.0254)));
+  return page;
+}
+
+BinaryImage PageGenerator::binaryPage() const {
+  BinaryImage page(grayPage().toQImage(), BinaryThreshold(128));
+
+  // Speckles of up to about 0.3 mm.
+  std::mt19937 rng(m_seed + 1);
+  std::uniform_int_distribution<int> xDist(0, m_size.width() - 1);
+  std::uniform_int_distribution<int> yDist(0, m_size.height() - 1);
+  std::uniform_int_distribution<int> sizeDist(1, std::max(1, m_dpi / 80));
+  const int numSpeckles = static_cast<int>(megapixels() * 500);
+  for (int i = 0; i < numSpeckles; ++i) {
+    page.fill(QRect(xDist(rng), yDist(rng), sizeDist(rng), sizeDist(rng)).intersected(page.rect()), BLACK);
+  }
+  return page;
+}
+}  // namespace benchmarks
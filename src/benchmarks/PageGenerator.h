@@ -0,0 +1,51 @@
+// Copyright (C) 2019  Joseph Artsimovich <joseph.artsimovich@gmail.com>, 4lex4 <4lex49@zoho.com>
+// Use of this source code is governed by the GNU GPLv3 license that can be found in the LICENSE file.
+
+#ifndef SCANTAILOR_BENCHMARKS_PAGEGENERATOR_H_
+#define SCANTAILOR_BENCHMARKS_PAGEGENERATOR_H_
+
+#include <BinaryImage.h>
+#include <GrayImage.h>
+
+#include <QImage>
+#include <QSize>
+#include <cstdint>
+
+class Dpi;
+
+namespace benchmarks {
+/**
+ * \brief Generates synthetic scans of book pages.
+ *
+ * The pages are A4 at the given resolution and contain lines of text-like
+ * glyphs, a picture, uneven illumination and sensor noise, which is enough
+ * for the algorithms to take their realistic code paths.  The same seed
+ * always gives the same page.
+ */
+class PageGenerator {
+ public:
+  explicit PageGenerator(const Dpi& dpi, uint32_t seed = 1);
+
+  const QSize& size() const { return m_size; }
+
+  double megapixels() const { return m_size.width() * double(m_size.height()) / 1e6; }
+
+  imageproc::GrayImage grayPage() const;
+
+  /**
+   * \brief The gray page on tinted paper with a colored picture.
+   */
+  QImage colorPage() const;
+
+  /**
+   * \brief The gray page binarized, with speckles added.
+   */
+  imageproc::BinaryImage binaryPage() const;
+
+ private:
+  QSize m_size;
+  int m_dpi;
+  uint32_t m_seed;
+};
+}  // namespace benchmarks
+#endif  // ifndef SCANTAILOR_BENCHMARKS_PAGEGENERATOR_H_
@@ -0,0 +1,119 @@
+// Copyright (C) 2019  Joseph Artsimovich <joseph.artsimovich@gmail.com>, 4lex4 <4lex49@zoho.com>
+// Use of this source code is governed by the GNU GPLv3 license that can be found in the LICENSE file.
+
+#include <ParallelFor.h>
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QRegularExpression>
+#include <QTextStream>
+#include <algorithm>
+
+#include "Benchmark.h"
+#include "BenchmarkRunner.h"
+#include "version.h"
+
+using namespace benchmarks;
+
+int main(int argc, char* argv[]) {
+  QCoreApplication app(argc, argv);
+
+  QTextStream out(stdout);
+  QTextStream err(stderr);
+
+  QCommandLineParser parser;
+  parser.setApplicationDescription("Runs the performance benchmarks on synthetic pages.");
+  parser.addHelpOption();
+  const QCommandLineOption listOption(QStringList() << "l" << "list", "List the benchmarks and exit.");
+  const QCommandLineOption filterOption(QStringList() << "f" << "filter",
+                                        "Only run the benchmarks whose names match <regex>.", "regex");
+  const QCommandLineOption dpiOption("dpi", "The resolution of the synthetic pages (default: 300).", "dpi", "300");
+  const QCommandLineOption warmupOption("warmup", "The number of untimed runs (default: 1).", "count", "1");
+  const QCommandLineOption runsOption("runs", "The minimum number of timed runs (default: 5).", "count", "5");
+  const QCommandLineOption minTimeOption("min-time", "The minimum total time of the timed runs (default: 1).",
+                                         "seconds", "1");
+  const QCommandLineOption singleThreadOption("single-thread", "Disable parallel processing of image bands.");
+  const QCommandLineOption jsonOption(QStringList() << "j" << "json", "Write the results as JSON into <file>.",
+                                      "file");
+  parser.addOption(listOption);
+  parser.addOption(filterOption);
+  parser.addOption(dpiOption);
+  parser.addOption(warmupOption);
+  parser.addOption(runsOption);
+  parser.addOption(minTimeOption);
+  parser.addOption(singleThreadOption);
+  parser.addOption(jsonOption);
+  parser.process(app);
+
+  BenchmarkList benchmarks;
+  addImageprocBenchmarks(benchmarks);
+  addDewarpingBenchmarks(benchmarks);
+  addCoreBenchmarks(benchmarks);
+
+  if (parser.isSet(listOption)) {
+    for (const Benchmark& benchmark : benchmarks) {
+      out << benchmark.name() << '\n';
+    }
+    return 0;
+  }
+
+  const QRegularExpression filter(parser.value(filterOption));
+  if (!filter.isValid()) {
+    err << "Invalid filter: " << filter.errorString() << '\n';
+    return 1;
+  }
+
+  RunOptions options;
+  const int dpi = parser.value(dpiOption).toInt();
+  if (dpi <= 0) {
+    err << "Invalid DPI\n";
+    return 1;
+  }
+  options.dpi = Dpi(dpi, dpi);
+  options.warmupRuns = std::max(0, parser.value(warmupOption).toInt());
+  options.minRuns = std::max(1, parser.value(runsOption).toInt());
+  options.minSeconds = std::max(0.0, parser.value(minTimeOption).toDouble());
+  options.maxRuns = std::max(options.minRuns, options.maxRuns);
+  if (parser.isSet(singleThreadOption)) {
+    setParallelForEnabled(false);
+  }
+
+  const BenchmarkRunner runner(options);
+  QJsonArray results;
+  for (const Benchmark& benchmark : benchmarks) {
+    if (!filter.match(benchmark.name()).hasMatch()) {
+      continue;
+    }
+    const RunResult result(runner.run(benchmark));
+    out << QString("%1 %2 ms (min %3, runs %4)  %5 MP/s  peak RSS %6 MiB")
+               .arg(result.name, -48)
+               .arg(result.medianMs, 9, 'f', 2)
+               .arg(result.minMs, 0, 'f', 2)
+               .arg(result.runs)
+               .arg(result.throughput, 8, 'f', 2)
+               .arg(result.peakRssKb / 1024)
+        << '\n';
+    out.flush();
+    results.append(result.toJson());
+  }
+
+  if (parser.isSet(jsonOption)) {
+    QJsonObject root;
+    root["version"] = QString(VERSION);
+    root["dpi"] = dpi;
+    root["threads"] = parallelForMaxThreads();
+    root["warmup_runs"] = options.warmupRuns;
+    root["benchmarks"] = results;
+
+    QFile file(parser.value(jsonOption));
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+      err << "Can't write " << file.fileName() << '\n';
+      return 1;
+    }
+    file.write(QJsonDocument(root).toJson());
+  }
+  return 0;
+}
@@ -0,0 +1,290 @@
+// Copyright (C) 2019  Joseph Artsimovich <joseph.artsimovich@gmail.com>, 4lex4 <4lex49@zoho.com>
+// Use of this source code is governed by the GNU GPLv3 license that can be found in the LICENSE file.
+
+#include "ConsoleBatch.h"
+
+#include <QDir>
+#include <QEventLoop>
+#include <cassert>
+
+#include "FileNameDisambiguator.h"
+#include "LoadFileTask.h"
+#include "OutOfMemoryHandler.h"
+#include "PageMemoryEstimate.h"
+#include "PageSelectionAccessor.h"
+#include "ProcessingTaskQueue.h"
+#include "ProjectJournal.h"
+#include "ProjectPages.h"
+#include "ProjectReader.h"
+#include "ProjectWriter.h"
+#include "StageSequence.h"
+#include "ThumbnailPixmapCache.h"
+#include "Utils.h"
+#include "WorkerThreadPool.h"
+#include "filters/deskew/Task.h"
+#include "filters/fix_orientation/Task.h"
+#include "filters/output/Task.h"
+#include "filters/page_layout/Task.h"
+#include "filters/page_split/Task.h"
+#include "filters/select_content/Task.h"
+
+namespace {
+/**
+ * There is no thumbnail view in console mode, so "selected pages"
+ * (used by the "Apply To" dialogs) is the whole project.
+ */
+class AllPagesSelectionProvider : public PageSelectionProvider {
+ public:
+  explicit AllPagesSelectionProvider(std::shared_ptr<ProjectPages> pages) : m_pages(std::move(pages)) {}
+
+  PageSequence allPages() const override { return m_pages->toPageSequence(PAGE_VIEW); }
+
+  std::set<PageId> selectedPages() const override { return allPages().selectAll(); }
+
+  std::vector<PageRange> selectedRanges() const override { return std::vector<PageRange>(); }
+
+ private:
+  std::shared_ptr<ProjectPages> m_pages;
+};
+
+QString pageName(const PageId& pageId) {
+  QString name = QDir::toNativeSeparators(pageId.imageId().filePath());
+  if (pageId.imageId().isMultiPageFile()) {
+    name += QString("#%1").arg(pageId.imageId().page());
+  }
+  if (pageId.subPage() != PageId::SINGLE_PAGE) {
+    name += QString(" (%1)").arg(pageId.subPageAsString());
+  }
+  return name;
+}
+}  // namespace
+
+ConsoleBatch::ConsoleBatch(const ProjectReader& projectReader)
+    : m_pages(projectReader.pages()),
+      m_selectedPage(projectReader.selectedPage()),
+      m_workerThreadPool(std::make_unique<WorkerThreadPool>()),
+      m_eventLoop(nullptr),
+      m_out(nullptr),
+      m_lastFilterIdx(-1),
+      m_numProcessed(0),
+      m_numFailed(0),
+      m_numPassProcessed(0),
+      m_numPassTotal(0),
+      m_outOfMemory(false) {
+  const QString& outDir = projectReader.outputDirectory();
+  Utils::maybeCreateCacheDir(outDir);
+
+  std::shared_ptr<FileNameDisambiguator> disambiguator = projectReader.namingDisambiguator();
+  if (!disambiguator) {
+    disambiguator = std::make_shared<FileNameDisambiguator>();
+  }
+  m_outFileNameGen = OutputFileNameGenerator(disambiguator, outDir, m_pages->layoutDirection());
+
+  m_stages = std::make_shared<StageSequence>(
+      m_pages, PageSelectionAccessor(std::make_shared<AllPagesSelectionProvider>(m_pages)));
+  projectReader.readFilterSettings(m_stages->filters());
+  m_lastFilterIdx = m_stages->count() - 1;
+
+  m_thumbnailCache = Utils::createThumbnailCache(m_outFileNameGen.outDir());
+  m_intermediateCache = Utils::createIntermediateImageCache(m_outFileNameGen.outDir());
+
+  connect(m_workerThreadPool.get(), SIGNAL(taskResult(const BackgroundTaskPtr&, const FilterResultPtr&)), this,
+          SLOT(taskResult(const BackgroundTaskPtr&, const FilterResultPtr&)));
+  connect(&OutOfMemoryHandler::instance(), SIGNAL(outOfMemory()), SLOT(outOfMemory()));
+}
+
+ConsoleBatch::~ConsoleBatch() {
+  if (m_queue) {
+    m_queue->cancelAndClear();
+  }
+  m_workerThreadPool->shutdown();
+}
+
+void ConsoleBatch::setNumberOfThreads(const int numThreads) {
+  m_workerThreadPool->setMaxThreadCount(numThreads);
+}
+
+void ConsoleBatch::setMemoryBudget(const int megabytes) {
+  m_workerThreadPool->setMemoryBudget(megabytes);
+}
+
+void ConsoleBatch::setLastFilterIdx(const int lastFilterIdx) {
+  m_lastFilterIdx = qBound(0, lastFilterIdx, m_stages->count() - 1);
+}
+
+int ConsoleBatch::stageCount() const {
+  return m_stages->count();
+}
+
+int ConsoleBatch::process(QTextStream& out) {
+  m_out = &out;
+  m_numProcessed = 0;
+  m_numFailed = 0;
+
+  QElapsedTimer totalTimer;
+  totalTimer.start();
+
+  // Page splitting changes the set of logical pages, so the image-level stages
+  // have to be finished for every image before the logical pages can be enumerated.
+  // That's what the user does in the GUI by going through the stages one by one.
+  const int pageSplitIdx = m_stages->pageSplitFilterIdx();
+  const PageView lastView = m_stages->filterAt(m_lastFilterIdx)->getView();
+  if ((m_lastFilterIdx > pageSplitIdx) && (lastView == PAGE_VIEW)) {
+    runPass(m_pages->toPageSequence(IMAGE_VIEW), pageSplitIdx, m_stages->filterAt(pageSplitIdx)->getName());
+  }
+  if (!m_outOfMemory) {
+    runPass(m_pages->toPageSequence(lastView), m_lastFilterIdx, m_stages->filterAt(m_lastFilterIdx)->getName());
+  }
+
+  out << QString("Processed %1 page(s) in %2 s, %3 failed.\n")
+             .arg(m_numProcessed)
+             .arg(totalTimer.elapsed() / 1000.0, 0, 'f', 3)
+             .arg(m_numFailed);
+  if (m_outOfMemory) {
+    out << "Out of memory.\n";
+  }
+  out.flush();
+
+  m_out = nullptr;
+  if (m_outOfMemory) {
+    return EXIT_OUT_OF_MEMORY;
+  }
+  return (m_numFailed > 0) ? EXIT_PAGES_FAILED : EXIT_OK;
+}  // ConsoleBatch::process
+
+bool ConsoleBatch::saveProject(const QString& projectFile) const {
+  const ProjectWriter writer(m_pages, m_selectedPage, m_outFileNameGen);
+  if (!writer.write(projectFile, m_stages->filters())) {
+    return false;
+  }
+  // A journal of an earlier version of the file no longer applies to it.
+  ProjectJournal::remove(projectFile);
+  return true;
+}
+
+void ConsoleBatch::runPass(const PageSequence& pages, const int lastFilterIdx, const QString& passName) {
+  m_passName = passName;
+  m_numPassTotal = static_cast<int>(pages.numPages());
+  m_numPassProcessed = 0;
+
+  m_queue = std::make_unique<ProcessingTaskQueue>();
+  for (const PageInfo& page : pages) {
+    for (int i = 0; i <= lastFilterIdx; ++i) {
+      m_stages->filterAt(i)->loadDefaultSettings(page);
+    }
+    const BackgroundTaskPtr task = createCompositeTask(page, lastFilterIdx);
+    m_queue->addProcessingTask(page, task);
+    m_pageRecords[task.get()].page = page;
+  }
+
+  submitTasks();
+  if (!m_queue->allProcessed()) {
+    QEventLoop eventLoop;
+    m_eventLoop = &eventLoop;
+    eventLoop.exec();
+    m_eventLoop = nullptr;
+  }
+  m_queue.reset();
+  m_pageRecords.clear();
+}
+
+void ConsoleBatch::submitTasks() {
+  while (m_workerThreadPool->hasSpareCapacity()) {
+    const BackgroundTaskPtr task(m_queue->takeForProcessing());
+    if (!task) {
+      break;
+    }
+    m_pageRecords[task.get()].timer.start();
+    m_workerThreadPool->submitTask(task);
+  }
+}
+
+void ConsoleBatch::taskResult(const BackgroundTaskPtr& task, const FilterResultPtr& result) {
+  if (!m_queue) {
+    return;
+  }
+  m_queue->processingFinished(task);
+
+  const auto it = m_pageRecords.find(task.get());
+  if (it != m_pageRecords.end()) {
+    // LoadFileTask reports a missing or unreadable file by a result without a filter.
+    reportPage(it->second, !result->filter());
+    m_pageRecords.erase(it);
+  }
+
+  if (m_queue->allProcessed()) {
+    if (m_eventLoop) {
+      m_eventLoop->quit();
+    }
+    return;
+  }
+  submitTasks();
+}
+
+void ConsoleBatch::outOfMemory() {
+  m_outOfMemory = true;
+  if (m_queue) {
+    m_queue->cancelAndClear();
+  }
+  // The task that ran out of memory will never report back,
+  // so wait for the rest of them and give up.
+  m_workerThreadPool->shutdown();
+  if (m_eventLoop) {
+    m_eventLoop->quit();
+  }
+}
+
+BackgroundTaskPtr ConsoleBatch::createCompositeTask(const PageInfo& page, const int lastFilterIdx) {
+  // This mirrors MainWindow::createCompositeTask() in batch mode.
+  std::shared_ptr<fix_orientation::Task> fixOrientationTask;
+  std::shared_ptr<page_split::Task> pageSplitTask;
+  std::shared_ptr<deskew::Task> deskewTask;
+  std::shared_ptr<select_content::Task> selectContentTask;
+  std::shared_ptr<page_layout::Task> pageLayoutTask;
+  std::shared_ptr<output::Task> outputTask;
+
+  if (lastFilterIdx >= m_stages->outputFilterIdx()) {
+    outputTask = m_stages->outputFilter()->createTask(page.id(), m_thumbnailCache, m_outFileNameGen, true, false);
+  }
+  if (lastFilterIdx >= m_stages->pageLayoutFilterIdx()) {
+    pageLayoutTask = m_stages->pageLayoutFilter()->createTask(page.id(), outputTask, true, false);
+  }
+  if (lastFilterIdx >= m_stages->selectContentFilterIdx()) {
+    selectContentTask = m_stages->selectContentFilter()->createTask(page.id(), pageLayoutTask, true, false);
+  }
+  if (lastFilterIdx >= m_stages->deskewFilterIdx()) {
+    deskewTask = m_stages->deskewFilter()->createTask(page.id(), selectContentTask, true, false);
+  }
+  if (lastFilterIdx >= m_stages->pageSplitFilterIdx()) {
+    pageSplitTask = m_stages->pageSplitFilter()->createTask(page, deskewTask, true, false);
+  }
+  if (lastFilterIdx >= m_stages->fixOrientationFilterIdx()) {
+    fixOrientationTask = m_stages->fixOrientationFilter()->createTask(page.id(), pageSplitTask, true);
+  }
+  assert(fixOrientationTask);
+  auto task = std::make_shared<LoadFileTask>(BackgroundTask::BATCH, page, m_thumbnailCache, m_intermediateCache,
+                                             m_pages, fixOrientationTask);
+  task->setEstimatedMemoryUsage(outputTask ? m_stages->outputFilter()->estimateMemoryUsage(page)
+                                           : PageMemoryEstimate::forSource(page.metadata()));
+  return task;
+}
+
+void ConsoleBatch::reportPage(const PageRecord& record, const bool failed) {
+  ++m_numProcessed;
+  ++m_numPassProcessed;
+  if (failed) {
+    ++m_numFailed;
+  }
+  if (!m_out) {
+    return;
+  }
+
+  *m_out << QString("[%1/%2]\t%3\t%4\t%5 ms\t%6\n")
+                .arg(m_numPassProcessed, QString::number(m_numPassTotal).size())
+                .arg(m_numPassTotal)
+                .arg(m_passName)
+                .arg(failed ? "FAILED" : "OK")
+                .arg(record.timer.elapsed())
+                .arg(pageName(record.page.id()));
+  m_out->flush();
+}
@@ -0,0 +1,132 @@
+// Copyright (C) 2019  Joseph Artsimovich <joseph.artsimovich@gmail.com>, 4lex4 <4lex49@zoho.com>
+// Use of this source code is governed by the GNU GPLv3 license that can be found in the LICENSE file.
+
+#ifndef SCANTAILOR_CLI_CONSOLEBATCH_H_
+#define SCANTAILOR_CLI_CONSOLEBATCH_H_
+
+#include <QElapsedTimer>
+#include <QObject>
+#include <QString>
+#include <QTextStream>
+#include <memory>
+#include <unordered_map>
+
+#include "BackgroundTask.h"
+#include "FilterResult.h"
+#include "NonCopyable.h"
+#include "OutputFileNameGenerator.h"
+#include "PageSequence.h"
+#include "SelectedPage.h"
+
+class IntermediateImageCache;
+class ProjectPages;
+class ProjectReader;
+class QEventLoop;
+class StageSequence;
+class ThumbnailPixmapCache;
+class WorkerThreadPool;
+class ProcessingTaskQueue;
+
+/**
+ * \brief Runs the processing pipeline of a project without any user interface.
+ *
+ * The same task chain as MainWindow::startBatchProcessing() is built for every page
+ * and fed to a WorkerThreadPool.  Results are never passed to FilterResult::updateUI(),
+ * so nothing is ever shown on screen.
+ */
+class ConsoleBatch : public QObject {
+  Q_OBJECT
+  DECLARE_NON_COPYABLE(ConsoleBatch)
+
+ public:
+  enum ExitCode {
+    EXIT_OK = 0,
+    EXIT_BAD_ARGUMENTS = 1,
+    EXIT_PROJECT_ERROR = 2,
+    EXIT_PAGES_FAILED = 3,
+    EXIT_OUT_OF_MEMORY = 4,
+    EXIT_SAVE_ERROR = 5
+  };
+
+  explicit ConsoleBatch(const ProjectReader& projectReader);
+
+  ~ConsoleBatch() override;
+
+  /**
+   * \brief The number of worker threads to use.
+   *
+   * A non-positive value means using the value from the application settings.
+   */
+  void setNumberOfThreads(int numThreads);
+
+  /**
+   * \brief The memory the pages being processed at the same time may take, in MiB.
+   *
+   * 0 means no limit, while a negative value means using the value from
+   * the application settings, or a part of the physical memory.
+   */
+  void setMemoryBudget(int megabytes);
+
+  /**
+   * \brief The index of the last stage to run, 0 being "Fix Orientation".
+   *
+   * By default all the stages are run.
+   */
+  void setLastFilterIdx(int lastFilterIdx);
+
+  int stageCount() const;
+
+  /**
+   * \brief Processes all the pages of the project.
+   *
+   * Blocks until all the pages are processed, running a local event loop.
+   * Per-page timings are written to \p out as they become available.
+   *
+   * \return One of ExitCode values.
+   */
+  int process(QTextStream& out);
+
+  bool saveProject(const QString& projectFile) const;
+
+ private slots:
+
+  void taskResult(const BackgroundTaskPtr& task, const FilterResultPtr& result);
+
+  void outOfMemory();
+
+ private:
+  struct PageRecord {
+    PageInfo page;
+    QElapsedTimer timer;
+  };
+
+  void runPass(const PageSequence& pages, int lastFilterIdx, const QString& passName);
+
+  void submitTasks();
+
+  BackgroundTaskPtr createCompositeTask(const PageInfo& page, int lastFilterIdx);
+
+  void reportPage(const PageRecord& record, bool failed);
+
+  std::shared_ptr<ProjectPages> m_pages;
+  std::shared_ptr<StageSequence> m_stages;
+  std::shared_ptr<ThumbnailPixmapCache> m_thumbnailCache;
+  std::shared_ptr<IntermediateImageCache> m_intermediateCache;
+  OutputFileNameGenerator m_outFileNameGen;
+  SelectedPage m_selectedPage;
+  std::unique_ptr<WorkerThreadPool> m_workerThreadPool;
+  std::unique_ptr<ProcessingTaskQueue> m_queue;
+  std::unordered_map<BackgroundTask*, PageRecord> m_pageRecords;
+  QEventLoop* m_eventLoop;
+  QTextStream* m_out;
+  QString m_passName;
+  int m_lastFilterIdx;
+  int m_numProcessed;
+  int m_numFailed;
+  int m_numPassProcessed;
+  int m_numPassTotal;
+  bool m_outOfMemory;
+};
+
+
+#endif  // ifndef SCANTAILOR_CLI_CONSOLEBATCH_H_
@@ -0,0 +1,163 @@
+// Copyright (C) 2019  Joseph Artsimovich <joseph.artsimovich@gmail.com>, 4lex4 <4lex49@zoho.com>
+// Use of this source code is governed by the GNU GPLv3 license that can be found in the LICENSE file.
+
+#include <config.h>
+#include <core/Application.h>
+#include <foundation/Tracer.h>
+
+#include <QCommandLineParser>
+#include <QDomDocument>
+#include <QFile>
+#include <QSettings>
+#include <QTextStream>
+
+#include "ConsoleBatch.h"
+#include "OutOfMemoryHandler.h"
+#include "ProjectJournal.h"
+#include "ProjectPages.h"
+#include "ProjectReader.h"
+#include "version.h"
+
+int main(int argc, char* argv[]) {
+  // The filter stages create their option widgets even if those are never shown,
+  // so a QApplication is still needed.  Make sure it doesn't need a display.
+  if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM")) {
+    qputenv("QT_QPA_PLATFORM", QByteArrayLiteral("offscreen"));
+  }
+  Application app(argc, argv);
+
+  // This information is used by QSettings.
+  Application::setApplicationName(APPLICATION_NAME);
+  Application::setOrganizationName(ORGANIZATION_NAME);
+
+  QSettings::setDefaultFormat(QSettings::IniFormat);
+  if (app.isPortableVersion()) {
+    QSettings::setPath(QSettings::IniFormat, QSettings::UserScope, app.getPortableConfigPath());
+  }
+
+  QTextStream out(stdout);
+  QTextStream err(stderr);
+
+  QCommandLineParser parser;
+  parser.setApplicationDescription("Processes a Scan Tailor project without user interface.");
+  parser.addHelpOption();
+  parser.addPositionalArgument("project", "The project file to process.");
+  const QCommandLineOption threadsOption(
+      QStringList() << "t" << "threads", "The number of worker threads (default: from the application settings).",
+      "count");
+  const QCommandLineOption memoryOption(
+      QStringList() << "m" << "memory-budget",
+      "The memory the pages processed at the same time may take, in MiB, 0 meaning no limit "
+      "(default: from the application settings, or 3/4 of the physical memory).",
+      "megabytes");
+  const QCommandLineOption endFilterOption(
+      QStringList() << "e" << "end-filter", "The number of the last stage to run, from 1 to 6 (default: 6).", "stage");
+  const QCommandLineOption saveOption(QStringList() << "s" << "save",
+                                      "Save the updated settings back into the project file.");
+  const QCommandLineOption saveAsOption("save-as", "Save the updated project into <file>.", "file");
+  const QCommandLineOption traceOption(
+      "trace", "Write a Chrome trace of the processing into <file> (default: $SCANTAILOR_TRACE).", "file");
+  parser.addOption(threadsOption);
+  parser.addOption(memoryOption);
+  parser.addOption(endFilterOption);
+  parser.addOption(saveOption);
+  parser.addOption(saveAsOption);
+  parser.addOption(traceOption);
+  parser.process(app);
+
+  const QStringList positionalArgs = parser.positionalArguments();
+  if (positionalArgs.size() != 1) {
+    err << parser.helpText();
+    return ConsoleBatch::EXIT_BAD_ARGUMENTS;
+  }
+  const QString projectFile = positionalArgs.front();
+
+  int numThreads = 0;
+  if (parser.isSet(threadsOption)) {
+    bool ok = false;
+    numThreads = parser.value(threadsOption).toInt(&ok);
+    if (!ok || (numThreads <= 0)) {
+      err << "Invalid number of threads: " << parser.value(threadsOption) << '\n';
+      return ConsoleBatch::EXIT_BAD_ARGUMENTS;
+    }
+  }
+
+  int memoryBudget = -1;
+  if (parser.isSet(memoryOption)) {
+    bool ok = false;
+    memoryBudget = parser.value(memoryOption).toInt(&ok);
+    if (!ok || (memoryBudget < 0)) {
+      err << "Invalid memory budget: " << parser.value(memoryOption) << '\n';
+      return ConsoleBatch::EXIT_BAD_ARGUMENTS;
+    }
+  }
+
+  QDomDocument doc;
+  {
+    QFile file(projectFile);
+    if (!file.open(QIODevice::ReadOnly)) {
+      err << "Unable to open the project file: " << projectFile << '\n';
+      return ConsoleBatch::EXIT_PROJECT_ERROR;
+    }
+    const QByteArray projectData(file.readAll());
+    if (!doc.setContent(projectData)) {
+      err << "The project file is broken: " << projectFile << '\n';
+      return ConsoleBatch::EXIT_PROJECT_ERROR;
+    }
+    ProjectJournal::replay(projectFile, projectData, doc);
+  }
+
+  const ProjectReader reader(doc, projectFile);
+  if (!reader.success()) {
+    if (!reader.getVersion().isNull() && (reader.getVersion().toInt() != PROJECT_VERSION)) {
+      err << "The project file is not compatible with the current application version.\n";
+    } else {
+      err << "Unable to interpret the project file.\n";
+    }
+    return ConsoleBatch::EXIT_PROJECT_ERROR;
+  }
+  if (!reader.pages()->validateDpis()) {
+    err << "Some images in the project have no valid DPI. Fix them in the GUI first.\n";
+    return ConsoleBatch::EXIT_PROJECT_ERROR;
+  }
+
+  OutOfMemoryHandler::instance().allocateEmergencyMemory(3 * 1024 * 1024);
+
+  ConsoleBatch batch(reader);
+  batch.setNumberOfThreads(numThreads);
+  batch.setMemoryBudget(memoryBudget);
+  if (parser.isSet(endFilterOption)) {
+    bool ok = false;
+    const int stage = parser.value(endFilterOption).toInt(&ok);
+    if (!ok || (stage < 1) || (stage > batch.stageCount())) {
+      err << "Invalid stage number: " << parser.value(endFilterOption) << '\n';
+      return ConsoleBatch::EXIT_BAD_ARGUMENTS;
+    }
+    batch.setLastFilterIdx(stage - 1);
+  }
+
+  int exitCode;
+  {
+    const TraceSession traceSession(parser.isSet(traceOption) ? parser.value(traceOption)
+                                                              : TraceSession::filePathFromEnvironment());
+    exitCode = batch.process(out);
+  }
+  if (exitCode == ConsoleBatch::EXIT_OUT_OF_MEMORY) {
+    // The settings may be in an inconsistent state, don't save them.
+    return exitCode;
+  }
+
+  QString saveFile;
+  if (parser.isSet(saveAsOption)) {
+    saveFile = parser.value(saveAsOption);
+  } else if (parser.isSet(saveOption)) {
+    saveFile = projectFile;
+  }
+  if (!saveFile.isEmpty() && !batch.saveProject(saveFile)) {
+    err << "Error saving the project file: " << saveFile << '\n';
+    if (exitCode == ConsoleBatch::EXIT_OK) {
+      exitCode = ConsoleBatch::EXIT_SAVE_ERROR;
+    }
+  }
+  return exitCode;
+}  // main
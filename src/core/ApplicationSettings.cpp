@@ -13,6 +13,7 @@ const QString ApplicationSettings::DEFAULT_COLOR_SCHEME = "dark";
 const bool ApplicationSettings::DEFAULT_AUTO_SAVE_PROJECT = false;
 const int ApplicationSettings::DEFAULT_TIFF_BW_COMPRESSION = COMPRESSION_CCITTFAX4;
 const int ApplicationSettings::DEFAULT_TIFF_COLOR_COMPRESSION = COMPRESSION_LZW;
+const int ApplicationSettings::DEFAULT_TIFF_COMPRESSION_LEVEL = 0;
 const bool ApplicationSettings::DEFAULT_BLACK_ON_WHITE_DETECTION = true;
 const bool ApplicationSettings::DEFAULT_BLACK_ON_WHITE_DETECTION_OUTPUT = true;
 const bool ApplicationSettings::DEFAULT_HIGHLIGHT_DEVIATION = true;
@@ -36,6 +37,7 @@ const QString ApplicationSettings::AUTO_SAVE_PROJECT_KEY = "auto_save_project";
 const QString ApplicationSettings::COLOR_SCHEME_KEY = "color_scheme";
 const QString ApplicationSettings::TIFF_BW_COMPRESSION_KEY = "bw_compression";
 const QString ApplicationSettings::TIFF_COLOR_COMPRESSION_KEY = "color_compression";
+const QString ApplicationSettings::TIFF_COMPRESSION_LEVEL_KEY = "compression_level";
 const QString ApplicationSettings::BLACK_ON_WHITE_DETECTION_KEY = "black_on_white_detection";
 const QString ApplicationSettings::BLACK_ON_WHITE_DETECTION_OUTPUT_KEY = "black_on_white_detection_at_output";
 const QString ApplicationSettings::HIGHLIGHT_DEVIATION_KEY = "highlight_deviation";
@@ -54,8 +56,10 @@ const QString ApplicationSettings::CURRENT_PROFILE_KEY = "current_profile";
 const QString ApplicationSettings::SHOW_CANCELING_SELECTION_QUESTION_KEY = "selection_canceling_question";
 const QString ApplicationSettings::DEFAULT_ZONE_CREATION_MODE_KEY = "default_zone_creation_mode";
 const QString ApplicationSettings::OUTPUT_SHOW_GUIDES_KEY = "output_show_guides";
+const QString ApplicationSettings::INTERMEDIATE_CACHE_SIZE_KEY = "intermediate_cache_size_mb";
 const int ApplicationSettings::DEFAULT_ZONE_CREATION_MODE = 0;  // POLYGONAL
 const bool ApplicationSettings::DEFAULT_OUTPUT_SHOW_GUIDES = false;
+const int ApplicationSettings::DEFAULT_INTERMEDIATE_CACHE_SIZE_MB = 2048;
 
 QString ApplicationSettings::getKey(const QString& keyName) {
   return ApplicationSettings::ROOT_KEY + '/' + keyName;
@@ -108,6 +112,14 @@ void ApplicationSettings::setTiffColorCompression(int compression) {
   m_settings.setValue(getKey(TIFF_COLOR_COMPRESSION_KEY), compression);
 }
 
+int ApplicationSettings::getTiffCompressionLevel() const {
+  return m_settings.value(getKey(TIFF_COMPRESSION_LEVEL_KEY), DEFAULT_TIFF_COMPRESSION_LEVEL).toInt();
+}
+
+void ApplicationSettings::setTiffCompressionLevel(int level) {
+  m_settings.setValue(getKey(TIFF_COMPRESSION_LEVEL_KEY), level);
+}
+
 bool ApplicationSettings::isBlackOnWhiteDetectionEnabled() const {
   return m_settings.value(getKey(BLACK_ON_WHITE_DETECTION_KEY), DEFAULT_BLACK_ON_WHITE_DETECTION).toBool();
 }
@@ -258,3 +270,11 @@ bool ApplicationSettings::isOutputShowGuidesEnabled() const {
 void ApplicationSettings::setOutputShowGuidesEnabled(bool enabled) {
   m_settings.setValue(getKey(OUTPUT_SHOW_GUIDES_KEY), enabled);
 }
+
+int ApplicationSettings::getIntermediateCacheSizeMb() const {
+  return m_settings.value(getKey(INTERMEDIATE_CACHE_SIZE_KEY), DEFAULT_INTERMEDIATE_CACHE_SIZE_MB).toInt();
+}
+
+void ApplicationSettings::setIntermediateCacheSizeMb(const int sizeMb) {
+  m_settings.setValue(getKey(INTERMEDIATE_CACHE_SIZE_KEY), sizeMb);
+}
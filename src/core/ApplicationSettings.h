@@ -40,6 +40,11 @@ class ApplicationSettings {
 
   void setTiffColorCompression(int compression);
 
+  /** The Deflate or ZSTD compression level.  Zero means the codec's default. */
+  int getTiffCompressionLevel() const;
+
+  void setTiffCompressionLevel(int level);
+
   bool isBlackOnWhiteDetectionEnabled() const;
 
   void setBlackOnWhiteDetectionEnabled(bool enabled);
@@ -114,6 +119,11 @@ class ApplicationSettings {
 
   void setOutputShowGuidesEnabled(bool enabled);
 
+  /** The maximum size of the intermediate images cache, in megabytes.  Zero disables the cache. */
+  int getIntermediateCacheSizeMb() const;
+
+  void setIntermediateCacheSizeMb(int sizeMb);
+
  private:
   static inline QString getKey(const QString& keyName);
 
@@ -122,6 +132,7 @@ class ApplicationSettings {
   static const bool DEFAULT_AUTO_SAVE_PROJECT;
   static const int DEFAULT_TIFF_BW_COMPRESSION;
   static const int DEFAULT_TIFF_COLOR_COMPRESSION;
+  static const int DEFAULT_TIFF_COMPRESSION_LEVEL;
   static const bool DEFAULT_BLACK_ON_WHITE_DETECTION;
   static const bool DEFAULT_BLACK_ON_WHITE_DETECTION_OUTPUT;
   static const bool DEFAULT_HIGHLIGHT_DEVIATION;
@@ -145,6 +156,7 @@ class ApplicationSettings {
   static const QString COLOR_SCHEME_KEY;
   static const QString TIFF_BW_COMPRESSION_KEY;
   static const QString TIFF_COLOR_COMPRESSION_KEY;
+  static const QString TIFF_COMPRESSION_LEVEL_KEY;
   static const QString BLACK_ON_WHITE_DETECTION_KEY;
   static const QString BLACK_ON_WHITE_DETECTION_OUTPUT_KEY;
   static const QString HIGHLIGHT_DEVIATION_KEY;
@@ -163,9 +175,11 @@ class ApplicationSettings {
   static const QString SHOW_CANCELING_SELECTION_QUESTION_KEY;
   static const QString DEFAULT_ZONE_CREATION_MODE_KEY;
   static const QString OUTPUT_SHOW_GUIDES_KEY;
+  static const QString INTERMEDIATE_CACHE_SIZE_KEY;
 
   static const int DEFAULT_ZONE_CREATION_MODE;  // 0 = polygonal
   static const bool DEFAULT_OUTPUT_SHOW_GUIDES;
+  static const int DEFAULT_INTERMEDIATE_CACHE_SIZE_MB;
 
   QSettings m_settings;
 };
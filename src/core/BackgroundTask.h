@@ -5,6 +5,7 @@
 #define SCANTAILOR_CORE_BACKGROUNDTASK_H_
 
 #include <QAtomicInt>
+#include <cstdint>
 #include <exception>
 #include <memory>
 
@@ -22,10 +23,22 @@ class BackgroundTask : public AbstractCommand<FilterResultPtr>, public TaskStatu
   };
 
 
-  explicit BackgroundTask(Type type) : m_type(type) {}
+  explicit BackgroundTask(Type type) : m_type(type), m_estimatedMemoryUsage(0) {}
 
   Type type() const { return m_type; }
 
+  /**
+   * \brief The peak memory the task is expected to take, in bytes.
+   *
+   * WorkerThreadPool holds the task back until that much fits its memory budget.
+   * 0, the default, means unknown, and doesn't hold it back.
+   *
+   * \see PageMemoryEstimate
+   */
+  uint64_t estimatedMemoryUsage() const { return m_estimatedMemoryUsage; }
+
+  void setEstimatedMemoryUsage(uint64_t bytes) { m_estimatedMemoryUsage = bytes; }
+
   void cancel() override {
 #if QT_VERSION_MAJOR == 5 && QT_VERSION_MINOR < 14
     m_cancelFlag.store(1);
@@ -50,6 +63,7 @@ class BackgroundTask : public AbstractCommand<FilterResultPtr>, public TaskStatu
  private:
   QAtomicInt m_cancelFlag;
   const Type m_type;
+  uint64_t m_estimatedMemoryUsage;
 };
 
 
@@ -8,8 +8,12 @@
 
 #include <QDebug>
 #include <QImage>
+#include <algorithm>
 #include <cmath>
+#include <functional>
+#include <map>
 #include <unordered_map>
+#include <vector>
 
 #include "DebugImages.h"
 #include "Dpi.h"
@@ -609,18 +613,27 @@ void voronoiSpecial(ConnectivityMap& cmap, std::vector<Distance>& dist, const Di
   }
 }  // voronoiSpecial
 
+using Connections = std::unordered_map<Connection, uint32_t, Connection::hash>;  // conn -> sqdist
+using ConnectionList = std::vector<std::pair<Connection, uint32_t>>;
+
 /**
  * Calculate the minimum distance between components from neighboring
  * Voronoi segments.
+ *
+ * The connections are listed in the order they were first encountered.
+ * Tagging the components depends on the order it goes through them,
+ * so keptComponents() adds them to its map in this order, which makes it
+ * go through them the same way despeckling with unified labels would.
  */
-void voronoiDistances(const ConnectivityMap& cmap,
-                      const std::vector<Distance>& distanceMatrix,
-                      std::unordered_map<Connection, uint32_t, Connection::hash>& conns) {
+ConnectionList voronoiDistances(const ConnectivityMap& cmap, const std::vector<Distance>& distanceMatrix) {
   const int width = cmap.size().width();
   const int height = cmap.size().height();
 
   const int offsets[] = {-cmap.stride(), -1, 1, cmap.stride()};
 
+  ConnectionList list;
+  std::unordered_map<Connection, size_t, Connection::hash> listIndex;
+
   const uint32_t* const cmapData = cmap.data();
   const Distance* const distanceData = &distanceMatrix[0] + width + 3;
   for (int y = 0, offset = 0; y < height; ++y, offset += 2) {
@@ -646,105 +659,238 @@ void voronoiDistances(const ConnectivityMap& cmap,
         const int dy = y1 - y2;
         const uint32_t sqdist = dx * dx + dy * dy;
 
-        updateDistance(conns, label, nbhLabel, sqdist);
+        const Connection conn(label, nbhLabel);
+        const auto it = listIndex.find(conn);
+        if (it == listIndex.end()) {
+          listIndex.emplace(conn, list.size());
+          list.emplace_back(conn, sqdist);
+        } else if (sqdist < list[it->second].second) {
+          list[it->second].second = sqdist;
+        }
       }
     }
   }
+  return list;
 }  // voronoiDistances
 
-void despeckleImpl(BinaryImage& image,
-                   const Dpi& dpi,
-                   const Settings& settings,
-                   const TaskStatus& status,
-                   DebugImages* const dbg) {
+/**
+ * \brief The part of despeckling that doesn't depend on the settings.
+ *
+ * The connected components keep their original labels here, as which
+ * of them get unified into the big one depends on the settings.
+ * Labels don't affect the shape of a Voronoi diagram, and the distances
+ * between the unified components are the minimums of the distances between
+ * their parts, so the end result is the same as unifying them up front.
+ */
+struct Analysis {
+  int width = 0;
+  int height = 0;
+
+  /**
+   * The Voronoi diagram.  Black pixels are labeled by their own component,
+   * white ones by the closest one.
+   */
+  ConnectivityMap cmap;
+
+  std::vector<Distance> distanceMatrix;
+
+  /**
+   * Indexed by label.
+   */
+  std::vector<uint32_t> numPixels;
+
+  /**
+   * The larger dimension of the bounding box, indexed by label.
+   */
+  std::vector<int> extents;
+
+  /**
+   * Distances between neighboring Voronoi regions.
+   */
+  ConnectionList connections;
+};
+
+/**
+ * \return false if \p image is completely white, in which case there is nothing to analyze.
+ */
+bool analyze(const BinaryImage& image, Analysis& analysis, const TaskStatus& status, DebugImages* const dbg) {
   ConnectivityMap cmap(image, CONN8);
   if (cmap.maxLabel() == 0) {
     // Completely white image?
-    return;
+    return false;
   }
 
   status.throwIfCancelled();
 
-  std::vector<Component> components(cmap.maxLabel() + 1);
-  std::vector<BoundingBox> boundingBoxes(cmap.maxLabel() + 1);
-
   const int width = image.width();
   const int height = image.height();
+  analysis.width = width;
+  analysis.height = height;
 
-  uint32_t* const cmapData = cmap.data();
+  std::vector<BoundingBox> boundingBoxes(cmap.maxLabel() + 1);
+  analysis.numPixels.assign(cmap.maxLabel() + 1, 0);
 
   // Count the number of pixels and a bounding rect of each component.
-  uint32_t* cmapLine = cmapData;
+  const uint32_t* cmapLine = cmap.data();
   const int cmapStride = cmap.stride();
   for (int y = 0; y < height; ++y) {
     for (int x = 0; x < width; ++x) {
       const uint32_t label = cmapLine[x];
-      ++components[label].numPixels;
+      ++analysis.numPixels[label];
       boundingBoxes[label].extend(x, y);
     }
     cmapLine += cmapStride;
   }
 
+  analysis.extents.resize(boundingBoxes.size());
+  for (size_t label = 0; label < boundingBoxes.size(); ++label) {
+    analysis.extents[label] = std::max(boundingBoxes[label].width(), boundingBoxes[label].height());
+  }
+  std::vector<BoundingBox>().swap(boundingBoxes);
+
   status.throwIfCancelled();
+  // Build a Voronoi diagram.
+  voronoi(cmap, analysis.distanceMatrix);
+  if (dbg) {
+    dbg->add(cmap.visualized(), "voronoi");
+  }
+
+  status.throwIfCancelled();
+
+  // Now build a bidirectional map of distances between neighboring
+  // connected components.
+  analysis.connections = voronoiDistances(cmap, analysis.distanceMatrix);
+
+  analysis.cmap.swap(cmap);
+  return true;
+}  // analyze
+
+/**
+ * \brief Finds the connections of the components that didn't get anchored
+ *        to a big one, through the regions of the other components.
+ *
+ * Maybe they do have big neighbors, but Voronoi regions from smaller ones
+ * block the path to the bigger ones.  \p cmap and \p distanceMatrix come
+ * from analyze() and are modified.
+ *
+ * \param labels The original labels of such components.
+ */
+ConnectionList secondChanceConnections(ConnectivityMap& cmap,
+                                       std::vector<Distance>& distanceMatrix,
+                                       const std::vector<uint32_t>& labels,
+                                       DebugImages* const dbg) {
+  std::vector<uint8_t> secondChance(cmap.maxLabel() + 1, 0);
+  for (const uint32_t label : labels) {
+    secondChance[label] = 1;
+  }
+
+  const int width = cmap.size().width();
+  const int height = cmap.size().height();
+  const uint32_t* const cmapData = cmap.data();
+  Distance* const distanceData = &distanceMatrix[0] + width + 3;
+
+  const Distance zeroDistance(Distance::zero());
+  const Distance specialDistance(Distance::special());
+  for (int y = 0, offset = 0; y < height; ++y, offset += 2) {
+    for (int x = 0; x < width; ++x, ++offset) {
+      const uint32_t label = cmapData[offset];
+      assert(label != 0);
+
+      if (!secondChance[label]) {
+        if (distanceData[offset] == zeroDistance) {
+          // Prevent this region from growing
+          // and from being taken over by another
+          // by another region.
+          distanceData[offset] = specialDistance;
+        } else {
+          // Allow this region to be taken over by others.
+          // Note: x + 1 here is equivalent to x
+          // in voronoi() or voronoiSpecial().
+          distanceData[offset].reset(x + 1);
+        }
+      }
+    }
+  }
+
+  // Calculate the Voronoi diagram again, but this time
+  // treat pixels with a special distance in such a way
+  // to prevent them from spreading but also preventing
+  // them from being overwritten.
+  voronoiSpecial(cmap, distanceMatrix, specialDistance);
+  if (dbg) {
+    dbg->add(cmap.visualized(), "voronoi_special");
+  }
+
+  return voronoiDistances(cmap, distanceMatrix);
+}  // secondChanceConnections
+
+/**
+ * \brief Brings the Voronoi diagram of \p analysis back to the state analyze()
+ *        left it in, after secondChanceConnections() has modified it.
+ *
+ * The old diagram is released first, so that there is only ever one of them.
+ */
+void rebuildVoronoi(const BinaryImage& image, Analysis& analysis) {
+  ConnectivityMap().swap(analysis.cmap);
+  std::vector<Distance>().swap(analysis.distanceMatrix);
+
+  ConnectivityMap cmap(image, CONN8);
+  voronoi(cmap, analysis.distanceMatrix);
+  analysis.cmap.swap(cmap);
+}
+
+/**
+ * Given the original labels of the components to give a second chance,
+ * returns the result of secondChanceConnections() for them.
+ */
+using SecondChanceFunction = std::function<ConnectionList(const std::vector<uint32_t>& labels)>;
+
+/**
+ * \brief Decides which components are kept when despeckling with \p settings.
+ *
+ * \return A flag for each original label.
+ */
+std::vector<uint8_t> keptComponents(const Analysis& analysis,
+                                    const Settings& settings,
+                                    const SecondChanceFunction& secondChance,
+                                    const TaskStatus& status) {
+  const auto maxOrigLabel = static_cast<uint32_t>(analysis.numPixels.size() - 1);
+  std::vector<Component> components(maxOrigLabel + 1);
 
   // Unify big components into one.
-  std::vector<uint32_t> remappingTable(components.size());
+  std::vector<uint32_t> remappingTable(maxOrigLabel + 1, 0);
   uint32_t unifiedBigComponent = 0;
   uint32_t nextAvailComponent = 1;
-  for (uint32_t label = 1; label <= cmap.maxLabel(); ++label) {
-    if ((boundingBoxes[label].width() < settings.bigObjectThreshold)
-        && (boundingBoxes[label].height() < settings.bigObjectThreshold)) {
-      components[nextAvailComponent] = components[label];
+  for (uint32_t label = 1; label <= maxOrigLabel; ++label) {
+    if (analysis.extents[label] < settings.bigObjectThreshold) {
+      components[nextAvailComponent].numPixels = analysis.numPixels[label];
       remappingTable[label] = nextAvailComponent;
       ++nextAvailComponent;
     } else {
       if (unifiedBigComponent == 0) {
         unifiedBigComponent = nextAvailComponent;
         ++nextAvailComponent;
-        components[unifiedBigComponent] = components[label];
         // Set numPixels to a large value so that canBeAttachedTo()
         // always allows attaching to any such component.
-        components[unifiedBigComponent].numPixels = width * height;
+        components[unifiedBigComponent].numPixels = analysis.width * analysis.height;
       }
       remappingTable[label] = unifiedBigComponent;
     }
   }
   components.resize(nextAvailComponent);
-  std::vector<BoundingBox>().swap(boundingBoxes);  // We don't need them any more.
-  status.throwIfCancelled();
-
   const uint32_t maxLabel = nextAvailComponent - 1;
-  // Remapping individual pixels.
-  cmapLine = cmapData;
-  for (int y = 0; y < height; ++y) {
-    for (int x = 0; x < width; ++x) {
-      cmapLine[x] = remappingTable[cmapLine[x]];
-    }
-    cmapLine += cmapStride;
-  }
-  if (dbg) {
-    dbg->add(cmap.visualized(), "big_components_unified");
-  }
-
-  status.throwIfCancelled();
-  // Build a Voronoi diagram.
-  std::vector<Distance> distanceMatrix;
-  voronoi(cmap, distanceMatrix);
-  if (dbg) {
-    dbg->add(cmap.visualized(), "voronoi");
-  }
-
-  status.throwIfCancelled();
 
-  Distance* const distanceData = &distanceMatrix[0] + width + 3;
-
-  // Now build a bidirectional map of distances between neighboring
-  // connected components.
-
-  using Connections = std::unordered_map<Connection, uint32_t, Connection::hash>;  // conn -> sqdist
   Connections conns;
-
-  voronoiDistances(cmap, distanceMatrix, conns);
+  const auto addConnections = [&](const ConnectionList& list) {
+    for (const auto& pair : list) {
+      const uint32_t label1 = remappingTable[pair.first.lesserLabel];
+      const uint32_t label2 = remappingTable[pair.first.greaterLabel];
+      if (label1 != label2) {
+        updateDistance(conns, label1, label2, pair.second);
+      }
+    }
+  };
+  addConnections(analysis.connections);
 
   status.throwIfCancelled();
 
@@ -757,72 +903,25 @@ void despeckleImpl(BinaryImage& image,
     tagSourceComponent(comp1, comp2, sqdist, settings);
     tagSourceComponent(comp2, comp1, sqdist, settings);
   }
-
   // Prevent it from growing when we compute the Voronoi diagram
   // the second time.
   components[unifiedBigComponent].setAnchoredToBig();
 
-  bool haveAnchoredToSmallButNotBig = false;
-  for (const Component& comp : components) {
-    if (comp.anchoredToSmallButNotBig()) {
-      haveAnchoredToSmallButNotBig = true;
-      break;
+  std::vector<uint32_t> secondChanceLabels;
+  for (uint32_t label = 1; label <= maxOrigLabel; ++label) {
+    if (components[remappingTable[label]].anchoredToSmallButNotBig()) {
+      secondChanceLabels.push_back(label);
     }
   }
 
-  if (haveAnchoredToSmallButNotBig) {
-    status.throwIfCancelled();
-
-    // Give such components a second chance.  Maybe they do have
-    // big neighbors, but Voronoi regions from a smaller ones
-    // block the path to the bigger ones.
-
-    const Distance zeroDistance(Distance::zero());
-    const Distance specialDistance(Distance::special());
-    for (int y = 0, offset = 0; y < height; ++y, offset += 2) {
-      for (int x = 0; x < width; ++x, ++offset) {
-        const uint32_t label = cmapData[offset];
-        assert(label != 0);
-
-        const Component& comp = components[label];
-        if (!comp.anchoredToSmallButNotBig()) {
-          if (distanceData[offset] == zeroDistance) {
-            // Prevent this region from growing
-            // and from being taken over by another
-            // by another region.
-            distanceData[offset] = specialDistance;
-          } else {
-            // Allow this region to be taken over by others.
-            // Note: x + 1 here is equivalent to x
-            // in voronoi() or voronoiSpecial().
-            distanceData[offset].reset(x + 1);
-          }
-        }
-      }
-    }
-
-    status.throwIfCancelled();
-
-    // Calculate the Voronoi diagram again, but this time
-    // treat pixels with a special distance in such a way
-    // to prevent them from spreading but also preventing
-    // them from being overwritten.
-    voronoiSpecial(cmap, distanceMatrix, specialDistance);
-    if (dbg) {
-      dbg->add(cmap.visualized(), "voronoi_special");
-    }
-
+  if (!secondChanceLabels.empty()) {
     status.throwIfCancelled();
-
     // We've got new connections.  Add them to the map.
-    voronoiDistances(cmap, distanceMatrix, conns);
+    addConnections(secondChance(secondChanceLabels));
   }
 
   status.throwIfCancelled();
 
-  // Clear the distance matrix.
-  std::vector<Distance>().swap(distanceMatrix);
-
   // Remove tags from components.
   for (Component& comp : components) {
     comp.clearTags();
@@ -890,15 +989,44 @@ void despeckleImpl(BinaryImage& image,
     }
   }
 
+  std::vector<uint8_t> kept(maxOrigLabel + 1, 0);
+  for (uint32_t label = 1; label <= maxOrigLabel; ++label) {
+    kept[label] = components[remappingTable[label]].anchoredToBig() ? 1 : 0;
+  }
+  return kept;
+}  // keptComponents
+
+void despeckleImpl(BinaryImage& image,
+                   const Dpi& dpi,
+                   const Settings& settings,
+                   const TaskStatus& status,
+                   DebugImages* const dbg) {
+  Analysis analysis;
+  if (!analyze(image, analysis, status, dbg)) {
+    return;
+  }
+
+  // The analysis is not needed afterwards, so the second chance can work on it directly.
+  // That doesn't change the labels of black pixels, which is all we need below.
+  const std::vector<uint8_t> kept = keptComponents(
+      analysis, settings,
+      [&](const std::vector<uint32_t>& labels) {
+        return secondChanceConnections(analysis.cmap, analysis.distanceMatrix, labels, dbg);
+      },
+      status);
+
   status.throwIfCancelled();
   // Remove unmarked components from the binary image.
   const uint32_t msb = uint32_t(1) << 31;
   uint32_t* imageLine = image.data();
   const int imageStride = image.wordsPerLine();
-  cmapLine = cmapData;
+  const uint32_t* cmapLine = analysis.cmap.data();
+  const int cmapStride = analysis.cmap.stride();
+  const int width = image.width();
+  const int height = image.height();
   for (int y = 0; y < height; ++y) {
     for (int x = 0; x < width; ++x) {
-      if (!components[cmapLine[x]].anchoredToBig()) {
+      if (!kept[cmapLine[x]]) {
         imageLine[x >> 5] &= ~(msb >> (x & 31));
       }
     }
@@ -946,3 +1074,114 @@ void Despeckle::despeckleInPlace(imageproc::BinaryImage& image,
   despeckleImpl(image, dpi, settings, status, dbg);
 }
 // Despeckle::despeckleInPlace
+
+/*========================== DespeckleAnalysis ============================*/
+
+DespeckleAnalysis::DespeckleAnalysis(const BinaryImage& image, const Dpi& dpi, const TaskStatus& status)
+    : m_size(image.size()) {
+  Analysis analysis;
+  if (!analyze(image, analysis, status, nullptr)) {
+    return;
+  }
+
+  // Different levels often give the same components a second chance,
+  // and that is the expensive part, so remember the results.
+  std::map<std::vector<uint32_t>, ConnectionList> secondChanceCache;
+  // The second chance modifies the Voronoi diagram.  Rather than working on
+  // a copy of it, which would double the peak memory use, we rebuild it
+  // when another set of components needs a second chance.
+  bool voronoiModified = false;
+  const SecondChanceFunction secondChance = [&](const std::vector<uint32_t>& labels) {
+    auto it = secondChanceCache.find(labels);
+    if (it == secondChanceCache.end()) {
+      if (voronoiModified) {
+        status.throwIfCancelled();
+        rebuildVoronoi(image, analysis);
+      }
+      voronoiModified = true;
+      it = secondChanceCache
+               .emplace(labels, secondChanceConnections(analysis.cmap, analysis.distanceMatrix, labels, nullptr))
+               .first;
+    }
+    return it->second;
+  };
+
+  std::vector<uint32_t> keptAtLevels(analysis.numPixels.size(), 0);
+  for (int tenths = MIN_LEVEL_TENTHS; tenths <= MAX_LEVEL_TENTHS; ++tenths) {
+    const Settings settings = Settings::get(0.1 * tenths, dpi);
+    const std::vector<uint8_t> kept = keptComponents(analysis, settings, secondChance, status);
+    const uint32_t levelBit = uint32_t(1) << (tenths - MIN_LEVEL_TENTHS);
+    for (size_t label = 1; label < kept.size(); ++label) {
+      if (kept[label]) {
+        keptAtLevels[label] |= levelBit;
+      }
+    }
+  }
+  secondChanceCache.clear();
+  // Only the labels of black pixels are needed below, and the second chance doesn't change them.
+  std::vector<Distance>().swap(analysis.distanceMatrix);
+
+  status.throwIfCancelled();
+
+  const uint32_t allLevels = (uint32_t(1) << (MAX_LEVEL_TENTHS - MIN_LEVEL_TENTHS + 1)) - 1;
+  const uint32_t* imageLine = image.data();
+  const int imageStride = image.wordsPerLine();
+  const uint32_t* cmapLine = analysis.cmap.data();
+  const int cmapStride = analysis.cmap.stride();
+  const uint32_t msb = uint32_t(1) << 31;
+  const int width = analysis.width;
+  const int height = analysis.height;
+  for (int y = 0; y < height; ++y) {
+    for (int x = 0; x < width;) {
+      if (!(imageLine[x >> 5] & (msb >> (x & 31)))) {
+        ++x;
+        continue;
+      }
+      // A run of black pixels always belongs to a single component.
+      const int begin = x;
+      for (++x; x < width && (imageLine[x >> 5] & (msb >> (x & 31))); ++x) {
+      }
+      const uint32_t levels = keptAtLevels[cmapLine[begin]];
+      if (levels != allLevels) {
+        m_runs.push_back({y, begin, x, levels});
+      }
+    }
+    imageLine += imageStride;
+    cmapLine += cmapStride;
+  }
+}  // DespeckleAnalysis::DespeckleAnalysis
+
+int DespeckleAnalysis::levelIndex(const double level) {
+  const int tenths = qRound(level * 10);
+  if ((tenths < MIN_LEVEL_TENTHS) || (tenths > MAX_LEVEL_TENTHS) || (level != 0.1 * tenths)) {
+    // The settings are derived from the exact value, so something like
+    // 0.7 read from a project file doesn't quite match 0.1 * 7.
+    return -1;
+  }
+  return tenths - MIN_LEVEL_TENTHS;
+}
+
+bool DespeckleAnalysis::covers(const double level) {
+  return levelIndex(level) >= 0;
+}
+
+BinaryImage DespeckleAnalysis::speckles(const double level) const {
+  const int idx = levelIndex(level);
+  assert(idx >= 0);
+  const uint32_t levelBit = uint32_t(1) << idx;
+
+  BinaryImage speckles(m_size, WHITE);
+  uint32_t* const data = speckles.data();
+  const int stride = speckles.wordsPerLine();
+  const uint32_t msb = uint32_t(1) << 31;
+  for (const Run& run : m_runs) {
+    if (run.keptAtLevels & levelBit) {
+      continue;
+    }
+    uint32_t* const line = data + run.y * stride;
+    for (int x = run.begin; x < run.end; ++x) {
+      line[x >> 5] |= msb >> (x & 31);
+    }
+  }
+  return speckles;
+}
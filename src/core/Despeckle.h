@@ -4,6 +4,10 @@
 #ifndef SCANTAILOR_CORE_DESPECKLE_H_
 #define SCANTAILOR_CORE_DESPECKLE_H_
 
+#include <QSize>
+#include <cstdint>
+#include <vector>
+
 class Dpi;
 class TaskStatus;
 class DebugImages;
@@ -55,4 +59,60 @@ class Despeckle {
 };
 
 
+/**
+ * \brief Remembers which connected components of an image despeckling removes
+ *        at each of the levels the user can pick.
+ *
+ * Building it costs about as much as a few despecklings, but afterwards
+ * speckles() for any of those levels only touches the removed pixels.
+ * Whether a component survives isn't monotonic in the level, as all the
+ * settings derived from it change at once, so a set of levels is kept
+ * per component rather than a single threshold.
+ */
+class DespeckleAnalysis {
+ public:
+  /**
+   * The levels covered are MIN_LEVEL_TENTHS * 0.1, (MIN_LEVEL_TENTHS + 1) * 0.1, ...,
+   * MAX_LEVEL_TENTHS * 0.1, which is what the despeckling slider produces.
+   */
+  static const int MIN_LEVEL_TENTHS = 5;
+  static const int MAX_LEVEL_TENTHS = 35;
+
+  /**
+   * \param image The image to analyze.  Must not be null.
+   * \param dpi DPI of \p image.
+   * \param status For asynchronous task cancellation.
+   */
+  DespeckleAnalysis(const imageproc::BinaryImage& image, const Dpi& dpi, const TaskStatus& status);
+
+  /**
+   * \brief Checks if \p level is one of the levels an analysis covers.
+   */
+  static bool covers(double level);
+
+  /**
+   * \brief The black pixels Despeckle::despeckle() would remove at \p level.
+   *
+   * \p level must be covered.  The result is never null.
+   */
+  imageproc::BinaryImage speckles(double level) const;
+
+ private:
+  /**
+   * A horizontal run of black pixels from a component that is removed
+   * at some of the levels.
+   */
+  struct Run {
+    int y;
+    int begin;
+    int end;  // exclusive
+    uint32_t keptAtLevels;  // bit i stands for (MIN_LEVEL_TENTHS + i) * 0.1
+  };
+
+  static int levelIndex(double level);
+
+  QSize m_size;
+  std::vector<Run> m_runs;
+};
+
 #endif
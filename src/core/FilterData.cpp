@@ -6,15 +6,24 @@
 #include <Grayscale.h>
 
 #include "Dpm.h"
+#include "ImageId.h"
 
 using namespace imageproc;
 
-FilterData::FilterData(const QImage& image)
-    : m_origImage(image), m_grayImage(toGrayscale(m_origImage)), m_xform(image.rect(), Dpm(image)) {}
+FilterData::FilterData(const QImage& image) : FilterData(image, ImageId(), nullptr) {}
+
+FilterData::FilterData(const QImage& image,
+                       const ImageId& imageId,
+                       std::shared_ptr<IntermediateImageCache> intermediateCache)
+    : m_origImage(image),
+      m_grayImage(toGrayscale(m_origImage)),
+      m_pyramid(std::make_shared<ImagePyramid>(m_grayImage, Dpm(image), imageId, std::move(intermediateCache))),
+      m_xform(image.rect(), Dpm(image)) {}
 
 FilterData::FilterData(const FilterData& other, const ImageTransformation& xform)
     : m_origImage(other.m_origImage),
       m_grayImage(other.m_grayImage),
+      m_pyramid(other.m_pyramid),
       m_xform(xform),
       m_imageParams(other.m_imageParams) {}
 
@@ -35,3 +44,9 @@ imageproc::BinaryThreshold FilterData::bwThresholdBlackOnWhite() const {
 imageproc::GrayImage FilterData::grayImageBlackOnWhite() const {
   return isBlackOnWhite() ? m_grayImage : m_grayImage.inverted();
 }
+
+uint8_t FilterData::darkestGrayLevelBlackOnWhite() const {
+  const std::pair<uint8_t, uint8_t> range(m_pyramid->grayLevelRange());
+  // The darkest level of the inverted image is the inverted lightest one.
+  return isBlackOnWhite() ? range.first : static_cast<uint8_t>(255 - range.second);
+}
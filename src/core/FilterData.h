@@ -8,15 +8,26 @@
 #include <GrayImage.h>
 
 #include <QImage>
+#include <memory>
 
+#include "ImagePyramid.h"
 #include "ImageSettings.h"
 #include "ImageTransformation.h"
 
+class ImageId;
+class IntermediateImageCache;
+
 class FilterData {
   // Member-wise copying is OK.
  public:
   explicit FilterData(const QImage& image);
 
+  /**
+   * \brief Same as above, but the images the stages derive from this one
+   *        are kept in \p intermediateCache, see ImagePyramid.
+   */
+  FilterData(const QImage& image, const ImageId& imageId, std::shared_ptr<IntermediateImageCache> intermediateCache);
+
   FilterData(const FilterData& other, const ImageTransformation& xform);
 
   FilterData(const FilterData& other);
@@ -35,11 +46,29 @@ class FilterData {
 
   imageproc::GrayImage grayImageBlackOnWhite() const;
 
+  /**
+   * \brief Same as imageproc::darkestGrayLevel(grayImageBlackOnWhite()),
+   *        without making a copy of the image.
+   *
+   * Computed once per page load and then shared, like the pyramid.
+   */
+  uint8_t darkestGrayLevelBlackOnWhite() const;
+
+  /**
+   * \brief Reduced resolution versions of grayImage().
+   *
+   * The pyramid is shared by all the copies of this object, so each level
+   * gets computed once per page load and then reused by all the stages.
+   * The last stage using a level releases it, see ImagePyramid::releaseLevels().
+   */
+  const ImagePyramid& pyramid() const;
+
   void updateImageParams(const ImageSettings::PageParams& imageParams);
 
  private:
   QImage m_origImage;
   imageproc::GrayImage m_grayImage;
+  std::shared_ptr<const ImagePyramid> m_pyramid;
   ImageTransformation m_xform;
   ImageSettings::PageParams m_imageParams;
 };
@@ -57,6 +86,10 @@ inline const imageproc::GrayImage& FilterData::grayImage() const {
   return m_grayImage;
 }
 
+inline const ImagePyramid& FilterData::pyramid() const {
+  return *m_pyramid;
+}
+
 inline void FilterData::updateImageParams(const ImageSettings::PageParams& imageParams) {
   m_imageParams = imageParams;
 }
@@ -3,6 +3,8 @@
 
 #include "ImageLoader.h"
 
+#include <Tracer.h>
+
 #include <QFile>
 #include <QFileInfo>
 #include <QImage>
@@ -23,7 +25,20 @@ QImage ImageLoader::load(const QString& filePath, const int pageNum) {
   return load(file, pageNum);
 }
 
+QImage ImageLoader::loadReduced(const ImageId& imageId, const QSize& boundingSize) {
+  TRACE_SPAN("io", "ImageLoader::loadReduced");
+  QFile file(imageId.filePath());
+  if (!file.open(QIODevice::ReadOnly)) {
+    return QImage();
+  }
+  if (TiffReader::canRead(file)) {
+    return TiffReader::readReducedImage(file, imageId.zeroBasedPage(), boundingSize);
+  }
+  return load(file, imageId.zeroBasedPage());
+}
+
 QImage ImageLoader::load(QIODevice& ioDev, const int pageNum) {
+  TRACE_SPAN("io", "ImageLoader::load");
   if (TiffReader::canRead(ioDev)) {
     return TiffReader::readImage(ioDev, pageNum);
   }
@@ -8,6 +8,7 @@ class ImageId;
 class QImage;
 class QString;
 class QIODevice;
+class QSize;
 
 class ImageLoader {
  public:
@@ -16,6 +17,15 @@ class ImageLoader {
   static QImage load(const ImageId& imageId);
 
   static QImage load(QIODevice& ioDev, int pageNum);
+
+  /**
+   * \brief Loads an image that is only going to be displayed within \p boundingSize.
+   *
+   * The result may be reduced by an integer factor, but never below the size
+   * the image would have when scaled to fit \p boundingSize.  For TIFF files,
+   * the reduction is done while decoding, so the full image is never in memory.
+   */
+  static QImage loadReduced(const ImageId& imageId, const QSize& boundingSize);
 };
 
 
@@ -0,0 +1,189 @@
+// Copyright (C) 2019  Joseph Artsimovich <joseph.artsimovich@gmail.com>, 4lex4 <4lex49@zoho.com>
+// Use of this source code is governed by the GNU GPLv3 license that can be found in the LICENSE file.
+
+#include "ImageMetadataScanner.h"
+
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QEvent>
+#include <QFileInfo>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <tuple>
+
+#include "TaskScheduler.h"
+
+namespace {
+TaskScheduler& scanScheduler() {
+  static TaskScheduler scheduler(ImageMetadataScanner::MAX_THREADS);
+  return scheduler;
+}
+
+class MetadataCache {
+ public:
+  static MetadataCache& instance() {
+    static MetadataCache cache;
+    return cache;
+  }
+
+  bool find(const QFileInfo& fileInfo, std::vector<ImageMetadata>& perPageMetadata) const {
+    std::lock_guard<std::mutex> guard(m_mutex);
+    const auto it = m_entries.find(keyOf(fileInfo));
+    if (it == m_entries.end()) {
+      return false;
+    }
+    perPageMetadata = it->second;
+    return true;
+  }
+
+  void insert(const QFileInfo& fileInfo, const std::vector<ImageMetadata>& perPageMetadata) {
+    std::lock_guard<std::mutex> guard(m_mutex);
+    if (m_entries.size() >= MAX_ENTRIES) {
+      // A few dozen bytes per entry, so this is only a safety net.
+      m_entries.clear();
+    }
+    m_entries[keyOf(fileInfo)] = perPageMetadata;
+  }
+
+ private:
+  using Key = std::tuple<QString, qint64, qint64>;  // path, size, modification time
+
+  static const size_t MAX_ENTRIES = 100000;
+
+  static Key keyOf(const QFileInfo& fileInfo) {
+    return Key(fileInfo.absoluteFilePath(), fileInfo.size(), fileInfo.lastModified().toMSecsSinceEpoch());
+  }
+
+  mutable std::mutex m_mutex;
+  std::map<Key, std::vector<ImageMetadata>> m_entries;
+};
+}  // namespace
+
+/**
+ * The part of a scanner shared with the tasks probing the files,
+ * which may outlive the scanner itself.
+ */
+class ImageMetadataScanner::State {
+ public:
+  explicit State(ImageMetadataScanner* owner) : m_owner(owner), m_deliveryPosted(false) {}
+
+  void detach() {
+    std::lock_guard<std::mutex> guard(m_mutex);
+    m_owner = nullptr;
+  }
+
+  bool isDetached() const {
+    std::lock_guard<std::mutex> guard(m_mutex);
+    return m_owner == nullptr;
+  }
+
+  void addResult(Result result) {
+    std::lock_guard<std::mutex> guard(m_mutex);
+    if (!m_owner) {
+      return;
+    }
+    m_results.push_back(std::move(result));
+    if (!m_deliveryPosted) {
+      // Whatever gets ready before the event is handled goes into the same batch.
+      m_deliveryPosted = true;
+      QCoreApplication::postEvent(m_owner, new QEvent(QEvent::User));
+    }
+  }
+
+  std::vector<Result> takeResults() {
+    std::lock_guard<std::mutex> guard(m_mutex);
+    m_deliveryPosted = false;
+    std::vector<Result> results;
+    results.swap(m_results);
+    return results;
+  }
+
+ private:
+  mutable std::mutex m_mutex;
+  ImageMetadataScanner* m_owner;
+  std::vector<Result> m_results;
+  bool m_deliveryPosted;
+};
+
+
+ImageMetadataScanner::ImageMetadataScanner(QObject* parent)
+    : QObject(parent), m_state(std::make_shared<State>(this)), m_numPending(0) {}
+
+ImageMetadataScanner::~ImageMetadataScanner() {
+  // The tasks still in the queue will see that and skip their files.
+  // The ones probing files right now will drop their results.
+  m_state->detach();
+}
+
+void ImageMetadataScanner::scan(const std::vector<QString>& filePaths) {
+  m_numPending += static_cast<int>(filePaths.size());
+  for (const QString& filePath : filePaths) {
+    const std::shared_ptr<State> state(m_state);
+    scanScheduler().submit([state, filePath]() {
+      if (!state->isDetached()) {
+        state->addResult(probe(filePath));
+      }
+    });
+  }
+}
+
+std::vector<ImageMetadataScanner::Result> ImageMetadataScanner::scanAndWait(const std::vector<QString>& filePaths) {
+  std::vector<Result> results(filePaths.size());
+  std::mutex mutex;
+  std::condition_variable allDone;
+  size_t numDone = 0;
+
+  for (size_t i = 0; i < filePaths.size(); ++i) {
+    scanScheduler().submit([&, i]() {
+      Result result(probe(filePaths[i]));
+      std::lock_guard<std::mutex> guard(mutex);
+      results[i] = std::move(result);
+      if (++numDone == filePaths.size()) {
+        allDone.notify_all();
+      }
+    });
+  }
+
+  std::unique_lock<std::mutex> lock(mutex);
+  allDone.wait(lock, [&]() { return numDone == filePaths.size(); });
+  return results;
+}
+
+bool ImageMetadataScanner::isScanning() const {
+  return m_numPending > 0;
+}
+
+void ImageMetadataScanner::customEvent(QEvent*) {
+  const std::vector<Result> results(m_state->takeResults());
+  if (results.empty()) {
+    return;
+  }
+
+  m_numPending -= static_cast<int>(results.size());
+  emit resultsReady(results);
+  if (m_numPending == 0) {
+    emit finished();
+  }
+}
+
+ImageMetadataScanner::Result ImageMetadataScanner::probe(const QString& filePath) {
+  Result result;
+  result.filePath = filePath;
+
+  const QFileInfo fileInfo(filePath);
+  MetadataCache& cache = MetadataCache::instance();
+  if (cache.find(fileInfo, result.perPageMetadata)) {
+    result.status = ImageMetadataLoader::LOADED;
+    return result;
+  }
+
+  result.status = ImageMetadataLoader::load(
+      filePath, [&](const ImageMetadata& metadata) { result.perPageMetadata.push_back(metadata); });
+  if (result.status == ImageMetadataLoader::LOADED) {
+    cache.insert(fileInfo, result.perPageMetadata);
+  } else {
+    result.perPageMetadata.clear();
+  }
+  return result;
+}
@@ -0,0 +1,94 @@
+// Copyright (C) 2019  Joseph Artsimovich <joseph.artsimovich@gmail.com>, 4lex4 <4lex49@zoho.com>
+// Use of this source code is governed by the GNU GPLv3 license that can be found in the LICENSE file.
+
+#ifndef SCANTAILOR_CORE_IMAGEMETADATASCANNER_H_
+#define SCANTAILOR_CORE_IMAGEMETADATASCANNER_H_
+
+#include <QObject>
+#include <QString>
+#include <memory>
+#include <vector>
+
+#include "ImageMetadata.h"
+#include "ImageMetadataLoader.h"
+#include "NonCopyable.h"
+
+/**
+ * \brief Reads the metadata of image files on a pool of background threads.
+ *
+ * The files are probed with ImageMetadataLoader, at most MAX_THREADS of them
+ * at a time.  The results are delivered in the thread the scanner lives in,
+ * grouped into batches of whatever got ready since the previous delivery.
+ *
+ * Successfully read metadata is cached for the lifetime of the process,
+ * keyed by the path, the size and the modification time of a file,
+ * so scanning an unchanged file again doesn't touch its contents.
+ */
+class ImageMetadataScanner : public QObject {
+  Q_OBJECT
+  DECLARE_NON_COPYABLE(ImageMetadataScanner)
+
+ public:
+  /**
+   * Probing metadata is mostly waiting for the storage, the network one
+   * in particular, so this doesn't depend on the number of processors.
+   */
+  static const int MAX_THREADS = 8;
+
+  struct Result {
+    QString filePath;
+    ImageMetadataLoader::Status status = ImageMetadataLoader::GENERIC_ERROR;
+    /** Empty unless status is LOADED. */
+    std::vector<ImageMetadata> perPageMetadata;
+  };
+
+  explicit ImageMetadataScanner(QObject* parent = nullptr);
+
+  /**
+   * \brief Cancels the scanning, without waiting for the files being probed.
+   */
+  ~ImageMetadataScanner() override;
+
+  /**
+   * \brief Starts probing \p filePaths, in the given order.
+   *
+   * May be called again before the previous files are done, in which case
+   * the new files are added to the ones in progress.
+   */
+  void scan(const std::vector<QString>& filePaths);
+
+  /**
+   * \brief Probes \p filePaths on the same threads and with the same cache,
+   *        but waits for the results.
+   *
+   * \return The results in the order of \p filePaths.
+   */
+  static std::vector<Result> scanAndWait(const std::vector<QString>& filePaths);
+
+  /**
+   * \brief Whether there are files scheduled with scan() whose results were not delivered yet.
+   */
+  bool isScanning() const;
+
+ signals:
+
+  void resultsReady(const std::vector<ImageMetadataScanner::Result>& results);
+
+  /**
+   * \brief Emitted after the results of all the scheduled files have been delivered.
+   */
+  void finished();
+
+ private:
+  class State;
+
+  void customEvent(QEvent* event) override;
+
+  static Result probe(const QString& filePath);
+
+  std::shared_ptr<State> m_state;
+  int m_numPending;
+};
+
+
+#endif  // ifndef SCANTAILOR_CORE_IMAGEMETADATASCANNER_H_
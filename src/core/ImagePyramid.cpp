@@ -0,0 +1,177 @@
+// Copyright (C) 2019  Joseph Artsimovich <joseph.artsimovich@gmail.com>, 4lex4 <4lex49@zoho.com>
+// Use of this source code is governed by the GNU GPLv3 license that can be found in the LICENSE file.
+
+#include "ImagePyramid.h"
+
+#include <Constants.h>
+#include <Dpi.h>
+#include <Scale.h>
+
+#include <QDataStream>
+#include <algorithm>
+#include <cmath>
+
+#include "IntermediateImageCache.h"
+
+using namespace imageproc;
+
+namespace {
+const QString BINARY_LEVEL_STAGE = "pyramid_binary";
+const QString TRANSFORMED_GRAY_STAGE = "pyramid_transformed";
+}  // namespace
+
+ImagePyramid::ImagePyramid(const GrayImage& image, const Dpm& dpm) : ImagePyramid(image, dpm, ImageId(), nullptr) {}
+
+ImagePyramid::ImagePyramid(const GrayImage& image,
+                           const Dpm& dpm,
+                           const ImageId& imageId,
+                           std::shared_ptr<IntermediateImageCache> intermediateCache)
+    : m_image(image),
+      m_dpm(dpm),
+      m_imageId(imageId),
+      m_intermediateCache(std::move(intermediateCache)),
+      m_grayLevelRange(0xff, 0x00) {}
+
+GrayImage ImagePyramid::grayLevel(const Dpi& dpi) const {
+  const QSizeF factors(scaleFactors(dpi));
+  if ((std::fabs(factors.width() - 1.0) < 0.1) && (std::fabs(factors.height() - 1.0) < 0.1)) {
+    return m_image;
+  }
+
+  std::lock_guard<std::mutex> guard(m_mutex);
+  const DpiKey key(dpi.horizontal(), dpi.vertical());
+  auto it = m_grayLevels.find(key);
+  if (it == m_grayLevels.end()) {
+    const QSize newSize(std::max(1, (int) std::ceil(factors.width() * m_image.width())),
+                        std::max(1, (int) std::ceil(factors.height() * m_image.height())));
+    it = m_grayLevels.emplace(key, scaleToGray(m_image, newSize)).first;
+  }
+  return it->second;
+}
+
+GrayImage ImagePyramid::grayLevelNotAbove(const Dpi& dpi) const {
+  const QSizeF factors(scaleFactors(dpi));
+  if ((factors.width() > 1.0) || (factors.height() > 1.0)) {
+    return m_image;
+  }
+  return grayLevel(dpi);
+}
+
+BinaryImage ImagePyramid::binaryLevel(const Dpi& dpi, const BinaryThreshold threshold) const {
+  const auto key = std::make_pair(DpiKey(dpi.horizontal(), dpi.vertical()), int(threshold));
+  {
+    std::lock_guard<std::mutex> guard(m_mutex);
+    const auto it = m_binaryLevels.find(key);
+    if (it != m_binaryLevels.end()) {
+      return it->second;
+    }
+  }
+
+  QByteArray params;
+  {
+    QDataStream strm(&params, QIODevice::WriteOnly);
+    strm << qint32(dpi.horizontal()) << qint32(dpi.vertical()) << qint32(threshold);
+  }
+  const BinaryImage level(derivedImage(BINARY_LEVEL_STAGE, params, [&]() {
+    return BinaryImage(grayLevel(dpi), threshold).toQImage();
+  }));
+
+  std::lock_guard<std::mutex> guard(m_mutex);
+  // Another thread may have got there first, in which case we share its level.
+  return m_binaryLevels.emplace(key, level).first->second;
+}
+
+std::pair<uint8_t, uint8_t> ImagePyramid::grayLevelRange() const {
+  std::call_once(m_grayLevelRangeOnce, [this]() {
+    uint8_t darkest = 0xff;
+    uint8_t lightest = 0x00;
+    const int width = m_image.width();
+    const uint8_t* line = m_image.data();
+    for (int y = 0; y < m_image.height(); ++y, line += m_image.stride()) {
+      for (int x = 0; x < width; ++x) {
+        darkest = std::min(darkest, line[x]);
+        lightest = std::max(lightest, line[x]);
+      }
+    }
+    m_grayLevelRange = std::make_pair(darkest, lightest);
+  });
+  return m_grayLevelRange;
+}
+
+QTransform ImagePyramid::origToLevel(const GrayImage& level) const {
+  if (level.size() == m_image.size()) {
+    return QTransform();
+  }
+  return QTransform::fromScale(double(level.width()) / m_image.width(), double(level.height()) / m_image.height());
+}
+
+GrayImage ImagePyramid::transformToGray(const Dpi& levelDpi,
+                                        const QTransform& xform,
+                                        const QRect& dstRect,
+                                        const OutsidePixels outsidePixels,
+                                        const QSizeF& minMappingArea) const {
+  QByteArray params;
+  {
+    QDataStream strm(&params, QIODevice::WriteOnly);
+    strm << qint32(levelDpi.horizontal()) << qint32(levelDpi.vertical()) << xform << dstRect
+         << qint32(outsidePixels.flags()) << quint32(outsidePixels.rgba()) << minMappingArea;
+  }
+  return GrayImage(derivedImage(TRANSFORMED_GRAY_STAGE, params, [&]() {
+    if (!isAxisAligned(xform)) {
+      return imageproc::transformToGray(m_image, xform, dstRect, outsidePixels, minMappingArea).toQImage();
+    }
+
+    const GrayImage level(grayLevelNotAbove(levelDpi));
+    const QTransform origToLevelXform(origToLevel(level));
+    const QSizeF levelMinMappingArea(minMappingArea.width() * origToLevelXform.m11(),
+                                     minMappingArea.height() * origToLevelXform.m22());
+    return imageproc::transformToGray(level, origToLevelXform.inverted() * xform, dstRect, outsidePixels,
+                                      levelMinMappingArea)
+        .toQImage();
+  }));
+}
+
+void ImagePyramid::releaseLevels() const {
+  std::lock_guard<std::mutex> guard(m_mutex);
+  m_grayLevels.clear();
+  m_binaryLevels.clear();
+}
+
+QImage ImagePyramid::derivedImage(const QString& stage,
+                                  const QByteArray& params,
+                                  const std::function<QImage()>& compute) const {
+  if (!m_intermediateCache) {
+    return compute();
+  }
+
+  // The resolution is part of the key, as it may be overridden in the project.
+  QByteArray fullParams;
+  {
+    QDataStream strm(&fullParams, QIODevice::WriteOnly);
+    strm << qint32(m_dpm.horizontal()) << qint32(m_dpm.vertical()) << params;
+  }
+
+  QImage image(m_intermediateCache->load(m_imageId, stage, fullParams));
+  if (image.isNull()) {
+    image = compute();
+    if (!image.isNull()) {
+      m_intermediateCache->store(m_imageId, stage, fullParams, image);
+    }
+  }
+  return image;
+}
+
+bool ImagePyramid::isAxisAligned(const QTransform& xform) {
+  if (xform.type() > QTransform::TxRotate) {
+    return false;  // Shearing or projection.
+  }
+  const double eps = 1e-6;
+  const bool keepsAxes = (std::fabs(xform.m12()) < eps) && (std::fabs(xform.m21()) < eps);
+  const bool swapsAxes = (std::fabs(xform.m11()) < eps) && (std::fabs(xform.m22()) < eps);
+  return keepsAxes || swapsAxes;
+}
+
+QSizeF ImagePyramid::scaleFactors(const Dpi& dpi) const {
+  return QSizeF((dpi.horizontal() * constants::DPI2DPM) / m_dpm.horizontal(),
+                (dpi.vertical() * constants::DPI2DPM) / m_dpm.vertical());
+}
@@ -0,0 +1,158 @@
+// Copyright (C) 2019  Joseph Artsimovich <joseph.artsimovich@gmail.com>, 4lex4 <4lex49@zoho.com>
+// Use of this source code is governed by the GNU GPLv3 license that can be found in the LICENSE file.
+
+#ifndef SCANTAILOR_CORE_IMAGEPYRAMID_H_
+#define SCANTAILOR_CORE_IMAGEPYRAMID_H_
+
+#include <BinaryImage.h>
+#include <BinaryThreshold.h>
+#include <Dpm.h>
+#include <GrayImage.h>
+#include <Transform.h>
+
+#include <QTransform>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <utility>
+
+#include "ImageId.h"
+#include "NonCopyable.h"
+
+class Dpi;
+class IntermediateImageCache;
+class QByteArray;
+
+/**
+ * \brief Reduced resolution versions of a page image, shared by the stages
+ *        processing that page.
+ *
+ * Each level is computed on first request and kept until releaseLevels()
+ * is called by the last stage that needs it.  The pyramid itself lives as
+ * long as the FilterData objects created from a single page load.
+ *
+ * Given an IntermediateImageCache, the images the stages get from here,
+ * that is binaryLevel(), transformToGray() and derivedImage(), are also
+ * kept on disk, so that processing the same page again doesn't recompute
+ * them.  The intermediate gray levels are only kept in memory.
+ *
+ * All the methods are thread-safe.
+ */
+class ImagePyramid {
+  DECLARE_NON_COPYABLE(ImagePyramid)
+
+ public:
+  /**
+   * \param image The full resolution grayscale image.
+   * \param dpm Its resolution.
+   */
+  ImagePyramid(const imageproc::GrayImage& image, const Dpm& dpm);
+
+  /**
+   * \param image The full resolution grayscale image.
+   * \param dpm Its resolution.
+   * \param imageId The id of the source image, addressing the cache entries.
+   * \param intermediateCache The disk cache for the derived images, or null.
+   */
+  ImagePyramid(const imageproc::GrayImage& image,
+               const Dpm& dpm,
+               const ImageId& imageId,
+               std::shared_ptr<IntermediateImageCache> intermediateCache);
+
+  const imageproc::GrayImage& image() const { return m_image; }
+
+  /**
+   * \brief The image scaled to \p dpi.
+   *
+   * If the resolution of the image is within 10% of \p dpi,
+   * the image is returned as is.
+   */
+  imageproc::GrayImage grayLevel(const Dpi& dpi) const;
+
+  /**
+   * \brief Same as grayLevel(), but never upscales.
+   *
+   * This is what callers that transform the image further need,
+   * as upscaling before a transformation only loses quality.
+   */
+  imageproc::GrayImage grayLevelNotAbove(const Dpi& dpi) const;
+
+  /**
+   * \brief grayLevel() binarized with \p threshold.
+   */
+  imageproc::BinaryImage binaryLevel(const Dpi& dpi, imageproc::BinaryThreshold threshold) const;
+
+  /**
+   * \brief The darkest and the lightest gray levels of image().
+   *
+   * Computed on first request.  Unlike the pyramid levels, these are exact.
+   */
+  std::pair<uint8_t, uint8_t> grayLevelRange() const;
+
+  /**
+   * \brief Maps the coordinates of the full resolution image to the ones of \p level.
+   */
+  QTransform origToLevel(const imageproc::GrayImage& level) const;
+
+  /**
+   * \brief Same as imageproc::transformToGray() applied to image(), except
+   *        it starts from grayLevelNotAbove(\p levelDpi) when \p xform
+   *        is axis-aligned.
+   *
+   * \p xform and \p minMappingArea are in terms of the full resolution image,
+   * so callers don't have to care which level was used.  \p levelDpi should
+   * be the resolution of the transformed image.
+   *
+   * A level is only used for scaling, translation and rotation by multiples
+   * of 90 degrees.  Resampling a reduced level once more at an arbitrary angle
+   * would blur the result noticeably, so any other transformation is applied
+   * to the full resolution image, giving exactly what imageproc::transformToGray()
+   * gives.
+   */
+  imageproc::GrayImage transformToGray(const Dpi& levelDpi,
+                                       const QTransform& xform,
+                                       const QRect& dstRect,
+                                       imageproc::OutsidePixels outsidePixels,
+                                       const QSizeF& minMappingArea = QSizeF(0.9, 0.9)) const;
+
+  /**
+   * \brief Drops the cached levels.
+   *
+   * Called once no further stage needs them, so that they don't stay in
+   * memory until the page is fully processed.  A level requested after
+   * this is computed again.
+   */
+  void releaseLevels() const;
+
+  /**
+   * \brief An image derived from image() by \p stage, taken from the
+   *        intermediate cache if possible.
+   *
+   * Otherwise \p compute is called and its result is stored in the cache.
+   * \p params must capture everything the result depends on, besides image()
+   * and its resolution, which are accounted for here.
+   */
+  QImage derivedImage(const QString& stage, const QByteArray& params, const std::function<QImage()>& compute) const;
+
+ private:
+  using DpiKey = std::pair<int, int>;
+
+  static bool isAxisAligned(const QTransform& xform);
+
+  QSizeF scaleFactors(const Dpi& dpi) const;
+
+  const imageproc::GrayImage m_image;
+  const Dpm m_dpm;
+  const ImageId m_imageId;
+  const std::shared_ptr<IntermediateImageCache> m_intermediateCache;
+  mutable std::mutex m_mutex;
+  mutable std::map<DpiKey, imageproc::GrayImage> m_grayLevels;
+  mutable std::map<std::pair<DpiKey, int>, imageproc::BinaryImage> m_binaryLevels;
+  mutable std::once_flag m_grayLevelRangeOnce;
+  mutable std::pair<uint8_t, uint8_t> m_grayLevelRange;
+};
+
+
+#endif  // ifndef SCANTAILOR_CORE_IMAGEPYRAMID_H_
@@ -0,0 +1,256 @@
+// Copyright (C) 2019  Joseph Artsimovich <joseph.artsimovich@gmail.com>, 4lex4 <4lex49@zoho.com>
+// Use of this source code is governed by the GNU GPLv3 license that can be found in the LICENSE file.
+
+#include "IntermediateImageCache.h"
+
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QImage>
+#include <QVector>
+#include <algorithm>
+#include <cstring>
+
+#include "AtomicFileOverwriter.h"
+#include "ImageId.h"
+
+namespace {
+const quint32 MAGIC = 0x53544943;  // "STIC"
+const quint32 VERSION = 2;
+const char* const ENTRY_SUFFIX = ".qimg";
+
+// The image data is compressed in strips of that many lines, to keep
+// the temporary buffers small.
+const int STRIP_HEIGHT = 64;
+
+// Fast compression.  The point is to make the entries of the large color
+// and grayscale images smaller, not to make them as small as possible.
+const int COMPRESSION_LEVEL = 1;
+
+bool writeImage(QIODevice& device, const QImage& image) {
+  QDataStream strm(&device);
+  strm.setVersion(QDataStream::Qt_5_0);
+  strm << MAGIC << VERSION << qint32(image.format()) << qint32(image.width()) << qint32(image.height())
+       << qint32(image.dotsPerMeterX()) << qint32(image.dotsPerMeterY()) << image.colorTable();
+
+  const int bytesPerLine = image.bytesPerLine();
+  for (int y = 0; y < image.height(); y += STRIP_HEIGHT) {
+    const int stripHeight = std::min(STRIP_HEIGHT, image.height() - y);
+    strm << qCompress(image.constScanLine(y), bytesPerLine * stripHeight, COMPRESSION_LEVEL);
+    if (strm.status() != QDataStream::Ok) {
+      return false;
+    }
+  }
+  return true;
+}
+
+QImage readImage(QIODevice& device) {
+  QDataStream strm(&device);
+  strm.setVersion(QDataStream::Qt_5_0);
+
+  quint32 magic = 0;
+  quint32 version = 0;
+  qint32 format = 0;
+  qint32 width = 0;
+  qint32 height = 0;
+  qint32 dpmX = 0;
+  qint32 dpmY = 0;
+  QVector<QRgb> colorTable;
+  strm >> magic >> version >> format >> width >> height >> dpmX >> dpmY >> colorTable;
+  if ((strm.status() != QDataStream::Ok) || (magic != MAGIC) || (version != VERSION) || (width <= 0)
+      || (height <= 0) || (format <= QImage::Format_Invalid) || (format >= QImage::NImageFormats)) {
+    return QImage();
+  }
+
+  QImage image(width, height, static_cast<QImage::Format>(format));
+  if (image.isNull()) {
+    return QImage();
+  }
+  image.setDotsPerMeterX(dpmX);
+  image.setDotsPerMeterY(dpmY);
+  if (!colorTable.isEmpty()) {
+    image.setColorTable(colorTable);
+  }
+
+  const int bytesPerLine = image.bytesPerLine();
+  for (int y = 0; y < height; y += STRIP_HEIGHT) {
+    const int stripSize = bytesPerLine * std::min(STRIP_HEIGHT, height - y);
+    QByteArray compressed;
+    strm >> compressed;
+    const QByteArray strip(qUncompress(compressed));
+    if ((strm.status() != QDataStream::Ok) || (strip.size() != stripSize)) {
+      return QImage();
+    }
+    memcpy(image.scanLine(y), strip.constData(), stripSize);
+  }
+  return image;
+}
+}  // namespace
+
+const QString IntermediateImageCache::DECODED_IMAGE = "decoded";
+
+IntermediateImageCache::IntermediateImageCache(const QString& cacheDir, const qint64 maxSizeBytes)
+    : m_cacheDir(cacheDir), m_totalSize(0), m_maxSize(maxSizeBytes) {
+  QDir().mkpath(m_cacheDir);
+  scanCacheDir();
+
+  std::lock_guard<std::mutex> guard(m_mutex);
+  evictIfNecessary();
+}
+
+IntermediateImageCache::~IntermediateImageCache() = default;
+
+void IntermediateImageCache::setMaxSize(const qint64 maxSizeBytes) {
+  std::lock_guard<std::mutex> guard(m_mutex);
+  m_maxSize = maxSizeBytes;
+  evictIfNecessary();
+}
+
+QImage IntermediateImageCache::load(const ImageId& imageId, const QString& stage, const QByteArray& params) {
+  const QString name(entryName(imageId, stage, params));
+  if (name.isEmpty()) {
+    return QImage();
+  }
+
+  {
+    std::lock_guard<std::mutex> guard(m_mutex);
+    if (m_entries.find(name) == m_entries.end()) {
+      return QImage();
+    }
+  }
+
+  QFile file(entryPath(name));
+  QImage image;
+  if (file.open(QIODevice::ReadOnly)) {
+    image = readImage(file);
+  }
+
+  std::lock_guard<std::mutex> guard(m_mutex);
+  if (image.isNull()) {
+    // Broken or removed behind our back.
+    removeEntry(name);
+    return QImage();
+  }
+  if (m_entries.find(name) != m_entries.end()) {
+    touch(name);
+#if !(QT_VERSION_MAJOR == 5 && QT_VERSION_MINOR < 10)
+    // Makes the order of use persistent.
+    file.setFileTime(QDateTime::currentDateTimeUtc(), QFileDevice::FileModificationTime);
+#endif
+  }
+  return image;
+}
+
+bool IntermediateImageCache::store(const ImageId& imageId,
+                                   const QString& stage,
+                                   const QByteArray& params,
+                                   const QImage& image) {
+  if (image.isNull()) {
+    return false;
+  }
+
+  const QString name(entryName(imageId, stage, params));
+  if (name.isEmpty()) {
+    return false;
+  }
+
+  const QString path(entryPath(name));
+  AtomicFileOverwriter overwriter;
+  QIODevice* device = overwriter.startWriting(path);
+  if (!device || !writeImage(*device, image)) {
+    return false;
+  }
+  if (!overwriter.commit()) {
+    return false;
+  }
+
+  const qint64 size = QFileInfo(path).size();
+  std::lock_guard<std::mutex> guard(m_mutex);
+  if (size > m_maxSize) {
+    // It would only push out everything else, and then itself.
+    QFile::remove(path);
+    removeEntry(name);
+    return false;
+  }
+  addEntry(name, size);
+  evictIfNecessary();
+  return true;
+}
+
+qint64 IntermediateImageCache::totalSize() const {
+  std::lock_guard<std::mutex> guard(m_mutex);
+  return m_totalSize;
+}
+
+QString IntermediateImageCache::entryName(const ImageId& imageId, const QString& stage, const QByteArray& params) {
+  const QFileInfo sourceInfo(imageId.filePath());
+  if (!sourceInfo.exists()) {
+    return QString();
+  }
+
+  QCryptographicHash hash(QCryptographicHash::Sha1);
+  hash.addData(sourceInfo.absoluteFilePath().toUtf8());
+  hash.addData(QByteArray::number(imageId.page()));
+  hash.addData(QByteArray::number(sourceInfo.size()));
+  hash.addData(QByteArray::number(sourceInfo.lastModified().toMSecsSinceEpoch()));
+  hash.addData(stage.toUtf8());
+  hash.addData(params);
+  return QString::fromLatin1(hash.result().toHex()) + QLatin1String(ENTRY_SUFFIX);
+}
+
+QString IntermediateImageCache::entryPath(const QString& name) const {
+  return m_cacheDir + QLatin1Char('/') + name;
+}
+
+void IntermediateImageCache::scanCacheDir() {
+  const QDir dir(m_cacheDir);
+  // Sorted by modification time, the oldest goes last.
+  const QFileInfoList files(dir.entryInfoList(QStringList(QLatin1String("*") + QLatin1String(ENTRY_SUFFIX)),
+                                              QDir::Files, QDir::Time));
+
+  std::lock_guard<std::mutex> guard(m_mutex);
+  for (auto it = files.crbegin(); it != files.crend(); ++it) {
+    addEntry(it->fileName(), it->size());
+  }
+}
+
+void IntermediateImageCache::touch(const QString& name) {
+  const auto it = m_entries.find(name);
+  if (it != m_entries.end()) {
+    m_lruList.splice(m_lruList.end(), m_lruList, it->second.lruPos);
+  }
+}
+
+void IntermediateImageCache::addEntry(const QString& name, const qint64 size) {
+  const auto it = m_entries.find(name);
+  if (it != m_entries.end()) {
+    m_totalSize += size - it->second.size;
+    it->second.size = size;
+    touch(name);
+  } else {
+    m_entries[name] = Entry{size, m_lruList.insert(m_lruList.end(), name)};
+    m_totalSize += size;
+  }
+}
+
+void IntermediateImageCache::removeEntry(const QString& name) {
+  const auto it = m_entries.find(name);
+  if (it == m_entries.end()) {
+    return;
+  }
+
+  m_totalSize -= it->second.size;
+  m_lruList.erase(it->second.lruPos);
+  m_entries.erase(it);
+}
+
+void IntermediateImageCache::evictIfNecessary() {
+  while ((m_totalSize > m_maxSize) && !m_lruList.empty()) {
+    const QString name(m_lruList.front());
+    QFile::remove(entryPath(name));
+    removeEntry(name);
+  }
+}
@@ -0,0 +1,123 @@
+// Copyright (C) 2019  Joseph Artsimovich <joseph.artsimovich@gmail.com>, 4lex4 <4lex49@zoho.com>
+// Use of this source code is governed by the GNU GPLv3 license that can be found in the LICENSE file.
+
+#ifndef SCANTAILOR_CORE_INTERMEDIATEIMAGECACHE_H_
+#define SCANTAILOR_CORE_INTERMEDIATEIMAGECACHE_H_
+
+#include <QByteArray>
+#include <QString>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+
+#include "Hashes.h"
+#include "NonCopyable.h"
+
+class ImageId;
+class QImage;
+
+/**
+ * \brief A disk cache for images derived from the source images,
+ *        so that they don't have to be decoded and recomputed every time
+ *        a page is processed.
+ *
+ * An entry is addressed by a hash of the source image id, the size and
+ * modification time of the source file, the name of the stage that
+ * produced the image and the parameters it depended on.  Modifying the
+ * source file or the parameters therefore makes the old entries
+ * unreachable, and they eventually get evicted.
+ *
+ * The images are stored in their own format, compressed, so that a 1-bit
+ * image takes about as much space as its source file, rather than
+ * the space of its grayscale version.
+ *
+ * When the total size of the entries exceeds the limit, the least
+ * recently used ones are removed.  The order of use survives restarts,
+ * as it's stored in the file modification times.
+ *
+ * All the methods are thread-safe.
+ */
+class IntermediateImageCache {
+  DECLARE_NON_COPYABLE(IntermediateImageCache)
+
+ public:
+  /**
+   * \brief The stage name for the decoded source images, as they were
+   *        before being converted to one of the supported formats.
+   */
+  static const QString DECODED_IMAGE;
+
+  /**
+   * \param cacheDir The directory to store the entries in.  It will be
+   *        created if it doesn't exist.
+   * \param maxSizeBytes The maximum total size of the entries.
+   */
+  IntermediateImageCache(const QString& cacheDir, qint64 maxSizeBytes);
+
+  ~IntermediateImageCache();
+
+  void setMaxSize(qint64 maxSizeBytes);
+
+  /**
+   * \brief Loads an image from cache.
+   *
+   * \return The cached image, or a null image if there is no such entry
+   *         or it couldn't be read.
+   */
+  QImage load(const ImageId& imageId, const QString& stage, const QByteArray& params = QByteArray());
+
+  /**
+   * \brief Stores an image, replacing the existing entry, if any.
+   *
+   * \return false if the image couldn't be written.
+   */
+  bool store(const ImageId& imageId, const QString& stage, const QByteArray& params, const QImage& image);
+
+  qint64 totalSize() const;
+
+ private:
+  struct Entry {
+    qint64 size;
+    std::list<QString>::iterator lruPos;
+  };
+
+  static QString entryName(const ImageId& imageId, const QString& stage, const QByteArray& params);
+
+  QString entryPath(const QString& name) const;
+
+  void scanCacheDir();
+
+  /**
+   * \brief Marks an entry as the most recently used one.
+   *
+   * Must be called with m_mutex locked.
+   */
+  void touch(const QString& name);
+
+  /**
+   * \brief Must be called with m_mutex locked.
+   */
+  void addEntry(const QString& name, qint64 size);
+
+  /**
+   * \brief Must be called with m_mutex locked.
+   */
+  void removeEntry(const QString& name);
+
+  /**
+   * \brief Removes the least recently used entries, until we fit the limit.
+   *
+   * Must be called with m_mutex locked.
+   */
+  void evictIfNecessary();
+
+  const QString m_cacheDir;
+  mutable std::mutex m_mutex;
+  std::list<QString> m_lruList;  // The least recently used goes first.
+  std::unordered_map<QString, Entry, hashes::hash<QString>> m_entries;
+  qint64 m_totalSize;
+  qint64 m_maxSize;
+};
+
+
+#endif  // ifndef SCANTAILOR_CORE_INTERMEDIATEIMAGECACHE_H_
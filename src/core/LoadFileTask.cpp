@@ -3,6 +3,8 @@
 
 #include "LoadFileTask.h"
 
+#include <Tracer.h>
+
 #include <imageproc/Grayscale.h>
 
 #include <QCoreApplication>
@@ -17,6 +19,7 @@
 #include "FilterOptionsWidget.h"
 #include "FilterUiInterface.h"
 #include "ImageLoader.h"
+#include "IntermediateImageCache.h"
 #include "ProjectPages.h"
 #include "ThumbnailPixmapCache.h"
 #include "filters/fix_orientation/Task.h"
@@ -41,10 +44,12 @@ class LoadFileTask::ErrorResult : public FilterResult {
 LoadFileTask::LoadFileTask(Type type,
                            const PageInfo& page,
                            std::shared_ptr<ThumbnailPixmapCache> thumbnailCache,
+                           std::shared_ptr<IntermediateImageCache> intermediateCache,
                            std::shared_ptr<ProjectPages> pages,
                            std::shared_ptr<fix_orientation::Task> nextTask)
     : BackgroundTask(type),
       m_thumbnailCache(std::move(thumbnailCache)),
+      m_intermediateCache(std::move(intermediateCache)),
       m_imageId(page.imageId()),
       m_imageMetadata(page.metadata()),
       m_pages(std::move(pages)),
@@ -55,7 +60,8 @@ LoadFileTask::LoadFileTask(Type type,
 LoadFileTask::~LoadFileTask() = default;
 
 FilterResultPtr LoadFileTask::operator()() {
-  QImage image = ImageLoader::load(m_imageId);
+  TRACE_SPAN("load", "LoadFileTask");
+  QImage image = loadConvertedImage();
 
   try {
     throwIfCancelled();
@@ -63,11 +69,10 @@ FilterResultPtr LoadFileTask::operator()() {
     if (image.isNull()) {
       return std::make_shared<ErrorResult>(m_imageId.filePath());
     } else {
-      convertToSupportedFormat(image);
       updateImageSizeIfChanged(image);
       overrideDpi(image);
       m_thumbnailCache->ensureThumbnailExists(m_imageId, image);
-      return m_nextTask->process(*this, FilterData(image));
+      return m_nextTask->process(*this, FilterData(image, m_imageId, m_intermediateCache));
     }
   } catch (const CancelledException&) {
     return nullptr;
@@ -106,6 +111,26 @@ void LoadFileTask::convertToSupportedFormat(QImage& image) const {
   }
 }
 
+QImage LoadFileTask::loadConvertedImage() const {
+  TRACE_SPAN("load", "LoadFileTask::loadConvertedImage");
+  QImage image;
+  if (m_intermediateCache) {
+    image = m_intermediateCache->load(m_imageId, IntermediateImageCache::DECODED_IMAGE);
+  }
+  if (image.isNull()) {
+    image = ImageLoader::load(m_imageId);
+    if (!image.isNull() && m_intermediateCache) {
+      // Stored before the conversion, which may make it several times larger.
+      m_intermediateCache->store(m_imageId, IntermediateImageCache::DECODED_IMAGE, QByteArray(), image);
+    }
+  }
+
+  if (!image.isNull()) {
+    convertToSupportedFormat(image);
+  }
+  return image;
+}
+
 /*======================= LoadFileTask::ErrorResult ======================*/
 
 LoadFileTask::ErrorResult::ErrorResult(const QString& filePath)
@@ -12,6 +12,7 @@
 #include "ImageMetadata.h"
 #include "NonCopyable.h"
 
+class IntermediateImageCache;
 class ThumbnailPixmapCache;
 class PageInfo;
 class ProjectPages;
@@ -28,6 +29,7 @@ class LoadFileTask : public BackgroundTask {
   LoadFileTask(Type type,
                const PageInfo& page,
                std::shared_ptr<ThumbnailPixmapCache> thumbnailCache,
+               std::shared_ptr<IntermediateImageCache> intermediateCache,
                std::shared_ptr<ProjectPages> pages,
                std::shared_ptr<fix_orientation::Task> nextTask);
 
@@ -44,7 +46,14 @@ class LoadFileTask : public BackgroundTask {
 
   void convertToSupportedFormat(QImage& image) const;
 
+  /**
+   * \brief Loads the image in one of the supported formats, either from
+   *        the intermediate cache or by decoding the source file.
+   */
+  QImage loadConvertedImage() const;
+
   std::shared_ptr<ThumbnailPixmapCache> m_thumbnailCache;
+  std::shared_ptr<IntermediateImageCache> m_intermediateCache;
   ImageId m_imageId;
   ImageMetadata m_imageMetadata;
   const std::shared_ptr<ProjectPages> m_pages;
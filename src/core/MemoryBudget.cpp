@@ -0,0 +1,68 @@
+// Copyright (C) 2019  Joseph Artsimovich <joseph.artsimovich@gmail.com>, 4lex4 <4lex49@zoho.com>
+// Use of this source code is governed by the GNU GPLv3 license that can be found in the LICENSE file.
+
+#include "MemoryBudget.h"
+
+#include <cassert>
+
+#if defined(_WIN32)
+#include <windows.h>
+#elif defined(__APPLE__)
+#include <sys/sysctl.h>
+#include <sys/types.h>
+#elif defined(__unix__)
+#include <unistd.h>
+#endif
+
+MemoryBudget::MemoryBudget(const uint64_t limit) : m_limit(limit), m_reserved(0), m_numReservations(0) {}
+
+bool MemoryBudget::canReserve(const uint64_t bytes) const {
+  return (bytes == 0) || (m_limit == 0) || (m_numReservations == 0) || (m_reserved + bytes <= m_limit);
+}
+
+void MemoryBudget::reserve(const uint64_t bytes) {
+  m_reserved += bytes;
+  ++m_numReservations;
+}
+
+void MemoryBudget::release(const uint64_t bytes) {
+  assert(m_numReservations > 0 && m_reserved >= bytes);
+  m_reserved -= bytes;
+  --m_numReservations;
+}
+
+uint64_t MemoryBudget::physicalMemory() {
+#if defined(_WIN32)
+  MEMORYSTATUSEX status;
+  status.dwLength = sizeof(status);
+  if (GlobalMemoryStatusEx(&status)) {
+    return status.ullTotalPhys;
+  }
+#elif defined(__APPLE__)
+  int mib[2] = {CTL_HW, HW_MEMSIZE};
+  int64_t size = 0;
+  size_t length = sizeof(size);
+  if ((sysctl(mib, 2, &size, &length, nullptr, 0) == 0) && (size > 0)) {
+    return static_cast<uint64_t>(size);
+  }
+#elif defined(__unix__)
+  const long numPages = sysconf(_SC_PHYS_PAGES);
+  const long pageSize = sysconf(_SC_PAGE_SIZE);
+  if ((numPages > 0) && (pageSize > 0)) {
+    return static_cast<uint64_t>(numPages) * static_cast<uint64_t>(pageSize);
+  }
+#endif
+  return 0;
+}
+
+uint64_t MemoryBudget::defaultLimit() {
+  uint64_t limit = physicalMemory() / 4 * 3;
+  if (sizeof(void*) <= 4) {
+    // The address space runs out well before 4 GiB.
+    const uint64_t addressSpaceLimit = uint64_t(1536) << 20;
+    if ((limit == 0) || (limit > addressSpaceLimit)) {
+      limit = addressSpaceLimit;
+    }
+  }
+  return limit;
+}
@@ -0,0 +1,59 @@
+// Copyright (C) 2019  Joseph Artsimovich <joseph.artsimovich@gmail.com>, 4lex4 <4lex49@zoho.com>
+// Use of this source code is governed by the GNU GPLv3 license that can be found in the LICENSE file.
+
+#ifndef SCANTAILOR_CORE_MEMORYBUDGET_H_
+#define SCANTAILOR_CORE_MEMORYBUDGET_H_
+
+#include <cstdint>
+
+/**
+ * \brief Keeps track of the memory reserved by running tasks against a limit.
+ *
+ * A reservation that doesn't fit is refused, unless nothing is reserved at all,
+ * so a task bigger than the whole budget still runs, just alone.  Empty
+ * reservations always fit.
+ * The class is not thread-safe.
+ */
+class MemoryBudget {
+ public:
+  /**
+   * \param limit The limit in bytes, 0 meaning no limit.
+   */
+  explicit MemoryBudget(uint64_t limit = 0);
+
+  uint64_t limit() const { return m_limit; }
+
+  void setLimit(uint64_t limit) { m_limit = limit; }
+
+  uint64_t reserved() const { return m_reserved; }
+
+  int numReservations() const { return m_numReservations; }
+
+  bool canReserve(uint64_t bytes) const;
+
+  void reserve(uint64_t bytes);
+
+  void release(uint64_t bytes);
+
+  /**
+   * \brief The amount of physical memory in the system, or 0 if unknown.
+   */
+  static uint64_t physicalMemory();
+
+  /**
+   * \brief The limit to use when none is configured.
+   *
+   * That's a part of the physical memory, leaving the rest to the system,
+   * the caches and the user interface.  In 32-bit builds it's also kept
+   * well within the address space.
+   */
+  static uint64_t defaultLimit();
+
+ private:
+  uint64_t m_limit;
+  uint64_t m_reserved;
+  int m_numReservations;
+};
+
+
+#endif  // ifndef SCANTAILOR_CORE_MEMORYBUDGET_H_
@@ -0,0 +1,55 @@
+// Copyright (C) 2019  Joseph Artsimovich <joseph.artsimovich@gmail.com>, 4lex4 <4lex49@zoho.com>
+// Use of this source code is governed by the GNU GPLv3 license that can be found in the LICENSE file.
+
+#include "PageMemoryEstimate.h"
+
+#include <algorithm>
+
+#include "Dpi.h"
+#include "ImageMetadata.h"
+
+namespace {
+// The source image as loaded, plus its grayscale and binarized versions.
+const double SOURCE_BYTES_PER_PIXEL = 4 + 1 + 1;
+
+/**
+ * The bytes per pixel of the output image the output stage keeps alive at its peak:
+ * the transformed image, the masks and the result, along with the connectivity
+ * maps of despeckling for black and white content.
+ */
+double outputBytesPerPixel(const output::ColorMode colorMode) {
+  switch (colorMode) {
+    case output::BLACK_AND_WHITE:
+      return 8;
+    case output::COLOR_GRAYSCALE:
+      return 12;
+    case output::MIXED:
+      return 16;
+  }
+  return 16;
+}
+
+double numPixels(const ImageMetadata& metadata) {
+  return double(metadata.size().width()) * metadata.size().height();
+}
+}  // namespace
+
+uint64_t PageMemoryEstimate::forSource(const ImageMetadata& metadata) {
+  return static_cast<uint64_t>(numPixels(metadata) * SOURCE_BYTES_PER_PIXEL);
+}
+
+uint64_t PageMemoryEstimate::forOutput(const ImageMetadata& metadata,
+                                       const output::ColorMode colorMode,
+                                       const Dpi& outputDpi) {
+  double scale = 1.0;
+  const Dpi& sourceDpi = metadata.dpi();
+  if (!sourceDpi.isNull() && !outputDpi.isNull()) {
+    scale = (double(outputDpi.horizontal()) / sourceDpi.horizontal())
+            * (double(outputDpi.vertical()) / sourceDpi.vertical());
+  }
+  const double outputPixels = numPixels(metadata) * scale;
+  // The source image is still around while the output is being built.
+  const auto outputBytes
+      = static_cast<uint64_t>(numPixels(metadata) * 4 + outputPixels * outputBytesPerPixel(colorMode));
+  return std::max(outputBytes, forSource(metadata));
+}
@@ -0,0 +1,36 @@
+// Copyright (C) 2019  Joseph Artsimovich <joseph.artsimovich@gmail.com>, 4lex4 <4lex49@zoho.com>
+// Use of this source code is governed by the GNU GPLv3 license that can be found in the LICENSE file.
+
+#ifndef SCANTAILOR_CORE_PAGEMEMORYESTIMATE_H_
+#define SCANTAILOR_CORE_PAGEMEMORYESTIMATE_H_
+
+#include <cstdint>
+
+#include "filters/output/ColorParams.h"
+
+class Dpi;
+class ImageMetadata;
+
+/**
+ * \brief Rough estimates of the peak memory processing a page takes.
+ *
+ * They are meant for admission control, not accounting, so they err on
+ * the high side.  Nothing tells the color depth of the source image before
+ * loading it, so it's assumed to be the deepest one the pipeline works with,
+ * which is 32 bits per pixel.
+ */
+class PageMemoryEstimate {
+ public:
+  /**
+   * \brief Processing a page up to, but not including, the output stage.
+   */
+  static uint64_t forSource(const ImageMetadata& metadata);
+
+  /**
+   * \brief Processing a page through the output stage.
+   */
+  static uint64_t forOutput(const ImageMetadata& metadata, output::ColorMode colorMode, const Dpi& outputDpi);
+};
+
+
+#endif  // ifndef SCANTAILOR_CORE_PAGEMEMORYESTIMATE_H_
@@ -0,0 +1,39 @@
+// Copyright (C) 2019  Joseph Artsimovich <joseph.artsimovich@gmail.com>, 4lex4 <4lex49@zoho.com>
+// Use of this source code is governed by the GNU GPLv3 license that can be found in the LICENSE file.
+
+#include "PendingTaskQueue.h"
+
+#include <algorithm>
+
+#include "MemoryBudget.h"
+
+void PendingTaskQueue::push(const BackgroundTaskPtr& task) {
+  if (task->type() == BackgroundTask::INTERACTIVE) {
+    // Goes after other interactive tasks, but before any batch ones.
+    const auto it = std::find_if(m_entries.begin(), m_entries.end(),
+                                 [](const Entry& entry) { return entry.task->type() != BackgroundTask::INTERACTIVE; });
+    m_entries.insert(it, Entry{task, 0});
+  } else {
+    m_entries.push_back(Entry{task, 0});
+  }
+}
+
+BackgroundTaskPtr PendingTaskQueue::takeNext(const MemoryBudget& budget) {
+  for (size_t idx = 0; idx < m_entries.size(); ++idx) {
+    const Entry& entry = m_entries[idx];
+    if (budget.canReserve(entry.task->estimatedMemoryUsage())) {
+      // The tasks before this one didn't fit, so they are being overtaken.
+      for (size_t i = 0; i < idx; ++i) {
+        ++m_entries[i].timesOvertaken;
+      }
+      BackgroundTaskPtr task(entry.task);
+      m_entries.erase(m_entries.begin() + idx);
+      return task;
+    }
+    if (entry.timesOvertaken >= MAX_TIMES_OVERTAKEN) {
+      // Let the running tasks finish until it fits.
+      break;
+    }
+  }
+  return nullptr;
+}
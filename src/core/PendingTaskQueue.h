@@ -0,0 +1,50 @@
+// Copyright (C) 2019  Joseph Artsimovich <joseph.artsimovich@gmail.com>, 4lex4 <4lex49@zoho.com>
+// Use of this source code is governed by the GNU GPLv3 license that can be found in the LICENSE file.
+
+#ifndef SCANTAILOR_CORE_PENDINGTASKQUEUE_H_
+#define SCANTAILOR_CORE_PENDINGTASKQUEUE_H_
+
+#include <cstddef>
+#include <deque>
+
+#include "BackgroundTask.h"
+
+class MemoryBudget;
+
+/**
+ * \brief The tasks of WorkerThreadPool waiting to run, and the order they start in.
+ *
+ * Interactive tasks go before batch ones.  A task whose
+ * BackgroundTask::estimatedMemoryUsage() doesn't fit the memory budget
+ * is deferred, letting the tasks queued after it go first, but only
+ * MAX_TIMES_OVERTAKEN times.  After that, nothing else is taken until it fits.
+ *
+ * The class is not thread-safe.
+ */
+class PendingTaskQueue {
+ public:
+  static const int MAX_TIMES_OVERTAKEN = 8;
+
+  void push(const BackgroundTaskPtr& task);
+
+  /**
+   * \brief Removes and returns the task to start next, or null if none may start
+   *        until some of the memory reserved in \p budget is released.
+   */
+  BackgroundTaskPtr takeNext(const MemoryBudget& budget);
+
+  bool empty() const { return m_entries.empty(); }
+
+  size_t size() const { return m_entries.size(); }
+
+ private:
+  struct Entry {
+    BackgroundTaskPtr task;
+    int timesOvertaken;
+  };
+
+  std::deque<Entry> m_entries;
+};
+
+
+#endif  // ifndef SCANTAILOR_CORE_PENDINGTASKQUEUE_H_
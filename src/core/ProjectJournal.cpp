@@ -0,0 +1,277 @@
+// Copyright (C) 2019  Joseph Artsimovich <joseph.artsimovich@gmail.com>, 4lex4 <4lex49@zoho.com>
+// Use of this source code is governed by the GNU GPLv3 license that can be found in the LICENSE file.
+
+#include "ProjectJournal.h"
+
+#include <QCryptographicHash>
+#include <QDomDocument>
+#include <QFile>
+#include <QIODevice>
+#include <QSaveFile>
+#include <QStringList>
+#include <map>
+#include <unordered_set>
+#include <vector>
+
+namespace {
+QByteArray headerLine(const QByteArray& projectDigest) {
+  return "ScanTailor project journal 1 " + projectDigest.toHex() + '\n';
+}
+
+std::unordered_set<int> parseIds(const QString& ids) {
+  std::unordered_set<int> result;
+#if QT_VERSION_MAJOR == 5 && QT_VERSION_MINOR < 14
+  auto opt = QString::SkipEmptyParts;
+#else
+  auto opt = Qt::SkipEmptyParts;
+#endif
+  for (const QString& id : ids.split(' ', opt)) {
+    bool ok = false;
+    const int numericId = id.toInt(&ok);
+    if (ok) {
+      result.insert(numericId);
+    }
+  }
+  return result;
+}
+
+/**
+ * Records are the elements holding the settings of a single image or page,
+ * identified by its numeric id.
+ */
+bool isRecord(const QDomElement& el) {
+  return el.hasAttribute("id");
+}
+
+bool hasRecords(const QDomElement& el) {
+  for (QDomElement child(el.firstChildElement()); !child.isNull(); child = child.nextSiblingElement()) {
+    if (isRecord(child)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+/**
+ * The tag name of the element following the records among the children of \p el,
+ * or an empty string if the records are the last children or there are none.
+ */
+QString tagAfterRecords(const QDomElement& el) {
+  bool recordsSeen = false;
+  for (QDomElement child(el.firstChildElement()); !child.isNull(); child = child.nextSiblingElement()) {
+    if (isRecord(child)) {
+      recordsSeen = true;
+    } else if (recordsSeen) {
+      return child.tagName();
+    }
+  }
+  return QString();
+}
+
+/**
+ * Everything in \p entryEl but the records replaces its counterpart in \p baseEl,
+ * while the records of \p changedIds in \p baseEl are replaced by the ones
+ * in \p entryEl, if any.
+ *
+ * The children end up in the order ProjectWriter writes them: the other
+ * elements in the order of \p entryEl, and the records in the order of their
+ * ids, in the place they take in \p entryEl, or in \p baseEl if \p entryEl
+ * has none.  That keeps a compacted project file identical to a full write
+ * of the same project.
+ */
+void merge(QDomDocument& doc,
+           QDomElement& baseEl,
+           const QDomElement& entryEl,
+           const std::unordered_set<int>& changedIds) {
+  const QDomNamedNodeMap baseAttrs(baseEl.attributes());
+  QStringList obsoleteAttrs;
+  for (int i = 0; i < baseAttrs.count(); ++i) {
+    const QString name(baseAttrs.item(i).nodeName());
+    if (!entryEl.hasAttribute(name)) {
+      obsoleteAttrs.push_back(name);
+    }
+  }
+  for (const QString& name : obsoleteAttrs) {
+    baseEl.removeAttribute(name);
+  }
+  const QDomNamedNodeMap entryAttrs(entryEl.attributes());
+  for (int i = 0; i < entryAttrs.count(); ++i) {
+    const QDomNode attr(entryAttrs.item(i));
+    baseEl.setAttribute(attr.nodeName(), attr.nodeValue());
+  }
+
+  std::map<int, QDomNode> records;
+  for (QDomElement child(baseEl.firstChildElement()); !child.isNull(); child = child.nextSiblingElement()) {
+    const int id = child.attribute("id").toInt();
+    if (isRecord(child) && (changedIds.count(id) == 0)) {
+      records[id] = child;
+    }
+  }
+  std::vector<QDomNode> others;
+  for (QDomElement child(entryEl.firstChildElement()); !child.isNull(); child = child.nextSiblingElement()) {
+    if (isRecord(child)) {
+      records[child.attribute("id").toInt()] = doc.importNode(child, true);
+      continue;
+    }
+    QDomElement baseChild(baseEl.firstChildElement(child.tagName()));
+    if (!baseChild.isNull() && (hasRecords(baseChild) || hasRecords(child))) {
+      merge(doc, baseChild, child, changedIds);
+      others.push_back(baseChild);
+    } else {
+      others.push_back(doc.importNode(child, true));
+    }
+  }
+  const QString recordsBefore(tagAfterRecords(hasRecords(entryEl) ? entryEl : baseEl));
+
+  while (!baseEl.firstChild().isNull()) {
+    baseEl.removeChild(baseEl.firstChild());
+  }
+  bool recordsAppended = false;
+  const auto appendRecords = [&]() {
+    for (auto& idAndRecord : records) {
+      baseEl.appendChild(idAndRecord.second);
+    }
+    recordsAppended = true;
+  };
+  for (QDomNode& child : others) {
+    if (!recordsAppended && (child.toElement().tagName() == recordsBefore)) {
+      appendRecords();
+    }
+    baseEl.appendChild(child);
+  }
+  if (!recordsAppended) {
+    appendRecords();
+  }
+}  // merge
+}  // namespace
+
+QString ProjectJournal::filePathFor(const QString& projectFilePath) {
+  return projectFilePath + ".journal";
+}
+
+QByteArray ProjectJournal::digest(const QByteArray& projectData) {
+  return QCryptographicHash::hash(projectData, QCryptographicHash::Sha1);
+}
+
+bool ProjectJournal::append(const QString& projectFilePath,
+                            const QByteArray& projectDigest,
+                            const QByteArray& entryXml) {
+  const QByteArray header(headerLine(projectDigest));
+
+  QFile file(filePathFor(projectFilePath));
+  bool startNew = true;
+  if (file.open(QIODevice::ReadOnly)) {
+    startNew = (file.readLine() != header);
+    file.close();
+  }
+  const QIODevice::OpenMode mode = startNew ? QIODevice::Truncate : QIODevice::Append;
+  if (!file.open(QIODevice::WriteOnly | mode)) {
+    return false;
+  }
+
+  QByteArray record;
+  if (startNew) {
+    record += header;
+  }
+  record += QByteArray::number(entryXml.size()) + '\n';
+  record += entryXml;
+  record += '\n';
+  return (file.write(record) == record.size()) && file.flush();
+}
+
+void ProjectJournal::remove(const QString& projectFilePath) {
+  QFile::remove(filePathFor(projectFilePath));
+}
+
+int ProjectJournal::replay(const QString& projectFilePath, const QByteArray& projectData, QDomDocument& doc) {
+  QFile file(filePathFor(projectFilePath));
+  if (!file.open(QIODevice::ReadOnly)) {
+    return 0;
+  }
+  if (file.readLine() != headerLine(digest(projectData))) {
+    return 0;
+  }
+
+  int numApplied = 0;
+  while (!file.atEnd()) {
+    bool ok = false;
+    const qint64 size = file.readLine().trimmed().toLongLong(&ok);
+    if (!ok || (size < 0)) {
+      break;
+    }
+    const QByteArray entryXml(file.read(size));
+    if ((entryXml.size() != size) || (file.read(1) != "\n")) {
+      break;
+    }
+    QDomDocument entryDoc;
+    if (!entryDoc.setContent(entryXml)) {
+      break;
+    }
+    applyEntry(doc, entryDoc.documentElement());
+    ++numApplied;
+  }
+  return numApplied;
+}
+
+bool ProjectJournal::compact(const QString& projectFilePath) {
+  if (!QFile::exists(filePathFor(projectFilePath))) {
+    return true;
+  }
+
+  QFile file(projectFilePath);
+  if (!file.open(QIODevice::ReadOnly)) {
+    return false;
+  }
+  const QByteArray projectData(file.readAll());
+  file.close();
+
+  QDomDocument doc;
+  if (!doc.setContent(projectData)) {
+    return false;
+  }
+
+  if (replay(projectFilePath, projectData, doc) > 0) {
+    const QByteArray compacted(doc.toByteArray(2));
+    QSaveFile saveFile(projectFilePath);
+    if (!saveFile.open(QIODevice::WriteOnly) || (saveFile.write(compacted) != compacted.size())
+        || !saveFile.commit()) {
+      return false;
+    }
+  }
+  remove(projectFilePath);
+  return true;
+}
+
+void ProjectJournal::applyEntry(QDomDocument& doc, const QDomElement& entryEl) {
+  QDomElement projectEl(doc.documentElement());
+  const std::unordered_set<int> changedIds(parseIds(entryEl.firstChildElement("changed").attribute("ids")));
+
+  const QDomElement selectedEl(entryEl.firstChildElement("selected"));
+  if (!selectedEl.isNull()) {
+    const std::unordered_set<int> selectedIds(parseIds(selectedEl.attribute("ids")));
+    QDomElement pageEl(projectEl.firstChildElement("pages").firstChildElement("page"));
+    for (; !pageEl.isNull(); pageEl = pageEl.nextSiblingElement("page")) {
+      if (selectedIds.count(pageEl.attribute("id").toInt())) {
+        pageEl.setAttribute("selected", "selected");
+      } else {
+        pageEl.removeAttribute("selected");
+      }
+    }
+  }
+
+  QDomElement filtersEl(projectEl.firstChildElement("filters"));
+  if (filtersEl.isNull()) {
+    filtersEl = doc.createElement("filters");
+    projectEl.appendChild(filtersEl);
+  }
+  const QDomElement entryFiltersEl(entryEl.firstChildElement("filters"));
+  QDomElement entryFilterEl(entryFiltersEl.firstChildElement());
+  for (; !entryFilterEl.isNull(); entryFilterEl = entryFilterEl.nextSiblingElement()) {
+    QDomElement filterEl(filtersEl.firstChildElement(entryFilterEl.tagName()));
+    if (filterEl.isNull()) {
+      filtersEl.appendChild(doc.importNode(entryFilterEl, true));
+    } else {
+      merge(doc, filterEl, entryFilterEl, changedIds);
+    }
+  }
+}  // ProjectJournal::applyEntry
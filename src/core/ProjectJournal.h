@@ -0,0 +1,71 @@
+// Copyright (C) 2019  Joseph Artsimovich <joseph.artsimovich@gmail.com>, 4lex4 <4lex49@zoho.com>
+// Use of this source code is governed by the GNU GPLv3 license that can be found in the LICENSE file.
+
+#ifndef SCANTAILOR_CORE_PROJECTJOURNAL_H_
+#define SCANTAILOR_CORE_PROJECTJOURNAL_H_
+
+#include <QByteArray>
+#include <QString>
+
+class QDomDocument;
+class QDomElement;
+
+/**
+ * \brief An append-only log of the changes made to a project since its file was last written.
+ *
+ * The journal lives next to the project file, as "<project file>.journal".
+ * Each entry is produced by ProjectWriter::toJournalEntryXml() and carries
+ * the complete filter records of some images and pages, identified by their
+ * numeric ids in the project file, plus the filter-wide settings and the
+ * page selection.  Applying an entry replaces the records of those ids.
+ *
+ * The journal starts with the digest of the project file it extends,
+ * so a journal left over from another version of the file is ignored.
+ * An entry that was cut short by a crash is ignored as well, along with
+ * anything after it.
+ */
+class ProjectJournal {
+ public:
+  static QString filePathFor(const QString& projectFilePath);
+
+  /**
+   * \brief The digest of the contents of a project file, identifying
+   *        the version of it a journal extends.
+   */
+  static QByteArray digest(const QByteArray& projectData);
+
+  /**
+   * \brief Appends an entry to the journal of \p projectFilePath.
+   *
+   * If the journal doesn't exist, or it extends a different version of
+   * the project file than the one identified by \p projectDigest,
+   * a new journal is started.
+   */
+  static bool append(const QString& projectFilePath, const QByteArray& projectDigest, const QByteArray& entryXml);
+
+  static void remove(const QString& projectFilePath);
+
+  /**
+   * \brief Applies the journal of \p projectFilePath to \p doc.
+   *
+   * \param projectData The contents of the project file.
+   * \param doc The document parsed from \p projectData.
+   * \return The number of entries applied.
+   */
+  static int replay(const QString& projectFilePath, const QByteArray& projectData, QDomDocument& doc);
+
+  /**
+   * \brief Applies the journal of \p projectFilePath, if any, to the project file and removes the journal.
+   *
+   * \return false if the project file could not be read or written.
+   */
+  static bool compact(const QString& projectFilePath);
+
+  /**
+   * \brief Applies a single journal entry to a project document.
+   */
+  static void applyEntry(QDomDocument& doc, const QDomElement& entryEl);
+};
+
+
+#endif  // ifndef SCANTAILOR_CORE_PROJECTJOURNAL_H_
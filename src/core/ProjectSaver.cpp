@@ -0,0 +1,212 @@
+// Copyright (C) 2019  Joseph Artsimovich <joseph.artsimovich@gmail.com>, 4lex4 <4lex49@zoho.com>
+// Use of this source code is governed by the GNU GPLv3 license that can be found in the LICENSE file.
+
+#include "ProjectSaver.h"
+
+#include <Tracer.h>
+
+#include <QCoreApplication>
+#include <QEvent>
+#include <QSaveFile>
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <mutex>
+
+#include "ProjectJournal.h"
+#include "ProjectWriter.h"
+#include "TaskScheduler.h"
+
+namespace {
+TaskScheduler& saveScheduler() {
+  // A single thread, so a project file and its journal are never written concurrently.
+  static TaskScheduler scheduler(1);
+  return scheduler;
+}
+
+class SavedEvent : public QEvent {
+ public:
+  SavedEvent(const QString& filePath, bool success) : QEvent(QEvent::User), filePath(filePath), success(success) {}
+
+  QString filePath;
+  bool success;
+};
+}  // namespace
+
+/**
+ * The part of a saver shared with the task doing the saves.
+ */
+class ProjectSaver::State : public std::enable_shared_from_this<State> {
+ public:
+  struct Job {
+    std::shared_ptr<ProjectWriter> writer;
+    QString filePath;
+    std::vector<FilterPtr> filters;
+    std::unordered_set<ImageId> changedImages;
+    bool changesOnly = false;
+    bool notify = true;
+    std::shared_ptr<std::promise<bool>> result;
+  };
+
+  explicit State(ProjectSaver* owner) : m_owner(owner), m_numPending(0), m_draining(false), m_numJournalEntries(0) {}
+
+  void detach() {
+    std::lock_guard<std::mutex> guard(m_mutex);
+    m_owner = nullptr;
+  }
+
+  void schedule(Job job) {
+    std::lock_guard<std::mutex> guard(m_mutex);
+    m_jobs.push_back(std::move(job));
+    ++m_numPending;
+    if (!m_draining) {
+      m_draining = true;
+      const std::shared_ptr<State> self(shared_from_this());
+      saveScheduler().submit([self]() { self->drain(); });
+    }
+  }
+
+  void waitForDone() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_allDone.wait(lock, [this]() { return m_numPending == 0; });
+  }
+
+ private:
+  void drain() {
+    while (true) {
+      Job job;
+      {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        if (m_jobs.empty()) {
+          m_draining = false;
+          return;
+        }
+        job = std::move(m_jobs.front());
+        m_jobs.pop_front();
+      }
+
+      bool success = false;
+      try {
+        success = execute(job);
+      } catch (...) {
+        // The tasks are not allowed to throw.
+        m_journalProjectPath.clear();
+      }
+      // Waiting for the saves to finish is what allows the filters to be
+      // destroyed in the GUI thread, so don't hold them past that point.
+      job.writer.reset();
+      job.filters.clear();
+      if (job.result) {
+        job.result->set_value(success);
+      }
+
+      std::lock_guard<std::mutex> guard(m_mutex);
+      if (job.notify && m_owner) {
+        QCoreApplication::postEvent(m_owner, new SavedEvent(job.filePath, success));
+      }
+      if (--m_numPending == 0) {
+        m_allDone.notify_all();
+      }
+    }
+  }
+
+  /**
+   * Only called from drain(), so the journal state needs no locking.
+   */
+  bool execute(Job& job) {
+    if (job.changesOnly && (job.filePath == m_journalProjectPath) && (m_numJournalEntries < MAX_JOURNAL_ENTRIES)
+        && (job.writer->structureDigest(job.filePath) == m_structureDigest)) {
+      TRACE_SPAN("project", "ProjectSaver::appendJournal");
+      job.writer->restrictToImages(job.changedImages);
+      if (!ProjectJournal::append(job.filePath, m_projectDigest, job.writer->toJournalEntryXml(job.filters))) {
+        // Start over with a full save next time.
+        m_journalProjectPath.clear();
+        return false;
+      }
+      ++m_numJournalEntries;
+      return true;
+    }
+
+    TRACE_SPAN("project", "ProjectSaver::writeProject");
+    m_journalProjectPath.clear();
+
+    const QByteArray data(job.writer->toXml(job.filePath, job.filters));
+    QSaveFile file(job.filePath);
+    if (!file.open(QIODevice::WriteOnly) || (file.write(data) != data.size()) || !file.commit()) {
+      return false;
+    }
+    ProjectJournal::remove(job.filePath);
+
+    m_journalProjectPath = job.filePath;
+    m_projectDigest = ProjectJournal::digest(data);
+    m_structureDigest = job.writer->structureDigest(job.filePath);
+    m_numJournalEntries = 0;
+    return true;
+  }
+
+  std::mutex m_mutex;
+  std::condition_variable m_allDone;
+  ProjectSaver* m_owner;
+  std::deque<Job> m_jobs;
+  int m_numPending;
+  bool m_draining;
+
+  QString m_journalProjectPath;
+  QByteArray m_projectDigest;
+  QByteArray m_structureDigest;
+  int m_numJournalEntries;
+};
+
+
+ProjectSaver::ProjectSaver(QObject* parent) : QObject(parent), m_state(std::make_shared<State>(this)) {}
+
+ProjectSaver::~ProjectSaver() {
+  m_state->waitForDone();
+  m_state->detach();
+}
+
+void ProjectSaver::save(std::unique_ptr<ProjectWriter> writer,
+                        const QString& filePath,
+                        const std::vector<FilterPtr>& filters) {
+  State::Job job;
+  job.writer = std::move(writer);
+  job.filePath = filePath;
+  job.filters = filters;
+  m_state->schedule(std::move(job));
+}
+
+void ProjectSaver::saveChanges(std::unique_ptr<ProjectWriter> writer,
+                               const std::unordered_set<ImageId>& changedImages,
+                               const QString& filePath,
+                               const std::vector<FilterPtr>& filters) {
+  State::Job job;
+  job.writer = std::move(writer);
+  job.filePath = filePath;
+  job.filters = filters;
+  job.changedImages = changedImages;
+  job.changesOnly = true;
+  m_state->schedule(std::move(job));
+}
+
+bool ProjectSaver::saveAndWait(std::unique_ptr<ProjectWriter> writer,
+                               const QString& filePath,
+                               const std::vector<FilterPtr>& filters) {
+  State::Job job;
+  job.writer = std::move(writer);
+  job.filePath = filePath;
+  job.filters = filters;
+  job.notify = false;
+  job.result = std::make_shared<std::promise<bool>>();
+  std::future<bool> result(job.result->get_future());
+  m_state->schedule(std::move(job));
+  return result.get();
+}
+
+void ProjectSaver::waitForDone() {
+  m_state->waitForDone();
+}
+
+void ProjectSaver::customEvent(QEvent* event) {
+  const auto* savedEvent = static_cast<SavedEvent*>(event);
+  emit saved(savedEvent->filePath, savedEvent->success);
+}
@@ -0,0 +1,99 @@
+// Copyright (C) 2019  Joseph Artsimovich <joseph.artsimovich@gmail.com>, 4lex4 <4lex49@zoho.com>
+// Use of this source code is governed by the GNU GPLv3 license that can be found in the LICENSE file.
+
+#ifndef SCANTAILOR_CORE_PROJECTSAVER_H_
+#define SCANTAILOR_CORE_PROJECTSAVER_H_
+
+#include <QObject>
+#include <QString>
+#include <memory>
+#include <unordered_set>
+#include <vector>
+
+#include "ImageId.h"
+#include "NonCopyable.h"
+
+class AbstractFilter;
+class ProjectWriter;
+
+/**
+ * \brief Writes project files on a background thread.
+ *
+ * A ProjectWriter only takes a snapshot of the page sequence, so it's cheap
+ * to create on the GUI thread.  The filter settings, which make up most of
+ * a project, are serialized by the saver, off the GUI thread, as the settings
+ * classes are thread-safe anyway.
+ *
+ * Saves are carried out one at a time, in the order they were requested.
+ * A full save replaces the project file and drops its ProjectJournal.
+ * Saving changes only appends the settings of the changed images to that
+ * journal, unless there is no journal this saver started on top of the
+ * project file, the set of pages changed, or the journal has grown long,
+ * in which case a full save is done instead.
+ */
+class ProjectSaver : public QObject {
+  Q_OBJECT
+  DECLARE_NON_COPYABLE(ProjectSaver)
+
+ public:
+  using FilterPtr = std::shared_ptr<AbstractFilter>;
+
+  /**
+   * Once a journal has that many entries, the next save of changes
+   * writes the whole project instead.
+   */
+  static const int MAX_JOURNAL_ENTRIES = 32;
+
+  explicit ProjectSaver(QObject* parent = nullptr);
+
+  /**
+   * \brief Waits for the scheduled saves to finish.
+   */
+  ~ProjectSaver() override;
+
+  /**
+   * \brief Schedules writing the whole project to \p filePath.
+   */
+  void save(std::unique_ptr<ProjectWriter> writer, const QString& filePath, const std::vector<FilterPtr>& filters);
+
+  /**
+   * \brief Schedules saving the settings of \p changedImages and their pages,
+   *        along with the page selection.
+   */
+  void saveChanges(std::unique_ptr<ProjectWriter> writer,
+                   const std::unordered_set<ImageId>& changedImages,
+                   const QString& filePath,
+                   const std::vector<FilterPtr>& filters);
+
+  /**
+   * \brief Writes the whole project after the scheduled saves are done.
+   *
+   * \return Whether the project was written successfully.  The saved() signal
+   *         is not emitted for this save.
+   */
+  bool saveAndWait(std::unique_ptr<ProjectWriter> writer,
+                   const QString& filePath,
+                   const std::vector<FilterPtr>& filters);
+
+  /**
+   * \brief Blocks until the scheduled saves are done.
+   */
+  void waitForDone();
+
+ signals:
+
+  /**
+   * \brief Emitted in the thread the saver lives in, when a scheduled save is done.
+   */
+  void saved(const QString& filePath, bool success);
+
+ private:
+  class State;
+
+  void customEvent(QEvent* event) override;
+
+  std::shared_ptr<State> m_state;
+};
+
+
+#endif  // ifndef SCANTAILOR_CORE_PROJECTSAVER_H_
@@ -3,10 +3,10 @@
 
 #include "ProjectWriter.h"
 
+#include <QCryptographicHash>
 #include <QDir>
 #include <QFile>
 #include <QFileInfo>
-#include <QTextStream>
 #include <QtXml>
 
 #include "AbstractFilter.h"
@@ -34,7 +34,8 @@ ProjectWriter::ProjectWriter(const std::shared_ptr<ProjectPages>& pageSequence,
     : m_pageSequence(pageSequence->toPageSequence(PAGE_VIEW)),
       m_outFileNameGen(outFileNameGen),
       m_selectedPage(selectedPage),
-      m_layoutDirection(pageSequence->layoutDirection()) {
+      m_layoutDirection(pageSequence->layoutDirection()),
+      m_restricted(false) {
   int nextId = 1;
   for (const PageInfo& page : m_pageSequence) {
     const PageId& pageId = page.id();
@@ -78,11 +79,78 @@ static QString toRelativeIfPossible(const QString& projectDirPath, const QString
 }
 
 bool ProjectWriter::write(const QString& filePath, const std::vector<FilterPtr>& filters) const {
+  const QByteArray data(toXml(filePath, filters));
+
+  QFile file(filePath);
+  if (file.open(QIODevice::WriteOnly)) {
+    return file.write(data) == data.size();
+  }
+  return false;
+}
+
+QByteArray ProjectWriter::toXml(const QString& filePath, const std::vector<FilterPtr>& filters) const {
   const QString projectDirPath(QFileInfo(filePath).absolutePath());
 
   QDomDocument doc;
-  QDomElement rootEl(doc.createElement("project"));
+  QDomElement rootEl(processProject(doc, projectDirPath));
   doc.appendChild(rootEl);
+
+  QDomElement filtersEl(doc.createElement("filters"));
+  rootEl.appendChild(filtersEl);
+  for (const FilterPtr& filter : filters) {
+    filtersEl.appendChild(filter->saveSettings(*this, doc));
+  }
+  return doc.toByteArray(2);
+}
+
+QByteArray ProjectWriter::toJournalEntryXml(const std::vector<FilterPtr>& filters) const {
+  QDomDocument doc;
+  QDomElement entryEl(doc.createElement("journal-entry"));
+  doc.appendChild(entryEl);
+
+  // The records of these ids are replaced, even by nothing, if a filter has no settings for them.
+  QStringList changedIds;
+  enumImages([&](const ImageId&, const int numericId) { changedIds.push_back(QString::number(numericId)); });
+  enumPages([&](const PageId&, const int numericId) { changedIds.push_back(QString::number(numericId)); });
+  QDomElement changedEl(doc.createElement("changed"));
+  changedEl.setAttribute("ids", changedIds.join(' '));
+  entryEl.appendChild(changedEl);
+
+  QStringList selectedIds;
+  for (const int numericId : selectedPageIds()) {
+    selectedIds.push_back(QString::number(numericId));
+  }
+  QDomElement selectedEl(doc.createElement("selected"));
+  selectedEl.setAttribute("ids", selectedIds.join(' '));
+  entryEl.appendChild(selectedEl);
+
+  QDomElement filtersEl(doc.createElement("filters"));
+  entryEl.appendChild(filtersEl);
+  for (const FilterPtr& filter : filters) {
+    filtersEl.appendChild(filter->saveSettings(*this, doc));
+  }
+  return doc.toByteArray(-1);
+}
+
+QByteArray ProjectWriter::structureDigest(const QString& filePath) const {
+  QDomDocument doc;
+  QDomElement rootEl(processProject(doc, QFileInfo(filePath).absolutePath()));
+  doc.appendChild(rootEl);
+
+  QDomElement pageEl(rootEl.firstChildElement("pages").firstChildElement("page"));
+  for (; !pageEl.isNull(); pageEl = pageEl.nextSiblingElement("page")) {
+    pageEl.removeAttribute("selected");
+  }
+  return QCryptographicHash::hash(doc.toByteArray(-1), QCryptographicHash::Sha1);
+}
+
+void ProjectWriter::restrictToImages(const std::unordered_set<ImageId>& images) {
+  m_restrictedTo = images;
+  m_restricted = true;
+}
+
+QDomElement ProjectWriter::processProject(QDomDocument& doc, const QString& projectDirPath) const {
+  QDomElement rootEl(doc.createElement("project"));
   rootEl.setAttribute("version", PROJECT_VERSION);
   rootEl.setAttribute("outputDirectory", toRelativeIfPossible(projectDirPath, m_outFileNameGen.outDir()));
   rootEl.setAttribute("layoutDirection", m_layoutDirection == Qt::LeftToRight ? "LTR" : "RTL");
@@ -93,23 +161,8 @@ bool ProjectWriter::write(const QString& filePath, const std::vector<FilterPtr>&
   rootEl.appendChild(processPages(doc));
   rootEl.appendChild(m_outFileNameGen.disambiguator()->toXml(
       doc, "file-name-disambiguation", boost::bind(&ProjectWriter::packFilePath, this, boost::placeholders::_1)));
-
-  QDomElement filtersEl(doc.createElement("filters"));
-  rootEl.appendChild(filtersEl);
-  auto it(filters.begin());
-  const auto end(filters.end());
-  for (; it != end; ++it) {
-    filtersEl.appendChild((*it)->saveSettings(*this, doc));
-  }
-
-  QFile file(filePath);
-  if (file.open(QIODevice::WriteOnly)) {
-    QTextStream strm(&file);
-    doc.save(strm, 2);
-    return true;
-  }
-  return false;
-}  // ProjectWriter::write
+  return rootEl;
+}
 
 QDomElement ProjectWriter::processDirectories(QDomDocument& doc, const QString& projectDirPath) const {
   QDomElement dirsEl(doc.createElement("directories"));
@@ -176,6 +229,25 @@ void ProjectWriter::writeImageMetadata(QDomDocument& doc, QDomElement& imageEl,
 QDomElement ProjectWriter::processPages(QDomDocument& doc) const {
   QDomElement pagesEl(doc.createElement("pages"));
 
+  const std::unordered_set<int> selectedIds(selectedPageIds());
+  for (const PageInfo& page : m_pageSequence) {
+    const PageId& pageId = page.id();
+    const int numericId = this->pageId(pageId);
+    QDomElement pageEl(doc.createElement("page"));
+    pageEl.setAttribute("id", numericId);
+    pageEl.setAttribute("imageId", imageId(pageId.imageId()));
+    pageEl.setAttribute("subPage", pageId.subPageAsString());
+    if (selectedIds.count(numericId)) {
+      pageEl.setAttribute("selected", "selected");
+    }
+    pagesEl.appendChild(pageEl);
+  }
+  return pagesEl;
+}
+
+std::unordered_set<int> ProjectWriter::selectedPageIds() const {
+  std::unordered_set<int> selectedIds;
+
   const PageId selOpt1(m_selectedPage.get(IMAGE_VIEW));
   const PageId selOpt2(m_selectedPage.get(PAGE_VIEW));
 
@@ -187,21 +259,15 @@ QDomElement ProjectWriter::processPages(QDomDocument& doc) const {
     pageRight = PageId(selOpt2.imageId(), PageId::RIGHT_PAGE);
   }
 
-
   for (const PageInfo& page : m_pageSequence) {
     const PageId& pageId = page.id();
-    QDomElement pageEl(doc.createElement("page"));
-    pageEl.setAttribute("id", this->pageId(pageId));
-    pageEl.setAttribute("imageId", imageId(pageId.imageId()));
-    pageEl.setAttribute("subPage", pageId.subPageAsString());
     if ((pageId == selOpt1) || (pageId == selOpt2) || (pageId == pageLeft) || (pageId == pageRight)) {
-      pageEl.setAttribute("selected", "selected");
+      selectedIds.insert(this->pageId(pageId));
       pageLeft = pageRight = PageId();  // if one of these match other shouldn't
     }
-    pagesEl.appendChild(pageEl);
   }
-  return pagesEl;
-}  // ProjectWriter::processPages
+  return selectedIds;
+}  // ProjectWriter::selectedPageIds
 
 int ProjectWriter::dirId(const QString& dirPath) const {
   const Directories::const_iterator it(m_dirs.find(dirPath));
@@ -241,13 +307,17 @@ int ProjectWriter::pageId(const PageId& pageId) const {
 
 void ProjectWriter::enumImagesImpl(const VirtualFunction<void, const ImageId&, int>& out) const {
   for (const Image& image : m_images.get<Sequenced>()) {
-    out(image.id, image.numericId);
+    if (!m_restricted || m_restrictedTo.count(image.id)) {
+      out(image.id, image.numericId);
+    }
   }
 }
 
 void ProjectWriter::enumPagesImpl(const VirtualFunction<void, const PageId&, int>& out) const {
   for (const Page& page : m_pages.get<Sequenced>()) {
-    out(page.id, page.numericId);
+    if (!m_restricted || m_restrictedTo.count(page.id.imageId())) {
+      out(page.id, page.numericId);
+    }
   }
 }
 
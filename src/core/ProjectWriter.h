@@ -6,6 +6,7 @@
 
 #include <foundation/Hashes.h>
 
+#include <QByteArray>
 #include <QString>
 #include <Qt>
 #include <boost/multi_index/hashed_index.hpp>
@@ -14,6 +15,7 @@
 #include <boost/multi_index_container.hpp>
 #include <memory>
 #include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
 #include "ImageId.h"
@@ -43,6 +45,33 @@ class ProjectWriter {
 
   bool write(const QString& filePath, const std::vector<FilterPtr>& filters) const;
 
+  /**
+   * \brief Serializes the whole project, the way write() stores it in \p filePath.
+   */
+  QByteArray toXml(const QString& filePath, const std::vector<FilterPtr>& filters) const;
+
+  /**
+   * \brief Serializes the settings enumerated by enumImages() and enumPages(),
+   *        along with the page selection, as a ProjectJournal entry.
+   */
+  QByteArray toJournalEntryXml(const std::vector<FilterPtr>& filters) const;
+
+  /**
+   * \brief A digest of everything toXml() writes, except the filter settings
+   *        and the page selection.
+   *
+   * A journal entry only applies on top of a project file with the same digest,
+   * as otherwise its numeric ids may refer to different pages.
+   */
+  QByteArray structureDigest(const QString& filePath) const;
+
+  /**
+   * \brief Restricts enumImages() and enumPages() to \p images and their pages.
+   *
+   * The numeric ids stay the same as if the whole project was enumerated.
+   */
+  void restrictToImages(const std::unordered_set<ImageId>& images);
+
   /**
    * \p out will be called like this: out(ImageId, numeric_image_id)
    */
@@ -125,6 +154,10 @@ class ProjectWriter {
 
   QDomElement processPages(QDomDocument& doc) const;
 
+  QDomElement processProject(QDomDocument& doc, const QString& projectDirPath) const;
+
+  std::unordered_set<int> selectedPageIds() const;
+
   void writeImageMetadata(QDomDocument& doc, QDomElement& imageEl, const ImageId& imageId) const;
 
   int dirId(const QString& dirPath) const;
@@ -150,6 +183,8 @@ class ProjectWriter {
   Pages m_pages;
   MetadataByImage m_metadataByImage;
   Qt::LayoutDirection m_layoutDirection;
+  std::unordered_set<ImageId> m_restrictedTo;
+  bool m_restricted;
 };
 
 
@@ -5,6 +5,7 @@
 
 #include <GrayImage.h>
 #include <Scale.h>
+#include <Tracer.h>
 
 #include <QCoreApplication>
 #include <QCryptographicHash>
@@ -590,6 +591,7 @@ void ThumbnailPixmapCache::Impl::backgroundProcessing() {
 QImage ThumbnailPixmapCache::Impl::loadSaveThumbnail(const ImageId& imageId,
                                                      const QString& thumbDir,
                                                      const QSize& maxThumbSize) {
+  TRACE_SPAN("thumbnails", "loadSaveThumbnail");
   const QString thumbFilePath(getThumbFilePath(imageId, thumbDir, maxThumbSize));
 
   QImage image(ImageLoader::load(thumbFilePath, 0));
@@ -597,7 +599,8 @@ QImage ThumbnailPixmapCache::Impl::loadSaveThumbnail(const ImageId& imageId,
     return image;
   }
 
-  image = ImageLoader::load(imageId);
+  // Decoding TIFFs a band at a time keeps large scans from being in memory in full.
+  image = ImageLoader::loadReduced(imageId, maxThumbSize);
   if (image.isNull()) {
     return QImage();
   }
@@ -6,11 +6,16 @@
 #include <tiff.h>
 #include <tiffio.h>
 
+#include <Grayscale.h>
+#include <Tracer.h>
+
 #include <QDebug>
 #include <QIODevice>
 #include <QImage>
+#include <algorithm>
 #include <cassert>
 #include <cmath>
+#include <vector>
 
 #include "Dpm.h"
 #include "ImageMetadata.h"
@@ -241,82 +246,407 @@ static void convertAbgrToArgb(const uint32_t* src, uint32_t* dst, int count) {
   }
 }
 
-QImage TiffReader::readImage(QIODevice& device, const int pageNum) {
-  if (!device.isReadable()) {
-    return QImage();
-  }
-  if (device.isSequential()) {
-    // libtiff needs to be able to seek.
-    return QImage();
-  }
+class TiffReader::LineReader {
+  DECLARE_NON_COPYABLE(LineReader)
 
-  TiffHeader header(readHeader(device));
-  if (!checkHeader(header)) {
-    return QImage();
+ public:
+  LineReader(const TiffHandle& tif, const TiffInfo& info);
+
+  ~LineReader();
+
+  /**
+   * \brief Creates an image of the page width and \p numLines lines, having
+   *        the format, the palette and the resolution of the page.
+   *
+   * \return The image, or a null image if the page can't be decoded.
+   */
+  QImage createImage(int numLines) const;
+
+  /**
+   * \brief Decodes the lines starting from \p firstLine into all the lines of \p image.
+   *
+   * The lines must be read from top to bottom.
+   */
+  bool readLines(QImage& image, int firstLine);
+
+  /**
+   * \brief The number of lines in a band that can be decoded without
+   *        decoding any strips or tiles twice.
+   */
+  int bandHeight() const { return m_bandHeight; }
+
+ private:
+  QVector<QRgb> binaryOrIndexed8Palette() const;
+
+  static const int MIN_BAND_HEIGHT;
+
+  const TiffHandle& m_tif;
+  const TiffInfo& m_info;
+  Dpm m_dpm;
+  QVector<QRgb> m_palette;
+  TIFFRGBAImage m_rgbaImage;
+  bool m_rgba;
+  bool m_rgbaStarted;
+  int m_bandHeight;
+};
+
+const int TiffReader::LineReader::MIN_BAND_HEIGHT = 64;
+
+TiffReader::LineReader::LineReader(const TiffHandle& tif, const TiffInfo& info)
+    : m_tif(tif), m_info(info), m_rgbaImage(), m_rgba(!info.mapsToBinaryOrIndexed8()), m_rgbaStarted(false) {
+  const ImageMetadata metadata(currentPageMetadata(tif));
+  if (!metadata.dpi().isNull()) {
+    m_dpm = Dpm(metadata.dpi());
   }
 
-  TiffHandle tif(TIFFClientOpen("file", "rBm", &device, &deviceRead, &deviceWrite, &deviceSeek, &deviceClose,
-                                &deviceSize, &deviceMap, &deviceUnmap));
-  if (!tif.handle()) {
-    return QImage();
+  uint32_t linesPerChunk = 0;
+  if (TIFFIsTiled(tif.handle())) {
+    TIFFGetField(tif.handle(), TIFFTAG_TILELENGTH, &linesPerChunk);
+  } else {
+    TIFFGetFieldDefaulted(tif.handle(), TIFFTAG_ROWSPERSTRIP, &linesPerChunk);
   }
+  linesPerChunk = std::max<uint32_t>(1, std::min<uint32_t>(linesPerChunk, info.height));
 
-  if (!TIFFSetDirectory(tif.handle(), (uint16_t) pageNum)) {
-    return QImage();
+  bool streamable = true;
+  if (m_rgba) {
+    char errorMsg[1024];
+    if (TIFFRGBAImageOK(tif.handle(), errorMsg) && TIFFRGBAImageBegin(&m_rgbaImage, tif.handle(), 0, errorMsg)) {
+      m_rgbaStarted = true;
+      m_rgbaImage.req_orientation = ORIENTATION_TOPLEFT;
+    }
+    // Reading a band of a page stored in some other orientation would
+    // require the lines from the opposite side of the page.
+    streamable = m_rgbaStarted && (m_rgbaImage.orientation == ORIENTATION_TOPLEFT);
+  } else {
+    m_palette = binaryOrIndexed8Palette();
   }
 
-  const TiffInfo info(tif, header);
+  if (streamable) {
+    const int chunks = (MIN_BAND_HEIGHT + linesPerChunk - 1) / linesPerChunk;
+    m_bandHeight = std::min<int>(info.height, chunks * linesPerChunk);
+  } else {
+    m_bandHeight = info.height;
+  }
+  m_bandHeight = std::max(1, m_bandHeight);
+}
 
-  const ImageMetadata metadata(currentPageMetadata(tif));
+TiffReader::LineReader::~LineReader() {
+  if (m_rgbaStarted) {
+    TIFFRGBAImageEnd(&m_rgbaImage);
+  }
+}
 
+QImage TiffReader::LineReader::createImage(const int numLines) const {
   QImage image;
-
-  if (info.mapsToBinaryOrIndexed8()) {
-    // Common case optimization.
-    image = extractBinaryOrIndexed8Image(tif, info);
+  if (!m_rgba) {
+    if (m_palette.isEmpty()) {
+      return QImage();
+    }
+    // Because we specify B option when opening, we can
+    // always use Format_Mono, and not Format_MonoLSB.
+    image = QImage(m_info.width, numLines,
+                   (m_info.bitsPerSample == 1) ? QImage::Format_Mono : QImage::Format_Indexed8);
+    if (image.isNull()) {
+      throw std::bad_alloc();
+    }
+    image.setColorTable(m_palette);
   } else {
-    // General case.
-    image = QImage(info.width, info.height, info.samplesPerPixel == 3 ? QImage::Format_RGB32 : QImage::Format_ARGB32);
+    if (!m_rgbaStarted) {
+      return QImage();
+    }
+    image = QImage(m_info.width, numLines,
+                   (m_info.samplesPerPixel == 3) ? QImage::Format_RGB32 : QImage::Format_ARGB32);
     if (image.isNull()) {
       throw std::bad_alloc();
     }
+  }
 
-    // For ABGR -> ARGB conversion.
-    TiffBuffer<uint32_t> tmpBuffer;
-    const uint32_t* srcLine = nullptr;
+  if (!m_dpm.isNull()) {
+    image.setDotsPerMeterX(m_dpm.horizontal());
+    image.setDotsPerMeterY(m_dpm.vertical());
+  }
+  return image;
+}
 
-    if (image.bytesPerLine() == 4 * info.width) {
-      // We can avoid creating a temporary buffer in this case.
-      if (!TIFFReadRGBAImageOriented(tif.handle(), info.width, info.height, (uint32_t*) image.bits(),
-                                     ORIENTATION_TOPLEFT, 0)) {
-        return QImage();
-      }
-      srcLine = (const uint32_t*) image.bits();
+bool TiffReader::LineReader::readLines(QImage& image, const int firstLine) {
+  if (!m_rgba) {
+    if ((m_info.bitsPerSample == 1) || (m_info.bitsPerSample == 8)) {
+      TiffReader::readLines(m_tif, image, firstLine);
     } else {
-      TiffBuffer<uint32_t>(info.width * info.height).swap(tmpBuffer);
-      if (!TIFFReadRGBAImageOriented(tif.handle(), info.width, info.height, tmpBuffer.data(), ORIENTATION_TOPLEFT, 0)) {
-        return QImage();
+      readAndUnpackLines(m_tif, m_info, image, firstLine);
+    }
+    return true;
+  }
+
+  // We decode directly into the image and convert ABGR -> ARGB in place.
+  assert(image.bytesPerLine() == 4 * image.width());
+  auto* const data = (uint32_t*) image.bits();
+  m_rgbaImage.row_offset = firstLine;
+  m_rgbaImage.col_offset = 0;
+  if (!TIFFRGBAImageGet(&m_rgbaImage, data, image.width(), image.height())) {
+    return false;
+  }
+  convertAbgrToArgb(data, data, image.width() * image.height());
+  return true;
+}
+
+QVector<QRgb> TiffReader::LineReader::binaryOrIndexed8Palette() const {
+  const int numColors = 1 << m_info.bitsPerSample;
+  QVector<QRgb> palette(numColors);
+
+  if (m_info.photometric == PHOTOMETRIC_PALETTE) {
+    uint16_t* pr = nullptr;
+    uint16_t* pg = nullptr;
+    uint16_t* pb = nullptr;
+    TIFFGetField(m_tif.handle(), TIFFTAG_COLORMAP, &pr, &pg, &pb);
+    if (!pr || !pg || !pb) {
+      return QVector<QRgb>();
+    }
+    if (m_info.hostBigEndian != m_info.fileBigEndian) {
+      TIFFSwabArrayOfShort(pr, numColors);
+      TIFFSwabArrayOfShort(pg, numColors);
+      TIFFSwabArrayOfShort(pb, numColors);
+    }
+    const double f = 255.0 / 65535.0;
+    for (int i = 0; i < numColors; ++i) {
+      const auto r = (uint32_t) std::lround(pr[i] * f);
+      const auto g = (uint32_t) std::lround(pg[i] * f);
+      const auto b = (uint32_t) std::lround(pb[i] * f);
+      const uint32_t a = 0xFF000000;
+      palette[i] = a | (r << 16) | (g << 8) | b;
+    }
+  } else if (m_info.photometric == PHOTOMETRIC_MINISBLACK) {
+    const double f = 255.0 / (numColors - 1);
+    for (int i = 0; i < numColors; ++i) {
+      const auto gray = (int) std::lround(i * f);
+      palette[i] = qRgb(gray, gray, gray);
+    }
+  } else if (m_info.photometric == PHOTOMETRIC_MINISWHITE) {
+    const double f = 255.0 / (numColors - 1);
+    int c = numColors - 1;
+    for (int i = 0; i < numColors; ++i, --c) {
+      const auto gray = (int) std::lround(c * f);
+      palette[i] = qRgb(gray, gray, gray);
+    }
+  } else {
+    return QVector<QRgb>();
+  }
+  return palette;
+}  // TiffReader::LineReader::binaryOrIndexed8Palette
+
+
+namespace {
+/**
+ * \brief Reduces an image by an integer factor, a band of lines at a time.
+ */
+class ImageReducer {
+ public:
+  ImageReducer(const QSize& size, int factor, bool grayscale)
+      : m_width(size.width()),
+        m_factor(factor),
+        m_grayscale(grayscale),
+        m_channels(grayscale ? 1 : 4),
+        m_outWidth((size.width() + factor - 1) / factor),
+        m_outHeight((size.height() + factor - 1) / factor),
+        m_sums(m_outWidth * m_channels, 0),
+        m_linesInSums(0),
+        m_nextOutLine(0) {}
+
+  void addBand(const QImage& band) {
+    QImage src;
+    if (m_grayscale) {
+      src = imageproc::toGrayscale(band);
+    } else if ((band.format() == QImage::Format_RGB32) || (band.format() == QImage::Format_ARGB32)) {
+      src = band;
+    } else {
+      src = band.convertToFormat(QImage::Format_RGB32);
+    }
+
+    if (m_result.isNull()) {
+      createResult(src);
+    }
+
+    for (int y = 0; y < src.height(); ++y) {
+      const uint8_t* line = src.constScanLine(y);
+      if (m_grayscale) {
+        for (int x = 0; x < m_width; ++x) {
+          m_sums[x / m_factor] += line[x];
+        }
+      } else {
+        for (int x = 0; x < m_width; ++x) {
+          uint32_t* sum = &m_sums[(x / m_factor) * 4];
+          for (int c = 0; c < 4; ++c) {
+            sum[c] += line[x * 4 + c];
+          }
+        }
+      }
+
+      if (++m_linesInSums == m_factor) {
+        flushLine();
       }
-      srcLine = tmpBuffer.data();
     }
+  }
 
-    auto* dstLine = (uint32_t*) image.bits();
-    assert(image.bytesPerLine() % 4 == 0);
-    const int dstStride = image.bytesPerLine() / 4;
-    for (int y = 0; y < info.height; ++y) {
-      convertAbgrToArgb(srcLine, dstLine, info.width);
-      srcLine += info.width;
-      dstLine += dstStride;
+  QImage result() {
+    if (m_linesInSums > 0) {
+      flushLine();
     }
+    return m_result;
   }
 
-  if (!metadata.dpi().isNull()) {
-    const Dpm dpm(metadata.dpi());
-    image.setDotsPerMeterX(dpm.horizontal());
-    image.setDotsPerMeterY(dpm.vertical());
+ private:
+  void createResult(const QImage& src) {
+    m_result = QImage(m_outWidth, m_outHeight, m_grayscale ? QImage::Format_Indexed8 : src.format());
+    if (m_result.isNull()) {
+      throw std::bad_alloc();
+    }
+    if (m_grayscale) {
+      m_result.setColorTable(imageproc::createGrayscalePalette());
+    }
+    m_result.setDotsPerMeterX(src.dotsPerMeterX() / m_factor);
+    m_result.setDotsPerMeterY(src.dotsPerMeterY() / m_factor);
+  }
+
+  void flushLine() {
+    uint8_t* line = m_result.scanLine(m_nextOutLine);
+    for (int x = 0; x < m_outWidth; ++x) {
+      const int columns = std::min(m_factor, m_width - x * m_factor);
+      const uint32_t count = columns * m_linesInSums;
+      for (int c = 0; c < m_channels; ++c) {
+        uint32_t& sum = m_sums[x * m_channels + c];
+        line[x * m_channels + c] = static_cast<uint8_t>((sum + count / 2) / count);
+        sum = 0;
+      }
+    }
+    m_linesInSums = 0;
+    ++m_nextOutLine;
+  }
+
+  const int m_width;
+  const int m_factor;
+  const bool m_grayscale;
+  const int m_channels;
+  const int m_outWidth;
+  const int m_outHeight;
+  std::vector<uint32_t> m_sums;
+  int m_linesInSums;
+  int m_nextOutLine;
+  QImage m_result;
+};
+}  // namespace
+
+std::unique_ptr<TiffReader::TiffHandle> TiffReader::openPage(QIODevice& device,
+                                                             const int pageNum,
+                                                             TiffHeader& header) {
+  if (!device.isReadable()) {
+    return nullptr;
+  }
+  if (device.isSequential()) {
+    // libtiff needs to be able to seek.
+    return nullptr;
+  }
+
+  header = readHeader(device);
+  if (!checkHeader(header)) {
+    return nullptr;
+  }
+
+  auto tif = std::make_unique<TiffHandle>(TIFFClientOpen("file", "rBm", &device, &deviceRead, &deviceWrite,
+                                                         &deviceSeek, &deviceClose, &deviceSize, &deviceMap,
+                                                         &deviceUnmap));
+  if (!tif->handle()) {
+    return nullptr;
+  }
+
+  if (!TIFFSetDirectory(tif->handle(), (uint16_t) pageNum)) {
+    return nullptr;
+  }
+  return tif;
+}
+
+QImage TiffReader::readImage(QIODevice& device, const int pageNum) {
+  TRACE_SPAN("io", "TiffReader::readImage");
+  TiffHeader header;
+  const std::unique_ptr<TiffHandle> tif(openPage(device, pageNum, header));
+  if (!tif) {
+    return QImage();
+  }
+
+  const TiffInfo info(*tif, header);
+  LineReader reader(*tif, info);
+
+  QImage image(reader.createImage(info.height));
+  if (image.isNull() || !reader.readLines(image, 0)) {
+    return QImage();
   }
   return image;
-}  // TiffReader::readImage
+}
+
+bool TiffReader::readImageBands(QIODevice& device,
+                                const int pageNum,
+                                const VirtualFunction<void, const QImage&, int>& out) {
+  TiffHeader header;
+  const std::unique_ptr<TiffHandle> tif(openPage(device, pageNum, header));
+  if (!tif) {
+    return false;
+  }
+
+  const TiffInfo info(*tif, header);
+  LineReader reader(*tif, info);
+
+  QImage band;
+  for (int y = 0; y < info.height; y += reader.bandHeight()) {
+    const int numLines = std::min(reader.bandHeight(), info.height - y);
+    if (band.height() != numLines) {
+      band = reader.createImage(numLines);
+    }
+    if (band.isNull() || !reader.readLines(band, y)) {
+      return false;
+    }
+    out(band, y);
+  }
+  return true;
+}
+
+QImage TiffReader::readReducedImage(QIODevice& device, const int pageNum, const QSize& boundingSize) {
+  TRACE_SPAN("io", "TiffReader::readReducedImage");
+  TiffHeader header;
+  const std::unique_ptr<TiffHandle> tif(openPage(device, pageNum, header));
+  if (!tif) {
+    return QImage();
+  }
+
+  const TiffInfo info(*tif, header);
+  if ((info.width <= 0) || (info.height <= 0)) {
+    return QImage();
+  }
+  LineReader reader(*tif, info);
+
+  int factor = 1;
+  if (!boundingSize.isEmpty()) {
+    const double xscale = double(info.width) / boundingSize.width();
+    const double yscale = double(info.height) / boundingSize.height();
+    factor = std::max(1, (int) std::max(xscale, yscale));
+  }
+
+  QImage band(reader.createImage(std::min(reader.bandHeight(), info.height)));
+  if (band.isNull()) {
+    return QImage();
+  }
+  ImageReducer reducer(QSize(info.width, info.height), factor, band.isGrayscale());
+
+  for (int y = 0; y < info.height; y += reader.bandHeight()) {
+    const int numLines = std::min(reader.bandHeight(), info.height - y);
+    if (band.height() != numLines) {
+      band = reader.createImage(numLines);
+    }
+    if (!reader.readLines(band, y)) {
+      return QImage();
+    }
+    reducer.addBand(band);
+  }
+  return reducer.result();
+}
 
 TiffReader::TiffHeader TiffReader::readHeader(QIODevice& device) {
   unsigned char data[4];
@@ -372,76 +702,17 @@ Dpi TiffReader::getDpi(float xres, float yres, unsigned resUnit) {
   return Dpi();
 }
 
-QImage TiffReader::extractBinaryOrIndexed8Image(const TiffHandle& tif, const TiffInfo& info) {
-  QImage::Format format = QImage::Format_Indexed8;
-  if (info.bitsPerSample == 1) {
-    // Because we specify B option when opening, we can
-    // always use Format_Mono, and not Format_MonoLSB.
-    format = QImage::Format_Mono;
-  }
-
-  QImage image(info.width, info.height, format);
-  if (image.isNull()) {
-    throw std::bad_alloc();
-  }
-
-  const int numColors = 1 << info.bitsPerSample;
-  image.setColorCount(numColors);
-
-  if (info.photometric == PHOTOMETRIC_PALETTE) {
-    uint16_t* pr = nullptr;
-    uint16_t* pg = nullptr;
-    uint16_t* pb = nullptr;
-    TIFFGetField(tif.handle(), TIFFTAG_COLORMAP, &pr, &pg, &pb);
-    if (!pr || !pg || !pb) {
-      return QImage();
-    }
-    if (info.hostBigEndian != info.fileBigEndian) {
-      TIFFSwabArrayOfShort(pr, numColors);
-      TIFFSwabArrayOfShort(pg, numColors);
-      TIFFSwabArrayOfShort(pb, numColors);
-    }
-    const double f = 255.0 / 65535.0;
-    for (int i = 0; i < numColors; ++i) {
-      const auto r = (uint32_t) std::lround(pr[i] * f);
-      const auto g = (uint32_t) std::lround(pg[i] * f);
-      const auto b = (uint32_t) std::lround(pb[i] * f);
-      const uint32_t a = 0xFF000000;
-      image.setColor(i, a | (r << 16) | (g << 8) | b);
-    }
-  } else if (info.photometric == PHOTOMETRIC_MINISBLACK) {
-    const double f = 255.0 / (numColors - 1);
-    for (int i = 0; i < numColors; ++i) {
-      const auto gray = (int) std::lround(i * f);
-      image.setColor(i, qRgb(gray, gray, gray));
-    }
-  } else if (info.photometric == PHOTOMETRIC_MINISWHITE) {
-    const double f = 255.0 / (numColors - 1);
-    int c = numColors - 1;
-    for (int i = 0; i < numColors; ++i, --c) {
-      const auto gray = (int) std::lround(c * f);
-      image.setColor(i, qRgb(gray, gray, gray));
-    }
-  } else {
-    return QImage();
-  }
-
-  if ((info.bitsPerSample == 1) || (info.bitsPerSample == 8)) {
-    readLines(tif, image);
-  } else {
-    readAndUnpackLines(tif, info, image);
-  }
-  return image;
-}  // TiffReader::extractBinaryOrIndexed8Image
-
-void TiffReader::readLines(const TiffHandle& tif, QImage& image) {
+void TiffReader::readLines(const TiffHandle& tif, QImage& image, const int firstLine) {
   const int height = image.height();
   for (int y = 0; y < height; ++y) {
-    TIFFReadScanline(tif.handle(), image.scanLine(y), y);
+    TIFFReadScanline(tif.handle(), image.scanLine(y), firstLine + y);
   }
 }
 
-void TiffReader::readAndUnpackLines(const TiffHandle& tif, const TiffInfo& info, QImage& image) {
+void TiffReader::readAndUnpackLines(const TiffHandle& tif,
+                                    const TiffInfo& info,
+                                    QImage& image,
+                                    const int firstLine) {
   TiffBuffer<uint8_t> buf(TIFFScanlineSize(tif.handle()));
 
   const int width = image.width();
@@ -450,7 +721,7 @@ void TiffReader::readAndUnpackLines(const TiffHandle& tif, const TiffInfo& info,
   const unsigned dstMask = (1 << bitsPerSample) - 1;
 
   for (int y = 0; y < height; ++y) {
-    TIFFReadScanline(tif.handle(), buf.data(), y);
+    TIFFReadScanline(tif.handle(), buf.data(), firstLine + y);
 
     unsigned accum = 0;
     int bitsInAccum = 0;
@@ -4,11 +4,14 @@
 #ifndef SCANTAILOR_CORE_TIFFREADER_H_
 #define SCANTAILOR_CORE_TIFFREADER_H_
 
+#include <memory>
+
 #include "ImageMetadataLoader.h"
 #include "VirtualFunction.h"
 
 class QIODevice;
 class QImage;
+class QSize;
 class ImageMetadata;
 class Dpi;
 
@@ -30,9 +33,41 @@ class TiffReader {
    */
   static QImage readImage(QIODevice& device, int pageNum = 0);
 
+  /**
+   * \brief Reads the image from io device, a band of lines at a time.
+   *
+   * Only a single band is decoded at any moment, so the consumer may process
+   * or reduce the image without ever holding all of it in memory.
+   *
+   * \param device The device to read from.  This device must be
+   *        opened for reading and must be seekable.
+   * \param pageNum A zero-based page number within a multi-page
+   *        TIFF file.
+   * \param out Called for every band, from top to bottom, with the band and
+   *        the index of its first line within the page.  The bands have the
+   *        width, format and resolution readImage() would produce.
+   * \return false in case of failure, in which case \p out may have been
+   *         called for some of the bands already.
+   */
+  static bool readImageBands(QIODevice& device, int pageNum, const VirtualFunction<void, const QImage&, int>& out);
+
+  /**
+   * \brief Reads the image reduced by an integer factor, without decoding
+   *        all of it at once.
+   *
+   * The factor is the largest one that still keeps the result at least as large
+   * as the image scaled to fit into \p boundingSize.  Each pixel of the result
+   * is the average of the pixels it was reduced from.  Grayscale and black and
+   * white images result in grayscale Format_Indexed8 images.
+   *
+   * \return The reduced image, or a null image in case of failure.
+   */
+  static QImage readReducedImage(QIODevice& device, int pageNum, const QSize& boundingSize);
+
  private:
   class TiffHeader;
   class TiffHandle;
+  class LineReader;
 
   struct TiffInfo;
 
@@ -41,17 +76,22 @@ class TiffReader {
 
   static TiffHeader readHeader(QIODevice& device);
 
+  /**
+   * \brief Opens the device and makes \p pageNum the current directory.
+   *
+   * \return The handle, or null in case of failure.
+   */
+  static std::unique_ptr<TiffHandle> openPage(QIODevice& device, int pageNum, TiffHeader& header);
+
   static bool checkHeader(const TiffHeader& header);
 
   static ImageMetadata currentPageMetadata(const TiffHandle& tif);
 
   static Dpi getDpi(float xres, float yres, unsigned resUnit);
 
-  static QImage extractBinaryOrIndexed8Image(const TiffHandle& tif, const TiffInfo& info);
-
-  static void readLines(const TiffHandle& tif, QImage& image);
+  static void readLines(const TiffHandle& tif, QImage& image, int firstLine);
 
-  static void readAndUnpackLines(const TiffHandle& tif, const TiffInfo& info, QImage& image);
+  static void readAndUnpackLines(const TiffHandle& tif, const TiffInfo& info, QImage& image, int firstLine);
 };
 
 
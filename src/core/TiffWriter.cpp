@@ -5,12 +5,18 @@
 
 #include <Constants.h>
 #include <Grayscale.h>
+#include <ParallelFor.h>
+#include <Tracer.h>
 #include <tiffio.h>
 
+#include <QBuffer>
 #include <QDebug>
 #include <QtCore/QFile>
+#include <algorithm>
 #include <cassert>
 #include <cmath>
+#include <cstring>
+#include <vector>
 
 #include "ApplicationSettings.h"
 #include "Dpm.h"
@@ -35,6 +41,14 @@ const uint8_t TiffWriter::m_reverseBitsLUT[256]
        0xef, 0x1f, 0x9f, 0x5f, 0xdf, 0x3f, 0xbf, 0x7f, 0xff};
 
 
+namespace {
+/**
+ * The uncompressed size strips are aimed at when compressing them in parallel.
+ * Larger strips compress slightly better, smaller ones spread better across threads.
+ */
+const int PARALLEL_STRIP_BYTES = 256 * 1024;
+}  // namespace
+
 class TiffWriter::TiffHandle {
  public:
   explicit TiffHandle(TIFF* handle) : m_handle(handle) {}
@@ -52,6 +66,19 @@ class TiffWriter::TiffHandle {
 };
 
 
+/**
+ * \brief The tags a strip has to be compressed with.
+ */
+struct TiffWriter::StripFormat {
+  uint32_t width;
+  uint16_t bitsPerSample;
+  uint16_t samplesPerPixel;
+  uint16_t photometric;
+  uint16_t compression;
+  int compressionLevel;
+};
+
+
 static tsize_t deviceRead(thandle_t context, tdata_t data, tsize_t size) {
   // Not implemented.
   return 0;
@@ -119,6 +146,7 @@ bool TiffWriter::writeImage(const QString& filePath, const QImage& image) {
 }
 
 bool TiffWriter::writeImage(QIODevice& device, const QImage& image) {
+  TRACE_SPAN("io", "TiffWriter::writeImage");
   if (image.isNull()) {
     return false;
   }
@@ -190,6 +218,59 @@ void TiffWriter::setDpm(const TiffHandle& tif, const Dpm& dpm) {
   TIFFSetField(tif.handle(), TIFFTAG_RESOLUTIONUNIT, unit);
 }
 
+void TiffWriter::setCompression(const TiffHandle& tif, int compression, const int level) {
+  if (!TIFFIsCODECConfigured(uint16_t(compression))) {
+    // The setting may come from a machine with a different libtiff build.
+    compression = COMPRESSION_LZW;
+  }
+  TIFFSetField(tif.handle(), TIFFTAG_COMPRESSION, uint16_t(compression));
+
+  // The codec specific tags may only be set after the compression.
+  if (level <= 0) {
+    return;
+  }
+  switch (compression) {
+    case COMPRESSION_DEFLATE:
+    case COMPRESSION_ADOBE_DEFLATE:
+      TIFFSetField(tif.handle(), TIFFTAG_ZIPQUALITY, std::min(level, maxCompressionLevel(compression)));
+      break;
+#ifdef COMPRESSION_ZSTD
+    case COMPRESSION_ZSTD:
+      TIFFSetField(tif.handle(), TIFFTAG_ZSTD_LEVEL, std::min(level, maxCompressionLevel(compression)));
+      break;
+#endif
+    default:;
+  }
+}
+
+int TiffWriter::maxCompressionLevel(const int compression) {
+  switch (compression) {
+    case COMPRESSION_DEFLATE:
+    case COMPRESSION_ADOBE_DEFLATE:
+      return 9;
+#ifdef COMPRESSION_ZSTD
+    case COMPRESSION_ZSTD:
+      return 22;
+#endif
+    default:
+      return 0;
+  }
+}
+
+bool TiffWriter::isParallelCompression(const int compression) {
+  switch (compression) {
+    case COMPRESSION_LZW:
+    case COMPRESSION_DEFLATE:
+    case COMPRESSION_ADOBE_DEFLATE:
+#ifdef COMPRESSION_ZSTD
+    case COMPRESSION_ZSTD:
+#endif
+      return true;
+    default:
+      return false;
+  }
+}
+
 bool TiffWriter::writeBitonalOrIndexed8Image(const TiffHandle& tif, const QImage& image) {
   TIFFSetField(tif.handle(), TIFFTAG_SAMPLESPERPIXEL, uint16_t(1));
 
@@ -221,12 +302,11 @@ bool TiffWriter::writeBitonalOrIndexed8Image(const TiffHandle& tif, const QImage
     default:;
   }
 
+  const ApplicationSettings& settings = ApplicationSettings::getInstance();
   if (image.format() == QImage::Format_Indexed8) {
-    TIFFSetField(tif.handle(), TIFFTAG_COMPRESSION,
-                 uint16_t(ApplicationSettings::getInstance().getTiffColorCompression()));
+    setCompression(tif, settings.getTiffColorCompression(), settings.getTiffCompressionLevel());
   } else {
-    TIFFSetField(tif.handle(), TIFFTAG_COMPRESSION,
-                 uint16_t(ApplicationSettings::getInstance().getTiffBwCompression()));
+    setCompression(tif, settings.getTiffBwCompression(), settings.getTiffCompressionLevel());
   }
 
   TIFFSetField(tif.handle(), TIFFTAG_BITSPERSAMPLE, bitsPerSample);
@@ -265,21 +345,17 @@ bool TiffWriter::writeRGB32Image(const TiffHandle& tif, const QImage& image) {
   assert(image.format() == QImage::Format_RGB32);
 
   TIFFSetField(tif.handle(), TIFFTAG_SAMPLESPERPIXEL, uint16_t(3));
-  TIFFSetField(tif.handle(), TIFFTAG_COMPRESSION,
-               uint16_t(ApplicationSettings::getInstance().getTiffColorCompression()));
+  const ApplicationSettings& settings = ApplicationSettings::getInstance();
+  setCompression(tif, settings.getTiffColorCompression(), settings.getTiffCompressionLevel());
   TIFFSetField(tif.handle(), TIFFTAG_BITSPERSAMPLE, uint16_t(8));
   TIFFSetField(tif.handle(), TIFFTAG_PHOTOMETRIC, PHOTOMETRIC_RGB);
 
   const int width = image.width();
-  const int height = image.height();
-
-  std::vector<uint8_t> tmpLine(width * 3);
 
   // Libtiff expects "RR GG BB" sequences regardless of CPU byte order.
 
-  for (int y = 0; y < height; ++y) {
+  return writeLines(tif, image.height(), width * 3, [&image, width](const int y, uint8_t* pDst) {
     const auto* pSrc = (const uint32_t*) image.scanLine(y);
-    uint8_t* pDst = &tmpLine[0];
     for (int x = 0; x < width; ++x) {
       const uint32_t ARGB = *pSrc;
       pDst[0] = static_cast<uint8_t>(ARGB >> 16);
@@ -288,32 +364,24 @@ bool TiffWriter::writeRGB32Image(const TiffHandle& tif, const QImage& image) {
       ++pSrc;
       pDst += 3;
     }
-    if (TIFFWriteScanline(tif.handle(), &tmpLine[0], y) == -1) {
-      return false;
-    }
-  }
-  return true;
+  });
 }  // TiffWriter::writeRGB32Image
 
 bool TiffWriter::writeARGB32Image(const TiffHandle& tif, const QImage& image) {
   assert(image.format() == QImage::Format_ARGB32);
 
   TIFFSetField(tif.handle(), TIFFTAG_SAMPLESPERPIXEL, uint16_t(4));
-  TIFFSetField(tif.handle(), TIFFTAG_COMPRESSION,
-               uint16_t(ApplicationSettings::getInstance().getTiffColorCompression()));
+  const ApplicationSettings& settings = ApplicationSettings::getInstance();
+  setCompression(tif, settings.getTiffColorCompression(), settings.getTiffCompressionLevel());
   TIFFSetField(tif.handle(), TIFFTAG_BITSPERSAMPLE, uint16_t(8));
   TIFFSetField(tif.handle(), TIFFTAG_PHOTOMETRIC, PHOTOMETRIC_RGB);
 
   const int width = image.width();
-  const int height = image.height();
-
-  std::vector<uint8_t> tmpLine(width * 4);
 
   // Libtiff expects "RR GG BB AA" sequences regardless of CPU byte order.
 
-  for (int y = 0; y < height; ++y) {
+  return writeLines(tif, image.height(), width * 4, [&image, width](const int y, uint8_t* pDst) {
     const auto* pSrc = (const uint32_t*) image.scanLine(y);
-    uint8_t* pDst = &tmpLine[0];
     for (int x = 0; x < width; ++x) {
       const uint32_t ARGB = *pSrc;
       pDst[0] = static_cast<uint8_t>(ARGB >> 16);
@@ -323,44 +391,48 @@ bool TiffWriter::writeARGB32Image(const TiffHandle& tif, const QImage& image) {
       ++pSrc;
       pDst += 4;
     }
-    if (TIFFWriteScanline(tif.handle(), &tmpLine[0], y) == -1) {
-      return false;
-    }
-  }
-  return true;
+  });
 }  // TiffWriter::writeARGB32Image
 
 bool TiffWriter::write8bitLines(const TiffHandle& tif, const QImage& image) {
   const int width = image.width();
-  const int height = image.height();
+  return writeLines(tif, image.height(), width,
+                    [&image, width](const int y, uint8_t* dst) { memcpy(dst, image.scanLine(y), width); });
+}
 
-  // TIFFWriteScanline() can actually modify the data you pass it,
-  // so we have to use a temporary buffer even when no coversion
-  // is required.
-  std::vector<uint8_t> tmpLine(width, 0);
+bool TiffWriter::writeBinaryLinesAsIs(const TiffHandle& tif, const QImage& image) {
+  const int bpl = (image.width() + 7) / 8;
+  return writeLines(tif, image.height(), bpl,
+                    [&image, bpl](const int y, uint8_t* dst) { memcpy(dst, image.scanLine(y), bpl); });
+}
 
-  for (int y = 0; y < height; ++y) {
+bool TiffWriter::writeBinaryLinesReversed(const TiffHandle& tif, const QImage& image) {
+  const int bpl = (image.width() + 7) / 8;
+  return writeLines(tif, image.height(), bpl, [&image, bpl](const int y, uint8_t* dst) {
     const uint8_t* srcLine = image.scanLine(y);
-    memcpy(&tmpLine[0], srcLine, tmpLine.size());
-    if (TIFFWriteScanline(tif.handle(), &tmpLine[0], y) == -1) {
-      return false;
+    for (int i = 0; i < bpl; ++i) {
+      dst[i] = m_reverseBitsLUT[srcLine[i]];
     }
-  }
-  return true;
+  });
 }
 
-bool TiffWriter::writeBinaryLinesAsIs(const TiffHandle& tif, const QImage& image) {
-  const int width = image.width();
-  const int height = image.height();
+bool TiffWriter::writeLines(const TiffHandle& tif,
+                            const int height,
+                            const int bytesPerLine,
+                            const LinePacker& packLine) {
+  uint16_t compression = COMPRESSION_NONE;
+  TIFFGetField(tif.handle(), TIFFTAG_COMPRESSION, &compression);
+  const int rowsPerStrip = std::max(1, PARALLEL_STRIP_BYTES / std::max(1, bytesPerLine));
+  if (isParallelCompression(compression) && (rowsPerStrip < height) && (parallelForMaxThreads() > 1)) {
+    return writeStripsInParallel(tif, height, bytesPerLine, rowsPerStrip, packLine);
+  }
+
   // TIFFWriteScanline() can actually modify the data you pass it,
-  // so we have to use a temporary buffer even when no coversion
-  // is required.
-  const int bpl = (width + 7) / 8;
-  std::vector<uint8_t> tmpLine(bpl, 0);
+  // so we always pack lines into a temporary buffer.
+  std::vector<uint8_t> tmpLine(bytesPerLine, 0);
 
   for (int y = 0; y < height; ++y) {
-    const uint8_t* srcLine = image.scanLine(y);
-    memcpy(&tmpLine[0], srcLine, bpl);
+    packLine(y, &tmpLine[0]);
     if (TIFFWriteScanline(tif.handle(), &tmpLine[0], y) == -1) {
       return false;
     }
@@ -368,21 +440,99 @@ bool TiffWriter::writeBinaryLinesAsIs(const TiffHandle& tif, const QImage& image
   return true;
 }
 
-bool TiffWriter::writeBinaryLinesReversed(const TiffHandle& tif, const QImage& image) {
-  const int width = image.width();
-  const int height = image.height();
+/**
+ * Each strip is compressed on its own by a private in-memory TIFF handle,
+ * after which its compressed bytes are written into \p tif as a raw strip.
+ * The strips are processed in batches, so that no more than a few of them
+ * per thread are kept in memory at once.
+ */
+bool TiffWriter::writeStripsInParallel(const TiffHandle& tif,
+                                       const int height,
+                                       const int bytesPerLine,
+                                       const int rowsPerStrip,
+                                       const LinePacker& packLine) {
+  StripFormat format{};
+  TIFFGetField(tif.handle(), TIFFTAG_IMAGEWIDTH, &format.width);
+  TIFFGetField(tif.handle(), TIFFTAG_BITSPERSAMPLE, &format.bitsPerSample);
+  TIFFGetField(tif.handle(), TIFFTAG_SAMPLESPERPIXEL, &format.samplesPerPixel);
+  TIFFGetField(tif.handle(), TIFFTAG_PHOTOMETRIC, &format.photometric);
+  TIFFGetField(tif.handle(), TIFFTAG_COMPRESSION, &format.compression);
+  format.compressionLevel = ApplicationSettings::getInstance().getTiffCompressionLevel();
+  if (format.photometric == PHOTOMETRIC_PALETTE) {
+    // The compressed data doesn't depend on it, while a palette
+    // would require a color map in the temporary handles.
+    format.photometric = PHOTOMETRIC_MINISBLACK;
+  }
 
-  const int bpl = (width + 7) / 8;
-  std::vector<uint8_t> tmpLine(bpl, 0);
+  TIFFSetField(tif.handle(), TIFFTAG_ROWSPERSTRIP, uint32_t(rowsPerStrip));
 
-  for (int y = 0; y < height; ++y) {
-    const uint8_t* srcLine = image.scanLine(y);
-    for (int i = 0; i < bpl; ++i) {
-      tmpLine[i] = m_reverseBitsLUT[srcLine[i]];
-    }
-    if (TIFFWriteScanline(tif.handle(), &tmpLine[0], y) == -1) {
-      return false;
+  const int numStrips = (height + rowsPerStrip - 1) / rowsPerStrip;
+  const int batchSize = parallelForMaxThreads() * 2;
+  std::vector<QByteArray> compressed(std::min(batchSize, numStrips));
+
+  for (int batchBegin = 0; batchBegin < numStrips; batchBegin += batchSize) {
+    const int batchEnd = std::min(numStrips, batchBegin + batchSize);
+    parallelForBands(batchEnd - batchBegin, 1, [&](const int begin, const int end) {
+      for (int i = begin; i < end; ++i) {
+        const int firstLine = (batchBegin + i) * rowsPerStrip;
+        const int numLines = std::min(rowsPerStrip, height - firstLine);
+        compressed[i] = compressStrip(format, firstLine, numLines, bytesPerLine, packLine);
+      }
+    });
+
+    for (int strip = batchBegin; strip < batchEnd; ++strip) {
+      QByteArray& data = compressed[strip - batchBegin];
+      if (data.isEmpty() || (TIFFWriteRawStrip(tif.handle(), strip, data.data(), data.size()) == -1)) {
+        return false;
+      }
+      data.clear();
     }
   }
   return true;
-}
+}  // TiffWriter::writeStripsInParallel
+
+QByteArray TiffWriter::compressStrip(const StripFormat& format,
+                                     const int firstLine,
+                                     const int numLines,
+                                     const int bytesPerLine,
+                                     const LinePacker& packLine) {
+  TRACE_SPAN("io", "TiffWriter::compressStrip");
+  std::vector<uint8_t> strip(size_t(bytesPerLine) * numLines);
+  for (int i = 0; i < numLines; ++i) {
+    packLine(firstLine + i, &strip[size_t(bytesPerLine) * i]);
+  }
+
+  QByteArray file;
+  QBuffer buffer(&file);
+  buffer.open(QIODevice::WriteOnly);
+
+  TiffHandle tif(TIFFClientOpen("strip", "wBm", &buffer, &deviceRead, &deviceWrite, &deviceSeek, &deviceClose,
+                                &deviceSize, &deviceMap, &deviceUnmap));
+  if (!tif.handle()) {
+    return QByteArray();
+  }
+
+  TIFFSetField(tif.handle(), TIFFTAG_IMAGEWIDTH, format.width);
+  TIFFSetField(tif.handle(), TIFFTAG_IMAGELENGTH, uint32_t(numLines));
+  TIFFSetField(tif.handle(), TIFFTAG_ROWSPERSTRIP, uint32_t(numLines));
+  TIFFSetField(tif.handle(), TIFFTAG_SAMPLEFORMAT, SAMPLEFORMAT_UINT);
+  TIFFSetField(tif.handle(), TIFFTAG_PLANARCONFIG, PLANARCONFIG_CONTIG);
+  TIFFSetField(tif.handle(), TIFFTAG_BITSPERSAMPLE, format.bitsPerSample);
+  TIFFSetField(tif.handle(), TIFFTAG_SAMPLESPERPIXEL, format.samplesPerPixel);
+  TIFFSetField(tif.handle(), TIFFTAG_PHOTOMETRIC, format.photometric);
+  setCompression(tif, format.compression, format.compressionLevel);
+
+  if (TIFFWriteEncodedStrip(tif.handle(), 0, &strip[0], tsize_t(strip.size())) == -1) {
+    return QByteArray();
+  }
+
+  // The strip has been written out at this point, so we can just
+  // cut its compressed bytes out of the buffer.
+  uint64_t* offsets = nullptr;
+  uint64_t* byteCounts = nullptr;
+  if (!TIFFGetField(tif.handle(), TIFFTAG_STRIPOFFSETS, &offsets)
+      || !TIFFGetField(tif.handle(), TIFFTAG_STRIPBYTECOUNTS, &byteCounts) || !offsets || !byteCounts) {
+    return QByteArray();
+  }
+  return file.mid(int(offsets[0]), int(byteCounts[0]));
+}  // TiffWriter::compressStrip
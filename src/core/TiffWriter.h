@@ -8,7 +8,9 @@
 
 #include <cstddef>
 #include <cstdint>
+#include <functional>
 
+class QByteArray;
 class QIODevice;
 class QString;
 class QImage;
@@ -35,11 +37,47 @@ class TiffWriter {
    */
   static bool writeImage(QIODevice& device, const QImage& image);
 
+  /**
+   * \brief The highest compression level \p compression accepts,
+   *        or 0 if its level can't be set.
+   *
+   * Higher levels are clamped to this one when writing.
+   */
+  static int maxCompressionLevel(int compression);
+
  private:
   class TiffHandle;
+  struct StripFormat;
+
+  /**
+   * Fills \p dst with the line \p line packed the way libtiff expects it.
+   */
+  using LinePacker = std::function<void(int line, uint8_t* dst)>;
 
   static void setDpm(const TiffHandle& tif, const Dpm& dpm);
 
+  static void setCompression(const TiffHandle& tif, int compression, int level);
+
+  /**
+   * Whether strips compressed with \p compression can be compressed
+   * independently of each other, and therefore in parallel.
+   */
+  static bool isParallelCompression(int compression);
+
+  static bool writeLines(const TiffHandle& tif, int height, int bytesPerLine, const LinePacker& packLine);
+
+  static bool writeStripsInParallel(const TiffHandle& tif,
+                                    int height,
+                                    int bytesPerLine,
+                                    int rowsPerStrip,
+                                    const LinePacker& packLine);
+
+  static QByteArray compressStrip(const StripFormat& format,
+                                  int firstLine,
+                                  int numLines,
+                                  int bytesPerLine,
+                                  const LinePacker& packLine);
+
   static bool writeBitonalOrIndexed8Image(const TiffHandle& tif, const QImage& image);
 
   static bool writeRGB32Image(const TiffHandle& tif, const QImage& image);
@@ -53,6 +53,19 @@ std::shared_ptr<ThumbnailPixmapCache> Utils::createThumbnailCache(const QString&
   return std::make_shared<ThumbnailPixmapCache>(thumbsCachePath, maxPixmapSize, 40, 5);
 }
 
+QString Utils::outputDirToIntermediateCacheDir(const QString& outputDir) {
+  return outputDir + QLatin1String("/cache/intermediate");
+}
+
+std::shared_ptr<IntermediateImageCache> Utils::createIntermediateImageCache(const QString& outputDir) {
+  const int maxSizeMb = ApplicationSettings::getInstance().getIntermediateCacheSizeMb();
+  if (maxSizeMb <= 0) {
+    return nullptr;
+  }
+  return std::make_shared<IntermediateImageCache>(outputDirToIntermediateCacheDir(outputDir),
+                                                  qint64(maxSizeMb) * 1024 * 1024);
+}
+
 QString Utils::qssConvertPxToEm(const QString& stylesheet, const double base, const int precision) {
   QString result = "";
   const QRegularExpression pxToEm(R"((\d+(\.\d+)?)px)");
@@ -9,6 +9,7 @@
 #include <map>
 #include <unordered_map>
 
+#include "IntermediateImageCache.h"
 #include "ThumbnailPixmapCache.h"
 
 namespace core {
@@ -38,6 +39,13 @@ class Utils {
 
   static std::shared_ptr<ThumbnailPixmapCache> createThumbnailCache(const QString& outputDir);
 
+  static QString outputDirToIntermediateCacheDir(const QString& outputDir);
+
+  /**
+   * \brief Creates the cache of decoded images, or returns null if it's disabled in the settings.
+   */
+  static std::shared_ptr<IntermediateImageCache> createIntermediateImageCache(const QString& outputDir);
+
   /**
    * Unlike QFile::rename(), this one overwrites existing files.
    */
@@ -4,10 +4,12 @@
 #include "WorkerThreadPool.h"
 
 #include <QCoreApplication>
-#include <QThreadPool>
+#include <QThread>
+#include <algorithm>
 #include <utility>
 
 #include "OutOfMemoryHandler.h"
+#include "TaskScheduler.h"
 
 class WorkerThreadPool::TaskResultEvent : public QEvent {
  public:
@@ -24,51 +26,86 @@ class WorkerThreadPool::TaskResultEvent : public QEvent {
 };
 
 
-WorkerThreadPool::WorkerThreadPool(QObject* parent) : QObject(parent), m_pool(new QThreadPool(this)) {
+WorkerThreadPool::WorkerThreadPool(QObject* parent)
+    : QObject(parent),
+      m_maxThreadCountOverride(0),
+      m_memoryBudgetOverride(-1),
+      m_maxThreadCount(1),
+      m_numRunningTasks(0) {
+  updateMemoryBudget();
   updateNumberOfThreads();
 }
 
-WorkerThreadPool::~WorkerThreadPool() = default;
+WorkerThreadPool::~WorkerThreadPool() {
+  shutdown();
+}
 
 void WorkerThreadPool::shutdown() {
-  m_pool->waitForDone();
+  std::unique_lock<std::mutex> lock(m_mutex);
+  m_allTasksFinished.wait(lock, [this]() { return m_pendingTasks.empty() && (m_numRunningTasks == 0); });
 }
 
 bool WorkerThreadPool::hasSpareCapacity() const {
-  return m_pool->activeThreadCount() < m_pool->maxThreadCount();
+  std::lock_guard<std::mutex> guard(m_mutex);
+  return m_pendingTasks.empty() && (m_numRunningTasks < m_maxThreadCount);
+}
+
+void WorkerThreadPool::setMaxThreadCount(const int numThreads) {
+  m_maxThreadCountOverride = numThreads;
+  updateNumberOfThreads();
+}
+
+void WorkerThreadPool::setMemoryBudget(const int megabytes) {
+  m_memoryBudgetOverride = megabytes;
+  updateMemoryBudget();
 }
 
 void WorkerThreadPool::submitTask(const BackgroundTaskPtr& task) {
-  class Runnable : public QRunnable {
-   public:
-    Runnable(WorkerThreadPool& owner, BackgroundTaskPtr task) : m_owner(owner), m_task(std::move(task)) {
-      setAutoDelete(true);
-    }
+  updateMemoryBudget();
+  updateNumberOfThreads();
 
-    void run() override {
-      if (m_task->isCancelled()) {
-        return;
-      }
+  std::lock_guard<std::mutex> guard(m_mutex);
+  m_pendingTasks.push(task);
+  dispatchPendingTasks();
+}
 
-      try {
-        const FilterResultPtr result((*m_task)());
-        if (result) {
-          QCoreApplication::postEvent(&m_owner, new TaskResultEvent(m_task, result));
-        }
-      } catch (const std::bad_alloc&) {
-        OutOfMemoryHandler::instance().handleOutOfMemorySituation();
-      }
+void WorkerThreadPool::dispatchPendingTasks() {
+  while (m_numRunningTasks < m_maxThreadCount) {
+    BackgroundTaskPtr task(m_pendingTasks.takeNext(m_memoryBudget));
+    if (!task) {
+      break;
     }
+    const uint64_t memory = task->estimatedMemoryUsage();
+    ++m_numRunningTasks;
+    m_memoryBudget.reserve(memory);
+
+    const TaskScheduler::Priority priority = (task->type() == BackgroundTask::INTERACTIVE)
+                                                 ? TaskScheduler::HIGH_PRIORITY
+                                                 : TaskScheduler::NORMAL_PRIORITY;
+    TaskScheduler::instance().submit([this, task, memory]() { runTask(task, memory); }, priority);
+  }
+}
 
-   private:
-    WorkerThreadPool& m_owner;
-    BackgroundTaskPtr m_task;
-  };
-
+void WorkerThreadPool::runTask(const BackgroundTaskPtr& task, const uint64_t reservedMemory) {
+  if (!task->isCancelled()) {
+    try {
+      const FilterResultPtr result((*task)());
+      if (result) {
+        QCoreApplication::postEvent(this, new TaskResultEvent(task, result));
+      }
+    } catch (const std::bad_alloc&) {
+      OutOfMemoryHandler::instance().handleOutOfMemorySituation();
+    }
+  }
 
-  updateNumberOfThreads();
-  m_pool->start(new Runnable(*this, task));
-}  // WorkerThreadPool::submitTask
+  std::lock_guard<std::mutex> guard(m_mutex);
+  --m_numRunningTasks;
+  m_memoryBudget.release(reservedMemory);
+  dispatchPendingTasks();
+  if (m_pendingTasks.empty() && (m_numRunningTasks == 0)) {
+    m_allTasksFinished.notify_all();
+  }
+}
 
 void WorkerThreadPool::customEvent(QEvent* event) {
   if (auto* evt = dynamic_cast<TaskResultEvent*>(event)) {
@@ -84,7 +121,23 @@ void WorkerThreadPool::updateNumberOfThreads() {
     maxThreads = std::min(maxThreads, 2);
   }
 
-  int numThreads = m_settings.value("settings/batch_processing_threads", maxThreads).toInt();
-  numThreads = std::min(numThreads, maxThreads);
-  m_pool->setMaxThreadCount(numThreads);
+  int numThreads = (m_maxThreadCountOverride > 0)
+                       ? m_maxThreadCountOverride
+                       : m_settings.value("settings/batch_processing_threads", maxThreads).toInt();
+  numThreads = std::max(1, std::min(numThreads, maxThreads));
+
+  std::lock_guard<std::mutex> guard(m_mutex);
+  m_maxThreadCount = numThreads;
+  dispatchPendingTasks();
+}
+
+void WorkerThreadPool::updateMemoryBudget() {
+  const int megabytes = (m_memoryBudgetOverride >= 0)
+                            ? m_memoryBudgetOverride
+                            : m_settings.value("settings/batch_processing_memory_budget", -1).toInt();
+  const uint64_t limit = (megabytes >= 0) ? (uint64_t(megabytes) << 20) : MemoryBudget::defaultLimit();
+
+  std::lock_guard<std::mutex> guard(m_mutex);
+  m_memoryBudget.setLimit(limit);
+  dispatchPendingTasks();
 }
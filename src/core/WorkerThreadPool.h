@@ -6,13 +6,30 @@
 
 #include <QObject>
 #include <QSettings>
+#include <condition_variable>
 #include <memory>
+#include <mutex>
 
 #include "BackgroundTask.h"
 #include "FilterResult.h"
-
-class QThreadPool;
-
+#include "MemoryBudget.h"
+#include "PendingTaskQueue.h"
+
+/**
+ * \brief Runs page processing tasks on the shared TaskScheduler.
+ *
+ * At most "settings/batch_processing_threads" tasks run at the same time,
+ * the rest wait in a queue, where interactive tasks go before batch ones.
+ * Interactive tasks also run with high priority in the scheduler, and so do
+ * the pieces they split their work into.
+ *
+ * On top of that, the running tasks have to fit a memory budget, taken from
+ * "settings/batch_processing_memory_budget" in MiB, or derived from the
+ * physical memory size if that's not set.  PendingTaskQueue decides which
+ * of the queued tasks fits what is left of it.
+ *
+ * Both settings are re-read whenever a task is submitted.
+ */
 class WorkerThreadPool : public QObject {
   Q_OBJECT
  public:
@@ -30,6 +47,21 @@ class WorkerThreadPool : public QObject {
 
   bool hasSpareCapacity() const;
 
+  /**
+   * \brief Overrides the "settings/batch_processing_threads" value.
+   *
+   * A non-positive value restores the default behaviour.
+   */
+  void setMaxThreadCount(int numThreads);
+
+  /**
+   * \brief Overrides the "settings/batch_processing_memory_budget" value.
+   *
+   * \param megabytes The budget in MiB.  A negative value restores the default
+   *        behaviour, while 0 disables the budget.
+   */
+  void setMemoryBudget(int megabytes);
+
   void submitTask(const BackgroundTaskPtr& task);
 
  signals:
@@ -43,8 +75,27 @@ class WorkerThreadPool : public QObject {
 
   void updateNumberOfThreads();
 
-  QThreadPool* m_pool;
+  void updateMemoryBudget();
+
+  /**
+   * \brief Hands the queued tasks over to the scheduler, as long as there is capacity.
+   *
+   * Must be called with m_mutex locked.
+   */
+  void dispatchPendingTasks();
+
+  void runTask(const BackgroundTaskPtr& task, uint64_t reservedMemory);
+
   QSettings m_settings;
+  int m_maxThreadCountOverride;
+  int m_memoryBudgetOverride;
+
+  mutable std::mutex m_mutex;
+  std::condition_variable m_allTasksFinished;
+  PendingTaskQueue m_pendingTasks;
+  int m_maxThreadCount;
+  int m_numRunningTasks;
+  MemoryBudget m_memoryBudget;
 };
 
 
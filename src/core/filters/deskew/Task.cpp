@@ -11,6 +11,7 @@
 #include <ReduceThreshold.h>
 #include <SeedFill.h>
 #include <SkewFinder.h>
+#include <Tracer.h>
 #include <UnitsProvider.h>
 #include <UpscaleIntegerTimes.h>
 #include <core/ApplicationSettings.h>
@@ -21,6 +22,7 @@
 #include <imageproc/PolygonRasterizer.h>
 #include <imageproc/Transform.h>
 
+#include <QDataStream>
 #include <QPolygonF>
 #include <QTransform>
 #include <utility>
@@ -39,6 +41,10 @@
 namespace deskew {
 using namespace imageproc;
 
+namespace {
+const QString CLEANED_IMAGE_STAGE = "deskew_cleaned";
+}  // namespace
+
 class Task::UiUpdater : public FilterResult {
  public:
   UiUpdater(std::shared_ptr<Filter> filter,
@@ -86,6 +92,7 @@ Task::Task(std::shared_ptr<Filter> filter,
 Task::~Task() = default;
 
 FilterResultPtr Task::process(const TaskStatus& status, FilterData data) {
+  TRACE_SPAN("deskew", "Task::process");
   status.throwIfCancelled();
 
   const Dependencies deps(data.xform().preCropArea(), data.xform().preRotation());
@@ -135,16 +142,9 @@ FilterResultPtr Task::process(const TaskStatus& status, FilterData data) {
     }
 
     if (boundedImageArea.isValid()) {
-      BinaryImage rotatedImage(orthogonalRotation(
-          BinaryImage(data.grayImageBlackOnWhite(), boundedImageArea, data.bwThresholdBlackOnWhite()),
-          data.xform().preRotation().toDegrees()));
-      if (m_dbg) {
-        m_dbg->add(rotatedImage, "bw_rotated");
-      }
-
       const QSize unrotatedDpm(Dpm(data.origImage()).toSize());
       const Dpm rotatedDpm(data.xform().preRotation().rotate(unrotatedDpm));
-      cleanup(status, rotatedImage, Dpi(rotatedDpm));
+      BinaryImage rotatedImage(cleanedBinaryImage(status, data, boundedImageArea, Dpi(rotatedDpm)));
       if (m_dbg) {
         m_dbg->add(rotatedImage, "after_cleanup");
       }
@@ -219,6 +219,34 @@ FilterResultPtr Task::process(const TaskStatus& status, FilterData data) {
   }
 }  // Task::process
 
+BinaryImage Task::cleanedBinaryImage(const TaskStatus& status,
+                                     const FilterData& data,
+                                     const QRect& imageArea,
+                                     const Dpi& dpi) {
+  const auto compute = [&]() {
+    BinaryImage rotatedImage(
+        orthogonalRotation(BinaryImage(data.grayImageBlackOnWhite(), imageArea, data.bwThresholdBlackOnWhite()),
+                           data.xform().preRotation().toDegrees()));
+    if (m_dbg) {
+      m_dbg->add(rotatedImage, "bw_rotated");
+    }
+    cleanup(status, rotatedImage, dpi);
+    return rotatedImage.toQImage();
+  };
+  if (m_dbg) {
+    // A cached image would come without the debugging images of the steps.
+    return BinaryImage(compute());
+  }
+
+  QByteArray params;
+  {
+    QDataStream strm(&params, QIODevice::WriteOnly);
+    strm << imageArea << data.xform().preRotation().toDegrees() << qint32(data.bwThresholdBlackOnWhite())
+         << data.isBlackOnWhite() << qint32(dpi.horizontal()) << qint32(dpi.vertical());
+  }
+  return BinaryImage(data.pyramid().derivedImage(CLEANED_IMAGE_STAGE, params, compute));
+}
+
 void Task::cleanup(const TaskStatus& status, BinaryImage& image, const Dpi& dpi) {
   // We don't have to clean up every piece of garbage.
   // The only concern are the horizontal shadows, which we remove here.
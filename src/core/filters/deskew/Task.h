@@ -15,6 +15,7 @@
 class TaskStatus;
 class QImage;
 class QSize;
+class QRect;
 class Dpi;
 class DebugImages;
 
@@ -49,6 +50,17 @@ class Task {
  private:
   class UiUpdater;
 
+  /**
+   * \brief The binarized \p imageArea of the page, rotated orthogonally
+   *        and cleaned up, as the skew is detected on.
+   *
+   * Taken from the intermediate cache, if the page was processed before.
+   */
+  imageproc::BinaryImage cleanedBinaryImage(const TaskStatus& status,
+                                            const FilterData& data,
+                                            const QRect& imageArea,
+                                            const Dpi& dpi);
+
   static void cleanup(const TaskStatus& status, imageproc::BinaryImage& img, const Dpi& dpi);
 
   static int from150dpi(int size, int targetDpi);
@@ -3,6 +3,7 @@
 
 #include "Task.h"
 
+#include <Tracer.h>
 #include <UnitsProvider.h>
 
 #include <utility>
@@ -59,6 +60,7 @@ Task::Task(const PageId& pageId,
 Task::~Task() = default;
 
 FilterResultPtr Task::process(const TaskStatus& status, FilterData data) {
+  TRACE_SPAN("fix_orientation", "Task::process");
   // This function is executed from the worker thread.
   status.throwIfCancelled();
 
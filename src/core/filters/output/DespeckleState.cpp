@@ -5,6 +5,10 @@
 
 #include <RasterOp.h>
 
+#include <chrono>
+#include <future>
+#include <mutex>
+
 #include "DebugImages.h"
 #include "Despeckle.h"
 #include "DespeckleVisualization.h"
@@ -13,11 +17,68 @@
 using namespace imageproc;
 
 namespace output {
+class DespeckleState::SharedAnalysis {
+ public:
+  /**
+   * \brief Returns the analysis, building it if necessary.
+   *
+   * The analysis is built outside of the lock, by the first caller.
+   * The others wait for it, and may be cancelled while waiting.
+   * If the one building it gets cancelled, the next caller starts over.
+   */
+  std::shared_ptr<const DespeckleAnalysis> get(const BinaryImage& image, const Dpi& dpi, const TaskStatus& status) {
+    while (true) {
+      std::promise<AnalysisPtr> promise;
+      std::shared_future<AnalysisPtr> future;
+      bool build = false;
+      {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        if (!m_future.valid()) {
+          m_future = promise.get_future().share();
+          build = true;
+        }
+        future = m_future;
+      }
+
+      if (build) {
+        AnalysisPtr analysis;
+        try {
+          analysis = std::make_shared<const DespeckleAnalysis>(image, dpi, status);
+        } catch (...) {
+          {
+            std::lock_guard<std::mutex> guard(m_mutex);
+            m_future = std::shared_future<AnalysisPtr>();
+          }
+          // Wakes up the waiting callers, so that one of them takes over.
+          promise.set_value(nullptr);
+          throw;
+        }
+        promise.set_value(analysis);
+        return analysis;
+      }
+
+      while (future.wait_for(std::chrono::milliseconds(50)) != std::future_status::ready) {
+        status.throwIfCancelled();
+      }
+      if (AnalysisPtr analysis = future.get()) {
+        return analysis;
+      }
+    }
+  }
+
+ private:
+  using AnalysisPtr = std::shared_ptr<const DespeckleAnalysis>;
+
+  std::mutex m_mutex;
+  std::shared_future<AnalysisPtr> m_future;
+};
+
+
 DespeckleState::DespeckleState(const QImage& output,
                                const imageproc::BinaryImage& speckles,
                                const double level,
                                const Dpi& dpi)
-    : m_speckles(speckles), m_dpi(dpi), m_despeckleLevel(level) {
+    : m_speckles(speckles), m_dpi(dpi), m_despeckleLevel(level), m_analysis(std::make_shared<SharedAnalysis>()) {
   m_everythingMixed = overlaySpeckles(output, speckles);
   m_everythingBW = extractBW(m_everythingMixed);
 }
@@ -41,6 +102,11 @@ DespeckleState DespeckleState::redespeckle(const double level, const TaskStatus&
     return newState;
   }
 
+  if (!dbg && DespeckleAnalysis::covers(level)) {
+    newState.m_speckles = m_analysis->get(m_everythingBW, m_dpi, status)->speckles(level);
+    return newState;
+  }
+
   newState.m_speckles = Despeckle::despeckle(m_everythingBW, m_dpi, level, status, dbg);
 
   status.throwIfCancelled();
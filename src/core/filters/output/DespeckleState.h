@@ -8,6 +8,7 @@
 #include <BinaryImage.h>
 
 #include <QImage>
+#include <memory>
 
 #include "DespeckleLevel.h"
 #include "Dpi.h"
@@ -21,6 +22,10 @@ class DespeckleVisualization;
 /**
  * Holds enough information to build a DespeckleVisualization
  * or to re-despeckle with different DespeckleLevel.
+ *
+ * Re-despeckling at the levels covered by DespeckleAnalysis goes through
+ * an analysis built on first use and shared by all the copies of a state,
+ * so only the first change of the level takes time.
  */
 class DespeckleState {
   // Member-wise copying is OK.
@@ -34,6 +39,8 @@ class DespeckleState {
   DespeckleState redespeckle(double level, const TaskStatus& status, DebugImages* dbg = nullptr) const;
 
  private:
+  class SharedAnalysis;
+
   static QImage overlaySpeckles(const QImage& mixed, const imageproc::BinaryImage& speckles);
 
   static imageproc::BinaryImage extractBW(const QImage& mixed);
@@ -67,6 +74,8 @@ class DespeckleState {
    * m_everythingBW.
    */
   double m_despeckleLevel;
+
+  std::shared_ptr<SharedAnalysis> m_analysis;
 };
 
 
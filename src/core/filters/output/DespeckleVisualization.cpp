@@ -13,35 +13,18 @@
 
 using namespace imageproc;
 
-namespace output {
-DespeckleVisualization::DespeckleVisualization(const QImage& output,
-                                               const imageproc::BinaryImage& speckles,
-                                               const Dpi& dpi) {
-  if (output.isNull()) {
-    // This can happen in batch processing mode.
-    return;
-  }
-
-  m_image = output.convertToFormat(QImage::Format_RGB32);
-
-  if (!speckles.isNull()) {
-    colorizeSpeckles(m_image, speckles, dpi);
-  }
-
-  m_downscaledImage = ImageViewBase::createDownscaledImage(m_image);
-}
-
-void DespeckleVisualization::colorizeSpeckles(QImage& image, const imageproc::BinaryImage& speckles, const Dpi& dpi) {
+namespace {
+template <typename T>
+void colorizeByDistance(QImage& image,
+                        const T* sedmLine,
+                        const int sedmStride,
+                        const float radius,
+                        const bool noSpeckles) {
   const int w = image.width();
   const int h = image.height();
   auto* imageLine = (uint32_t*) image.bits();
   const int imageStride = image.bytesPerLine() / 4;
 
-  const SEDM sedm(speckles, SEDM::DIST_TO_BLACK, SEDM::DIST_TO_NO_BORDERS);
-  const uint32_t* sedmLine = sedm.data();
-  const int sedmStride = sedm.stride();
-
-  const float radius = static_cast<float>(45.0 * std::max(dpi.horizontal(), dpi.vertical()) / 600);
   const float sqRadius = radius * radius;
 
   for (int y = 0; y < h; ++y) {
@@ -59,7 +42,7 @@ void DespeckleVisualization::colorizeSpeckles(QImage& image, const imageproc::Bi
       const float alphaUpperBound = 0.7f;
       const float noSpecklesOverlayAlpha = 0.3f;
       const float scale = alphaUpperBound / sqRadius;
-      const float alpha = (sqDist == SEDM::INF_DIST) ? noSpecklesOverlayAlpha : alphaUpperBound - scale * sqDist;
+      const float alpha = noSpeckles ? noSpecklesOverlayAlpha : alphaUpperBound - scale * sqDist;
       if (alpha > 0) {
         const float alpha2 = 1.0f - alpha;
         const float overlayR = 255;
@@ -75,6 +58,40 @@ void DespeckleVisualization::colorizeSpeckles(QImage& image, const imageproc::Bi
     imageLine += imageStride;
   }
 }
+}  // namespace
+
+namespace output {
+DespeckleVisualization::DespeckleVisualization(const QImage& output,
+                                               const imageproc::BinaryImage& speckles,
+                                               const Dpi& dpi) {
+  if (output.isNull()) {
+    // This can happen in batch processing mode.
+    return;
+  }
+
+  m_image = output.convertToFormat(QImage::Format_RGB32);
+
+  if (!speckles.isNull()) {
+    colorizeSpeckles(m_image, speckles, dpi);
+  }
+
+  m_downscaledImage = ImageViewBase::createDownscaledImage(m_image);
+}
+
+void DespeckleVisualization::colorizeSpeckles(QImage& image, const imageproc::BinaryImage& speckles, const Dpi& dpi) {
+  const float radius = static_cast<float>(45.0 * std::max(dpi.horizontal(), dpi.vertical()) / 600);
+  const bool noSpeckles = (speckles.countBlackPixels() == 0);
+
+  // Beyond the radius, the distances only matter as far as being beyond it,
+  // so the 16-bit map does as long as the radius fits it.
+  if (radius * radius < SEDM16::INF_DIST) {
+    const SEDM16 sedm(speckles, SEDM::DIST_TO_BLACK, SEDM::DIST_TO_NO_BORDERS);
+    colorizeByDistance(image, sedm.data(), sedm.stride(), radius, noSpeckles);
+  } else {
+    const SEDM sedm(speckles, SEDM::DIST_TO_BLACK, SEDM::DIST_TO_NO_BORDERS);
+    colorizeByDistance(image, sedm.data(), sedm.stride(), radius, noSpeckles);
+  }
+}
 
 bool DespeckleVisualization::isNull() const {
   return m_image.isNull();
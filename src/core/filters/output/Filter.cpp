@@ -10,6 +10,8 @@
 #include "CacheDrivenTask.h"
 #include "FilterUiInterface.h"
 #include "OptionsWidget.h"
+#include "PageInfo.h"
+#include "PageMemoryEstimate.h"
 #include "ProjectReader.h"
 #include "ProjectWriter.h"
 #include "Settings.h"
@@ -148,6 +150,11 @@ std::shared_ptr<CacheDrivenTask> Filter::createCacheDrivenTask(const OutputFileN
   return std::make_shared<CacheDrivenTask>(m_settings, outFileNameGen);
 }
 
+uint64_t Filter::estimateMemoryUsage(const PageInfo& pageInfo) const {
+  const Params params(m_settings->getParams(pageInfo.id()));
+  return PageMemoryEstimate::forOutput(pageInfo.metadata(), params.colorParams().colorMode(), params.outputDpi());
+}
+
 void Filter::loadDefaultSettings(const PageInfo& pageInfo) {
   if (!m_settings->isParamsNull(pageInfo.id()))
     return;
@@ -6,6 +6,7 @@
 
 #include <QCoreApplication>
 #include <QImage>
+#include <cstdint>
 #include <memory>
 
 #include "AbstractFilter.h"
@@ -58,6 +59,12 @@ class Filter : public AbstractFilter {
 
   std::shared_ptr<CacheDrivenTask> createCacheDrivenTask(const OutputFileNameGenerator& outFileNameGen);
 
+  /**
+   * \brief Estimates the peak memory processing a page through this stage takes,
+   *        given its current output settings.
+   */
+  uint64_t estimateMemoryUsage(const PageInfo& pageInfo) const;
+
   OptionsWidget* optionsWidget();
 
   std::vector<PageOrderOption> pageOrderOptions() const override;
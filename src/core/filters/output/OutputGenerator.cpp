@@ -19,6 +19,7 @@
 #include <InfluenceMap.h>
 #include <Morphology.h>
 #include <OrthogonalRotation.h>
+#include <ParallelFor.h>
 #include <PolygonRasterizer.h>
 #include <PolynomialSurface.h>
 #include <RasterDewarper.h>
@@ -28,6 +29,7 @@
 #include <SeedFill.h>
 #include <TextLineTracer.h>
 #include <TopBottomEdgeTracer.h>
+#include <Tracer.h>
 #include <Transform.h>
 #include <core/ApplicationSettings.h>
 #include <imageproc/BackgroundColorCalculator.h>
@@ -96,10 +98,13 @@ QSize OutputGenerator::outputImageSize() const {
 
 class OutputGenerator::Processor {
  public:
+  /**
+   * \param input The input image, which may be null for resume().
+   */
   Processor(const OutputGenerator& generator,
             const PageId& pageId,
             const std::shared_ptr<Settings>& settings,
-            const FilterData& input,
+            const FilterData* input,
             const TaskStatus& status,
             DebugImages* dbg);
 
@@ -108,7 +113,10 @@ class OutputGenerator::Processor {
                                        DistortionModel& distortionModel,
                                        const DepthPerception& depthPerception,
                                        BinaryImage* autoPictureMask,
-                                       BinaryImage* specklesImage);
+                                       BinaryImage* specklesImage,
+                                       QImage* checkpoint);
+
+  std::unique_ptr<OutputImage> resume(const QImage& checkpoint, const ZoneSet& fillZones, BinaryImage* specklesImage);
 
  private:
   void initParams();
@@ -124,12 +132,30 @@ class OutputGenerator::Processor {
                                            DistortionModel& distortionModel,
                                            const DepthPerception& depthPerception,
                                            BinaryImage* autoPictureMask,
-                                           BinaryImage* specklesImage);
+                                           BinaryImage* specklesImage,
+                                           QImage* checkpoint);
 
   std::unique_ptr<OutputImage> processWithoutDewarping(ZoneSet& pictureZones,
                                                        const ZoneSet& fillZones,
                                                        BinaryImage* autoPictureMask,
-                                                       BinaryImage* specklesImage);
+                                                       BinaryImage* specklesImage,
+                                                       QImage* checkpoint);
+
+  /**
+   * \brief The steps of black and white output following the checkpoint.
+   *
+   * \param content The binarized content of the output image, before despeckling.
+   */
+  std::unique_ptr<OutputImage> finishBinaryOutput(BinaryImage& content,
+                                                  const ZoneSet& fillZones,
+                                                  BinaryImage* specklesImage) const;
+
+  /**
+   * \brief The steps of color / grayscale output following the checkpoint.
+   *
+   * \param image The output image, before applying the fill zones.
+   */
+  std::unique_ptr<OutputImage> finishColorOutput(QImage& image, const ZoneSet& fillZones) const;
 
   std::unique_ptr<OutputImage> processWithDewarping(ZoneSet& pictureZones,
                                                     const ZoneSet& fillZones,
@@ -259,17 +285,38 @@ std::unique_ptr<OutputImage> OutputGenerator::process(const TaskStatus& status,
                                                       const DepthPerception& depthPerception,
                                                       BinaryImage* autoPictureMask,
                                                       BinaryImage* specklesImage,
+                                                      QImage* checkpoint,
                                                       DebugImages* dbg,
                                                       const PageId& pageId,
                                                       const std::shared_ptr<Settings>& settings) const {
-  return Processor(*this, pageId, settings, input, status, dbg)
-      .process(pictureZones, fillZones, distortionModel, depthPerception, autoPictureMask, specklesImage);
+  return Processor(*this, pageId, settings, &input, status, dbg)
+      .process(pictureZones, fillZones, distortionModel, depthPerception, autoPictureMask, specklesImage, checkpoint);
+}
+
+std::unique_ptr<OutputImage> OutputGenerator::resume(const TaskStatus& status,
+                                                     const QImage& checkpoint,
+                                                     const ZoneSet& fillZones,
+                                                     BinaryImage* specklesImage,
+                                                     DebugImages* dbg,
+                                                     const PageId& pageId,
+                                                     const std::shared_ptr<Settings>& settings) const {
+  return Processor(*this, pageId, settings, nullptr, status, dbg).resume(checkpoint, fillZones, specklesImage);
+}
+
+bool OutputGenerator::supportsCheckpoints(const RenderParams& renderParams, const DewarpingOptions& dewarpingOptions) {
+  if (dewarpingOptions.dewarpingMode() != OFF) {
+    return false;
+  }
+  if (renderParams.binaryOutput()) {
+    return !renderParams.needColorSegmentation();
+  }
+  return !renderParams.mixedOutput();
 }
 
 OutputGenerator::Processor::Processor(const OutputGenerator& generator,
                                       const PageId& pageId,
                                       const std::shared_ptr<Settings>& settings,
-                                      const FilterData& input,
+                                      const FilterData* input,
                                       const TaskStatus& status,
                                       DebugImages* dbg)
     : m_xform(generator.m_xform),
@@ -285,8 +332,12 @@ OutputGenerator::Processor::Processor(const OutputGenerator& generator,
       m_dbg(dbg) {
   initParams();
   calcAreas();
-  if (!m_blank) {
-    initFilterData(input);
+  if (input) {
+    if (!m_blank) {
+      initFilterData(*input);
+    }
+  } else {
+    m_blackOnWhite = m_settings->getParams(m_pageId).isBlackOnWhite();
   }
 }
 
@@ -295,9 +346,29 @@ std::unique_ptr<OutputImage> OutputGenerator::Processor::process(ZoneSet& pictur
                                                                  DistortionModel& distortionModel,
                                                                  const DepthPerception& depthPerception,
                                                                  BinaryImage* autoPictureMask,
-                                                                 BinaryImage* specklesImage) {
-  std::unique_ptr<OutputImage> image
-      = processImpl(pictureZones, fillZones, distortionModel, depthPerception, autoPictureMask, specklesImage);
+                                                                 BinaryImage* specklesImage,
+                                                                 QImage* checkpoint) {
+  TRACE_SPAN("output", "Processor::process");
+  std::unique_ptr<OutputImage> image = processImpl(pictureZones, fillZones, distortionModel, depthPerception,
+                                                   autoPictureMask, specklesImage, checkpoint);
+  image->setDpm(m_dpi);
+  return image;
+}
+
+std::unique_ptr<OutputImage> OutputGenerator::Processor::resume(const QImage& checkpoint,
+                                                                const ZoneSet& fillZones,
+                                                                BinaryImage* specklesImage) {
+  TRACE_SPAN("output", "Processor::resume");
+  std::unique_ptr<OutputImage> image;
+  if (m_blank) {
+    image = buildEmptyImage();
+  } else if (m_renderParams.binaryOutput()) {
+    BinaryImage content(checkpoint);
+    image = finishBinaryOutput(content, fillZones, specklesImage);
+  } else {
+    QImage content(checkpoint);
+    image = finishColorOutput(content, fillZones);
+  }
   image->setDpm(m_dpi);
   return image;
 }
@@ -419,15 +490,18 @@ void reserveBlackAndWhite(QImage& img) {
   const int width = img.width();
   const int height = img.height();
 
-  auto* imageLine = reinterpret_cast<PixelType*>(img.bits());
+  auto* const imageData = reinterpret_cast<PixelType*>(img.bits());
   const int imageStride = img.bytesPerLine() / sizeof(PixelType);
 
-  for (int y = 0; y < height; ++y) {
-    for (int x = 0; x < width; ++x) {
-      imageLine[x] = reserveBlackAndWhite<PixelType>(imageLine[x]);
+  parallelForBands(height, 16, [&](const int yBegin, const int yEnd) {
+    auto* imageLine = imageData + yBegin * imageStride;
+    for (int y = yBegin; y < yEnd; ++y) {
+      for (int x = 0; x < width; ++x) {
+        imageLine[x] = reserveBlackAndWhite<PixelType>(imageLine[x]);
+      }
+      imageLine += imageStride;
     }
-    imageLine += imageStride;
-  }
+  });
 }
 
 void reserveBlackAndWhite(QImage& img) {
@@ -449,21 +523,25 @@ void reserveBlackAndWhite(QImage& img, const BinaryImage& mask) {
   const int width = img.width();
   const int height = img.height();
 
-  auto* imageLine = reinterpret_cast<PixelType*>(img.bits());
+  auto* const imageData = reinterpret_cast<PixelType*>(img.bits());
   const int imageStride = img.bytesPerLine() / sizeof(PixelType);
-  const uint32_t* maskLine = mask.data();
+  const uint32_t* const maskData = mask.data();
   const int maskStride = mask.wordsPerLine();
   const uint32_t msb = uint32_t(1) << 31;
 
-  for (int y = 0; y < height; ++y) {
-    for (int x = 0; x < width; ++x) {
-      if (maskLine[x >> 5] & (msb >> (x & 31))) {
-        imageLine[x] = reserveBlackAndWhite<PixelType>(imageLine[x]);
+  parallelForBands(height, 16, [&](const int yBegin, const int yEnd) {
+    auto* imageLine = imageData + yBegin * imageStride;
+    const uint32_t* maskLine = maskData + yBegin * maskStride;
+    for (int y = yBegin; y < yEnd; ++y) {
+      for (int x = 0; x < width; ++x) {
+        if (maskLine[x >> 5] & (msb >> (x & 31))) {
+          imageLine[x] = reserveBlackAndWhite<PixelType>(imageLine[x]);
+        }
       }
+      imageLine += imageStride;
+      maskLine += maskStride;
     }
-    imageLine += imageStride;
-    maskLine += maskStride;
-  }
+  });
 }
 
 void reserveBlackAndWhite(QImage& img, const BinaryImage& mask) {
@@ -482,48 +560,56 @@ void reserveBlackAndWhite(QImage& img, const BinaryImage& mask) {
 
 template <typename MixedPixel>
 void fillExcept(QImage& image, const BinaryImage& bwMask, const QColor& color) {
-  auto* imageLine = reinterpret_cast<MixedPixel*>(image.bits());
+  auto* const imageData = reinterpret_cast<MixedPixel*>(image.bits());
   const int imageStride = image.bytesPerLine() / sizeof(MixedPixel);
-  const uint32_t* bwMaskLine = bwMask.data();
+  const uint32_t* const bwMaskData = bwMask.data();
   const int bwMaskStride = bwMask.wordsPerLine();
   const int width = image.width();
   const int height = image.height();
   const uint32_t msb = uint32_t(1) << 31;
   const auto fillingPixel = static_cast<MixedPixel>(color.rgba());
 
-  for (int y = 0; y < height; ++y) {
-    for (int x = 0; x < width; ++x) {
-      if (!(bwMaskLine[x >> 5] & (msb >> (x & 31)))) {
-        imageLine[x] = fillingPixel;
+  parallelForBands(height, 16, [&](const int yBegin, const int yEnd) {
+    auto* imageLine = imageData + yBegin * imageStride;
+    const uint32_t* bwMaskLine = bwMaskData + yBegin * bwMaskStride;
+    for (int y = yBegin; y < yEnd; ++y) {
+      for (int x = 0; x < width; ++x) {
+        if (!(bwMaskLine[x >> 5] & (msb >> (x & 31)))) {
+          imageLine[x] = fillingPixel;
+        }
       }
+      imageLine += imageStride;
+      bwMaskLine += bwMaskStride;
     }
-    imageLine += imageStride;
-    bwMaskLine += bwMaskStride;
-  }
+  });
 }
 
 void fillExcept(BinaryImage& image, const BinaryImage& bwMask, const BWColor color) {
-  uint32_t* imageLine = image.data();
+  uint32_t* const imageData = image.data();
   const int imageStride = image.wordsPerLine();
-  const uint32_t* bwMaskLine = bwMask.data();
+  const uint32_t* const bwMaskData = bwMask.data();
   const int bwMaskStride = bwMask.wordsPerLine();
   const int width = image.width();
   const int height = image.height();
   const uint32_t msb = uint32_t(1) << 31;
 
-  for (int y = 0; y < height; ++y) {
-    for (int x = 0; x < width; ++x) {
-      if (!(bwMaskLine[x >> 5] & (msb >> (x & 31)))) {
-        if (color == BLACK) {
-          imageLine[x >> 5] |= (msb >> (x & 31));
-        } else {
-          imageLine[x >> 5] &= ~(msb >> (x & 31));
+  parallelForBands(height, 16, [&](const int yBegin, const int yEnd) {
+    uint32_t* imageLine = imageData + yBegin * imageStride;
+    const uint32_t* bwMaskLine = bwMaskData + yBegin * bwMaskStride;
+    for (int y = yBegin; y < yEnd; ++y) {
+      for (int x = 0; x < width; ++x) {
+        if (!(bwMaskLine[x >> 5] & (msb >> (x & 31)))) {
+          if (color == BLACK) {
+            imageLine[x >> 5] |= (msb >> (x & 31));
+          } else {
+            imageLine[x >> 5] &= ~(msb >> (x & 31));
+          }
         }
       }
+      imageLine += imageStride;
+      bwMaskLine += bwMaskStride;
     }
-    imageLine += imageStride;
-    bwMaskLine += bwMaskStride;
-  }
+  });
 }
 
 void BinaryImageXOR(BinaryImage& image, const BinaryImage& bwMask, const BWColor color) {
@@ -1255,7 +1341,8 @@ std::unique_ptr<OutputImage> OutputGenerator::Processor::processImpl(ZoneSet& pi
                                                                      DistortionModel& distortionModel,
                                                                      const DepthPerception& depthPerception,
                                                                      BinaryImage* autoPictureMask,
-                                                                     BinaryImage* specklesImage) {
+                                                                     BinaryImage* specklesImage,
+                                                                     QImage* checkpoint) {
   if (m_blank) {
     return buildEmptyImage();
   }
@@ -1268,14 +1355,19 @@ std::unique_ptr<OutputImage> OutputGenerator::Processor::processImpl(ZoneSet& pi
     return processWithDewarping(pictureZones, fillZones, distortionModel, depthPerception, autoPictureMask,
                                 specklesImage);
   } else {
-    return processWithoutDewarping(pictureZones, fillZones, autoPictureMask, specklesImage);
+    if (!supportsCheckpoints(m_renderParams, m_dewarpingOptions)) {
+      checkpoint = nullptr;
+    }
+    return processWithoutDewarping(pictureZones, fillZones, autoPictureMask, specklesImage, checkpoint);
   }
 }
 
 std::unique_ptr<OutputImage> OutputGenerator::Processor::processWithoutDewarping(ZoneSet& pictureZones,
                                                                                  const ZoneSet& fillZones,
                                                                                  BinaryImage* autoPictureMask,
-                                                                                 BinaryImage* specklesImage) {
+                                                                                 BinaryImage* specklesImage,
+                                                                                 QImage* checkpoint) {
+  TRACE_SPAN("output", "Processor::processWithoutDewarping");
   QImage maybeNormalized, maybeSmoothed;
   BinaryImage bwContent, bwContentMaskOutput, bwContentOutput;
   OutputImageBuilder imageBuilder;
@@ -1334,51 +1426,48 @@ std::unique_ptr<OutputImage> OutputGenerator::Processor::processWithoutDewarping
     rasterOp<RopSrc>(dst, m_croppedContentRect, bwContent, m_contentRectInWorkingCs.topLeft());
     bwContent.release();  // Save memory.
 
+    if (!m_renderParams.needColorSegmentation()) {
+      if (checkpoint) {
+        *checkpoint = dst.toQImage();
+      }
+      return finishBinaryOutput(dst, fillZones, specklesImage);
+    }
+
     // It's important to keep despeckling the very last operation
     // affecting the binary part of the output. That's because
     // we will be reconstructing the input to this despeckling
     // operation from the final output file.
     maybeDespeckleInPlace(dst, m_outRect, m_outRect, m_despeckleLevel, specklesImage, m_dpi);
 
-    if (!m_renderParams.needColorSegmentation()) {
-      if (!m_blackOnWhite) {
-        dst.invert();
-      }
-
-      applyFillZonesInPlace(dst, fillZones, m_xform.transform());
-
-      imageBuilder.setImage(dst.toQImage());
-    } else {
-      QImage segmentedImage;
-      {
-        QImage colorImage(m_targetSize, maybeNormalized.format());
-        if (maybeNormalized.format() == QImage::Format_Indexed8) {
-          colorImage.setColorTable(maybeNormalized.colorTable());
-        }
-        colorImage.fill(Qt::white);
-        drawOver(colorImage, m_croppedContentRect, maybeNormalized, m_contentRectInWorkingCs);
-        maybeNormalized = QImage();
-
-        segmentedImage = segmentImage(dst, colorImage);
-        dst.release();
+    QImage segmentedImage;
+    {
+      QImage colorImage(m_targetSize, maybeNormalized.format());
+      if (maybeNormalized.format() == QImage::Format_Indexed8) {
+        colorImage.setColorTable(maybeNormalized.colorTable());
       }
+      colorImage.fill(Qt::white);
+      drawOver(colorImage, m_croppedContentRect, maybeNormalized, m_contentRectInWorkingCs);
+      maybeNormalized = QImage();
 
-      if (m_renderParams.posterize()) {
-        segmentedImage = posterizeImage(segmentedImage, m_outsideBackgroundColor);
-      }
+      segmentedImage = segmentImage(dst, colorImage);
+      dst.release();
+    }
 
-      if (!m_blackOnWhite) {
-        segmentedImage.invertPixels();
-      }
+    if (m_renderParams.posterize()) {
+      segmentedImage = posterizeImage(segmentedImage, m_outsideBackgroundColor);
+    }
 
-      applyFillZonesInPlace(segmentedImage, fillZones, m_xform.transform(), false);
-      if (m_dbg) {
-        m_dbg->add(segmentedImage, "segmented_with_fill_zones");
-      }
-      m_status.throwIfCancelled();
+    if (!m_blackOnWhite) {
+      segmentedImage.invertPixels();
+    }
 
-      imageBuilder.setImage(segmentedImage);
+    applyFillZonesInPlace(segmentedImage, fillZones, m_xform.transform(), false);
+    if (m_dbg) {
+      m_dbg->add(segmentedImage, "segmented_with_fill_zones");
     }
+    m_status.throwIfCancelled();
+
+    imageBuilder.setImage(segmentedImage);
     return imageBuilder.build();
   }
   // (BW only / Color segment) end
@@ -1498,6 +1587,13 @@ std::unique_ptr<OutputImage> OutputGenerator::Processor::processWithoutDewarping
     dst.invertPixels();
   }
 
+  if (!m_renderParams.mixedOutput()) {
+    if (checkpoint) {
+      *checkpoint = dst;
+    }
+    return finishColorOutput(dst, fillZones);
+  }
+
   if (m_renderParams.mixedOutput() && m_renderParams.needBinarization()) {
     applyFillZonesToMixedInPlace(dst, fillZones, m_xform.transform(), bwContentMaskOutput,
                                  !m_renderParams.needColorSegmentation());
@@ -1529,12 +1625,48 @@ std::unique_ptr<OutputImage> OutputGenerator::Processor::processWithoutDewarping
   return imageBuilder.setImage(dst).build();
 }
 
+std::unique_ptr<OutputImage> OutputGenerator::Processor::finishBinaryOutput(BinaryImage& content,
+                                                                            const ZoneSet& fillZones,
+                                                                            BinaryImage* specklesImage) const {
+  // It's important to keep despeckling the very last operation
+  // affecting the binary part of the output. That's because
+  // we will be reconstructing the input to this despeckling
+  // operation from the final output file.
+  maybeDespeckleInPlace(content, m_outRect, m_outRect, m_despeckleLevel, specklesImage, m_dpi);
+
+  if (!m_blackOnWhite) {
+    content.invert();
+  }
+
+  applyFillZonesInPlace(content, fillZones, m_xform.transform());
+
+  OutputImageBuilder imageBuilder;
+  return imageBuilder.setImage(content.toQImage()).build();
+}
+
+std::unique_ptr<OutputImage> OutputGenerator::Processor::finishColorOutput(QImage& image,
+                                                                           const ZoneSet& fillZones) const {
+  applyFillZonesInPlace(image, fillZones, m_xform.transform());
+  if (m_dbg) {
+    m_dbg->add(image, "fillZones");
+  }
+  m_status.throwIfCancelled();
+
+  if (m_renderParams.posterize()) {
+    image = posterizeImage(image);
+  }
+
+  OutputImageBuilder imageBuilder;
+  return imageBuilder.setImage(image).build();
+}
+
 std::unique_ptr<OutputImage> OutputGenerator::Processor::processWithDewarping(ZoneSet& pictureZones,
                                                                               const ZoneSet& fillZones,
                                                                               DistortionModel& distortionModel,
                                                                               const DepthPerception& depthPerception,
                                                                               BinaryImage* autoPictureMask,
                                                                               BinaryImage* specklesImage) {
+  TRACE_SPAN("output", "Processor::processWithDewarping");
   OutputImageBuilder imageBuilder;
 
   // The output we would get if dewarping was turned off, except always grayscale.
@@ -1895,6 +2027,7 @@ GrayImage OutputGenerator::Processor::normalizeIlluminationGray(const QImage& in
                                                                 const QTransform& xform,
                                                                 const QRect& targetRect,
                                                                 GrayImage* background) const {
+  TRACE_SPAN("output", "Processor::normalizeIlluminationGray");
   GrayImage toBeNormalized = transformToGray(input, xform, targetRect, OutsidePixels::assumeWeakNearest());
   if (m_dbg) {
     m_dbg->add(toBeNormalized, "toBeNormalized");
@@ -1928,6 +2061,7 @@ GrayImage OutputGenerator::Processor::normalizeIlluminationGray(const QImage& in
 BinaryImage OutputGenerator::Processor::estimateBinarizationMask(const GrayImage& graySource,
                                                                  const QRect& sourceRect,
                                                                  const QRect& sourceSubRect) const {
+  TRACE_SPAN("output", "Processor::estimateBinarizationMask");
   assert(sourceRect.contains(sourceSubRect));
 
   // If we need to strip some of the margins from a grayscale
@@ -2092,6 +2226,7 @@ QImage OutputGenerator::Processor::dewarp(const QTransform& origToSrc,
                                           const DistortionModel& distortionModel,
                                           const DepthPerception& depthPerception,
                                           const QColor& bgColor) const {
+  TRACE_SPAN("output", "Processor::dewarp");
   const CylindricalSurfaceDewarper dewarper(createDewarper(distortionModel, origToSrc, depthPerception.value()));
 
   // Model domain is a rectangle in output image coordinates that
@@ -2106,6 +2241,7 @@ QImage OutputGenerator::Processor::dewarp(const QTransform& origToSrc,
 }
 
 GrayImage OutputGenerator::Processor::detectPictures(const GrayImage& input300dpi) const {
+  TRACE_SPAN("output", "Processor::detectPictures");
   // We stretch the range of gray levels to cover the whole
   // range of [0, 255].  We do it because we want text
   // and background to be equally far from the center
@@ -2218,6 +2354,7 @@ BinaryThreshold OutputGenerator::Processor::calcBinarizationThreshold(const QIma
 }
 
 void OutputGenerator::Processor::morphologicalSmoothInPlace(BinaryImage& binImg) const {
+  TRACE_SPAN("output", "Processor::morphologicalSmoothInPlace");
   // When removing black noise, remove small ones first.
 
   {
@@ -2302,6 +2439,7 @@ void OutputGenerator::Processor::morphologicalSmoothInPlace(BinaryImage& binImg)
 }
 
 BinaryImage OutputGenerator::Processor::binarize(const QImage& image) const {
+  TRACE_SPAN("output", "Processor::binarize");
   if ((image.format() == QImage::Format_Mono) || (image.format() == QImage::Format_MonoLSB)) {
     return BinaryImage(image);
   }
@@ -2444,6 +2582,7 @@ void OutputGenerator::Processor::maybeDespeckleInPlace(BinaryImage& image,
                                                        double level,
                                                        BinaryImage* specklesImg,
                                                        const Dpi& dpi) const {
+  TRACE_SPAN("output", "Processor::maybeDespeckleInPlace");
   const QRect srcRect(maskRect.translated(-imageRect.topLeft()));
   const QRect dstRect(maskRect);
 
@@ -2472,6 +2611,7 @@ void OutputGenerator::Processor::maybeDespeckleInPlace(BinaryImage& image,
 }
 
 double OutputGenerator::Processor::findSkew(const QImage& image) const {
+  TRACE_SPAN("output", "Processor::findSkew");
   if (m_dewarpingOptions.needPostDeskew()
       && ((m_dewarpingOptions.dewarpingMode() == MARGINAL) || (m_dewarpingOptions.dewarpingMode() == MANUAL))) {
     const BinaryImage bwImage(image, BinaryThreshold::otsuThreshold(GrayscaleHistogram(image)));
@@ -2484,6 +2624,7 @@ double OutputGenerator::Processor::findSkew(const QImage& image) const {
 }
 
 QImage OutputGenerator::Processor::segmentImage(const BinaryImage& image, const QImage& colorImage) const {
+  TRACE_SPAN("output", "Processor::segmentImage");
   const BlackWhiteOptions::ColorSegmenterOptions& segmenterOptions
       = m_colorParams.blackWhiteOptions().getColorSegmenterOptions();
   ColorSegmenter segmenter(m_dpi, segmenterOptions.getNoiseReduction(), segmenterOptions.getRedThresholdAdjustment(),
@@ -2507,6 +2648,7 @@ QImage OutputGenerator::Processor::segmentImage(const BinaryImage& image, const
 }
 
 QImage OutputGenerator::Processor::posterizeImage(const QImage& image, const QColor& backgroundColor) const {
+  TRACE_SPAN("output", "Processor::posterizeImage");
   const ColorCommonOptions::PosterizationOptions& posterizationOptions
       = m_colorParams.colorCommonOptions().getPosterizationOptions();
   Posterizer posterizer(posterizationOptions.getLevel(), posterizationOptions.isNormalizationEnabled(),
@@ -2522,6 +2664,7 @@ QImage OutputGenerator::Processor::posterizeImage(const QImage& image, const QCo
 }
 
 void OutputGenerator::Processor::processPictureZones(BinaryImage& mask, ZoneSet& pictureZones, const GrayImage& image) {
+  TRACE_SPAN("output", "Processor::processPictureZones");
   if ((m_pictureShapeOptions.getPictureShape() != RECTANGULAR_SHAPE) || !m_outputProcessingParams.isAutoZonesFound()) {
     if (m_pictureShapeOptions.getPictureShape() != OFF_SHAPE) {
       mask = estimateBinarizationMask(image, m_workingBoundingRect, m_workingBoundingRect);
@@ -2565,6 +2708,7 @@ ForegroundType OutputGenerator::Processor::getForegroundType() const {
 }
 
 QImage OutputGenerator::Processor::transformToWorkingCs(bool normalize) const {
+  TRACE_SPAN("output", "Processor::transformToWorkingCs");
   QImage dst;
   if (normalize) {
     dst = normalizeIlluminationGray(m_inputGrayImage, m_preCropAreaInOriginalCs, m_xform.transform(),
@@ -2591,6 +2735,7 @@ QImage OutputGenerator::Processor::transformToWorkingCs(bool normalize) const {
 
 DistortionModel OutputGenerator::Processor::buildAutoDistortionModel(const GrayImage& warpedGrayOutput,
                                                                      const QTransform& toOriginal) const {
+  TRACE_SPAN("output", "Processor::buildAutoDistortionModel");
   DistortionModelBuilder modelBuilder(Vec2d(0, 1));
 
   TextLineTracer::trace(warpedGrayOutput, m_dpi, m_contentRectInWorkingCs, modelBuilder, m_status, m_dbg);
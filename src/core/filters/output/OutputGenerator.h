@@ -32,6 +32,8 @@ class CylindricalSurfaceDewarper;
 namespace output {
 class Settings;
 class DepthPerception;
+class DewarpingOptions;
+class RenderParams;
 
 class OutputGenerator {
  public:
@@ -59,6 +61,9 @@ class OutputGenerator {
    *        restored from the output and speckles images, allowing despeckling
    *        to be performed again with different settings, without going
    *        through the whole output generation process again.
+   * \param checkpoint If provided and the settings support checkpoints,
+   *        the image the last steps start from will be written there.
+   *        Passing it to resume() redoes those steps only.
    * \param dbg An optional sink for debugging images.
    */
   std::unique_ptr<OutputImage> process(const TaskStatus& status,
@@ -69,10 +74,36 @@ class OutputGenerator {
                                        const DepthPerception& depthPerception,
                                        imageproc::BinaryImage* autoPictureMask,
                                        imageproc::BinaryImage* specklesImage,
+                                       QImage* checkpoint,
                                        DebugImages* dbg,
                                        const PageId& pageId,
                                        const std::shared_ptr<Settings>& settings) const;
 
+  /**
+   * \brief Produce the output image from a checkpoint written by process().
+   *
+   * Only the steps after the checkpoint are run: despeckling, fill zones and
+   * posterization.  So the checkpoint must have been produced with the same
+   * settings, except for those of these steps.
+   *
+   * \see process()
+   */
+  std::unique_ptr<OutputImage> resume(const TaskStatus& status,
+                                      const QImage& checkpoint,
+                                      const ZoneSet& fillZones,
+                                      imageproc::BinaryImage* specklesImage,
+                                      DebugImages* dbg,
+                                      const PageId& pageId,
+                                      const std::shared_ptr<Settings>& settings) const;
+
+  /**
+   * \brief Whether process() writes a checkpoint for these settings.
+   *
+   * That's the case for black and white output without color segmentation and
+   * for color / grayscale output, as long as there is no dewarping.
+   */
+  static bool supportsCheckpoints(const RenderParams& renderParams, const DewarpingOptions& dewarpingOptions);
+
   QSize outputImageSize() const;
 
   /**
@@ -132,6 +132,15 @@ bool OutputImageParams::matches(const OutputImageParams& other) const {
   return true;
 }  // OutputImageParams::matches
 
+bool OutputImageParams::matchesUpToCheckpoint(const OutputImageParams& other) const {
+  OutputImageParams adjusted(other);
+  adjusted.m_despeckleLevel = m_despeckleLevel;
+  ColorCommonOptions colorCommonOptions(adjusted.m_colorParams.colorCommonOptions());
+  colorCommonOptions.setPosterizationOptions(m_colorParams.colorCommonOptions().getPosterizationOptions());
+  adjusted.m_colorParams.setColorCommonOptions(colorCommonOptions);
+  return matches(adjusted);
+}
+
 bool OutputImageParams::colorParamsMatch(const ColorParams& cp1,
                                          const double dl1,
                                          const SplittingOptions& so1,
@@ -71,6 +71,14 @@ class OutputImageParams {
    */
   bool matches(const OutputImageParams& other) const;
 
+  /**
+   * \brief Like matches(), but ignoring the parameters of the steps following
+   *        the output checkpoint, which are despeckling and posterization.
+   *
+   * \see OutputGenerator::resume()
+   */
+  bool matchesUpToCheckpoint(const OutputImageParams& other) const;
+
  private:
   class PartialXform {
    public:
@@ -39,6 +39,7 @@ OutputParams::OutputParams(const QDomElement& el)
       m_originalBackgroundFileParams(el.namedItem("original_background_file").toElement()),
       m_automaskFileParams(el.namedItem("automask").toElement()),
       m_specklesFileParams(el.namedItem("speckles").toElement()),
+      m_checkpointFileParams(el.namedItem("checkpoint").toElement()),
       m_pictureZones(el.namedItem("zones").toElement(), PictureZonePropFactory()),
       m_fillZones(el.namedItem("fill-zones").toElement(), FillZonePropFactory()) {}
 
@@ -52,6 +53,7 @@ QDomElement OutputParams::toXml(QDomDocument& doc, const QString& name) const {
   el.appendChild(m_originalBackgroundFileParams.toXml(doc, "original_background_file"));
   el.appendChild(m_automaskFileParams.toXml(doc, "automask"));
   el.appendChild(m_specklesFileParams.toXml(doc, "speckles"));
+  el.appendChild(m_checkpointFileParams.toXml(doc, "checkpoint"));
   el.appendChild(m_pictureZones.toXml(doc, "zones"));
   el.appendChild(m_fillZones.toXml(doc, "fill-zones"));
   return el;
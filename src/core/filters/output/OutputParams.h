@@ -46,6 +46,13 @@ class OutputParams {
 
   const OutputFileParams& specklesFileParams() const;
 
+  /**
+   * \brief The file OutputGenerator::resume() can start from.
+   */
+  const OutputFileParams& checkpointFileParams() const;
+
+  void setCheckpointFileParams(const OutputFileParams& checkpointFileParams);
+
   const ZoneSet& pictureZones() const;
 
   const ZoneSet& fillZones() const;
@@ -59,6 +66,7 @@ class OutputParams {
   OutputFileParams m_originalBackgroundFileParams;
   OutputFileParams m_automaskFileParams;
   OutputFileParams m_specklesFileParams;
+  OutputFileParams m_checkpointFileParams;
   ZoneSet m_pictureZones;
   ZoneSet m_fillZones;
 };
@@ -92,6 +100,14 @@ inline const OutputFileParams& OutputParams::specklesFileParams() const {
   return m_specklesFileParams;
 }
 
+inline const OutputFileParams& OutputParams::checkpointFileParams() const {
+  return m_checkpointFileParams;
+}
+
+inline void OutputParams::setCheckpointFileParams(const OutputFileParams& checkpointFileParams) {
+  m_checkpointFileParams = checkpointFileParams;
+}
+
 inline const ZoneSet& OutputParams::pictureZones() const {
   return m_pictureZones;
 }
@@ -4,13 +4,17 @@
 #include "Task.h"
 
 #include <DewarpingPointMapper.h>
+#include <ParallelFor.h>
 #include <PolygonUtils.h>
+#include <Tracer.h>
 #include <UnitsProvider.h>
 #include <core/TiffWriter.h>
 
 #include <QDir>
+#include <atomic>
 #include <boost/bind/bind.hpp>
 #include <utility>
+#include <vector>
 
 #include "DebugImagesImpl.h"
 #include "DespeckleState.h"
@@ -110,6 +114,7 @@ Task::Task(std::shared_ptr<Filter> filter,
 Task::~Task() = default;
 
 FilterResultPtr Task::process(const TaskStatus& status, const FilterData& data, const QPolygonF& contentRectPhys) {
+  TRACE_SPAN("output", "Task::process");
   status.throwIfCancelled();
 
   Params params = m_settings->getParams(m_pageId);
@@ -140,6 +145,9 @@ FilterResultPtr Task::process(const TaskStatus& status, const FilterData& data,
   const QString specklesFilePath(QDir(specklesDir).absoluteFilePath(outFileInfo.fileName()));
   QFileInfo specklesFileInfo(specklesFilePath);
 
+  const QString checkpointDir(Utils::predespeckleDir(m_outFileNameGen.outDir()));
+  const QString checkpointFilePath(QDir(checkpointDir).absoluteFilePath(outFileInfo.fileName()));
+
   const bool needPictureEditor = renderParams.mixedOutput() && !m_batchProcessing;
   const bool needSpecklesImage
       = ((params.despeckleLevel() != .0) && renderParams.needBinarization() && !m_batchProcessing);
@@ -254,6 +262,30 @@ FilterResultPtr Task::process(const TaskStatus& status, const FilterData& data,
   QImage outImg;
   BinaryImage automaskImg;
   BinaryImage specklesImg;
+  QImage checkpointImg;
+  // Like the speckles file, the checkpoint is only needed for redoing the last steps
+  // after changes made interactively, so batch processing doesn't write it.
+  const bool useCheckpoint
+      = !m_batchProcessing && OutputGenerator::supportsCheckpoints(renderParams, params.dewarpingOptions());
+
+  if (needReprocess && useCheckpoint) {
+    // Changes to the fill zones, despeckling or posterization only need
+    // the steps following the checkpoint, if we have one for the rest.
+    std::unique_ptr<OutputParams> storedOutputParams(m_settings->getOutputParams(m_pageId));
+    if ((storedOutputParams != nullptr)
+        && storedOutputParams->outputImageParams().matchesUpToCheckpoint(newOutputImageParams)
+        && storedOutputParams->sourceFileParams().matches(OutputFileParams(sourceFileInfo))
+        && storedOutputParams->checkpointFileParams().matches(OutputFileParams(QFileInfo(checkpointFilePath)))) {
+      QFile checkpointFile(checkpointFilePath);
+      if (checkpointFile.open(QIODevice::ReadOnly)) {
+        checkpointImg = ImageLoader::load(checkpointFile, 0);
+      }
+      if (checkpointImg.size() != generator.outputImageSize()) {
+        checkpointImg = QImage();
+      }
+    }
+  }
+  const bool resumeFromCheckpoint = !checkpointImg.isNull();
 
   if (!needReprocess) {
     QFile outFile(outFilePath);
@@ -318,10 +350,16 @@ FilterResultPtr Task::process(const TaskStatus& status, const FilterData& data,
 
     bool invalidateParams = false;
     {
-      std::unique_ptr<OutputImage> outputImage
-          = generator.process(status, data, newPictureZones, newFillZones, distortionModel, params.depthPerception(),
-                              writeAutomask ? &automaskImg : nullptr, writeSpecklesFile ? &specklesImg : nullptr,
-                              m_dbg.get(), m_pageId, m_settings);
+      std::unique_ptr<OutputImage> outputImage;
+      if (resumeFromCheckpoint) {
+        outputImage = generator.resume(status, checkpointImg, newFillZones, writeSpecklesFile ? &specklesImg : nullptr,
+                                       m_dbg.get(), m_pageId, m_settings);
+      } else {
+        outputImage = generator.process(status, data, newPictureZones, newFillZones, distortionModel,
+                                        params.depthPerception(), writeAutomask ? &automaskImg : nullptr,
+                                        writeSpecklesFile ? &specklesImg : nullptr,
+                                        useCheckpoint ? &checkpointImg : nullptr, m_dbg.get(), m_pageId, m_settings);
+      }
 
       params = m_settings->getParams(m_pageId);
 
@@ -344,19 +382,28 @@ FilterResultPtr Task::process(const TaskStatus& status, const FilterData& data,
 
         QDir().mkdir(foregroundDir);
         QDir().mkdir(backgroundDir);
-        if (!TiffWriter::writeImage(foregroundFilePath, outputImageWithForeground->getForegroundImage())
-            || !TiffWriter::writeImage(backgroundFilePath, outputImageWithForeground->getBackgroundImage())) {
-          invalidateParams = true;
-        }
+        std::vector<std::pair<QString, QImage>> layers{
+            {foregroundFilePath, outputImageWithForeground->getForegroundImage()},
+            {backgroundFilePath, outputImageWithForeground->getBackgroundImage()}};
 
         if (renderParams.originalBackground()) {
           auto* outputImageWithOrigBg = dynamic_cast<OutputImageWithOriginalBackground*>(outputImage.get());
 
           QDir().mkdir(originalBackgroundDir);
-          if (!TiffWriter::writeImage(originalBackgroundFilePath,
-                                      outputImageWithOrigBg->getOriginalBackgroundImage())) {
-            invalidateParams = true;
+          layers.emplace_back(originalBackgroundFilePath, outputImageWithOrigBg->getOriginalBackgroundImage());
+        }
+
+        // The layers are independent files, so they are written concurrently.
+        std::atomic<bool> layersWritten(true);
+        parallelForBands(static_cast<int>(layers.size()), 1, [&](const int begin, const int end) {
+          for (int i = begin; i < end; ++i) {
+            if (!TiffWriter::writeImage(layers[i].first, layers[i].second)) {
+              layersWritten.store(false);
+            }
           }
+        });
+        if (!layersWritten.load()) {
+          invalidateParams = true;
         }
       }
 
@@ -404,12 +451,23 @@ FilterResultPtr Task::process(const TaskStatus& status, const FilterData& data,
       }
     }
 
+    // A checkpoint we resumed from is still valid, as it doesn't depend on the steps we redid.
+    if (!resumeFromCheckpoint) {
+      if (checkpointImg.isNull()) {
+        QFile::remove(checkpointFilePath);
+      } else if (!QDir().mkpath(checkpointDir) || !TiffWriter::writeImage(checkpointFilePath, checkpointImg)) {
+        // Not having the checkpoint only makes the next change slower.
+        QFile::remove(checkpointFilePath);
+        checkpointImg = QImage();
+      }
+    }
+
     if (invalidateParams) {
       m_settings->removeOutputParams(m_pageId);
     } else {
       // Note that we can't reuse *_file_info objects
       // as we've just overwritten those files.
-      const OutputParams outParams(
+      OutputParams outParams(
           newOutputImageParams, OutputFileParams(sourceFileInfo), OutputFileParams(QFileInfo(outFilePath)),
           renderParams.splitOutput() ? OutputFileParams(QFileInfo(foregroundFilePath)) : OutputFileParams(),
           renderParams.splitOutput() ? OutputFileParams(QFileInfo(backgroundFilePath)) : OutputFileParams(),
@@ -418,6 +476,9 @@ FilterResultPtr Task::process(const TaskStatus& status, const FilterData& data,
           writeAutomask ? OutputFileParams(QFileInfo(automaskFilePath)) : OutputFileParams(),
           writeSpecklesFile ? OutputFileParams(QFileInfo(specklesFilePath)) : OutputFileParams(), newPictureZones,
           newFillZones);
+      if (!checkpointImg.isNull()) {
+        outParams.setCheckpointFileParams(OutputFileParams(QFileInfo(checkpointFilePath)));
+      }
 
       m_settings->setOutputParams(m_pageId, outParams);
     }
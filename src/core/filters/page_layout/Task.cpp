@@ -3,6 +3,8 @@
 
 #include "Task.h"
 
+#include <Tracer.h>
+
 #include <utility>
 
 #include "Dpm.h"
@@ -68,6 +70,7 @@ FilterResultPtr Task::process(const TaskStatus& status,
                               const FilterData& data,
                               const QRectF& pageRect,
                               const QRectF& contentRect) {
+  TRACE_SPAN("page_layout", "Task::process");
   status.throwIfCancelled();
 
   const QSizeF contentSizeMm(Utils::calcRectSizeMM(data.xform(), contentRect));
@@ -32,6 +32,7 @@
 #include "ContentSpanFinder.h"
 #include "DebugImages.h"
 #include "ImageMetadata.h"
+#include "ImagePyramid.h"
 #include "ImageTransformation.h"
 #include "OrthogonalRotation.h"
 #include "PageLayout.h"
@@ -173,7 +174,7 @@ int numPages(const LayoutType layoutType, const ImageTransformation& preXform) {
 }  // anonymous namespace
 
 PageLayout PageLayoutEstimator::estimatePageLayout(const LayoutType layoutType,
-                                                   const QImage& input,
+                                                   const ImagePyramid& pyramid,
                                                    const ImageTransformation& preXform,
                                                    const BinaryThreshold bwThreshold,
                                                    DebugImages* const dbg) {
@@ -181,11 +182,11 @@ PageLayout PageLayoutEstimator::estimatePageLayout(const LayoutType layoutType,
     return PageLayout(preXform.resultingRect());
   }
 
-  std::unique_ptr<PageLayout> layout(tryCutAtFoldingLine(layoutType, input, preXform, dbg));
+  std::unique_ptr<PageLayout> layout(tryCutAtFoldingLine(layoutType, pyramid, preXform, dbg));
   if (layout) {
     return *layout;
   }
-  return cutAtWhitespace(layoutType, input, preXform, bwThreshold, dbg);
+  return cutAtWhitespace(layoutType, pyramid, preXform, bwThreshold, dbg);
 }
 
 namespace {
@@ -216,8 +217,7 @@ class BadTwoPageSplitter {
  *        something other than AUTO_LAYOUT_TYPE, the returned
  *        layout will have the same type.  The layout type of
  *        SINGLE_PAGE_UNCUT is not handled here.
- * \param input The input image.  Will be converted to grayscale unless
- *        it's already grayscale.
+ * \param pyramid The pyramid of the grayscale input image.
  * \param preXform The logical transformation applied to the input image.
  *        The resulting page layout will be in transformed coordinates.
  * \param dbg An optional sink for debugging images.
@@ -225,7 +225,7 @@ class BadTwoPageSplitter {
  *         could not be detected.
  */
 std::unique_ptr<PageLayout> PageLayoutEstimator::tryCutAtFoldingLine(const LayoutType layoutType,
-                                                                     const QImage& input,
+                                                                     const ImagePyramid& pyramid,
                                                                      const ImageTransformation& preXform,
                                                                      DebugImages* const dbg) {
   const int numPages = page_split::numPages(layoutType, preXform);
@@ -234,13 +234,13 @@ std::unique_ptr<PageLayout> PageLayoutEstimator::tryCutAtFoldingLine(const Layou
   QTransform outToDownscaled;
 
   const int maxLines = 8;
-  std::vector<QLineF> lines(VertLineFinder::findLines(input, preXform, maxLines, dbg,
+  std::vector<QLineF> lines(VertLineFinder::findLines(pyramid, preXform, maxLines, dbg,
                                                       numPages == 1 ? &grayDownscaled : nullptr,
                                                       numPages == 1 ? &outToDownscaled : nullptr));
 
   std::sort(lines.begin(), lines.end(), CenterComparator());
 
-  const QRectF virtualImageRect(preXform.transform().mapRect(input.rect()));
+  const QRectF virtualImageRect(preXform.transform().mapRect(pyramid.image().rect()));
   const QPointF center(virtualImageRect.center());
 
   if (numPages == 1) {
@@ -288,8 +288,7 @@ std::unique_ptr<PageLayout> PageLayoutEstimator::tryCutAtFoldingLine(const Layou
  * \param layoutType The type of a layout to detect.  If set to
  *        something other than AUTO_LAYOUT_TYPE, the returned
  *        layout will have the same type.
- * \param input The input image.  Will be converted to grayscale unless
- *        it's already grayscale.
+ * \param pyramid The pyramid of the grayscale input image.
  * \param preXform The logical transformation applied to the input image.
  *        The resulting page layout will be in transformed coordinates.
  * \param bwThreshold The global binarization threshold for the input image.
@@ -298,14 +297,14 @@ std::unique_ptr<PageLayout> PageLayoutEstimator::tryCutAtFoldingLine(const Layou
  *         will return a PageLayout consistent with the layoutType requested.
  */
 PageLayout PageLayoutEstimator::cutAtWhitespace(const LayoutType layoutType,
-                                                const QImage& input,
+                                                const ImagePyramid& pyramid,
                                                 const ImageTransformation& preXform,
                                                 const BinaryThreshold bwThreshold,
                                                 DebugImages* const dbg) {
   QTransform xform;
 
   // Convert to B/W and rotate.
-  BinaryImage img(to300DpiBinary(input, xform, bwThreshold));
+  BinaryImage img(to300DpiBinary(pyramid, xform, bwThreshold));
   // Note: here we assume the only transformation applied
   // to the input image is orthogonal rotation.
   img = orthogonalRotation(img, preXform.preRotation().toDegrees());
@@ -433,23 +432,19 @@ PageLayout PageLayoutEstimator::cutAtWhitespaceDeskewed150(const LayoutType layo
   }
 }  // PageLayoutEstimator::cutAtWhitespaceDeskewed150
 
-imageproc::BinaryImage PageLayoutEstimator::to300DpiBinary(const QImage& img,
+imageproc::BinaryImage PageLayoutEstimator::to300DpiBinary(const ImagePyramid& pyramid,
                                                            QTransform& xform,
                                                            const BinaryThreshold binaryThreshold) {
+  const GrayImage& img = pyramid.image();
   const double xfactor = (300.0 * constants::DPI2DPM) / img.dotsPerMeterX();
   const double yfactor = (300.0 * constants::DPI2DPM) / img.dotsPerMeterY();
-  if ((std::fabs(xfactor - 1.0) < 0.1) && (std::fabs(yfactor - 1.0) < 0.1)) {
-    return BinaryImage(img, binaryThreshold);
+  if ((std::fabs(xfactor - 1.0) >= 0.1) || (std::fabs(yfactor - 1.0) >= 0.1)) {
+    QTransform scaleXform;
+    scaleXform.scale(xfactor, yfactor);
+    xform *= scaleXform;
   }
-
-  QTransform scaleXform;
-  scaleXform.scale(xfactor, yfactor);
-  xform *= scaleXform;
-  const QSize newSize(std::max(1, (int) std::ceil(xfactor * img.width())),
-                      std::max(1, (int) std::ceil(yfactor * img.height())));
-
-  const GrayImage newImage(scaleToGray(GrayImage(img), newSize));
-  return BinaryImage(newImage, binaryThreshold);
+  // The pyramid scales exactly the way we would, but shares the result.
+  return pyramid.binaryLevel(Dpi(300, 300), binaryThreshold);
 }
 
 BinaryImage PageLayoutEstimator::removeGarbageAnd2xDownscale(const BinaryImage& image, DebugImages* dbg) {
@@ -15,6 +15,7 @@
 class QRect;
 class QPoint;
 class QImage;
+class ImagePyramid;
 class QTransform;
 class ImageTransformation;
 class DebugImages;
@@ -36,8 +37,8 @@ class PageLayoutEstimator {
    * \param layoutType The type of a layout to detect.  If set to
    *        something other than Rule::AUTO_DETECT, the returned
    *        layout will have the same type.
-   * \param input The input image.  Will be converted to grayscale unless
-   *        it's already grayscale.
+   * \param pyramid The pyramid of the grayscale input image.  The stages of
+   *        the estimation take the reduced resolution levels from it.
    * \param preXform The logical transformation applied to the input image.
    *        The resulting page layout will be in transformed coordinates.
    * \param bwThreshold The global binarization threshold for the
@@ -47,19 +48,19 @@ class PageLayoutEstimator {
    *         requested layout type.
    */
   static PageLayout estimatePageLayout(LayoutType layoutType,
-                                       const QImage& input,
+                                       const ImagePyramid& pyramid,
                                        const ImageTransformation& preXform,
                                        imageproc::BinaryThreshold bwThreshold,
                                        DebugImages* dbg = nullptr);
 
  private:
   static std::unique_ptr<PageLayout> tryCutAtFoldingLine(LayoutType layoutType,
-                                                         const QImage& input,
+                                                         const ImagePyramid& pyramid,
                                                          const ImageTransformation& preXform,
                                                          DebugImages* dbg);
 
   static PageLayout cutAtWhitespace(LayoutType layoutType,
-                                    const QImage& input,
+                                    const ImagePyramid& pyramid,
                                     const ImageTransformation& preXform,
                                     imageproc::BinaryThreshold bwThreshold,
                                     DebugImages* dbg);
@@ -71,7 +72,7 @@ class PageLayoutEstimator {
                                                bool rightOffcut,
                                                DebugImages* dbg);
 
-  static imageproc::BinaryImage to300DpiBinary(const QImage& img,
+  static imageproc::BinaryImage to300DpiBinary(const ImagePyramid& pyramid,
                                                QTransform& xform,
                                                imageproc::BinaryThreshold threshold);
 
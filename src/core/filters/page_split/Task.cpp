@@ -3,6 +3,7 @@
 
 #include "Task.h"
 
+#include <Tracer.h>
 #include <UnitsProvider.h>
 
 #include <QPainterPath>
@@ -104,6 +105,7 @@ Task::Task(std::shared_ptr<Filter> filter,
 Task::~Task() = default;
 
 FilterResultPtr Task::process(const TaskStatus& status, const FilterData& data) {
+  TRACE_SPAN("page_split", "Task::process");
   status.throwIfCancelled();
 
   Settings::Record record(m_settings->getPageRecord(m_pageInfo.imageId()));
@@ -118,7 +120,7 @@ FilterResultPtr Task::process(const TaskStatus& status, const FilterData& data)
 
     if (!params || !deps.compatibleWith(*params)) {
       if (!params || (record.combinedLayoutType() == AUTO_LAYOUT_TYPE)) {
-        newLayout = PageLayoutEstimator::estimatePageLayout(record.combinedLayoutType(), data.grayImage(), data.xform(),
+        newLayout = PageLayoutEstimator::estimatePageLayout(record.combinedLayoutType(), data.pyramid(), data.xform(),
                                                             data.bwThreshold(), m_dbg.get());
 
         status.throwIfCancelled();
@@ -184,6 +186,9 @@ FilterResultPtr Task::process(const TaskStatus& status, const FilterData& data)
   m_pages->setLayoutTypeFor(m_pageInfo.imageId(), toPageLayoutType(layout));
 
   if (m_nextTask != nullptr) {
+    // The next stages use other levels, if any.
+    data.pyramid().releaseLevels();
+
     ImageTransformation newXform(data.xform());
     const QPolygonF pagePoly(layout.pageOutline(m_pageInfo.id().subPage()).toPolygon());
     const QPolygonF merged(intersectPreCropWithPageOutline(pagePoly, newXform.preCropArea()));
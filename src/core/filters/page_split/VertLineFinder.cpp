@@ -17,12 +17,13 @@
 #include <cmath>
 
 #include "DebugImages.h"
+#include "ImagePyramid.h"
 #include "ImageTransformation.h"
 
 namespace page_split {
 using namespace imageproc;
 
-std::vector<QLineF> VertLineFinder::findLines(const QImage& image,
+std::vector<QLineF> VertLineFinder::findLines(const ImagePyramid& pyramid,
                                               const ImageTransformation& xform,
                                               const int maxLines,
                                               DebugImages* dbg,
@@ -39,8 +40,8 @@ std::vector<QLineF> VertLineFinder::findLines(const QImage& image,
     targetRect.setHeight(1);
   }
 
-  const GrayImage gray100(transformToGray(image, xform100dpi.transform(), targetRect,
-                                          OutsidePixels::assumeWeakColor(Qt::black), QSizeF(5.0, 5.0)));
+  const GrayImage gray100(pyramid.transformToGray(Dpi(dpi, dpi), xform100dpi.transform(), targetRect,
+                                                  OutsidePixels::assumeWeakColor(Qt::black), QSizeF(5.0, 5.0)));
   if (dbg) {
     dbg->add(gray100, "gray100");
   }
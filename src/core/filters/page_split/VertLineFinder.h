@@ -12,6 +12,7 @@
 class QLineF;
 class QImage;
 class ImageTransformation;
+class ImagePyramid;
 class DebugImages;
 
 namespace imageproc {
@@ -21,7 +22,7 @@ class GrayImage;
 namespace page_split {
 class VertLineFinder {
  public:
-  static std::vector<QLineF> findLines(const QImage& image,
+  static std::vector<QLineF> findLines(const ImagePyramid& pyramid,
                                        const ImageTransformation& xform,
                                        int maxLines,
                                        DebugImages* dbg = nullptr,
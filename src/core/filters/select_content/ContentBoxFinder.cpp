@@ -30,6 +30,7 @@
 #include "Despeckle.h"
 #include "FilterData.h"
 #include "TaskStatus.h"
+#include "Utils.h"
 
 namespace select_content {
 using namespace imageproc;
@@ -79,12 +80,7 @@ QRectF ContentBoxFinder::findContentBox(const TaskStatus& status,
     return QRectF();
   }
 
-  const GrayImage dataGrayImage = data.grayImageBlackOnWhite();
-  const uint8_t darkestGrayLevel = imageproc::darkestGrayLevel(dataGrayImage);
-  const QColor outsideColor(darkestGrayLevel, darkestGrayLevel, darkestGrayLevel);
-
-  QImage gray150(transformToGray(dataGrayImage, xform150dpi.transform(), xform150dpi.resultingRect().toRect(),
-                                 OutsidePixels::assumeColor(outsideColor)));
+  QImage gray150(Utils::transformToGray150(data, xform150dpi));
   // Note that we fill new areas that appear as a result of
   // rotation with black, not white.  Filling them with white
   // may be bad for detecting the shadow around the page.
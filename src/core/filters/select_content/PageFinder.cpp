@@ -13,6 +13,7 @@
 #include "DebugImages.h"
 #include "FilterData.h"
 #include "TaskStatus.h"
+#include "Utils.h"
 
 namespace select_content {
 using namespace imageproc;
@@ -40,12 +41,7 @@ QRectF PageFinder::findPageBox(const TaskStatus& status,
   std::cout << "expWidth = " << expWidth << "; expHeight" << expHeight << std::endl;
 #endif
 
-  const GrayImage dataGrayImage = data.grayImageBlackOnWhite();
-  const uint8_t darkestGrayLevel = imageproc::darkestGrayLevel(dataGrayImage);
-  const QColor outsideColor(darkestGrayLevel, darkestGrayLevel, darkestGrayLevel);
-
-  QImage gray150(transformToGray(dataGrayImage, xform150dpi.transform(), xform150dpi.resultingRect().toRect(),
-                                 OutsidePixels::assumeColor(outsideColor)));
+  QImage gray150(Utils::transformToGray150(data, xform150dpi));
   if (dbg) {
     dbg->add(gray150, "gray150");
   }
@@ -3,6 +3,7 @@
 
 #include "Task.h"
 
+#include <Tracer.h>
 #include <UnitsProvider.h>
 
 #include <iostream>
@@ -70,6 +71,7 @@ Task::Task(std::shared_ptr<Filter> filter,
 Task::~Task() = default;
 
 FilterResultPtr Task::process(const TaskStatus& status, const FilterData& data) {
+  TRACE_SPAN("select_content", "Task::process");
   status.throwIfCancelled();
 
   std::unique_ptr<Params> params(m_settings->getPageParams(m_pageId));
@@ -165,6 +167,8 @@ FilterResultPtr Task::process(const TaskStatus& status, const FilterData& data)
   status.throwIfCancelled();
 
   if (m_nextTask) {
+    // This is the last stage that uses the pyramid levels.
+    data.pyramid().releaseLevels();
     return m_nextTask->process(status, FilterData(data, data.xform()), uiData.pageRect(), uiData.contentRect());
   } else {
     return std::make_shared<UiUpdater>(m_filter, m_pageId, std::move(m_dbg), data.origImage(), data.xform(),
@@ -7,6 +7,10 @@
 #include <core/DefaultParamsProvider.h>
 #include <core/UnitsConverter.h>
 
+#include <Transform.h>
+
+#include "FilterData.h"
+#include "ImageTransformation.h"
 #include "Params.h"
 
 using namespace select_content;
@@ -26,3 +30,20 @@ Params Utils::buildDefaultParams(const Dpi& dpi) {
                 selectContentParams.isContentDetectEnabled() ? MODE_AUTO : MODE_DISABLED,
                 selectContentParams.getPageDetectMode(), selectContentParams.isFineTuneCorners());
 }
+
+imageproc::GrayImage Utils::transformToGray150(const FilterData& data, const ImageTransformation& xform150dpi) {
+  using namespace imageproc;
+
+  const uint8_t darkestGrayLevel = data.darkestGrayLevelBlackOnWhite();
+  // We transform the image as is and then invert the much smaller result, if necessary.
+  const int outsideLevel = data.isBlackOnWhite() ? darkestGrayLevel : 255 - darkestGrayLevel;
+  const QColor outsideColor(outsideLevel, outsideLevel, outsideLevel);
+
+  GrayImage gray150(data.pyramid().transformToGray(Dpi(150, 150), xform150dpi.transform(),
+                                                   xform150dpi.resultingRect().toRect(),
+                                                   OutsidePixels::assumeColor(outsideColor)));
+  if (!data.isBlackOnWhite()) {
+    gray150.invert();
+  }
+  return gray150;
+}
@@ -5,6 +5,12 @@
 #define SCANTAILOR_SELECT_CONTENT_UTILS_H_
 
 class Dpi;
+class FilterData;
+class ImageTransformation;
+
+namespace imageproc {
+class GrayImage;
+}
 
 namespace select_content {
 class Params;
@@ -14,6 +20,14 @@ class Utils {
   Utils() = delete;
 
   static Params buildDefaultParams(const Dpi& dpi);
+
+  /**
+   * \brief Transforms the black on white version of the page image by \p xform150dpi.
+   *
+   * Areas outside of the image are filled with the darkest gray level of the image.
+   * The transformation starts from the reduced image in the pyramid of \p data.
+   */
+  static imageproc::GrayImage transformToGray150(const FilterData& data, const ImageTransformation& xform150dpi);
 };
 }  // namespace select_content
 
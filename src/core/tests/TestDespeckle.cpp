@@ -0,0 +1,133 @@
+// Copyright (C) 2019  Joseph Artsimovich <joseph.artsimovich@gmail.com>, 4lex4 <4lex49@zoho.com>
+// Use of this source code is governed by the GNU GPLv3 license that can be found in the LICENSE file.
+
+#include <BinaryImage.h>
+#include <Despeckle.h>
+#include <Dpi.h>
+#include <NullTaskStatus.h>
+#include <RasterOp.h>
+
+#include <boost/test/unit_test.hpp>
+#include <cstdint>
+
+using namespace imageproc;
+
+namespace {
+/**
+ * Lines of "words" with speckles of various sizes scattered around,
+ * some of them in clusters, so that all the rules of despeckling get exercised.
+ */
+BinaryImage makePage(const int width, const int height) {
+  BinaryImage image(width, height, WHITE);
+  for (int y = 20; y + 12 < height; y += 30) {
+    for (int x = 15; x + 40 < width; x += 55) {
+      image.fill(QRect(x, y, 40, 3), BLACK);
+      image.fill(QRect(x + (y % 7) * 4, y, 3, 12), BLACK);
+    }
+  }
+
+  uint32_t seed = 12345;
+  const auto random = [&seed](const int range) {
+    seed = seed * 1103515245u + 12345u;
+    return static_cast<int>((seed >> 16) % range);
+  };
+  for (int i = 0; i < 400; ++i) {
+    const int size = 1 + random(5);
+    const QRect speckle(random(width - size), random(height - size), size, 1 + random(size));
+    image.fill(speckle, BLACK);
+    if (random(3) == 0) {
+      // A cluster of smaller speckles around this one.
+      for (int j = 0; j < 4; ++j) {
+        const QPoint offset(random(15) - 7, random(15) - 7);
+        image.fill(QRect(speckle.center() + offset, QSize(1, 1)).intersected(image.rect()), BLACK);
+      }
+    }
+  }
+  return image;
+}
+
+/**
+ * A hash of the positions of the black pixels, in raster order.
+ */
+uint32_t blackPixelsHash(const BinaryImage& image) {
+  const uint32_t msb = uint32_t(1) << 31;
+  uint32_t hash = 0;
+  const uint32_t* line = image.data();
+  for (int y = 0; y < image.height(); ++y, line += image.wordsPerLine()) {
+    for (int x = 0; x < image.width(); ++x) {
+      if (line[x >> 5] & (msb >> (x & 31))) {
+        hash = hash * 31 + static_cast<uint32_t>(y * image.width() + x);
+      }
+    }
+  }
+  return hash;
+}
+
+BinaryImage expectedSpeckles(const BinaryImage& image, const Dpi& dpi, const double level) {
+  BinaryImage speckles(Despeckle::despeckle(image, dpi, level, NullTaskStatus()));
+  rasterOp<RopSubtract<RopSrc, RopDst>>(speckles, image);
+  return speckles;
+}
+}  // namespace
+
+BOOST_AUTO_TEST_SUITE(CoreDespeckleTestSuite)
+
+BOOST_AUTO_TEST_CASE(test_analysis_matches_despeckle) {
+  const BinaryImage image(makePage(700, 500));
+  const Dpi dpi(300, 300);
+  const DespeckleAnalysis analysis(image, dpi, NullTaskStatus());
+
+  for (int tenths = DespeckleAnalysis::MIN_LEVEL_TENTHS; tenths <= DespeckleAnalysis::MAX_LEVEL_TENTHS; ++tenths) {
+    const double level = 0.1 * tenths;
+    BOOST_REQUIRE(DespeckleAnalysis::covers(level));
+    BOOST_CHECK_MESSAGE(analysis.speckles(level) == expectedSpeckles(image, dpi, level), "level " << level);
+  }
+
+  // Make sure the test image is not trivial.
+  const BinaryImage cautious(analysis.speckles(0.1 * DespeckleAnalysis::MIN_LEVEL_TENTHS));
+  const BinaryImage aggressive(analysis.speckles(0.1 * DespeckleAnalysis::MAX_LEVEL_TENTHS));
+  BOOST_CHECK(cautious.countBlackPixels() > 0);
+  BOOST_CHECK(aggressive.countBlackPixels() > cautious.countBlackPixels());
+}
+
+BOOST_AUTO_TEST_CASE(test_same_as_before_analysis) {
+  // The speckles the despeckling removed from the test page before it was
+  // split into the analysis and the per-level decision.
+  struct Expected {
+    int tenths;
+    int numPixels;
+    uint32_t hash;
+  };
+  const Expected expected[] = {{5, 18, 2638786095u},   {10, 79, 366658387u},    {15, 120, 3582731712u},
+                               {20, 214, 3900695278u}, {25, 343, 1222263163u},  {30, 613, 110623864u},
+                               {35, 1123, 1503013027u}};
+
+  const BinaryImage image(makePage(700, 500));
+  const Dpi dpi(300, 300);
+  const DespeckleAnalysis analysis(image, dpi, NullTaskStatus());
+  for (const Expected& exp : expected) {
+    const double level = 0.1 * exp.tenths;
+    const BinaryImage speckles(expectedSpeckles(image, dpi, level));
+    BOOST_CHECK_MESSAGE(speckles.countBlackPixels() == exp.numPixels, "level " << level);
+    BOOST_CHECK_MESSAGE(blackPixelsHash(speckles) == exp.hash, "level " << level);
+    BOOST_CHECK_MESSAGE(blackPixelsHash(analysis.speckles(level)) == exp.hash, "level " << level);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(test_white_image) {
+  const BinaryImage image(100, 50, WHITE);
+  const DespeckleAnalysis analysis(image, Dpi(300, 300), NullTaskStatus());
+  const BinaryImage speckles(analysis.speckles(0.1 * 10));
+  BOOST_CHECK(speckles.size() == image.size());
+  BOOST_CHECK_EQUAL(speckles.countBlackPixels(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(test_covered_levels) {
+  BOOST_CHECK(DespeckleAnalysis::covers(0.1 * 5));
+  BOOST_CHECK(DespeckleAnalysis::covers(0.1 * 35));
+  BOOST_CHECK(!DespeckleAnalysis::covers(0));
+  BOOST_CHECK(!DespeckleAnalysis::covers(0.1 * 36));
+  BOOST_CHECK(!DespeckleAnalysis::covers(1.05));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,71 @@
+// Copyright (C) 2019  Joseph Artsimovich <joseph.artsimovich@gmail.com>, 4lex4 <4lex49@zoho.com>
+// Use of this source code is governed by the GNU GPLv3 license that can be found in the LICENSE file.
+
+#include <ImageMetadataScanner.h>
+
+#include <QFile>
+#include <QImage>
+#include <QTemporaryDir>
+#include <boost/test/unit_test.hpp>
+
+namespace {
+QString writePng(const QTemporaryDir& dir, const QString& name, const QSize& size) {
+  QImage image(size, QImage::Format_RGB32);
+  image.fill(Qt::white);
+  image.setDotsPerMeterX(11811);
+  image.setDotsPerMeterY(11811);
+  const QString path = dir.path() + '/' + name;
+  image.save(path, "PNG");
+  return path;
+}
+}  // namespace
+
+BOOST_AUTO_TEST_SUITE(CoreImageMetadataScannerTestSuite)
+
+BOOST_AUTO_TEST_CASE(test_scan_and_wait) {
+  QTemporaryDir dir;
+  BOOST_REQUIRE(dir.isValid());
+
+  std::vector<QString> paths;
+  for (int i = 0; i < 20; ++i) {
+    paths.push_back(writePng(dir, QString("page%1.png").arg(i), QSize(10 + i, 20)));
+  }
+  const QString brokenPath = dir.path() + "/broken.png";
+  {
+    QFile file(brokenPath);
+    file.open(QIODevice::WriteOnly);
+    file.write("not an image");
+  }
+  paths.push_back(brokenPath);
+  paths.push_back(dir.path() + "/missing.png");
+
+  const std::vector<ImageMetadataScanner::Result> results(ImageMetadataScanner::scanAndWait(paths));
+  BOOST_REQUIRE_EQUAL(results.size(), paths.size());
+  for (int i = 0; i < 20; ++i) {
+    const ImageMetadataScanner::Result& result = results[i];
+    BOOST_CHECK(result.filePath == paths[i]);
+    BOOST_REQUIRE_EQUAL(result.status, ImageMetadataLoader::LOADED);
+    BOOST_REQUIRE_EQUAL(result.perPageMetadata.size(), 1u);
+    BOOST_CHECK(result.perPageMetadata.front().size() == QSize(10 + i, 20));
+  }
+  BOOST_CHECK(results[20].status != ImageMetadataLoader::LOADED);
+  BOOST_CHECK(results[20].perPageMetadata.empty());
+  BOOST_CHECK(results[21].status != ImageMetadataLoader::LOADED);
+}
+
+BOOST_AUTO_TEST_CASE(test_modified_file_is_probed_again) {
+  QTemporaryDir dir;
+  BOOST_REQUIRE(dir.isValid());
+
+  const std::vector<QString> paths{writePng(dir, "page.png", QSize(30, 40))};
+  BOOST_CHECK(ImageMetadataScanner::scanAndWait(paths).front().perPageMetadata.front().size() == QSize(30, 40));
+  // The cached result.
+  BOOST_CHECK(ImageMetadataScanner::scanAndWait(paths).front().perPageMetadata.front().size() == QSize(30, 40));
+
+  // A different size of the file invalidates the cached entry, even if
+  // the modification time happens to be the same.
+  writePng(dir, "page.png", QSize(300, 400));
+  BOOST_CHECK(ImageMetadataScanner::scanAndWait(paths).front().perPageMetadata.front().size() == QSize(300, 400));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,180 @@
+// Copyright (C) 2019  Joseph Artsimovich <joseph.artsimovich@gmail.com>, 4lex4 <4lex49@zoho.com>
+// Use of this source code is governed by the GNU GPLv3 license that can be found in the LICENSE file.
+
+#include <BinaryImage.h>
+#include <Dpi.h>
+#include <Dpm.h>
+#include <GrayImage.h>
+#include <Grayscale.h>
+#include <ImageId.h>
+#include <ImagePyramid.h>
+#include <IntermediateImageCache.h>
+#include <Scale.h>
+
+#include <QFile>
+#include <QTemporaryDir>
+#include <boost/test/unit_test.hpp>
+#include <memory>
+
+using namespace imageproc;
+
+namespace {
+// Slightly above 600 and 400 DPI, so that the levels have round sizes.
+const Dpm DPM_600(23623, 23623);
+const Dpm DPM_400(15749, 15749);
+
+GrayImage makeImage(const int width, const int height) {
+  GrayImage image(QSize(width, height));
+  uint8_t* line = image.data();
+  for (int y = 0; y < height; ++y, line += image.stride()) {
+    for (int x = 0; x < width; ++x) {
+      line[x] = static_cast<uint8_t>((x * 7 + y * 13) & 0xff);
+    }
+  }
+  return image;
+}
+}  // namespace
+
+BOOST_AUTO_TEST_SUITE(CoreImagePyramidTestSuite)
+
+BOOST_AUTO_TEST_CASE(test_level_sizes) {
+  const GrayImage image(makeImage(600, 900));
+  const ImagePyramid pyramid(image, DPM_600);
+
+  const GrayImage level300(pyramid.grayLevel(Dpi(300, 300)));
+  BOOST_CHECK_EQUAL(level300.width(), 300);
+  BOOST_CHECK_EQUAL(level300.height(), 450);
+  BOOST_CHECK(level300 == scaleToGray(image, QSize(300, 450)));
+
+  // Within 10% of the original resolution, the original is returned.
+  BOOST_CHECK(pyramid.grayLevel(Dpi(580, 580)) == image);
+  // grayLevelNotAbove() never upscales.
+  BOOST_CHECK(pyramid.grayLevelNotAbove(Dpi(1200, 1200)) == image);
+  BOOST_CHECK(pyramid.grayLevelNotAbove(Dpi(150, 150)).size() == QSize(150, 225));
+}
+
+BOOST_AUTO_TEST_CASE(test_levels_are_shared) {
+  const ImagePyramid pyramid(makeImage(400, 400), DPM_400);
+
+  const GrayImage first(pyramid.grayLevel(Dpi(100, 100)));
+  const GrayImage second(pyramid.grayLevel(Dpi(100, 100)));
+  BOOST_CHECK(first.data() == second.data());
+
+  const BinaryImage bw(pyramid.binaryLevel(Dpi(100, 100), BinaryThreshold(128)));
+  BOOST_CHECK(bw == BinaryImage(first, BinaryThreshold(128)));
+  BOOST_CHECK(pyramid.binaryLevel(Dpi(100, 100), BinaryThreshold(128)).data() == bw.data());
+}
+
+BOOST_AUTO_TEST_CASE(test_gray_level_range) {
+  GrayImage image(QSize(300, 200));
+  image.fill(128);
+  image.data()[17 * image.stride() + 299] = 3;
+  image.data()[199 * image.stride()] = 250;
+  const ImagePyramid pyramid(image, DPM_600);
+
+  BOOST_CHECK_EQUAL(int(pyramid.grayLevelRange().first), int(darkestGrayLevel(image)));
+  BOOST_CHECK_EQUAL(int(pyramid.grayLevelRange().second), 250);
+  BOOST_CHECK_EQUAL(255 - pyramid.grayLevelRange().second, int(darkestGrayLevel(image.inverted())));
+}
+
+BOOST_AUTO_TEST_CASE(test_orig_to_level) {
+  const ImagePyramid pyramid(makeImage(400, 200), DPM_400);
+  const GrayImage level(pyramid.grayLevel(Dpi(100, 100)));
+  const QTransform xform(pyramid.origToLevel(level));
+  BOOST_CHECK_CLOSE(xform.m11(), 0.25, 1e-9);
+  BOOST_CHECK_CLOSE(xform.m22(), 0.25, 1e-9);
+  BOOST_CHECK(pyramid.origToLevel(pyramid.image()).isIdentity());
+}
+
+BOOST_AUTO_TEST_CASE(test_rotated_transform_uses_full_resolution) {
+  const GrayImage image(makeImage(400, 400));
+  const ImagePyramid pyramid(image, DPM_400);
+
+  // A deskew-like rotation combined with scaling to 100 DPI.
+  QTransform xform;
+  xform.scale(0.25, 0.25);
+  xform.rotate(2.5);
+  const QRect dstRect(0, 0, 100, 100);
+  const OutsidePixels outside(OutsidePixels::assumeColor(Qt::black));
+
+  const GrayImage expected(transformToGray(image, xform, dstRect, outside));
+  BOOST_CHECK(pyramid.transformToGray(Dpi(100, 100), xform, dstRect, outside) == expected);
+}
+
+BOOST_AUTO_TEST_CASE(test_axis_aligned_transform_uses_level) {
+  const ImagePyramid pyramid(makeImage(400, 200), DPM_400);
+
+  // Scaling to 100 DPI and an orthogonal rotation.
+  QTransform xform;
+  xform.rotate(90);
+  xform.scale(0.25, 0.25);
+  xform *= QTransform::fromTranslate(50, 0);
+  const QRect dstRect(0, 0, 50, 100);
+  const OutsidePixels outside(OutsidePixels::assumeColor(Qt::black));
+
+  const GrayImage level(pyramid.grayLevel(Dpi(100, 100)));
+  const QTransform levelToDst(pyramid.origToLevel(level).inverted() * xform);
+  const GrayImage expected(transformToGray(level, levelToDst, dstRect, outside, QSizeF(0.225, 0.225)));
+  BOOST_CHECK(pyramid.transformToGray(Dpi(100, 100), xform, dstRect, outside) == expected);
+}
+
+BOOST_AUTO_TEST_CASE(test_release_levels) {
+  const ImagePyramid pyramid(makeImage(400, 400), DPM_400);
+
+  const GrayImage before(pyramid.grayLevel(Dpi(100, 100)));
+  pyramid.releaseLevels();
+  const GrayImage after(pyramid.grayLevel(Dpi(100, 100)));
+  // Recomputed, rather than taken from the cache.
+  BOOST_CHECK(after.data() != before.data());
+  BOOST_CHECK(after == before);
+}
+
+BOOST_AUTO_TEST_CASE(test_derived_images_are_cached_on_disk) {
+  QTemporaryDir dir;
+  BOOST_REQUIRE(dir.isValid());
+  const QString sourcePath = dir.path() + "/source.png";
+  {
+    QFile source(sourcePath);
+    source.open(QIODevice::WriteOnly);
+    source.write("source");
+  }
+  const ImageId imageId(sourcePath);
+  auto cache = std::make_shared<IntermediateImageCache>(dir.path() + "/cache", 1024 * 1024);
+
+  QTransform xform;
+  xform.scale(0.25, 0.25);
+  xform.rotate(1.5);
+  const QRect dstRect(0, 0, 100, 100);
+  const OutsidePixels outside(OutsidePixels::assumeColor(Qt::black));
+
+  const ImagePyramid pyramid(makeImage(400, 400), DPM_400, imageId, cache);
+  const GrayImage transformed(pyramid.transformToGray(Dpi(100, 100), xform, dstRect, outside));
+  const BinaryImage bw(pyramid.binaryLevel(Dpi(100, 100), BinaryThreshold(128)));
+
+  // Another page load of the same file gets these from the cache, rather
+  // than computing them from its own image, which is blank here to tell them apart.
+  GrayImage blank(QSize(400, 400));
+  blank.fill(255);
+  const ImagePyramid reloaded(blank, DPM_400, imageId, cache);
+  BOOST_CHECK(reloaded.transformToGray(Dpi(100, 100), xform, dstRect, outside) == transformed);
+  BOOST_CHECK(reloaded.binaryLevel(Dpi(100, 100), BinaryThreshold(128)) == bw);
+  // Different parameters are different entries.
+  BOOST_CHECK(reloaded.binaryLevel(Dpi(100, 100), BinaryThreshold(100)) == BinaryImage(QSize(100, 100), WHITE));
+
+  int computed = 0;
+  const auto compute = [&computed]() {
+    ++computed;
+    QImage image(8, 8, QImage::Format_Mono);
+    image.fill(0);
+    return image;
+  };
+  pyramid.derivedImage("stage", "params", compute);
+  reloaded.derivedImage("stage", "params", compute);
+  BOOST_CHECK_EQUAL(computed, 1);
+  // Without a cache, it's always computed.
+  const ImagePyramid uncached(blank, DPM_400);
+  uncached.derivedImage("stage", "params", compute);
+  BOOST_CHECK_EQUAL(computed, 2);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,150 @@
+// Copyright (C) 2019  Joseph Artsimovich <joseph.artsimovich@gmail.com>, 4lex4 <4lex49@zoho.com>
+// Use of this source code is governed by the GNU GPLv3 license that can be found in the LICENSE file.
+
+#include <ImageId.h>
+#include <IntermediateImageCache.h>
+
+#include <QFile>
+#include <QImage>
+#include <QTemporaryDir>
+#include <boost/test/unit_test.hpp>
+#include <cstdlib>
+
+namespace {
+QImage makeGrayImage(const int width, const int height, const int seed) {
+  QImage image(width, height, QImage::Format_Indexed8);
+  QVector<QRgb> palette(256);
+  for (int i = 0; i < 256; ++i) {
+    palette[i] = qRgb(i, i, i);
+  }
+  image.setColorTable(palette);
+  for (int y = 0; y < height; ++y) {
+    uchar* line = image.scanLine(y);
+    for (int x = 0; x < width; ++x) {
+      line[x] = static_cast<uchar>((x * 7 + y * 13 + seed) & 0xff);
+    }
+  }
+  image.setDotsPerMeterX(11811);
+  image.setDotsPerMeterY(11811);
+  return image;
+}
+
+QImage makeNoiseImage(const int width, const int height, const int seed) {
+  QImage image(makeGrayImage(width, height, seed));
+  srand(seed);
+  for (int y = 0; y < height; ++y) {
+    uchar* line = image.scanLine(y);
+    for (int x = 0; x < width; ++x) {
+      line[x] = static_cast<uchar>(rand() & 0xff);
+    }
+  }
+  return image;
+}
+
+ImageId makeSourceFile(const QTemporaryDir& dir, const QString& name) {
+  const QString path = dir.path() + '/' + name;
+  QFile file(path);
+  file.open(QIODevice::WriteOnly);
+  file.write("source");
+  return ImageId(path);
+}
+}  // namespace
+
+BOOST_AUTO_TEST_SUITE(CoreIntermediateImageCacheTestSuite)
+
+BOOST_AUTO_TEST_CASE(test_store_and_load) {
+  QTemporaryDir dir;
+  BOOST_REQUIRE(dir.isValid());
+  const ImageId source = makeSourceFile(dir, "a.png");
+  const QImage gray = makeGrayImage(37, 23, 0);
+  QImage color(19, 11, QImage::Format_RGB32);
+  color.fill(qRgb(10, 20, 30));
+
+  IntermediateImageCache cache(dir.path() + "/cache", 1024 * 1024);
+  BOOST_CHECK(cache.load(source, "stage").isNull());
+  BOOST_REQUIRE(cache.store(source, "stage", "params", gray));
+  BOOST_REQUIRE(cache.store(source, IntermediateImageCache::DECODED_IMAGE, QByteArray(), color));
+
+  BOOST_CHECK(cache.load(source, "stage", "params") == gray);
+  BOOST_CHECK(cache.load(source, "stage", "other params").isNull());
+  BOOST_CHECK(cache.load(source, IntermediateImageCache::DECODED_IMAGE) == color);
+
+  // The entries survive re-creating the cache.
+  IntermediateImageCache reopened(dir.path() + "/cache", 1024 * 1024);
+  BOOST_CHECK(reopened.load(source, "stage", "params") == gray);
+  BOOST_CHECK_EQUAL(reopened.totalSize(), cache.totalSize());
+}
+
+BOOST_AUTO_TEST_CASE(test_source_modification_invalidates) {
+  QTemporaryDir dir;
+  BOOST_REQUIRE(dir.isValid());
+  const ImageId source = makeSourceFile(dir, "a.png");
+
+  IntermediateImageCache cache(dir.path() + "/cache", 1024 * 1024);
+  BOOST_REQUIRE(cache.store(source, "stage", QByteArray(), makeGrayImage(10, 10, 0)));
+
+  QFile file(source.filePath());
+  file.open(QIODevice::Append);
+  file.write("modified");
+  file.close();
+
+  BOOST_CHECK(cache.load(source, "stage").isNull());
+}
+
+BOOST_AUTO_TEST_CASE(test_lru_eviction) {
+  QTemporaryDir dir;
+  BOOST_REQUIRE(dir.isValid());
+  const ImageId source = makeSourceFile(dir, "a.png");
+  // Noise doesn't compress, so these take about 10000 bytes each.
+  const QImage img1 = makeNoiseImage(100, 100, 1);
+  const QImage img2 = makeNoiseImage(100, 100, 2);
+  const QImage img3 = makeNoiseImage(100, 100, 3);
+
+  // Room for two images, but not for three.
+  IntermediateImageCache cache(dir.path() + "/cache", 25000);
+  BOOST_REQUIRE(cache.store(source, "1", QByteArray(), img1));
+  BOOST_REQUIRE(cache.store(source, "2", QByteArray(), img2));
+  // Now the 2nd one is the least recently used.
+  BOOST_CHECK(cache.load(source, "1") == img1);
+  BOOST_REQUIRE(cache.store(source, "3", QByteArray(), img3));
+
+  BOOST_CHECK(cache.load(source, "1") == img1);
+  BOOST_CHECK(cache.load(source, "2").isNull());
+  BOOST_CHECK(cache.load(source, "3") == img3);
+  BOOST_CHECK(cache.totalSize() <= 25000);
+}
+
+BOOST_AUTO_TEST_CASE(test_mono_image_stays_small) {
+  QTemporaryDir dir;
+  BOOST_REQUIRE(dir.isValid());
+  const ImageId source = makeSourceFile(dir, "a.tif");
+  QImage mono(2000, 3000, QImage::Format_Mono);
+  mono.fill(1);
+  for (int y = 100; y < 2900; y += 40) {
+    for (int x = 100; x < 1900; ++x) {
+      mono.setPixel(x, y, 0);
+    }
+  }
+
+  IntermediateImageCache cache(dir.path() + "/cache", 1024 * 1024);
+  BOOST_REQUIRE(cache.store(source, IntermediateImageCache::DECODED_IMAGE, QByteArray(), mono));
+  const QImage loaded = cache.load(source, IntermediateImageCache::DECODED_IMAGE);
+  BOOST_CHECK_EQUAL(loaded.format(), QImage::Format_Mono);
+  BOOST_CHECK(loaded == mono);
+  // Much less than the 750000 bytes of the bits, let alone 6 MB of a grayscale version.
+  BOOST_CHECK_LT(cache.totalSize(), 100000);
+}
+
+BOOST_AUTO_TEST_CASE(test_too_large_image_is_not_stored) {
+  QTemporaryDir dir;
+  BOOST_REQUIRE(dir.isValid());
+  const ImageId source = makeSourceFile(dir, "a.png");
+
+  IntermediateImageCache cache(dir.path() + "/cache", 25000);
+  BOOST_REQUIRE(cache.store(source, "1", QByteArray(), makeNoiseImage(100, 100, 1)));
+  BOOST_CHECK(!cache.store(source, "2", QByteArray(), makeNoiseImage(200, 200, 2)));
+  BOOST_CHECK(!cache.load(source, "1").isNull());
+  BOOST_CHECK(cache.load(source, "2").isNull());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,62 @@
+// Copyright (C) 2019  Joseph Artsimovich <joseph.artsimovich@gmail.com>, 4lex4 <4lex49@zoho.com>
+// Use of this source code is governed by the GNU GPLv3 license that can be found in the LICENSE file.
+
+#include <Dpi.h>
+#include <ImageMetadata.h>
+#include <MemoryBudget.h>
+#include <PageMemoryEstimate.h>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_AUTO_TEST_SUITE(MemoryBudgetTestSuite)
+
+BOOST_AUTO_TEST_CASE(test_reservations_fit_the_limit) {
+  MemoryBudget budget(100);
+  BOOST_CHECK(budget.canReserve(60));
+  budget.reserve(60);
+  BOOST_CHECK(budget.canReserve(40));
+  BOOST_CHECK(!budget.canReserve(41));
+  budget.reserve(40);
+  BOOST_CHECK(!budget.canReserve(1));
+  BOOST_CHECK_EQUAL(budget.reserved(), 100u);
+
+  budget.release(60);
+  BOOST_CHECK(budget.canReserve(60));
+  BOOST_CHECK(!budget.canReserve(61));
+}
+
+BOOST_AUTO_TEST_CASE(test_oversized_reservation_runs_alone) {
+  MemoryBudget budget(100);
+  BOOST_CHECK(budget.canReserve(500));
+  budget.reserve(500);
+  BOOST_CHECK(!budget.canReserve(1));
+  // Tasks of unknown size are never held back.
+  BOOST_CHECK(budget.canReserve(0));
+
+  budget.release(500);
+  BOOST_CHECK_EQUAL(budget.numReservations(), 0);
+  BOOST_CHECK(budget.canReserve(500));
+}
+
+BOOST_AUTO_TEST_CASE(test_no_limit) {
+  MemoryBudget budget(0);
+  budget.reserve(uint64_t(1) << 40);
+  BOOST_CHECK(budget.canReserve(uint64_t(1) << 40));
+}
+
+BOOST_AUTO_TEST_CASE(test_page_estimates) {
+  const ImageMetadata page300(QSize(2550, 3300), Dpi(300, 300));
+  const ImageMetadata page1200(QSize(10200, 13200), Dpi(1200, 1200));
+
+  BOOST_CHECK_GT(PageMemoryEstimate::forSource(page1200), 15 * PageMemoryEstimate::forSource(page300));
+  BOOST_CHECK_GE(PageMemoryEstimate::forOutput(page300, output::BLACK_AND_WHITE, Dpi(300, 300)),
+                 PageMemoryEstimate::forSource(page300));
+
+  // The output is built at the output resolution.
+  BOOST_CHECK_GT(PageMemoryEstimate::forOutput(page300, output::BLACK_AND_WHITE, Dpi(600, 600)),
+                 2 * PageMemoryEstimate::forOutput(page300, output::BLACK_AND_WHITE, Dpi(300, 300)));
+  BOOST_CHECK_GT(PageMemoryEstimate::forOutput(page300, output::MIXED, Dpi(300, 300)),
+                 PageMemoryEstimate::forOutput(page300, output::BLACK_AND_WHITE, Dpi(300, 300)));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,163 @@
+// Copyright (C) 2019  Joseph Artsimovich <joseph.artsimovich@gmail.com>, 4lex4 <4lex49@zoho.com>
+// Use of this source code is governed by the GNU GPLv3 license that can be found in the LICENSE file.
+
+#include <BinaryImage.h>
+#include <Dpi.h>
+#include <FilterData.h>
+#include <ImageId.h>
+#include <ImageLoader.h>
+#include <ImageTransformation.h>
+#include <NullTaskStatus.h>
+#include <PageId.h>
+#include <PropertySet.h>
+#include <TiffWriter.h>
+#include <dewarping/DistortionModel.h>
+#include <filters/output/ColorParams.h>
+#include <filters/output/DepthPerception.h>
+#include <filters/output/FillColorProperty.h>
+#include <filters/output/OutputGenerator.h>
+#include <filters/output/Params.h>
+#include <filters/output/Settings.h>
+#include <zones/SerializableSpline.h>
+#include <zones/Zone.h>
+#include <zones/ZoneSet.h>
+
+#include <QBuffer>
+#include <QImage>
+#include <QPainter>
+#include <QPolygonF>
+#include <boost/test/unit_test.hpp>
+#include <memory>
+
+using namespace imageproc;
+
+namespace output {
+namespace tests {
+namespace {
+const Dpi DPI(300, 300);
+
+/**
+ * Blocks of "text" with speckles of a few sizes between them.
+ */
+QImage makePage() {
+  QImage image(600, 400, QImage::Format_RGB32);
+  image.fill(Qt::white);
+  const int dotsPerMeter = qRound(DPI.horizontal() / 0.0254);
+  image.setDotsPerMeterX(dotsPerMeter);
+  image.setDotsPerMeterY(dotsPerMeter);
+
+  QPainter painter(&image);
+  for (int y = 40; y < 360; y += 30) {
+    for (int x = 40; x < 540; x += 50) {
+      painter.fillRect(x, y, 35, 12, QColor(40, 40, 40));
+    }
+  }
+  for (int i = 0; i < 60; ++i) {
+    const int size = 1 + i % 5;
+    painter.fillRect((i * 97) % 580 + 10, (i * 61) % 380 + 10, size, size, Qt::black);
+  }
+  return image;
+}
+
+ZoneSet makeFillZones() {
+  PropertySet props;
+  props.locateOrCreate<FillColorProperty>()->setColor(Qt::black);
+  ZoneSet zones;
+  zones.add(Zone(SerializableSpline(QPolygonF(QRectF(100, 100, 120, 60))), props));
+  return zones;
+}
+
+/**
+ * The checkpoint goes through a file, the way output::Task stores it.
+ */
+QImage storeAndLoad(const QImage& checkpoint) {
+  QBuffer buffer;
+  BOOST_REQUIRE(buffer.open(QIODevice::ReadWrite));
+  BOOST_REQUIRE(TiffWriter::writeImage(buffer, checkpoint));
+  buffer.seek(0);
+  return ImageLoader::load(buffer, 0);
+}
+
+class Fixture {
+ public:
+  Fixture()
+      : m_pageId(ImageId("page.png"), PageId::SINGLE_PAGE),
+        m_settings(std::make_shared<Settings>()),
+        m_xform(QRectF(makePage().rect()), DPI),
+        m_input(FilterData(makePage()), m_xform),
+        m_generator(m_xform, QPolygonF(m_xform.origRect())) {
+    m_settings->setDpi(m_pageId, DPI);
+  }
+
+  void setColorMode(const ColorMode mode) {
+    ColorParams colorParams(m_settings->getParams(m_pageId).colorParams());
+    colorParams.setColorMode(mode);
+    m_settings->setColorParams(m_pageId, colorParams);
+  }
+
+  void setDespeckleLevel(const double level) { m_settings->setDespeckleLevel(m_pageId, level); }
+
+  QImage process(const ZoneSet& fillZones, QImage* checkpoint, BinaryImage* speckles) {
+    ZoneSet pictureZones;
+    dewarping::DistortionModel distortionModel;
+    return m_generator
+        .process(NullTaskStatus(), m_input, pictureZones, fillZones, distortionModel, DepthPerception(), nullptr,
+                 speckles, checkpoint, nullptr, m_pageId, m_settings)
+        ->toImage();
+  }
+
+  QImage resume(const QImage& checkpoint, const ZoneSet& fillZones, BinaryImage* speckles) {
+    return m_generator.resume(NullTaskStatus(), checkpoint, fillZones, speckles, nullptr, m_pageId, m_settings)
+        ->toImage();
+  }
+
+ private:
+  PageId m_pageId;
+  std::shared_ptr<Settings> m_settings;
+  ImageTransformation m_xform;
+  FilterData m_input;
+  OutputGenerator m_generator;
+};
+}  // namespace
+
+BOOST_AUTO_TEST_SUITE(OutputGeneratorTestSuite)
+
+BOOST_AUTO_TEST_CASE(test_resume_after_fill_zones_change) {
+  for (const ColorMode mode : {BLACK_AND_WHITE, COLOR_GRAYSCALE}) {
+    Fixture fixture;
+    fixture.setColorMode(mode);
+
+    QImage checkpoint;
+    const QImage before(fixture.process(ZoneSet(), &checkpoint, nullptr));
+    BOOST_REQUIRE(!checkpoint.isNull());
+
+    const ZoneSet fillZones(makeFillZones());
+    const QImage processed(fixture.process(fillZones, nullptr, nullptr));
+    BOOST_CHECK(processed != before);
+    BOOST_CHECK(fixture.resume(storeAndLoad(checkpoint), fillZones, nullptr) == processed);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(test_resume_after_despeckle_change) {
+  Fixture fixture;
+  fixture.setColorMode(BLACK_AND_WHITE);
+  fixture.setDespeckleLevel(1.0);
+
+  QImage checkpoint;
+  BinaryImage speckles;
+  const QImage before(fixture.process(ZoneSet(), &checkpoint, &speckles));
+  BOOST_REQUIRE(!checkpoint.isNull());
+
+  fixture.setDespeckleLevel(3.0);
+  BinaryImage processedSpeckles;
+  const QImage processed(fixture.process(ZoneSet(), nullptr, &processedSpeckles));
+  BOOST_CHECK(processed != before);
+
+  BinaryImage resumedSpeckles;
+  BOOST_CHECK(fixture.resume(storeAndLoad(checkpoint), ZoneSet(), &resumedSpeckles) == processed);
+  BOOST_CHECK(resumedSpeckles == processedSpeckles);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+}  // namespace tests
+}  // namespace output
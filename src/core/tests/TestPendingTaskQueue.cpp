@@ -0,0 +1,125 @@
+// Copyright (C) 2019  Joseph Artsimovich <joseph.artsimovich@gmail.com>, 4lex4 <4lex49@zoho.com>
+// Use of this source code is governed by the GNU GPLv3 license that can be found in the LICENSE file.
+
+#include <MemoryBudget.h>
+#include <PendingTaskQueue.h>
+
+#include <boost/test/unit_test.hpp>
+#include <memory>
+
+namespace {
+class FakeTask : public BackgroundTask {
+ public:
+  FakeTask(const Type type, const uint64_t memory) : BackgroundTask(type) { setEstimatedMemoryUsage(memory); }
+
+  FilterResultPtr operator()() override { return nullptr; }
+};
+
+BackgroundTaskPtr makeTask(const uint64_t memory, const BackgroundTask::Type type = BackgroundTask::BATCH) {
+  return std::make_shared<FakeTask>(type, memory);
+}
+
+/**
+ * Takes the next task and reserves its memory, the way WorkerThreadPool starts it.
+ */
+BackgroundTaskPtr start(PendingTaskQueue& queue, MemoryBudget& budget) {
+  BackgroundTaskPtr task(queue.takeNext(budget));
+  if (task) {
+    budget.reserve(task->estimatedMemoryUsage());
+  }
+  return task;
+}
+}  // namespace
+
+BOOST_AUTO_TEST_SUITE(PendingTaskQueueTestSuite)
+
+BOOST_AUTO_TEST_CASE(test_interactive_before_batch) {
+  PendingTaskQueue queue;
+  MemoryBudget budget;
+  const BackgroundTaskPtr batch1(makeTask(0));
+  const BackgroundTaskPtr batch2(makeTask(0));
+  const BackgroundTaskPtr interactive1(makeTask(0, BackgroundTask::INTERACTIVE));
+  const BackgroundTaskPtr interactive2(makeTask(0, BackgroundTask::INTERACTIVE));
+  queue.push(batch1);
+  queue.push(interactive1);
+  queue.push(batch2);
+  queue.push(interactive2);
+
+  BOOST_CHECK(queue.takeNext(budget) == interactive1);
+  BOOST_CHECK(queue.takeNext(budget) == interactive2);
+  BOOST_CHECK(queue.takeNext(budget) == batch1);
+  BOOST_CHECK(queue.takeNext(budget) == batch2);
+  BOOST_CHECK(queue.empty());
+  BOOST_CHECK(!queue.takeNext(budget));
+}
+
+BOOST_AUTO_TEST_CASE(test_smaller_tasks_overtake_a_deferred_one) {
+  PendingTaskQueue queue;
+  MemoryBudget budget(100);
+  const BackgroundTaskPtr running(makeTask(60));
+  const BackgroundTaskPtr big(makeTask(50));
+  const BackgroundTaskPtr small1(makeTask(20));
+  const BackgroundTaskPtr small2(makeTask(20));
+  const BackgroundTaskPtr unknown(makeTask(0));
+  queue.push(running);
+  queue.push(big);
+  queue.push(small1);
+  queue.push(small2);
+  queue.push(unknown);
+
+  BOOST_CHECK(start(queue, budget) == running);
+  BOOST_CHECK(start(queue, budget) == small1);
+  BOOST_CHECK(start(queue, budget) == small2);
+  // Tasks of unknown size are never held back.
+  BOOST_CHECK(start(queue, budget) == unknown);
+  BOOST_CHECK(!start(queue, budget));
+  BOOST_CHECK_EQUAL(queue.size(), 1u);
+
+  budget.release(running->estimatedMemoryUsage());
+  BOOST_CHECK(start(queue, budget) == big);
+  BOOST_CHECK(queue.empty());
+}
+
+BOOST_AUTO_TEST_CASE(test_deferred_task_is_not_starved) {
+  PendingTaskQueue queue;
+  MemoryBudget budget(100);
+  const BackgroundTaskPtr running(makeTask(60));
+  const BackgroundTaskPtr big(makeTask(50));
+  queue.push(running);
+  queue.push(big);
+  BOOST_REQUIRE(start(queue, budget) == running);
+
+  // Small tasks keep coming and finishing, while the big one keeps not fitting.
+  for (int i = 0; i < PendingTaskQueue::MAX_TIMES_OVERTAKEN; ++i) {
+    const BackgroundTaskPtr small(makeTask(10));
+    queue.push(small);
+    BOOST_REQUIRE(start(queue, budget) == small);
+    budget.release(small->estimatedMemoryUsage());
+  }
+
+  // Now the big one has been overtaken enough times, so nothing else starts before it.
+  const BackgroundTaskPtr small(makeTask(10));
+  queue.push(small);
+  BOOST_CHECK(!start(queue, budget));
+  BOOST_CHECK_EQUAL(queue.size(), 2u);
+
+  budget.release(running->estimatedMemoryUsage());
+  BOOST_CHECK(start(queue, budget) == big);
+  BOOST_CHECK(start(queue, budget) == small);
+}
+
+BOOST_AUTO_TEST_CASE(test_oversized_task_runs_alone) {
+  PendingTaskQueue queue;
+  MemoryBudget budget(100);
+  const BackgroundTaskPtr small(makeTask(10));
+  const BackgroundTaskPtr huge(makeTask(500));
+  queue.push(small);
+  queue.push(huge);
+
+  BOOST_CHECK(start(queue, budget) == small);
+  BOOST_CHECK(!start(queue, budget));
+  budget.release(small->estimatedMemoryUsage());
+  BOOST_CHECK(start(queue, budget) == huge);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,272 @@
+// Copyright (C) 2019  Joseph Artsimovich <joseph.artsimovich@gmail.com>, 4lex4 <4lex49@zoho.com>
+// Use of this source code is governed by the GNU GPLv3 license that can be found in the LICENSE file.
+
+#include <AbstractFilter.h>
+#include <ImageId.h>
+#include <ImageInfo.h>
+#include <ImageMetadata.h>
+#include <OutputFileNameGenerator.h>
+#include <PageId.h>
+#include <ProjectJournal.h>
+#include <ProjectPages.h>
+#include <ProjectWriter.h>
+#include <SelectedPage.h>
+
+#include <QDomDocument>
+#include <QFile>
+#include <QTemporaryDir>
+#include <boost/test/unit_test.hpp>
+#include <map>
+#include <memory>
+#include <unordered_set>
+#include <vector>
+
+namespace {
+const char* const BASE_PROJECT
+    = "<project version=\"3\">"
+      "<pages><page id=\"3\" selected=\"selected\"/><page id=\"5\"/><page id=\"7\"/></pages>"
+      "<filters>"
+      "<deskew mode=\"auto\"><page id=\"3\" angle=\"1\"/><page id=\"5\" angle=\"2\"/>"
+      "<image-settings><page id=\"3\" dpi=\"300\"/><page id=\"5\" dpi=\"300\"/></image-settings></deskew>"
+      "<page-layout showMiddleRect=\"1\"><guides><guide x=\"1\"/></guides><page id=\"5\" w=\"10\"/></page-layout>"
+      "</filters>"
+      "</project>";
+
+// Page 5 is changed: its deskew record is updated, its image settings and
+// its page layout record are gone.  Page 7 gets a deskew record.
+// Page 3 is not changed.
+const char* const ENTRY
+    = "<journal-entry>"
+      "<changed ids=\"5 7\"/>"
+      "<selected ids=\"7\"/>"
+      "<filters>"
+      "<deskew mode=\"manual\"><page id=\"5\" angle=\"4\"/><page id=\"7\" angle=\"5\"/><image-settings/></deskew>"
+      "<page-layout/>"
+      "</filters>"
+      "</journal-entry>";
+
+QDomDocument parse(const QByteArray& xml) {
+  QDomDocument doc;
+  BOOST_REQUIRE(doc.setContent(xml));
+  return doc;
+}
+
+QDomElement findPage(const QDomElement& parent, const int id) {
+  for (QDomElement el(parent.firstChildElement("page")); !el.isNull(); el = el.nextSiblingElement("page")) {
+    if (el.attribute("id").toInt() == id) {
+      return el;
+    }
+  }
+  return QDomElement();
+}
+
+void checkEntryApplied(const QDomDocument& doc) {
+  const QDomElement projectEl(doc.documentElement());
+  const QDomElement pagesEl(projectEl.firstChildElement("pages"));
+  BOOST_CHECK(!findPage(pagesEl, 3).hasAttribute("selected"));
+  BOOST_CHECK(findPage(pagesEl, 7).hasAttribute("selected"));
+
+  const QDomElement filtersEl(projectEl.firstChildElement("filters"));
+  const QDomElement deskewEl(filtersEl.firstChildElement("deskew"));
+  BOOST_CHECK(deskewEl.attribute("mode") == "manual");
+  BOOST_CHECK(findPage(deskewEl, 3).attribute("angle") == "1");
+  BOOST_CHECK(findPage(deskewEl, 5).attribute("angle") == "4");
+  BOOST_CHECK(findPage(deskewEl, 7).attribute("angle") == "5");
+
+  const QDomElement imageSettingsEl(deskewEl.firstChildElement("image-settings"));
+  BOOST_CHECK(!findPage(imageSettingsEl, 3).isNull());
+  BOOST_CHECK(findPage(imageSettingsEl, 5).isNull());
+
+  const QDomElement pageLayoutEl(filtersEl.firstChildElement("page-layout"));
+  BOOST_CHECK(!pageLayoutEl.hasAttribute("showMiddleRect"));
+  BOOST_CHECK(pageLayoutEl.firstChildElement("guides").isNull());
+  BOOST_CHECK(findPage(pageLayoutEl, 5).isNull());
+}
+
+void writeFile(const QString& path, const QByteArray& data) {
+  QFile file(path);
+  BOOST_REQUIRE(file.open(QIODevice::WriteOnly));
+  BOOST_REQUIRE(file.write(data) == data.size());
+}
+
+QByteArray readFile(const QString& path) {
+  QFile file(path);
+  BOOST_REQUIRE(file.open(QIODevice::ReadOnly));
+  return file.readAll();
+}
+
+/**
+ * Saves its settings the way the real filters do: filter-wide attributes,
+ * an optional element before the page records, and image records inside
+ * a container after them.
+ */
+class TestFilter : public AbstractFilter {
+ public:
+  QString getName() const override { return "test"; }
+
+  PageView getView() const override { return PAGE_VIEW; }
+
+  void performRelinking(const AbstractRelinker&) override {}
+
+  void preUpdateUI(FilterUiInterface*, const PageInfo&) override {}
+
+  QDomElement saveSettings(const ProjectWriter& writer, QDomDocument& doc) const override {
+    QDomElement filterEl(doc.createElement("test"));
+    filterEl.setAttribute("mode", mode);
+    if (guides) {
+      filterEl.appendChild(doc.createElement("guides"));
+    }
+    writer.enumPages([&](const PageId& pageId, const int numericId) {
+      const auto it = pageValues.find(pageId.imageId());
+      if (it != pageValues.end()) {
+        QDomElement pageEl(doc.createElement("page"));
+        pageEl.setAttribute("id", numericId);
+        pageEl.setAttribute("value", it->second);
+        filterEl.appendChild(pageEl);
+      }
+    });
+
+    QDomElement imageSettingsEl(doc.createElement("image-settings"));
+    writer.enumImages([&](const ImageId& imageId, const int numericId) {
+      const auto it = imageValues.find(imageId);
+      if (it != imageValues.end()) {
+        QDomElement imageEl(doc.createElement("image"));
+        imageEl.setAttribute("id", numericId);
+        imageEl.setAttribute("value", it->second);
+        imageSettingsEl.appendChild(imageEl);
+      }
+    });
+    filterEl.appendChild(imageSettingsEl);
+    return filterEl;
+  }
+
+  void loadSettings(const ProjectReader&, const QDomElement&) override {}
+
+  void loadDefaultSettings(const PageInfo&) override {}
+
+  QString mode;
+  bool guides = false;
+  std::map<ImageId, int> pageValues;
+  std::map<ImageId, int> imageValues;
+};
+
+void checkCompactedSameAsWritten(const QString& projectFile) {
+  std::vector<ImageId> images;
+  std::vector<ImageInfo> imageInfos;
+  for (int i = 0; i < 4; ++i) {
+    images.emplace_back(QString("/images/%1.png").arg(i));
+    imageInfos.emplace_back(images.back(), ImageMetadata(QSize(100, 200), Dpi(300, 300)), 1, false, false);
+  }
+  const auto pages = std::make_shared<ProjectPages>(imageInfos, Qt::LeftToRight);
+  const OutputFileNameGenerator outFileNameGen;
+
+  const auto filter = std::make_shared<TestFilter>();
+  const std::vector<ProjectWriter::FilterPtr> filters{filter};
+  filter->mode = "auto";
+  filter->pageValues = {{images[0], 1}, {images[1], 2}};
+  filter->imageValues = {{images[0], 10}, {images[1], 11}, {images[2], 12}};
+  const PageId firstPage(images[0], PageId::SINGLE_PAGE);
+  BOOST_REQUIRE(ProjectWriter(pages, SelectedPage(firstPage, PAGE_VIEW), outFileNameGen).write(projectFile, filters));
+  const QByteArray digest(ProjectJournal::digest(readFile(projectFile)));
+
+  // The changes an autosave would journal.
+  filter->mode = "manual";
+  filter->guides = true;
+  filter->imageValues.erase(images[2]);
+  const SelectedPage lastPage(PageId(images[3], PageId::SINGLE_PAGE), PAGE_VIEW);
+  {
+    ProjectWriter writer(pages, lastPage, outFileNameGen);
+    writer.restrictToImages({images[2]});
+    BOOST_REQUIRE(ProjectJournal::append(projectFile, digest, writer.toJournalEntryXml(filters)));
+  }
+  filter->pageValues.erase(images[0]);
+  filter->pageValues[images[1]] = 3;
+  filter->pageValues[images[3]] = 4;
+  filter->imageValues[images[3]] = 13;
+  {
+    ProjectWriter writer(pages, lastPage, outFileNameGen);
+    writer.restrictToImages({images[0], images[1], images[3]});
+    BOOST_REQUIRE(ProjectJournal::append(projectFile, digest, writer.toJournalEntryXml(filters)));
+  }
+
+  BOOST_REQUIRE(ProjectJournal::compact(projectFile));
+  const ProjectWriter writer(pages, lastPage, outFileNameGen);
+  BOOST_CHECK(readFile(projectFile) == writer.toXml(projectFile, filters));
+}
+}  // namespace
+
+BOOST_AUTO_TEST_SUITE(ProjectJournalTestSuite)
+
+BOOST_AUTO_TEST_CASE(test_apply_entry) {
+  QDomDocument doc(parse(BASE_PROJECT));
+  const QDomDocument entryDoc(parse(ENTRY));
+  ProjectJournal::applyEntry(doc, entryDoc.documentElement());
+  checkEntryApplied(doc);
+}
+
+BOOST_AUTO_TEST_CASE(test_replay) {
+  QTemporaryDir dir;
+  BOOST_REQUIRE(dir.isValid());
+  const QString projectFile(dir.path() + "/test.ScanTailor");
+  const QByteArray projectData(BASE_PROJECT);
+  writeFile(projectFile, projectData);
+
+  const QByteArray digest(ProjectJournal::digest(projectData));
+  BOOST_REQUIRE(ProjectJournal::append(projectFile, digest, ENTRY));
+  // Applying the same entry twice makes no difference.
+  BOOST_REQUIRE(ProjectJournal::append(projectFile, digest, ENTRY));
+
+  QDomDocument doc(parse(projectData));
+  BOOST_CHECK_EQUAL(ProjectJournal::replay(projectFile, projectData, doc), 2);
+  checkEntryApplied(doc);
+
+  // A journal of another version of the project file is ignored.
+  const QByteArray otherData(QByteArray(BASE_PROJECT) + ' ');
+  QDomDocument otherDoc(parse(otherData));
+  BOOST_CHECK_EQUAL(ProjectJournal::replay(projectFile, otherData, otherDoc), 0);
+
+  // Appending for another version starts a new journal.
+  BOOST_REQUIRE(ProjectJournal::append(projectFile, ProjectJournal::digest(otherData), ENTRY));
+  BOOST_CHECK_EQUAL(ProjectJournal::replay(projectFile, otherData, otherDoc), 1);
+}
+
+BOOST_AUTO_TEST_CASE(test_truncated_entry_is_ignored) {
+  QTemporaryDir dir;
+  BOOST_REQUIRE(dir.isValid());
+  const QString projectFile(dir.path() + "/test.ScanTailor");
+  const QByteArray projectData(BASE_PROJECT);
+  writeFile(projectFile, projectData);
+
+  const QByteArray digest(ProjectJournal::digest(projectData));
+  BOOST_REQUIRE(ProjectJournal::append(projectFile, digest, ENTRY));
+  BOOST_REQUIRE(ProjectJournal::append(projectFile, digest, ENTRY));
+
+  const QString journalFile(ProjectJournal::filePathFor(projectFile));
+  const QByteArray journal(readFile(journalFile));
+  writeFile(journalFile, journal.left(journal.size() - 10));
+
+  QDomDocument doc(parse(projectData));
+  BOOST_CHECK_EQUAL(ProjectJournal::replay(projectFile, projectData, doc), 1);
+  checkEntryApplied(doc);
+}
+
+BOOST_AUTO_TEST_CASE(test_compact) {
+  QTemporaryDir dir;
+  BOOST_REQUIRE(dir.isValid());
+  const QString projectFile(dir.path() + "/test.ScanTailor");
+  const QByteArray projectData(BASE_PROJECT);
+  writeFile(projectFile, projectData);
+  BOOST_REQUIRE(ProjectJournal::append(projectFile, ProjectJournal::digest(projectData), ENTRY));
+
+  BOOST_REQUIRE(ProjectJournal::compact(projectFile));
+  BOOST_CHECK(!QFile::exists(ProjectJournal::filePathFor(projectFile)));
+  checkEntryApplied(parse(readFile(projectFile)));
+}
+
+BOOST_AUTO_TEST_CASE(test_compact_same_as_full_write) {
+  QTemporaryDir dir;
+  BOOST_REQUIRE(dir.isValid());
+  checkCompactedSameAsWritten(dir.path() + "/test.ScanTailor");
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,126 @@
+// Copyright (C) 2019  Joseph Artsimovich <joseph.artsimovich@gmail.com>, 4lex4 <4lex49@zoho.com>
+// Use of this source code is governed by the GNU GPLv3 license that can be found in the LICENSE file.
+
+#include <TiffReader.h>
+#include <TiffWriter.h>
+
+#include <QBuffer>
+#include <QImage>
+#include <boost/test/unit_test.hpp>
+#include <cstdlib>
+#include <cstring>
+
+namespace {
+QImage makeColorImage() {
+  QImage image(203, 317, QImage::Format_RGB32);
+  for (int y = 0; y < image.height(); ++y) {
+    auto* line = reinterpret_cast<QRgb*>(image.scanLine(y));
+    for (int x = 0; x < image.width(); ++x) {
+      line[x] = qRgb((x * 3) & 0xff, (y * 5) & 0xff, (x + y) & 0xff);
+    }
+  }
+  image.setDotsPerMeterX(11811);
+  image.setDotsPerMeterY(11811);
+  return image;
+}
+
+QImage makeGrayImage() {
+  QImage image(makeColorImage().convertToFormat(QImage::Format_Indexed8));
+  QVector<QRgb> palette(256);
+  for (int i = 0; i < 256; ++i) {
+    palette[i] = qRgb(i, i, i);
+  }
+  image.setColorTable(palette);
+  return image;
+}
+
+QByteArray toTiff(const QImage& image) {
+  QByteArray data;
+  QBuffer buffer(&data);
+  buffer.open(QIODevice::WriteOnly);
+  BOOST_REQUIRE(TiffWriter::writeImage(buffer, image));
+  return data;
+}
+
+QImage readBands(QByteArray& data) {
+  QBuffer buffer(&data);
+  buffer.open(QIODevice::ReadOnly);
+
+  QImage assembled;
+  int numBands = 0;
+  int nextLine = 0;
+  const bool ok = TiffReader::readImageBands(
+      buffer, 0, ProxyFunction<std::function<void(const QImage&, int)>, void, const QImage&, int>(
+                     [&](const QImage& band, const int firstLine) {
+                       if (assembled.isNull()) {
+                         assembled = QImage(band.width(), 317, band.format());
+                         assembled.setColorTable(band.colorTable());
+                         assembled.setDotsPerMeterX(band.dotsPerMeterX());
+                         assembled.setDotsPerMeterY(band.dotsPerMeterY());
+                       }
+                       BOOST_CHECK_EQUAL(firstLine, nextLine);
+                       BOOST_REQUIRE(band.format() == assembled.format());
+                       for (int y = 0; y < band.height(); ++y) {
+                         memcpy(assembled.scanLine(firstLine + y), band.constScanLine(y), band.bytesPerLine());
+                       }
+                       nextLine += band.height();
+                       ++numBands;
+                     }));
+  BOOST_REQUIRE(ok);
+  BOOST_CHECK_EQUAL(nextLine, 317);
+  BOOST_CHECK(numBands > 1);
+  return assembled;
+}
+}  // namespace
+
+BOOST_AUTO_TEST_SUITE(CoreTiffReaderTestSuite)
+
+BOOST_AUTO_TEST_CASE(test_bands_match_full_image) {
+  QByteArray data(toTiff(makeColorImage()));
+
+  QBuffer buffer(&data);
+  buffer.open(QIODevice::ReadOnly);
+  const QImage full(TiffReader::readImage(buffer, 0));
+  BOOST_REQUIRE(!full.isNull());
+  BOOST_CHECK(full.convertToFormat(QImage::Format_RGB32) == makeColorImage());
+
+  const QImage assembled(readBands(data));
+  BOOST_CHECK(assembled == full);
+}
+
+BOOST_AUTO_TEST_CASE(test_reduced_gray_image) {
+  QByteArray data(toTiff(makeGrayImage()));
+  QBuffer buffer(&data);
+  buffer.open(QIODevice::ReadOnly);
+
+  // 203x317 scaled to fit 50x50 is about 32x50, so the factor is 6.
+  const QImage reduced(TiffReader::readReducedImage(buffer, 0, QSize(50, 50)));
+  BOOST_REQUIRE(!reduced.isNull());
+  BOOST_CHECK(reduced.format() == QImage::Format_Indexed8);
+  BOOST_CHECK(reduced.isGrayscale());
+  BOOST_CHECK_EQUAL(reduced.width(), 34);
+  BOOST_CHECK_EQUAL(reduced.height(), 53);
+  BOOST_CHECK(std::abs(reduced.dotsPerMeterX() - 11811 / 6) <= 1);
+
+  const QImage gray(makeGrayImage());
+  unsigned sum = 0;
+  for (int y = 0; y < 6; ++y) {
+    for (int x = 0; x < 6; ++x) {
+      sum += gray.constScanLine(y)[x];
+    }
+  }
+  BOOST_CHECK_EQUAL(int(reduced.constScanLine(0)[0]), int((sum + 18) / 36));
+}
+
+BOOST_AUTO_TEST_CASE(test_reduced_color_image) {
+  QByteArray data(toTiff(makeColorImage()));
+  QBuffer buffer(&data);
+  buffer.open(QIODevice::ReadOnly);
+
+  const QImage reduced(TiffReader::readReducedImage(buffer, 0, QSize(1000, 1000)));
+  BOOST_REQUIRE(!reduced.isNull());
+  // No reduction is needed, so we get the image as is.
+  BOOST_CHECK(reduced.convertToFormat(QImage::Format_RGB32) == makeColorImage());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
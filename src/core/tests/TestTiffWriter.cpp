@@ -0,0 +1,101 @@
+// Copyright (C) 2019  Joseph Artsimovich <joseph.artsimovich@gmail.com>, 4lex4 <4lex49@zoho.com>
+// Use of this source code is governed by the GNU GPLv3 license that can be found in the LICENSE file.
+
+#include <ParallelFor.h>
+#include <TaskScheduler.h>
+#include <TiffReader.h>
+#include <TiffWriter.h>
+
+#include <QBuffer>
+#include <QImage>
+#include <boost/test/unit_test.hpp>
+
+namespace {
+// Large enough to be split into several strips.
+const int WIDTH = 1031;
+const int HEIGHT = 757;
+
+QImage makeColorImage() {
+  QImage image(WIDTH, HEIGHT, QImage::Format_RGB32);
+  for (int y = 0; y < image.height(); ++y) {
+    auto* line = reinterpret_cast<QRgb*>(image.scanLine(y));
+    for (int x = 0; x < image.width(); ++x) {
+      line[x] = qRgb((x * 3) & 0xff, (y * 5) & 0xff, ((x ^ y) * 7) & 0xff);
+    }
+  }
+  return image;
+}
+
+QImage makePaletteImage() {
+  QImage image(WIDTH, HEIGHT, QImage::Format_Indexed8);
+  QVector<QRgb> palette(256);
+  for (int i = 0; i < 256; ++i) {
+    palette[i] = qRgb(i, 255 - i, (i * 3) & 0xff);
+  }
+  image.setColorTable(palette);
+  for (int y = 0; y < image.height(); ++y) {
+    uchar* line = image.scanLine(y);
+    for (int x = 0; x < image.width(); ++x) {
+      line[x] = static_cast<uchar>((x + y * 17) & 0xff);
+    }
+  }
+  return image;
+}
+
+QByteArray write(const QImage& image) {
+  QByteArray data;
+  QBuffer buffer(&data);
+  buffer.open(QIODevice::WriteOnly);
+  BOOST_REQUIRE(TiffWriter::writeImage(buffer, image));
+  return data;
+}
+
+QImage read(QByteArray data) {
+  QBuffer buffer(&data);
+  buffer.open(QIODevice::ReadOnly);
+  return TiffReader::readImage(buffer, 0);
+}
+
+QImage writeAndRead(const QImage& image) {
+  return read(write(image));
+}
+}  // namespace
+
+BOOST_AUTO_TEST_SUITE(CoreTiffWriterTestSuite)
+
+BOOST_AUTO_TEST_CASE(test_color_round_trip) {
+  const QImage image(makeColorImage());
+  const QImage read(writeAndRead(image));
+  BOOST_REQUIRE(!read.isNull());
+  BOOST_CHECK(read.convertToFormat(QImage::Format_RGB32) == image);
+}
+
+BOOST_AUTO_TEST_CASE(test_palette_round_trip) {
+  const QImage image(makePaletteImage());
+  const QImage read(writeAndRead(image));
+  BOOST_REQUIRE(!read.isNull());
+  BOOST_CHECK(read.convertToFormat(QImage::Format_RGB32) == image.convertToFormat(QImage::Format_RGB32));
+}
+
+BOOST_AUTO_TEST_CASE(test_serial_and_parallel_match) {
+  const QImage image(makeColorImage());
+  setParallelForEnabled(false);
+  const QByteArray serial(write(image));
+  setParallelForEnabled(true);
+
+  // Make sure the strips get compressed in parallel even on a single core.
+  TaskScheduler scheduler(4);
+  setParallelForScheduler(&scheduler);
+  const QByteArray parallel(write(image));
+  setParallelForScheduler(nullptr);
+
+  // The parallel path splits the image into strips of its own size,
+  // so the files differ, while the images they contain don't.
+  BOOST_CHECK(serial != parallel);
+  const QImage serialImage(read(serial));
+  BOOST_REQUIRE(!serialImage.isNull());
+  BOOST_CHECK(serialImage == read(parallel));
+  BOOST_CHECK(serialImage.convertToFormat(QImage::Format_RGB32) == image);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
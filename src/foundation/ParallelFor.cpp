@@ -0,0 +1,130 @@
+// Copyright (C) 2019  Joseph Artsimovich <joseph.artsimovich@gmail.com>, 4lex4 <4lex49@zoho.com>
+// Use of this source code is governed by the GNU GPLv3 license that can be found in the LICENSE file.
+
+#include "ParallelFor.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <memory>
+#include <mutex>
+
+#include "TaskScheduler.h"
+
+namespace {
+std::atomic<bool> parallelForEnabled(true);
+std::atomic<TaskScheduler*> parallelForScheduler(nullptr);
+
+TaskScheduler& currentScheduler() {
+  TaskScheduler* const scheduler = parallelForScheduler.load();
+  return scheduler ? *scheduler : TaskScheduler::instance();
+}
+
+class BandJob {
+ public:
+  BandJob(const int size, const int bandSize, const std::function<void(int, int)>& func)
+      : m_func(func),
+        m_size(size),
+        m_bandSize(bandSize),
+        m_numBands((size + bandSize - 1) / bandSize),
+        m_nextBand(0),
+        m_numBandsDone(0),
+        m_failed(false) {}
+
+  int numBands() const { return m_numBands; }
+
+  /**
+   * Takes bands one by one until there are none left.
+   * May be called by any number of threads.
+   */
+  void processBands() {
+    int band;
+    while ((band = m_nextBand.fetch_add(1)) < m_numBands) {
+      if (!m_failed.load(std::memory_order_relaxed)) {
+        try {
+          const int begin = band * m_bandSize;
+          m_func(begin, std::min(m_size, begin + m_bandSize));
+        } catch (...) {
+          std::lock_guard<std::mutex> guard(m_mutex);
+          if (!m_error) {
+            m_error = std::current_exception();
+          }
+          m_failed.store(true);
+        }
+      }
+
+      if (m_numBandsDone.fetch_add(1) + 1 == m_numBands) {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        m_allDone.notify_all();
+      }
+    }
+  }
+
+  void waitAndRethrow() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_allDone.wait(lock, [this]() { return m_numBandsDone.load() == m_numBands; });
+    if (m_error) {
+      std::rethrow_exception(m_error);
+    }
+  }
+
+ private:
+  // The function is only called for bands taken before all the bands were done,
+  // and the caller waits for those, so it's safe to keep a reference here.
+  const std::function<void(int, int)>& m_func;
+  const int m_size;
+  const int m_bandSize;
+  const int m_numBands;
+  std::atomic<int> m_nextBand;
+  std::atomic<int> m_numBandsDone;
+  std::atomic<bool> m_failed;
+  std::mutex m_mutex;
+  std::condition_variable m_allDone;
+  std::exception_ptr m_error;
+};
+}  // namespace
+
+void parallelForBands(const int size, const int minBandSize, const std::function<void(int, int)>& func) {
+  if (size <= 0) {
+    return;
+  }
+
+  const int maxThreads = parallelForMaxThreads();
+  const int minBand = std::max(1, minBandSize);
+  if ((maxThreads <= 1) || (size < minBand * 2)) {
+    func(0, size);
+    return;
+  }
+
+  // A few bands per thread balance the load when some bands are more expensive than others.
+  const int targetNumBands = maxThreads * 4;
+  const int bandSize = std::max(minBand, (size + targetNumBands - 1) / targetNumBands);
+
+  const auto job = std::make_shared<BandJob>(size, bandSize, func);
+  const int numHelpers = std::min(job->numBands(), maxThreads) - 1;
+  TaskScheduler& scheduler = currentScheduler();
+  for (int i = 0; i < numHelpers; ++i) {
+    // We never wait for the helpers to start: if all the workers are busy, we just do
+    // more of the work ourselves, and the helpers that start late find nothing left to do.
+    scheduler.submit([job]() { job->processBands(); });
+  }
+
+  job->processBands();
+  job->waitAndRethrow();
+}
+
+int parallelForMaxThreads() {
+  if (!parallelForEnabled.load(std::memory_order_relaxed)) {
+    return 1;
+  }
+  return currentScheduler().numThreads();
+}
+
+void setParallelForEnabled(const bool enabled) {
+  parallelForEnabled.store(enabled);
+}
+
+void setParallelForScheduler(TaskScheduler* const scheduler) {
+  parallelForScheduler.store(scheduler);
+}
@@ -0,0 +1,52 @@
+// Copyright (C) 2019  Joseph Artsimovich <joseph.artsimovich@gmail.com>, 4lex4 <4lex49@zoho.com>
+// Use of this source code is governed by the GNU GPLv3 license that can be found in the LICENSE file.
+
+#ifndef SCANTAILOR_FOUNDATION_PARALLELFOR_H_
+#define SCANTAILOR_FOUNDATION_PARALLELFOR_H_
+
+#include <functional>
+
+class TaskScheduler;
+
+/**
+ * \brief Splits [0, size) into consecutive bands and calls \p func(begin, end)
+ *        for each of them, possibly concurrently.
+ *
+ * The bands are processed by TaskScheduler::instance(), unless another
+ * scheduler was set with setParallelForScheduler().  The calling thread
+ * takes part in the processing and the call returns only when all the bands
+ * are done, so it's safe to call it from within another band or from
+ * a worker thread of any pool.  Bands are never
+ * smaller than \p minBandSize, except the last one.  If \p func throws,
+ * the remaining bands are skipped and the first exception is rethrown
+ * in the calling thread.
+ *
+ * \p func must only write to the data belonging to its own band.
+ * As long as it does, the result doesn't depend on how the range was split.
+ */
+void parallelForBands(int size, int minBandSize, const std::function<void(int begin, int end)>& func);
+
+/**
+ * \brief The maximum number of threads parallelForBands() would use.
+ */
+int parallelForMaxThreads();
+
+/**
+ * \brief Enables or disables concurrent processing in parallelForBands().
+ *
+ * When disabled, all the bands are processed by the calling thread in order.
+ * Enabled by default.
+ */
+void setParallelForEnabled(bool enabled);
+
+/**
+ * \brief Makes parallelForBands() process the bands with \p scheduler.
+ *
+ * Passing nullptr, the default, goes back to TaskScheduler::instance().
+ * Mostly useful for tests, to make sure the bands are processed concurrently
+ * regardless of the number of hardware threads.  The scheduler must outlive
+ * its use by parallelForBands().
+ */
+void setParallelForScheduler(TaskScheduler* scheduler);
+
+#endif  // ifndef SCANTAILOR_FOUNDATION_PARALLELFOR_H_
@@ -0,0 +1,144 @@
+// Copyright (C) 2019  Joseph Artsimovich <joseph.artsimovich@gmail.com>, 4lex4 <4lex49@zoho.com>
+// Use of this source code is governed by the GNU GPLv3 license that can be found in the LICENSE file.
+
+#include "TaskScheduler.h"
+
+#include <algorithm>
+#include <cassert>
+#include <utility>
+
+namespace {
+thread_local const TaskScheduler* currentScheduler = nullptr;
+thread_local int currentWorkerIdx = -1;
+thread_local TaskScheduler::Priority currentPriority = TaskScheduler::NORMAL_PRIORITY;
+}  // namespace
+
+TaskScheduler::TaskScheduler(int numThreads) : m_numQueued(0), m_stopping(false) {
+  if (numThreads <= 0) {
+    numThreads = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+  }
+
+  m_workers.reserve(numThreads);
+  for (int i = 0; i < numThreads; ++i) {
+    m_workers.push_back(std::make_unique<Worker>());
+  }
+  // Only start the threads once all the deques exist, as they steal from each other.
+  for (int i = 0; i < numThreads; ++i) {
+    m_workers[i]->thread = std::thread(&TaskScheduler::workerLoop, this, i);
+  }
+}
+
+TaskScheduler::~TaskScheduler() {
+  {
+    std::lock_guard<std::mutex> guard(m_mutex);
+    m_stopping = true;
+  }
+  m_wakeUp.notify_all();
+
+  for (const auto& worker : m_workers) {
+    worker->thread.join();
+  }
+}
+
+TaskScheduler& TaskScheduler::instance() {
+  static TaskScheduler scheduler;
+  return scheduler;
+}
+
+void TaskScheduler::submit(Task task, Priority priority) {
+  const bool fromWorker = isWorkerThread();
+  if (fromWorker) {
+    priority = std::max(priority, currentPriority);
+  }
+
+  if (fromWorker && (priority == NORMAL_PRIORITY)) {
+    Worker& worker = *m_workers[currentWorkerIdx];
+    {
+      std::lock_guard<std::mutex> guard(worker.mutex);
+      worker.deque.push_back(Entry{std::move(task), priority});
+    }
+    std::lock_guard<std::mutex> guard(m_mutex);
+    ++m_numQueued;
+  } else {
+    std::lock_guard<std::mutex> guard(m_mutex);
+    m_injected[priority].push_back(Entry{std::move(task), priority});
+    ++m_numQueued;
+  }
+  m_wakeUp.notify_one();
+}
+
+bool TaskScheduler::isWorkerThread() const {
+  return currentScheduler == this;
+}
+
+void TaskScheduler::workerLoop(const int workerIdx) {
+  currentScheduler = this;
+  currentWorkerIdx = workerIdx;
+
+  Entry entry;
+  while (true) {
+    if (takeTask(workerIdx, entry)) {
+      currentPriority = entry.priority;
+      entry.task();
+      entry.task = nullptr;
+      currentPriority = NORMAL_PRIORITY;
+      continue;
+    }
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_wakeUp.wait(lock, [this]() { return m_stopping || (m_numQueued.load() > 0); });
+    if (m_stopping && (m_numQueued.load() == 0)) {
+      break;
+    }
+  }
+}
+
+bool TaskScheduler::takeTask(const int workerIdx, Entry& entry) {
+  // The pieces of the pages already being processed go before new pages,
+  // so that a page started earlier also finishes earlier.
+  return takeFromInjected(HIGH_PRIORITY, entry) || takeFromOwn(workerIdx, entry) || steal(workerIdx, entry)
+         || takeFromInjected(NORMAL_PRIORITY, entry);
+}
+
+bool TaskScheduler::takeFromInjected(const Priority priority, Entry& entry) {
+  std::lock_guard<std::mutex> guard(m_mutex);
+  std::deque<Entry>& queue = m_injected[priority];
+  if (queue.empty()) {
+    return false;
+  }
+
+  entry = std::move(queue.front());
+  queue.pop_front();
+  --m_numQueued;
+  return true;
+}
+
+bool TaskScheduler::takeFromOwn(const int workerIdx, Entry& entry) {
+  Worker& worker = *m_workers[workerIdx];
+  std::lock_guard<std::mutex> guard(worker.mutex);
+  if (worker.deque.empty()) {
+    return false;
+  }
+
+  // The most recently submitted task is the most likely one to have its data in cache.
+  entry = std::move(worker.deque.back());
+  worker.deque.pop_back();
+  --m_numQueued;
+  return true;
+}
+
+bool TaskScheduler::steal(const int thiefIdx, Entry& entry) {
+  const int numWorkers = numThreads();
+  for (int i = 1; i < numWorkers; ++i) {
+    Worker& victim = *m_workers[(thiefIdx + i) % numWorkers];
+    std::lock_guard<std::mutex> guard(victim.mutex);
+    if (!victim.deque.empty()) {
+      // Take the oldest task, which is usually the biggest one.
+      entry = std::move(victim.deque.front());
+      victim.deque.pop_front();
+      --m_numQueued;
+      return true;
+    }
+  }
+  return false;
+}
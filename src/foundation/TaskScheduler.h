@@ -0,0 +1,104 @@
+// Copyright (C) 2019  Joseph Artsimovich <joseph.artsimovich@gmail.com>, 4lex4 <4lex49@zoho.com>
+// Use of this source code is governed by the GNU GPLv3 license that can be found in the LICENSE file.
+
+#ifndef SCANTAILOR_FOUNDATION_TASKSCHEDULER_H_
+#define SCANTAILOR_FOUNDATION_TASKSCHEDULER_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "NonCopyable.h"
+
+/**
+ * \brief A work-stealing pool of threads shared by whole-page tasks
+ *        and the smaller pieces of work they split into.
+ *
+ * Each worker owns a deque.  Tasks submitted from within a worker go to
+ * the back of its own deque and are taken from there by that worker,
+ * while idle workers steal from the front of other workers' deques.
+ * Tasks submitted from outside go to a shared queue.  This way the
+ * pieces of a slow page get picked up by the workers that have nothing
+ * else to do, instead of them waiting for the page to finish.
+ *
+ * High priority tasks are taken before anything else, and so are the
+ * tasks submitted from within them.
+ *
+ * Tasks must not throw.
+ */
+class TaskScheduler {
+  DECLARE_NON_COPYABLE(TaskScheduler)
+
+ public:
+  enum Priority { NORMAL_PRIORITY, HIGH_PRIORITY };
+
+  using Task = std::function<void()>;
+
+  /**
+   * \param numThreads The number of worker threads.  Non-positive values
+   *        mean the number of hardware threads.
+   */
+  explicit TaskScheduler(int numThreads = 0);
+
+  /**
+   * \brief Runs the remaining tasks and stops the workers.
+   */
+  ~TaskScheduler();
+
+  /**
+   * \brief The scheduler shared by the whole application.
+   */
+  static TaskScheduler& instance();
+
+  /**
+   * \brief Schedules a task for execution.  Thread-safe.
+   *
+   * The effective priority of a task submitted from within another task
+   * is the higher one of \p priority and the priority of that task.
+   */
+  void submit(Task task, Priority priority = NORMAL_PRIORITY);
+
+  int numThreads() const { return static_cast<int>(m_workers.size()); }
+
+  /**
+   * \brief Whether the calling thread is one of the workers of this scheduler.
+   */
+  bool isWorkerThread() const;
+
+ private:
+  struct Entry {
+    Task task;
+    Priority priority;
+  };
+
+  struct Worker {
+    std::mutex mutex;
+    std::deque<Entry> deque;
+    std::thread thread;
+  };
+
+  void workerLoop(int workerIdx);
+
+  bool takeTask(int workerIdx, Entry& entry);
+
+  bool takeFromInjected(Priority priority, Entry& entry);
+
+  bool takeFromOwn(int workerIdx, Entry& entry);
+
+  bool steal(int thiefIdx, Entry& entry);
+
+  std::vector<std::unique_ptr<Worker>> m_workers;
+  std::mutex m_mutex;
+  std::condition_variable m_wakeUp;
+  std::deque<Entry> m_injected[2];  // indexed by Priority, protected by m_mutex
+  std::atomic<int> m_numQueued;     // modified with m_mutex locked, except when taking
+  bool m_stopping;                  // protected by m_mutex
+};
+
+
+#endif  // ifndef SCANTAILOR_FOUNDATION_TASKSCHEDULER_H_
@@ -0,0 +1,259 @@
+// Copyright (C) 2019  Joseph Artsimovich <joseph.artsimovich@gmail.com>, 4lex4 <4lex49@zoho.com>
+// Use of this source code is governed by the GNU GPLv3 license that can be found in the LICENSE file.
+
+#include "Tracer.h"
+
+#include <QFile>
+#include <QTextStream>
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <utility>
+
+namespace {
+int64_t monotonicMicroseconds() {
+  using namespace std::chrono;
+  return duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+int histogramBucket(int64_t durationUs) {
+  int bucket = 0;
+  while ((durationUs > 0) && (bucket < Tracer::NUM_HISTOGRAM_BUCKETS - 1)) {
+    durationUs >>= 1;
+    ++bucket;
+  }
+  return bucket;
+}
+
+/**
+ * Span names are string literals, so escaping quotes and backslashes is enough.
+ */
+QString jsonString(const char* str) {
+  QString escaped(QString::fromUtf8(str));
+  escaped.replace('\\', "\\\\");
+  escaped.replace('"', "\\\"");
+  return '"' + escaped + '"';
+}
+}  // namespace
+
+struct Tracer::ThreadBuffer {
+  using Key = std::pair<const char*, const char*>;
+
+  explicit ThreadBuffer(const int threadId) : threadId(threadId), numDropped(0) {}
+
+  const int threadId;
+  std::mutex mutex;  // only contended while exporting
+  std::vector<Event> events;
+  std::map<Key, SpanStats> stats;
+  int64_t numDropped;
+};
+
+Tracer::Tracer() : m_enabled(false), m_epoch(monotonicMicroseconds()) {}
+
+Tracer::~Tracer() = default;
+
+Tracer& Tracer::instance() {
+  static Tracer tracer;
+  return tracer;
+}
+
+void Tracer::setEnabled(const bool enabled) {
+  m_enabled.store(enabled);
+}
+
+void Tracer::clear() {
+  std::lock_guard<std::mutex> guard(m_mutex);
+  for (const auto& buffer : m_buffers) {
+    std::lock_guard<std::mutex> bufferGuard(buffer->mutex);
+    buffer->events.clear();
+    buffer->stats.clear();
+    buffer->numDropped = 0;
+  }
+}
+
+int64_t Tracer::now() const {
+  return monotonicMicroseconds() - m_epoch;
+}
+
+Tracer::ThreadBuffer& Tracer::threadBuffer() {
+  thread_local ThreadBuffer* currentBuffer = nullptr;
+  if (!currentBuffer) {
+    std::lock_guard<std::mutex> guard(m_mutex);
+    m_buffers.push_back(std::make_unique<ThreadBuffer>(static_cast<int>(m_buffers.size()) + 1));
+    currentBuffer = m_buffers.back().get();
+  }
+  return *currentBuffer;
+}
+
+void Tracer::record(const char* category, const char* name, const int64_t startUs, const int64_t endUs) {
+  const int64_t durationUs = std::max<int64_t>(0, endUs - startUs);
+  ThreadBuffer& buffer = threadBuffer();
+  std::lock_guard<std::mutex> guard(buffer.mutex);
+
+  if (buffer.events.size() < MAX_EVENTS_PER_THREAD) {
+    buffer.events.push_back(Event{category, name, startUs, durationUs});
+  } else {
+    ++buffer.numDropped;
+  }
+
+  SpanStats& stats = buffer.stats[ThreadBuffer::Key(category, name)];
+  if (stats.count == 0) {
+    stats.minUs = durationUs;
+    stats.maxUs = durationUs;
+  } else {
+    stats.minUs = std::min(stats.minUs, durationUs);
+    stats.maxUs = std::max(stats.maxUs, durationUs);
+  }
+  ++stats.count;
+  stats.totalUs += durationUs;
+  ++stats.histogram[histogramBucket(durationUs)];
+}
+
+std::vector<Tracer::SpanStats> Tracer::statistics() const {
+  // The same literal may have different addresses in different translation units,
+  // so the spans are merged by their names.
+  std::map<std::pair<QString, QString>, SpanStats> merged;
+  {
+    std::lock_guard<std::mutex> guard(m_mutex);
+    for (const auto& buffer : m_buffers) {
+      std::lock_guard<std::mutex> bufferGuard(buffer->mutex);
+      for (const auto& keyAndStats : buffer->stats) {
+        const SpanStats& src = keyAndStats.second;
+        const QString category(QString::fromUtf8(keyAndStats.first.first));
+        const QString name(QString::fromUtf8(keyAndStats.first.second));
+        SpanStats& dst = merged[std::make_pair(category, name)];
+        if (dst.count == 0) {
+          dst.category = category;
+          dst.name = name;
+          dst.minUs = src.minUs;
+          dst.maxUs = src.maxUs;
+        } else {
+          dst.minUs = std::min(dst.minUs, src.minUs);
+          dst.maxUs = std::max(dst.maxUs, src.maxUs);
+        }
+        dst.count += src.count;
+        dst.totalUs += src.totalUs;
+        for (int i = 0; i < NUM_HISTOGRAM_BUCKETS; ++i) {
+          dst.histogram[i] += src.histogram[i];
+        }
+      }
+    }
+  }
+
+  std::vector<SpanStats> result;
+  result.reserve(merged.size());
+  for (auto& keyAndStats : merged) {
+    result.push_back(std::move(keyAndStats.second));
+  }
+  std::sort(result.begin(), result.end(),
+            [](const SpanStats& lhs, const SpanStats& rhs) { return lhs.totalUs > rhs.totalUs; });
+  return result;
+}
+
+int64_t Tracer::SpanStats::percentileUs(const double percentile) const {
+  const double target = count * percentile / 100.0;
+  int64_t accumulated = 0;
+  for (int i = 0; i < NUM_HISTOGRAM_BUCKETS; ++i) {
+    accumulated += histogram[i];
+    if ((accumulated > 0) && (accumulated >= target)) {
+      return std::min(maxUs, (i == 0) ? int64_t(0) : (int64_t(1) << i) - 1);
+    }
+  }
+  return maxUs;
+}
+
+bool Tracer::writeChromeTrace(const QString& filePath) const {
+  QFile file(filePath);
+  if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text)) {
+    return false;
+  }
+
+  QTextStream out(&file);
+  out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+  bool first = true;
+
+  std::lock_guard<std::mutex> guard(m_mutex);
+  for (const auto& buffer : m_buffers) {
+    std::lock_guard<std::mutex> bufferGuard(buffer->mutex);
+    if (buffer->events.empty()) {
+      continue;
+    }
+
+    if (!first) {
+      out << ",\n";
+    }
+    first = false;
+    out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->threadId
+        << ",\"args\":{\"name\":\"Thread " << buffer->threadId << "\"}}";
+
+    for (const Event& event : buffer->events) {
+      out << ",\n{\"name\":" << jsonString(event.name) << ",\"cat\":" << jsonString(event.category)
+          << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->threadId << ",\"ts\":" << event.startUs
+          << ",\"dur\":" << event.durationUs << '}';
+    }
+  }
+  out << "\n]}\n";
+  out.flush();
+  return file.error() == QFile::NoError;
+}  // Tracer::writeChromeTrace
+
+bool Tracer::writeStatistics(const QString& filePath) const {
+  QFile file(filePath);
+  if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text)) {
+    return false;
+  }
+
+  const auto ms = [](const int64_t us) { return QString::number(us / 1000.0, 'f', 3); };
+
+  QTextStream out(&file);
+  out << "category\tname\tcount\ttotal_ms\tmean_ms\tmin_ms\tp50_ms\tp90_ms\tp99_ms\tmax_ms\n";
+  const std::vector<SpanStats> allStats(statistics());
+  for (const SpanStats& stats : allStats) {
+    out << stats.category << '\t' << stats.name << '\t' << stats.count << '\t' << ms(stats.totalUs) << '\t'
+        << ms(stats.totalUs / std::max<int64_t>(1, stats.count)) << '\t' << ms(stats.minUs) << '\t'
+        << ms(stats.percentileUs(50)) << '\t' << ms(stats.percentileUs(90)) << '\t' << ms(stats.percentileUs(99))
+        << '\t' << ms(stats.maxUs) << '\n';
+  }
+
+  out << "\nHistograms (count of spans per duration bucket):\n";
+  for (const SpanStats& stats : allStats) {
+    out << '\n' << stats.category << '/' << stats.name << '\n';
+    for (int i = 0; i < NUM_HISTOGRAM_BUCKETS; ++i) {
+      if (stats.histogram[i] != 0) {
+        const int64_t upperUs = int64_t(1) << i;
+        out << "  < " << ms(upperUs).rightJustified(12) << " ms: " << stats.histogram[i] << '\n';
+      }
+    }
+  }
+
+  std::lock_guard<std::mutex> guard(m_mutex);
+  for (const auto& buffer : m_buffers) {
+    std::lock_guard<std::mutex> bufferGuard(buffer->mutex);
+    if (buffer->numDropped > 0) {
+      out << "\nThread " << buffer->threadId << ": " << buffer->numDropped
+          << " spans were left out of the trace, but are included in the statistics.\n";
+    }
+  }
+  out.flush();
+  return file.error() == QFile::NoError;
+}  // Tracer::writeStatistics
+
+TraceSession::TraceSession(const QString& filePath) : m_filePath(filePath) {
+  if (!m_filePath.isEmpty()) {
+    Tracer::instance().setEnabled(true);
+  }
+}
+
+TraceSession::~TraceSession() {
+  if (m_filePath.isEmpty()) {
+    return;
+  }
+  Tracer& tracer = Tracer::instance();
+  tracer.setEnabled(false);
+  tracer.writeChromeTrace(m_filePath);
+  tracer.writeStatistics(m_filePath + ".stats.txt");
+}
+
+QString TraceSession::filePathFromEnvironment() {
+  return QString::fromLocal8Bit(qgetenv("SCANTAILOR_TRACE"));
+}
@@ -0,0 +1,183 @@
+// Copyright (C) 2019  Joseph Artsimovich <joseph.artsimovich@gmail.com>, 4lex4 <4lex49@zoho.com>
+// Use of this source code is governed by the GNU GPLv3 license that can be found in the LICENSE file.
+
+#ifndef SCANTAILOR_FOUNDATION_TRACER_H_
+#define SCANTAILOR_FOUNDATION_TRACER_H_
+
+#include <QString>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "NonCopyable.h"
+
+/**
+ * \brief Collects timed spans of the hot paths, for finding out where
+ *        the time goes without an external profiler.
+ *
+ * Spans are recorded with TRACE_SPAN() and can be nested.  They are
+ * collected per thread, each thread's buffer behind its own mutex, which
+ * only the export contends for, so recording a span takes an uncontended
+ * lock.  Recording is disabled by default, in which case a span costs
+ * a single atomic load.
+ *
+ * The collected spans can be exported as a Chrome trace-event file,
+ * to be viewed in chrome://tracing or Perfetto, and as per-span
+ * duration statistics and histograms.
+ */
+class Tracer {
+  DECLARE_NON_COPYABLE(Tracer)
+
+ public:
+  /**
+   * Bucket i of a histogram counts the spans that took [2^(i-1), 2^i) microseconds,
+   * except for bucket 0, which counts those that took less than a microsecond.
+   * The last bucket also counts anything longer.
+   */
+  static const int NUM_HISTOGRAM_BUCKETS = 32;
+
+  struct SpanStats {
+    QString category;
+    QString name;
+    int64_t count = 0;
+    int64_t totalUs = 0;
+    int64_t minUs = 0;
+    int64_t maxUs = 0;
+    std::array<int64_t, NUM_HISTOGRAM_BUCKETS> histogram{};
+
+    /**
+     * \brief An upper bound of the given percentile of durations, in microseconds,
+     *        with the precision of the histogram buckets.
+     */
+    int64_t percentileUs(double percentile) const;
+  };
+
+  static Tracer& instance();
+
+  bool isEnabled() const { return m_enabled.load(std::memory_order_relaxed); }
+
+  void setEnabled(bool enabled);
+
+  /**
+   * \brief Discards everything recorded so far.
+   */
+  void clear();
+
+  /**
+   * \brief Microseconds on a monotonic clock, since the tracer was created.
+   */
+  int64_t now() const;
+
+  /**
+   * \brief Records a finished span.  Normally called by TraceSpan.
+   *
+   * \p category and \p name must point to strings that live forever,
+   * normally string literals.
+   */
+  void record(const char* category, const char* name, int64_t startUs, int64_t endUs);
+
+  /**
+   * \brief Per-span statistics, sorted by the total time, longest first.
+   */
+  std::vector<SpanStats> statistics() const;
+
+  /**
+   * \brief Writes the recorded spans in the Chrome trace-event format.
+   */
+  bool writeChromeTrace(const QString& filePath) const;
+
+  /**
+   * \brief Writes statistics() as a human readable table.
+   */
+  bool writeStatistics(const QString& filePath) const;
+
+ private:
+  struct Event {
+    const char* category;
+    const char* name;
+    int64_t startUs;
+    int64_t durationUs;
+  };
+
+  struct ThreadBuffer;
+
+  Tracer();
+
+  ~Tracer();
+
+  ThreadBuffer& threadBuffer();
+
+  /**
+   * Beyond this many events per thread, only statistics are updated.
+   */
+  static const size_t MAX_EVENTS_PER_THREAD = 1 << 20;
+
+  std::atomic<bool> m_enabled;
+  const int64_t m_epoch;
+  mutable std::mutex m_mutex;
+  std::vector<std::unique_ptr<ThreadBuffer>> m_buffers;  // protected by m_mutex
+};
+
+
+/**
+ * \brief Records the lifetime of this object as a span, if the tracer is enabled.
+ *
+ * \p category and \p name must be string literals.
+ */
+class TraceSpan {
+  DECLARE_NON_COPYABLE(TraceSpan)
+
+ public:
+  TraceSpan(const char* category, const char* name)
+      : m_category(category), m_name(name), m_startUs(Tracer::instance().isEnabled() ? Tracer::instance().now() : -1) {}
+
+  ~TraceSpan() {
+    if (m_startUs >= 0) {
+      Tracer& tracer = Tracer::instance();
+      tracer.record(m_category, m_name, m_startUs, tracer.now());
+    }
+  }
+
+ private:
+  const char* const m_category;
+  const char* const m_name;
+  const int64_t m_startUs;
+};
+
+
+/**
+ * \brief Enables the tracer for its lifetime and writes the results when destroyed.
+ *
+ * The trace goes into \p filePath, and the statistics go next to it,
+ * with ".stats.txt" appended.  Does nothing if \p filePath is empty.
+ */
+class TraceSession {
+  DECLARE_NON_COPYABLE(TraceSession)
+
+ public:
+  explicit TraceSession(const QString& filePath);
+
+  ~TraceSession();
+
+  /**
+   * \brief The file path given by the SCANTAILOR_TRACE environment variable, if set.
+   */
+  static QString filePathFromEnvironment();
+
+ private:
+  QString m_filePath;
+};
+
+
+#define TRACE_SPAN_CONCAT_IMPL(a, b) a##b
+#define TRACE_SPAN_CONCAT(a, b) TRACE_SPAN_CONCAT_IMPL(a, b)
+
+/**
+ * \brief Records a span from this point until the end of the enclosing scope.
+ */
+#define TRACE_SPAN(category, name) const TraceSpan TRACE_SPAN_CONCAT(traceSpan_, __LINE__)(category, name)
+
+#endif  // ifndef SCANTAILOR_FOUNDATION_TRACER_H_
@@ -0,0 +1,112 @@
+// Copyright (C) 2019  Joseph Artsimovich <joseph.artsimovich@gmail.com>, 4lex4 <4lex49@zoho.com>
+// Use of this source code is governed by the GNU GPLv3 license that can be found in the LICENSE file.
+
+#include <ParallelFor.h>
+#include <TaskScheduler.h>
+
+#include <atomic>
+#include <boost/test/unit_test.hpp>
+#include <stdexcept>
+#include <vector>
+
+BOOST_AUTO_TEST_SUITE(ParallelForTestSuite)
+
+BOOST_AUTO_TEST_CASE(test_empty_range) {
+  bool called = false;
+  parallelForBands(0, 1, [&](int, int) { called = true; });
+  BOOST_CHECK(!called);
+}
+
+BOOST_AUTO_TEST_CASE(test_each_index_visited_once) {
+  const int size = 10007;
+  std::vector<std::atomic<int>> visits(size);
+  for (auto& v : visits) {
+    v.store(0);
+  }
+
+  parallelForBands(size, 7, [&](const int begin, const int end) {
+    for (int i = begin; i < end; ++i) {
+      visits[i].fetch_add(1);
+    }
+  });
+
+  int wrong = 0;
+  for (const auto& v : visits) {
+    if (v.load() != 1) {
+      ++wrong;
+    }
+  }
+  BOOST_CHECK_EQUAL(wrong, 0);
+}
+
+BOOST_AUTO_TEST_CASE(test_min_band_size) {
+  std::atomic<int> tooSmall(0);
+  parallelForBands(1000, 100, [&](const int begin, const int end) {
+    if ((end - begin < 100) && (end != 1000)) {
+      tooSmall.fetch_add(1);
+    }
+  });
+  BOOST_CHECK_EQUAL(tooSmall.load(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(test_nested) {
+  std::atomic<int> sum(0);
+  parallelForBands(64, 1, [&](const int begin, const int end) {
+    for (int i = begin; i < end; ++i) {
+      parallelForBands(64, 1, [&](const int b, const int e) { sum.fetch_add(e - b); });
+    }
+  });
+  BOOST_CHECK_EQUAL(sum.load(), 64 * 64);
+}
+
+BOOST_AUTO_TEST_CASE(test_exception_propagates) {
+  BOOST_CHECK_THROW(parallelForBands(1000, 1,
+                                     [](const int begin, const int end) {
+                                       if ((begin <= 500) && (500 < end)) {
+                                         throw std::runtime_error("band failed");
+                                       }
+                                     }),
+                    std::runtime_error);
+}
+
+BOOST_AUTO_TEST_CASE(test_serial_when_disabled) {
+  setParallelForEnabled(false);
+  BOOST_CHECK_EQUAL(parallelForMaxThreads(), 1);
+
+  std::vector<int> order;
+  parallelForBands(100, 1, [&](const int begin, const int end) {
+    for (int i = begin; i < end; ++i) {
+      order.push_back(i);
+    }
+  });
+  setParallelForEnabled(true);
+
+  BOOST_REQUIRE_EQUAL(order.size(), 100u);
+  for (int i = 0; i < 100; ++i) {
+    BOOST_CHECK_EQUAL(order[i], i);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(test_own_scheduler) {
+  TaskScheduler scheduler(4);
+  setParallelForScheduler(&scheduler);
+  BOOST_CHECK_EQUAL(parallelForMaxThreads(), 4);
+
+  std::vector<std::atomic<int>> visits(1000);
+  for (auto& v : visits) {
+    v.store(0);
+  }
+  parallelForBands(1000, 1, [&](const int begin, const int end) {
+    for (int i = begin; i < end; ++i) {
+      visits[i].fetch_add(1);
+    }
+  });
+  setParallelForScheduler(nullptr);
+
+  for (const auto& v : visits) {
+    BOOST_REQUIRE_EQUAL(v.load(), 1);
+  }
+  BOOST_CHECK_EQUAL(parallelForMaxThreads(), TaskScheduler::instance().numThreads());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,116 @@
+// Copyright (C) 2019  Joseph Artsimovich <joseph.artsimovich@gmail.com>, 4lex4 <4lex49@zoho.com>
+// Use of this source code is governed by the GNU GPLv3 license that can be found in the LICENSE file.
+
+#include <TaskScheduler.h>
+
+#include <atomic>
+#include <boost/test/unit_test.hpp>
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+
+namespace {
+class Latch {
+ public:
+  explicit Latch(int count) : m_count(count) {}
+
+  void countDown() {
+    std::lock_guard<std::mutex> guard(m_mutex);
+    if (--m_count == 0) {
+      m_cond.notify_all();
+    }
+  }
+
+  void wait() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_cond.wait(lock, [this]() { return m_count == 0; });
+  }
+
+ private:
+  std::mutex m_mutex;
+  std::condition_variable m_cond;
+  int m_count;
+};
+}  // namespace
+
+BOOST_AUTO_TEST_SUITE(TaskSchedulerTestSuite)
+
+BOOST_AUTO_TEST_CASE(test_all_tasks_run) {
+  std::atomic<int> counter(0);
+  {
+    TaskScheduler scheduler(4);
+    BOOST_CHECK_EQUAL(scheduler.numThreads(), 4);
+    for (int i = 0; i < 1000; ++i) {
+      scheduler.submit([&counter]() { counter.fetch_add(1); });
+    }
+    // The destructor runs the remaining tasks.
+  }
+  BOOST_CHECK_EQUAL(counter.load(), 1000);
+}
+
+BOOST_AUTO_TEST_CASE(test_nested_tasks_are_stolen) {
+  TaskScheduler scheduler(4);
+  const int numSubtasks = 64;
+  Latch done(numSubtasks);
+  std::mutex mutex;
+  std::vector<std::thread::id> threads;
+
+  // All the subtasks land in the deque of a single worker, which then blocks.
+  // They can only finish if the other workers steal them.
+  Latch blocker(1);
+  std::atomic<bool> onWorker(false);
+  scheduler.submit([&]() {
+    onWorker.store(scheduler.isWorkerThread());
+    for (int i = 0; i < numSubtasks; ++i) {
+      scheduler.submit([&]() {
+        {
+          std::lock_guard<std::mutex> guard(mutex);
+          threads.push_back(std::this_thread::get_id());
+        }
+        done.countDown();
+      });
+    }
+    blocker.wait();
+  });
+
+  done.wait();
+  blocker.countDown();
+  BOOST_CHECK_EQUAL(threads.size(), static_cast<size_t>(numSubtasks));
+  BOOST_CHECK(onWorker.load());
+  BOOST_CHECK(!scheduler.isWorkerThread());
+}
+
+BOOST_AUTO_TEST_CASE(test_high_priority_goes_first) {
+  TaskScheduler scheduler(1);
+  Latch started(1);
+  Latch blocker(1);
+  Latch done(3);
+  std::mutex mutex;
+  std::vector<int> order;
+  auto record = [&](int value) {
+    {
+      std::lock_guard<std::mutex> guard(mutex);
+      order.push_back(value);
+    }
+    done.countDown();
+  };
+
+  // Keep the only worker busy while the other tasks are being queued.
+  scheduler.submit([&]() {
+    started.countDown();
+    blocker.wait();
+  });
+  started.wait();
+  scheduler.submit([&]() { record(1); });
+  scheduler.submit([&]() { record(2); });
+  scheduler.submit([&]() { record(3); }, TaskScheduler::HIGH_PRIORITY);
+  blocker.countDown();
+  done.wait();
+
+  BOOST_REQUIRE_EQUAL(order.size(), 3u);
+  BOOST_CHECK_EQUAL(order[0], 3);
+  BOOST_CHECK_EQUAL(order[1], 1);
+  BOOST_CHECK_EQUAL(order[2], 2);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
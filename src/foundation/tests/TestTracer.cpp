@@ -0,0 +1,98 @@
+// Copyright (C) 2019  Joseph Artsimovich <joseph.artsimovich@gmail.com>, 4lex4 <4lex49@zoho.com>
+// Use of this source code is governed by the GNU GPLv3 license that can be found in the LICENSE file.
+
+#include <Tracer.h>
+
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QTemporaryDir>
+#include <boost/test/unit_test.hpp>
+#include <thread>
+
+namespace {
+const Tracer::SpanStats* findStats(const std::vector<Tracer::SpanStats>& allStats, const QString& name) {
+  for (const Tracer::SpanStats& stats : allStats) {
+    if (stats.name == name) {
+      return &stats;
+    }
+  }
+  return nullptr;
+}
+}  // namespace
+
+BOOST_AUTO_TEST_SUITE(TracerTestSuite)
+
+BOOST_AUTO_TEST_CASE(test_disabled_records_nothing) {
+  Tracer& tracer = Tracer::instance();
+  tracer.clear();
+  tracer.setEnabled(false);
+  { TRACE_SPAN("test", "disabled"); }
+  BOOST_CHECK(findStats(tracer.statistics(), "disabled") == nullptr);
+}
+
+BOOST_AUTO_TEST_CASE(test_nested_spans_from_several_threads) {
+  Tracer& tracer = Tracer::instance();
+  tracer.clear();
+  tracer.setEnabled(true);
+
+  const auto work = [] {
+    for (int i = 0; i < 10; ++i) {
+      TRACE_SPAN("test", "outer");
+      TRACE_SPAN("test", "inner");
+    }
+  };
+  std::thread thread(work);
+  work();
+  thread.join();
+  tracer.setEnabled(false);
+
+  const std::vector<Tracer::SpanStats> allStats(tracer.statistics());
+  const Tracer::SpanStats* outer = findStats(allStats, "outer");
+  const Tracer::SpanStats* inner = findStats(allStats, "inner");
+  BOOST_REQUIRE(outer && inner);
+  BOOST_CHECK_EQUAL(outer->count, 20);
+  BOOST_CHECK_EQUAL(inner->count, 20);
+  BOOST_CHECK(outer->totalUs >= inner->totalUs);
+  BOOST_CHECK(outer->minUs <= outer->percentileUs(50));
+  BOOST_CHECK(outer->percentileUs(99) <= outer->maxUs);
+
+  int64_t histogramCount = 0;
+  for (const int64_t count : outer->histogram) {
+    histogramCount += count;
+  }
+  BOOST_CHECK_EQUAL(histogramCount, 20);
+}
+
+BOOST_AUTO_TEST_CASE(test_chrome_trace_export) {
+  Tracer& tracer = Tracer::instance();
+  tracer.clear();
+  tracer.record("test", "exported", 10, 25);
+
+  QTemporaryDir dir;
+  BOOST_REQUIRE(dir.isValid());
+  const QString path(dir.path() + "/trace.json");
+  BOOST_REQUIRE(tracer.writeChromeTrace(path));
+  BOOST_REQUIRE(tracer.writeStatistics(path + ".stats.txt"));
+
+  QFile file(path);
+  BOOST_REQUIRE(file.open(QIODevice::ReadOnly));
+  const QJsonDocument doc(QJsonDocument::fromJson(file.readAll()));
+  BOOST_REQUIRE(doc.isObject());
+
+  bool found = false;
+  for (const QJsonValue& value : doc.object()["traceEvents"].toArray()) {
+    const QJsonObject event(value.toObject());
+    if (event["name"].toString() == "exported") {
+      found = true;
+      BOOST_CHECK(event["ph"].toString() == "X");
+      BOOST_CHECK_EQUAL(event["ts"].toInt(), 10);
+      BOOST_CHECK_EQUAL(event["dur"].toInt(), 15);
+    }
+  }
+  BOOST_CHECK(found);
+  tracer.clear();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -6,13 +6,39 @@
 #include <QDebug>
 #include <cassert>
 #include <cmath>
+#include <mutex>
 #include <stdexcept>
+#include <vector>
 
 #include "BinaryImage.h"
 #include "Grayscale.h"
 #include "IntegralImage.h"
+#include "LocalWindowStats.h"
+#include "ParallelFor.h"
 
 namespace imageproc {
+namespace {
+/**
+ * \brief Fills a line of a binary image 32 pixels at a time.
+ *
+ * \p isBlack(x) is called for every x in [0, width).  The padding bits
+ * at the end of the line are cleared.
+ */
+template <typename IsBlack>
+void packLine(uint32_t* const bwLine, const int width, const IsBlack& isBlack) {
+  const uint32_t msb = uint32_t(1) << 31;
+  int x = 0;
+  for (int wordIdx = 0; x < width; ++wordIdx) {
+    const int wordEnd = std::min(width, x + 32);
+    uint32_t word = 0;
+    for (uint32_t mask = msb; x < wordEnd; ++x, mask >>= 1) {
+      word |= isBlack(x) ? mask : 0;
+    }
+    bwLine[wordIdx] = word;
+  }
+}
+}  // namespace
+
 BinaryImage binarizeOtsu(const QImage& src) {
   return BinaryImage(src, BinaryThreshold::otsuThreshold(src));
 }
@@ -61,52 +87,30 @@ BinaryImage binarizeSauvola(const QImage& src, const QSize windowSize, const dou
     grayLine += grayBpl;
   }
 
-  const int windowLowerHalf = windowSize.height() >> 1;
-  const int windowUpperHalf = windowSize.height() - windowLowerHalf;
-  const int windowLeftHalf = windowSize.width() >> 1;
-  const int windowRightHalf = windowSize.width() - windowLeftHalf;
-
   BinaryImage bwImg(w, h);
-  uint32_t* bwLine = bwImg.data();
+  uint32_t* const bwData = bwImg.data();
   const int bwWpl = bwImg.wordsPerLine();
 
+  const LocalWindowStats windowStats(integralImage, &integralSqimage, QSize(w, h), windowSize);
+
   const double frac_d = (double) delta / 128.0;
-  grayLine = gray.bits();
-  for (int y = 0; y < h; ++y) {
-    const int top = std::max(0, y - windowLowerHalf);
-    const int bottom = std::min(h, y + windowUpperHalf);  // exclusive
-    for (int x = 0; x < w; ++x) {
-      const int left = std::max(0, x - windowLeftHalf);
-      const int right = std::min(w, x + windowRightHalf);  // exclusive
-      const int area = (bottom - top) * (right - left);
-      assert(area > 0);  // because windowSize > 0 and w > 0 and h > 0
-      const QRect rect(left, top, right - left, bottom - top);
-      const double windowSum = integralImage.sum(rect);
-      const double windowSqsum = integralSqimage.sum(rect);
-
-      const double rArea = 1.0 / area;
-      const double mean = windowSum * rArea;
-      const double sqmean = windowSqsum * rArea;
-
-      const double variance = sqmean - mean * mean;
-      const double deviation = std::sqrt(std::fabs(variance));
-      const double frac_s = deviation / 128.0;
-
-      const double threshold = mean * (1.0 - k * (1.0 - (frac_s + frac_d)));
-
-      const uint32_t msb = uint32_t(1) << 31;
-      const uint32_t mask = msb >> (x & 31);
-      if (int(grayLine[x]) < threshold) {
-        // black
-        bwLine[x >> 5] |= mask;
-      } else {
-        // white
-        bwLine[x >> 5] &= ~mask;
-      }
+  parallelForBands(h, 16, [&](const int yBegin, const int yEnd) {
+    std::vector<double> means(w);
+    std::vector<double> deviations(w);
+    const uint8_t* grayLine = gray.bits() + yBegin * grayBpl;
+    uint32_t* bwLine = bwData + yBegin * bwWpl;
+    for (int y = yBegin; y < yEnd; ++y) {
+      windowStats.computeLine(y, means.data(), deviations.data());
+      packLine(bwLine, w, [&](const int x) {
+        const double mean = means[x];
+        const double frac_s = deviations[x] / 128.0;
+        const double threshold = mean * (1.0 - k * (1.0 - (frac_s + frac_d)));
+        return int(grayLine[x]) < threshold;
+      });
+      grayLine += grayBpl;
+      bwLine += bwWpl;
     }
-    grayLine += grayBpl;
-    bwLine += bwWpl;
-  }
+  });
   return bwImg;
 }  // binarizeSauvola
 
@@ -157,69 +161,54 @@ BinaryImage binarizeWolf(const QImage& src,
     grayLine += grayBpl;
   }
 
-  const int windowLowerHalf = windowSize.height() >> 1;
-  const int windowUpperHalf = windowSize.height() - windowLowerHalf;
-  const int windowLeftHalf = windowSize.width() >> 1;
-  const int windowRightHalf = windowSize.width() - windowLeftHalf;
-
   std::vector<float> means(w * h, 0);
   std::vector<float> deviations(w * h, 0);
 
   double maxDeviation = 0;
-
-  for (int y = 0; y < h; ++y) {
-    const int top = std::max(0, y - windowLowerHalf);
-    const int bottom = std::min(h, y + windowUpperHalf);  // exclusive
-    for (int x = 0; x < w; ++x) {
-      const int left = std::max(0, x - windowLeftHalf);
-      const int right = std::min(w, x + windowRightHalf);  // exclusive
-      const int area = (bottom - top) * (right - left);
-      assert(area > 0);  // because windowSize > 0 and w > 0 and h > 0
-      const QRect rect(left, top, right - left, bottom - top);
-      const double windowSum = integralImage.sum(rect);
-      const double windowSqsum = integralSqimage.sum(rect);
-
-      const double rArea = 1.0 / area;
-      const double mean = windowSum * rArea;
-      const double sqmean = windowSqsum * rArea;
-
-      const double variance = sqmean - mean * mean;
-      const double deviation = std::sqrt(std::fabs(variance));
-      maxDeviation = std::max(maxDeviation, deviation);
-      means[w * y + x] = (float) mean;
-      deviations[w * y + x] = (float) deviation;
+  std::mutex maxDeviationMutex;
+
+  const LocalWindowStats windowStats(integralImage, &integralSqimage, QSize(w, h), windowSize);
+
+  parallelForBands(h, 16, [&](const int yBegin, const int yEnd) {
+    double bandMaxDeviation = 0;
+    std::vector<double> lineMeans(w);
+    std::vector<double> lineDeviations(w);
+    for (int y = yBegin; y < yEnd; ++y) {
+      windowStats.computeLine(y, lineMeans.data(), lineDeviations.data());
+      for (int x = 0; x < w; ++x) {
+        bandMaxDeviation = std::max(bandMaxDeviation, lineDeviations[x]);
+        means[w * y + x] = (float) lineMeans[x];
+        deviations[w * y + x] = (float) lineDeviations[x];
+      }
     }
-  }
+
+    std::lock_guard<std::mutex> guard(maxDeviationMutex);
+    maxDeviation = std::max(maxDeviation, bandMaxDeviation);
+  });
 
   // TODO: integral images can be disposed at this point.
 
   BinaryImage bwImg(w, h);
-  uint32_t* bwLine = bwImg.data();
+  uint32_t* const bwData = bwImg.data();
   const int bwWpl = bwImg.wordsPerLine();
 
   const double frac_d = (double) delta / 128.0;
-  grayLine = gray.bits();
-  for (int y = 0; y < h; ++y) {
-    for (int x = 0; x < w; ++x) {
-      const float mean = means[y * w + x];
-      const float deviation = deviations[y * w + x];
-      const double base = mean - minGrayLevel;
-      const double frac_sn = deviation / maxDeviation;
-      const double threshold = base * (1.0 - k * (1.0 - (frac_sn + frac_d))) + minGrayLevel;
-
-      const uint32_t msb = uint32_t(1) << 31;
-      const uint32_t mask = msb >> (x & 31);
-      if ((grayLine[x] < lowerBound) || ((grayLine[x] <= upperBound) && (int(grayLine[x]) < threshold))) {
-        // black
-        bwLine[x >> 5] |= mask;
-      } else {
-        // white
-        bwLine[x >> 5] &= ~mask;
-      }
+  parallelForBands(h, 16, [&](const int yBegin, const int yEnd) {
+    const uint8_t* grayLine = gray.bits() + yBegin * grayBpl;
+    uint32_t* bwLine = bwData + yBegin * bwWpl;
+    for (int y = yBegin; y < yEnd; ++y) {
+      packLine(bwLine, w, [&](const int x) {
+        const float mean = means[y * w + x];
+        const float deviation = deviations[y * w + x];
+        const double base = mean - minGrayLevel;
+        const double frac_sn = deviation / maxDeviation;
+        const double threshold = base * (1.0 - k * (1.0 - (frac_sn + frac_d))) + minGrayLevel;
+        return (grayLine[x] < lowerBound) || ((grayLine[x] <= upperBound) && (int(grayLine[x]) < threshold));
+      });
+      grayLine += grayBpl;
+      bwLine += bwWpl;
     }
-    grayLine += grayBpl;
-    bwLine += bwWpl;
-  }
+  });
   return bwImg;
 }  // binarizeWolf
 
@@ -266,76 +255,58 @@ BinaryImage binarizeFox(const QImage& src,
     grayLine += grayBpl;
   }
 
-  const int windowLowerHalf = windowSize.height() >> 1;
-  const int windowUpperHalf = windowSize.height() - windowLowerHalf;
-  const int windowLeftHalf = windowSize.width() >> 1;
-  const int windowRightHalf = windowSize.width() - windowLeftHalf;
-
   double maxDeviation = 0.0;
-
-  grayLine = gray.bits();
-  for (int y = 0; y < h; ++y) {
-    const int top = (y > windowLowerHalf) ? (y - windowLowerHalf) : 0;
-    const int bottom = ((y + windowUpperHalf) < h) ? (y + windowUpperHalf) : h;
-    for (int x = 0; x < w; ++x) {
-      const int left = (x > windowLeftHalf) ? (x - windowLeftHalf) : 0;
-      const int right = ((x + windowRightHalf) < w) ? (x + windowRightHalf) : w;
-      const int area = (bottom - top) * (right - left);
-      assert(area > 0);  // because windowSize > 0 and w > 0 and h > 0
-      const QRect rect(left, top, right - left, bottom - top);
-      const double windowSum = integralImage.sum(rect);
-
-      const double rArea = 1.0 / area;
-      const double mean = windowSum * rArea;
-      const double di = (double) grayLine[x] - mean;
-      const double deviation = di / (256.0 - di);
-
-      maxDeviation = (deviation > maxDeviation) ? deviation : maxDeviation;
+  std::mutex maxDeviationMutex;
+
+  const LocalWindowStats windowStats(integralImage, nullptr, QSize(w, h), windowSize);
+
+  parallelForBands(h, 16, [&](const int yBegin, const int yEnd) {
+    double bandMaxDeviation = 0.0;
+    std::vector<double> means(w);
+    const uint8_t* grayLine = gray.bits() + yBegin * grayBpl;
+    for (int y = yBegin; y < yEnd; ++y) {
+      windowStats.computeLine(y, means.data());
+      for (int x = 0; x < w; ++x) {
+        const double mean = means[x];
+        const double di = (double) grayLine[x] - mean;
+        const double deviation = di / (256.0 - di);
+
+        bandMaxDeviation = (deviation > bandMaxDeviation) ? deviation : bandMaxDeviation;
+      }
+      grayLine += grayBpl;
     }
-    grayLine += grayBpl;
-  }
+
+    std::lock_guard<std::mutex> guard(maxDeviationMutex);
+    maxDeviation = (bandMaxDeviation > maxDeviation) ? bandMaxDeviation : maxDeviation;
+  });
   maxDeviation = (maxDeviation > 0.0) ? maxDeviation : 1.0;
 
   BinaryImage bwImg(w, h);
-  uint32_t* bwLine = bwImg.data();
+  uint32_t* const bwData = bwImg.data();
   const int bwWpl = bwImg.wordsPerLine();
 
   const double frac_d = (double) delta / 128.0;
-  grayLine = gray.bits();
-  for (int y = 0; y < h; ++y) {
-    const int top = (y > windowLowerHalf) ? (y - windowLowerHalf) : 0;
-    const int bottom = ((y + windowUpperHalf) < h) ? (y + windowUpperHalf) : h;
-    for (int x = 0; x < w; ++x) {
-      const int left = (x > windowLeftHalf) ? (x - windowLeftHalf) : 0;
-      const int right = ((x + windowRightHalf) < w) ? (x + windowRightHalf) : w;
-      const int area = (bottom - top) * (right - left);
-      assert(area > 0);  // because windowSize > 0 and w > 0 and h > 0
-      const QRect rect(left, top, right - left, bottom - top);
-      const double windowSum = integralImage.sum(rect);
-
-      const double rArea = 1.0 / area;
-      const double mean = windowSum * rArea;
-      const double di = (double) grayLine[x] - mean;
-      const double deviation = di / (256.0 - di);
-
-      const double base = mean - minGrayLevel;
-      const double frac_sn = deviation / maxDeviation;
-
-      const double threshold = base * (1.0 - k * 0.5 * (1.0 - (frac_sn + frac_d))) + minGrayLevel;
-
-      const uint32_t msb = uint32_t(1) << 31;
-      const uint32_t mask = msb >> (x & 31);
-      if ((grayLine[x] < lowerBound) || ((grayLine[x] <= upperBound) && (int(grayLine[x]) < threshold))) {
-        // black
-        bwLine[x >> 5] |= mask;
-      } else {
-        // white
-        bwLine[x >> 5] &= ~mask;
-      }
+  parallelForBands(h, 16, [&](const int yBegin, const int yEnd) {
+    std::vector<double> means(w);
+    const uint8_t* grayLine = gray.bits() + yBegin * grayBpl;
+    uint32_t* bwLine = bwData + yBegin * bwWpl;
+    for (int y = yBegin; y < yEnd; ++y) {
+      windowStats.computeLine(y, means.data());
+      packLine(bwLine, w, [&](const int x) {
+        const double mean = means[x];
+        const double di = (double) grayLine[x] - mean;
+        const double deviation = di / (256.0 - di);
+
+        const double base = mean - minGrayLevel;
+        const double frac_sn = deviation / maxDeviation;
+
+        const double threshold = base * (1.0 - k * 0.5 * (1.0 - (frac_sn + frac_d))) + minGrayLevel;
+        return (grayLine[x] < lowerBound) || ((grayLine[x] <= upperBound) && (int(grayLine[x]) < threshold));
+      });
+      grayLine += grayBpl;
+      bwLine += bwWpl;
     }
-    grayLine += grayBpl;
-    bwLine += bwWpl;
-  }
+  });
   return bwImg;
 }  // binarizeFox
 
@@ -388,90 +359,65 @@ BinaryImage binarizeWindow(const QImage& src,
     grayLine += grayBpl;
   }
 
-  const int windowLowerHalf = windowSize.height() >> 1;
-  const int windowUpperHalf = windowSize.height() - windowLowerHalf;
-  const int windowLeftHalf = windowSize.width() >> 1;
-  const int windowRightHalf = windowSize.width() - windowLeftHalf;
-
   const int areaFull = w * h;
   assert(areaFull > 0);
   const uint64_t meanFull = integralImage.sum(QRect(0, 0, w, h)) / areaFull;
   double deviationMax = 0.0;
   double deviationMin = 256.0;
+  std::mutex deviationMutex;
   const double coefw = k * 3.0; // translate from Wolf to Window coef.
 
-  grayLine = gray.bits();
-  for (int y = 0; y < h; ++y) {
-    const int top = (y > windowLowerHalf) ? (y - windowLowerHalf) : 0;
-    const int bottom = ((y + windowUpperHalf) < h) ? (y + windowUpperHalf) : h;
-    for (int x = 0; x < w; ++x) {
-      const int left = (x > windowLeftHalf) ? (x - windowLeftHalf) : 0;
-      const int right = ((x + windowRightHalf) < w) ? (x + windowRightHalf) : w;
-      const int area = (bottom - top) * (right - left);
-      assert(area > 0);  // because windowSize > 0 and w > 0 and h > 0
-      const QRect rect(left, top, right - left, bottom - top);
-      const double windowSum = integralImage.sum(rect);
-      const double windowSqsum = integralSqimage.sum(rect);
-
-      const double rArea = 1.0 / area;
-      const double mean = windowSum * rArea;
-      const double sqmean = windowSqsum * rArea;
-
-      const double variance = std::fabs(sqmean - mean * mean);
-      const double deviation = std::sqrt(variance);
-
-      deviationMax = (deviation > deviationMax) ? deviation : deviationMax;
-      deviationMin = (deviation < deviationMin) ? deviation : deviationMin;
+  const LocalWindowStats windowStats(integralImage, &integralSqimage, QSize(w, h), windowSize);
+
+  parallelForBands(h, 16, [&](const int yBegin, const int yEnd) {
+    double bandDeviationMax = 0.0;
+    double bandDeviationMin = 256.0;
+    std::vector<double> means(w);
+    std::vector<double> deviations(w);
+    for (int y = yBegin; y < yEnd; ++y) {
+      windowStats.computeLine(y, means.data(), deviations.data());
+      for (int x = 0; x < w; ++x) {
+        const double deviation = deviations[x];
+
+        bandDeviationMax = (deviation > bandDeviationMax) ? deviation : bandDeviationMax;
+        bandDeviationMin = (deviation < bandDeviationMin) ? deviation : bandDeviationMin;
+      }
     }
-    grayLine += grayBpl;
-  }
+
+    std::lock_guard<std::mutex> guard(deviationMutex);
+    deviationMax = (bandDeviationMax > deviationMax) ? bandDeviationMax : deviationMax;
+    deviationMin = (bandDeviationMin < deviationMin) ? bandDeviationMin : deviationMin;
+  });
 
   const double deviationD = deviationMax - deviationMin;
 
   BinaryImage bwImg(w, h);
-  uint32_t* bwLine = bwImg.data();
+  uint32_t* const bwData = bwImg.data();
   const int bwWpl = bwImg.wordsPerLine();
 
-  const uint32_t msb = uint32_t(1) << 31;
-  grayLine = gray.bits();
-  for (int y = 0; y < h; ++y) {
-    const int top = (y > windowLowerHalf) ? (y - windowLowerHalf) : 0;
-    const int bottom = ((y + windowUpperHalf) < h) ? (y + windowUpperHalf) : h;
-    for (int x = 0; x < w; ++x) {
-      const int left = (x > windowLeftHalf) ? (x - windowLeftHalf) : 0;
-      const int right = ((x + windowRightHalf) < w) ? (x + windowRightHalf) : w;
-      const int area = (bottom - top) * (right - left);
-      assert(area > 0);  // because windowSize > 0 and w > 0 and h > 0
-      const QRect rect(left, top, right - left, bottom - top);
-      const double windowSum = integralImage.sum(rect);
-      const double windowSqsum = integralSqimage.sum(rect);
-
-      const double rArea = 1.0 / area;
-      const double mean = windowSum * rArea;
-      const double sqmean = windowSqsum * rArea;
-
-      const double variance = std::fabs(sqmean - mean * mean);
-      const double deviation = std::sqrt(variance);
-
-      const double md = (mean + 1.0 - delta) / (meanFull + deviation + 1.0);
-      const double kdm = (meanFull + meanFull + 1.0) / (deviation + 1.0);
-      const double kds = (deviationD > 0.0) ? ((deviation - deviationMin) / deviationD) : 1.0;
-      const double kd = 1.0 + kdm * kds;
-
-      const double threshold = mean * (1.0 - coefw * md / kd);
-
-      const uint32_t mask = msb >> (x & 31);
-      if ((grayLine[x] < lowerBound) || ((grayLine[x] <= upperBound) && (int(grayLine[x]) < threshold))) {
-        // black
-        bwLine[x >> 5] |= mask;
-      } else {
-        // white
-        bwLine[x >> 5] &= ~mask;
-      }
+  parallelForBands(h, 16, [&](const int yBegin, const int yEnd) {
+    std::vector<double> means(w);
+    std::vector<double> deviations(w);
+    const uint8_t* grayLine = gray.bits() + yBegin * grayBpl;
+    uint32_t* bwLine = bwData + yBegin * bwWpl;
+    for (int y = yBegin; y < yEnd; ++y) {
+      windowStats.computeLine(y, means.data(), deviations.data());
+      packLine(bwLine, w, [&](const int x) {
+        const double mean = means[x];
+        const double deviation = deviations[x];
+
+        const double md = (mean + 1.0 - delta) / (meanFull + deviation + 1.0);
+        const double kdm = (meanFull + meanFull + 1.0) / (deviation + 1.0);
+        const double kds = (deviationD > 0.0) ? ((deviation - deviationMin) / deviationD) : 1.0;
+        const double kd = 1.0 + kdm * kds;
+
+        const double threshold = mean * (1.0 - coefw * md / kd);
+        return (grayLine[x] < lowerBound) || ((grayLine[x] <= upperBound) && (int(grayLine[x]) < threshold));
+      });
+      grayLine += grayBpl;
+      bwLine += bwWpl;
     }
-    grayLine += grayBpl;
-    bwLine += bwWpl;
-  }
+  });
   return bwImg;
 }  // binarizeWindow
 
@@ -508,43 +454,27 @@ BinaryImage binarizeBradley(const QImage& src, const QSize windowSize, const dou
     grayLine += grayBpl;
   }
 
-  const int windowLowerHalf = windowSize.height() >> 1;
-  const int windowUpperHalf = windowSize.height() - windowLowerHalf;
-  const int windowLeftHalf = windowSize.width() >> 1;
-  const int windowRightHalf = windowSize.width() - windowLeftHalf;
-
   BinaryImage bwImg(w, h);
-  uint32_t* bwLine = bwImg.data();
+  uint32_t* const bwData = bwImg.data();
   const int bwWpl = bwImg.wordsPerLine();
 
-  grayLine = gray.bits();
-  for (int y = 0; y < h; ++y) {
-    const int top = std::max(0, y - windowLowerHalf);
-    const int bottom = std::min(h, y + windowUpperHalf);  // exclusive
-    for (int x = 0; x < w; ++x) {
-      const int left = std::max(0, x - windowLeftHalf);
-      const int right = std::min(w, x + windowRightHalf);  // exclusive
-      const int area = (bottom - top) * (right - left);
-      assert(area > 0);  // because windowSize > 0 and w > 0 and h > 0
-      const QRect rect(left, top, right - left, bottom - top);
-      const double windowSum = integralImage.sum(rect);
-
-      const double rArea = 1.0 / area;
-      const double mean = windowSum * rArea;
-      const double threshold = (k < 1.0) ? (mean * (1.0 - k)) : 0;
-      const uint32_t msb = uint32_t(1) << 31;
-      const uint32_t mask = msb >> (x & 31);
-      if (int(grayLine[x]) < (threshold + delta)) {
-        // black
-        bwLine[x >> 5] |= mask;
-      } else {
-        // white
-        bwLine[x >> 5] &= ~mask;
-      }
+  const LocalWindowStats windowStats(integralImage, nullptr, QSize(w, h), windowSize);
+
+  const uint8_t* const grayData = gray.bits();
+  parallelForBands(h, 16, [&](const int yBegin, const int yEnd) {
+    std::vector<double> means(w);
+    const uint8_t* grayLine = grayData + yBegin * grayBpl;
+    uint32_t* bwLine = bwData + yBegin * bwWpl;
+    for (int y = yBegin; y < yEnd; ++y) {
+      windowStats.computeLine(y, means.data());
+      packLine(bwLine, w, [&](const int x) {
+        const double threshold = (k < 1.0) ? (means[x] * (1.0 - k)) : 0;
+        return int(grayLine[x]) < (threshold + delta);
+      });
+      grayLine += grayBpl;
+      bwLine += bwWpl;
     }
-    grayLine += grayBpl;
-    bwLine += bwWpl;
-  }
+  });
   return bwImg;
 }  // binarizeBradley
 
@@ -595,80 +525,80 @@ BinaryImage binarizeGrad(const QImage& src,
     grayLine += grayBpl;
   }
 
-  const int windowLowerHalf = windowSize.height() >> 1;
-  const int windowUpperHalf = windowSize.height() - windowLowerHalf;
-  const int windowLeftHalf = windowSize.width() >> 1;
-  const int windowRightHalf = windowSize.width() - windowLeftHalf;
+  const LocalWindowStats windowStats(integralImage, nullptr, QSize(w, h), windowSize);
 
-  for (int y = 0; y < h; ++y) {
-    const int top = std::max(0, y - windowLowerHalf);
-    const int bottom = std::min(h, y + windowUpperHalf);  // exclusive
-    for (int x = 0; x < w; ++x) {
-      const int left = std::max(0, x - windowLeftHalf);
-      const int right = std::min(w, x + windowRightHalf);  // exclusive
-      const int area = (bottom - top) * (right - left);
-      assert(area > 0);  // because windowSize > 0 and w > 0 and h > 0
-      const QRect rect(left, top, right - left, bottom - top);
-      const double windowSum = integralImage.sum(rect);
-
-      const double rArea = 1.0 / area;
-      const double mean = windowSum * rArea + 0.5 + delta;
-      const int imean = (int) ((mean < 0.0) ? 0.0 : (mean < 255.0) ? mean : 255.0);
-      gmeanLine[x] = imean;
+  uint8_t* const gmeanData = gmeanLine;
+  parallelForBands(h, 16, [&](const int yBegin, const int yEnd) {
+    std::vector<double> means(w);
+    uint8_t* gmeanLine = gmeanData + yBegin * gmeanBpl;
+    for (int y = yBegin; y < yEnd; ++y) {
+      windowStats.computeLine(y, means.data());
+      for (int x = 0; x < w; ++x) {
+        const double mean = means[x] + 0.5 + delta;
+        const int imean = (int) ((mean < 0.0) ? 0.0 : (mean < 255.0) ? mean : 255.0);
+        gmeanLine[x] = imean;
+      }
+      gmeanLine += gmeanBpl;
     }
-    gmeanLine += gmeanBpl;
-  }
+  });
+
+  // Per-line sums are accumulated in order afterwards, to get exactly
+  // the same result regardless of how the lines were split into bands.
+  std::vector<double> lineSumsG(h);
+  std::vector<double> lineSumsGi(h);
+  const uint8_t* const grayData = gray.bits();
+  parallelForBands(h, 16, [&](const int yBegin, const int yEnd) {
+    const uint8_t* grayLine = grayData + yBegin * grayBpl;
+    const uint8_t* gmeanLine = gmeanData + yBegin * gmeanBpl;
+    for (int y = yBegin; y < yEnd; y++) {
+      double sum_gl = 0.0;
+      double sum_gil = 0.0;
+      for (int x = 0; x < w; x++) {
+        double gi = grayLine[x];
+        double g = gmeanLine[x];
+        g -= gi;
+        g = (g < 0.0) ? -g : g;
+        gi *= g;
+        sum_gl += g;
+        sum_gil += gi;
+      }
+      lineSumsG[y] = sum_gl;
+      lineSumsGi[y] = sum_gil;
+      grayLine += grayBpl;
+      gmeanLine += gmeanBpl;
+    }
+  });
 
   double gvalue = 127.5;
   double sum_g = 0.0, sum_gi = 0.0;
-  grayLine = gray.bits();
-  gmeanLine = gmean.bits();
   for (int y = 0; y < h; y++) {
-    double sum_gl = 0.0;
-    double sum_gil = 0.0;
-    for (int x = 0; x < w; x++) {
-      double gi = grayLine[x];
-      double g = gmeanLine[x];
-      g -= gi;
-      g = (g < 0.0) ? -g : g;
-      gi *= g;
-      sum_gl += g;
-      sum_gil += gi;
-    }
-    sum_g += sum_gl;
-    sum_gi += sum_gil;
-    grayLine += grayBpl;
-    gmeanLine += gmeanBpl;
+    sum_g += lineSumsG[y];
+    sum_gi += lineSumsGi[y];
   }
   gvalue = (sum_g > 0.0) ? (sum_gi / sum_g) : gvalue;
 
   double const meanGrad = gvalue * (1.0 - k);
 
   BinaryImage bwImg(w, h);
-  uint32_t* bwLine = bwImg.data();
+  uint32_t* const bwData = bwImg.data();
   const int bwWpl = bwImg.wordsPerLine();
 
-  grayLine = gray.bits();
-  gmeanLine = gmean.bits();
-  for (int y = 0; y < h; ++y) {
-    for (int x = 0; x < w; ++x) {
-      const double origin = grayLine[x];
-      const double mean = gmeanLine[x];
-      const double threshold = meanGrad + mean * k;
-      const uint32_t msb = uint32_t(1) << 31;
-      const uint32_t mask = msb >> (x & 31);
-      if ((grayLine[x] < lowerBound) || ((grayLine[x] <= upperBound) && (origin < threshold))) {
-        // black
-        bwLine[x >> 5] |= mask;
-      } else {
-        // white
-        bwLine[x >> 5] &= ~mask;
-      }
+  parallelForBands(h, 16, [&](const int yBegin, const int yEnd) {
+    const uint8_t* grayLine = grayData + yBegin * grayBpl;
+    const uint8_t* gmeanLine = gmeanData + yBegin * gmeanBpl;
+    uint32_t* bwLine = bwData + yBegin * bwWpl;
+    for (int y = yBegin; y < yEnd; ++y) {
+      packLine(bwLine, w, [&](const int x) {
+        const double origin = grayLine[x];
+        const double mean = gmeanLine[x];
+        const double threshold = meanGrad + mean * k;
+        return (grayLine[x] < lowerBound) || ((grayLine[x] <= upperBound) && (origin < threshold));
+      });
+      grayLine += grayBpl;
+      gmeanLine += gmeanBpl;
+      bwLine += bwWpl;
     }
-    grayLine += grayBpl;
-    gmeanLine += gmeanBpl;
-    bwLine += bwWpl;
-  }
+  });
   return bwImg;
 }  // binarizeGrad
 
@@ -709,51 +639,43 @@ BinaryImage binarizeEdgeDiv(const QImage& src,
     grayLine += grayBpl;
   }
 
-  const int windowLowerHalf = windowSize.height() >> 1;
-  const int windowUpperHalf = windowSize.height() - windowLowerHalf;
-  const int windowLeftHalf = windowSize.width() >> 1;
-  const int windowRightHalf = windowSize.width() - windowLeftHalf;
-
-  grayLine = gray.bits();
-  for (int y = 0; y < h; ++y) {
-    const int top = std::max(0, y - windowLowerHalf);
-    const int bottom = std::min(h, y + windowUpperHalf);  // exclusive
-    for (int x = 0; x < w; ++x) {
-      const int left = std::max(0, x - windowLeftHalf);
-      const int right = std::min(w, x + windowRightHalf);  // exclusive
-      const int area = (bottom - top) * (right - left);
-      assert(area > 0);  // because windowSize > 0 and w > 0 and h > 0
-      const QRect rect(left, top, right - left, bottom - top);
-      const double windowSum = integralImage.sum(rect);
-
-      const double rArea = 1.0 / area;
-      const double mean = windowSum * rArea;
-      const double origin = grayLine[x];
-      double retval = origin;
-      if (kep > 0.0) {
-        // EdgePlus
-        // edge = I / blur (shift = -0.5) {0.0 .. >1.0}, mean value = 0.5
-        const double edge = (retval + 1) / (mean + 1) - 0.5;
-        // edgeplus = I * edge, mean value = 0.5 * mean(I)
-        const double edgeplus = origin * edge;
-        // return k * edgeplus + (1 - k) * I
-        retval = kep * edgeplus + (1.0 - kep) * origin;
-      }
-      if (kbd > 0.0) {
-        // BlurDiv
-        // edge = blur / I (shift = -0.5) {0.0 .. >1.0}, mean value = 0.5
-        const double edgeinv = (mean + 1) / (retval + 1) - 0.5;
-        // edgenorm = edge * k + max * (1 - k), mean value = {0.5 .. 1.0} * mean(I)
-        const double edgenorm = kbd * edgeinv + (1.0 - kbd);
-        // return I / edgenorm
-        retval = (edgenorm > 0.0) ? (origin / edgenorm) : origin;
+  const LocalWindowStats windowStats(integralImage, nullptr, QSize(w, h), windowSize);
+
+  uint8_t* const grayData = gray.bits();
+  parallelForBands(h, 16, [&](const int yBegin, const int yEnd) {
+    std::vector<double> means(w);
+    uint8_t* grayLine = grayData + yBegin * grayBpl;
+    for (int y = yBegin; y < yEnd; ++y) {
+      windowStats.computeLine(y, means.data());
+      for (int x = 0; x < w; ++x) {
+        const double mean = means[x];
+        const double origin = grayLine[x];
+        double retval = origin;
+        if (kep > 0.0) {
+          // EdgePlus
+          // edge = I / blur (shift = -0.5) {0.0 .. >1.0}, mean value = 0.5
+          const double edge = (retval + 1) / (mean + 1) - 0.5;
+          // edgeplus = I * edge, mean value = 0.5 * mean(I)
+          const double edgeplus = origin * edge;
+          // return k * edgeplus + (1 - k) * I
+          retval = kep * edgeplus + (1.0 - kep) * origin;
+        }
+        if (kbd > 0.0) {
+          // BlurDiv
+          // edge = blur / I (shift = -0.5) {0.0 .. >1.0}, mean value = 0.5
+          const double edgeinv = (mean + 1) / (retval + 1) - 0.5;
+          // edgenorm = edge * k + max * (1 - k), mean value = {0.5 .. 1.0} * mean(I)
+          const double edgenorm = kbd * edgeinv + (1.0 - kbd);
+          // return I / edgenorm
+          retval = (edgenorm > 0.0) ? (origin / edgenorm) : origin;
+        }
+        // trim value {0..255}
+        retval = (retval < 0.0) ? 0.0 : (retval < 255.0) ? retval : 255.0;
+        grayLine[x] = (int) retval;
       }
-      // trim value {0..255}
-      retval = (retval < 0.0) ? 0.0 : (retval < 255.0) ? retval : 255.0;
-      grayLine[x] = (int) retval;
+      grayLine += grayBpl;
     }
-    grayLine += grayBpl;
-  }
+  });
   return BinaryImage(gray, (BinaryThreshold::otsuThreshold(gray) + delta));
 }  // binarizeBlurDiv
 
@@ -5,14 +5,17 @@
 
 #include <QImage>
 #include <cmath>
+#include <mutex>
 #include <stdexcept>
+#include <vector>
 
 #include "BinaryImage.h"
 #include "BinaryThreshold.h"
 #include "ConnectivityMap.h"
 #include "GrayImage.h"
-#include "ImageCombination.h"
+#include "Grayscale.h"
 #include "InfluenceMap.h"
+#include "ParallelFor.h"
 #include "RasterOp.h"
 
 namespace imageproc {
@@ -100,41 +103,6 @@ bool ComponentCleaner::eligibleForDelete(const Component& component, const Bound
   return (averageWidth <= m_minAverageWidthThreshold);
 }
 
-enum RgbChannel { RED_CHANNEL, GREEN_CHANNEL, BLUE_CHANNEL };
-
-GrayImage extractRgbChannel(const QImage& image, const RgbChannel channel) {
-  if ((image.format() != QImage::Format_RGB32) && (image.format() != QImage::Format_ARGB32)) {
-    throw std::invalid_argument("ColorSegmenter: wrong image format.");
-  }
-
-  GrayImage dst(image.size());
-  const auto* imgLine = reinterpret_cast<const uint32_t*>(image.bits());
-  const int imgStride = image.bytesPerLine() / sizeof(uint32_t);
-  uint8_t* dstLine = dst.data();
-  const int dstStride = dst.stride();
-  const int width = image.width();
-  const int height = image.height();
-
-  for (int y = 0; y < height; ++y) {
-    for (int x = 0; x < width; ++x) {
-      switch (channel) {
-        case RED_CHANNEL:
-          dstLine[x] = static_cast<uint8_t>((imgLine[x] >> 16) & 0xff);
-          break;
-        case GREEN_CHANNEL:
-          dstLine[x] = static_cast<uint8_t>((imgLine[x] >> 8) & 0xff);
-          break;
-        case BLUE_CHANNEL:
-          dstLine[x] = static_cast<uint8_t>(imgLine[x] & 0xff);
-          break;
-      }
-    }
-    imgLine += imgStride;
-    dstLine += dstStride;
-  }
-  return dst;
-}
-
 inline BinaryThreshold adjustThreshold(const BinaryThreshold threshold, const int adjustment) {
   return qBound(1, int(threshold) + adjustment, 255);
 }
@@ -171,17 +139,110 @@ void reduceNoise(ConnectivityMap& segmentsMap, const Dpi& dpi, const int noiseTh
   segmentsMap.removeComponents(labels);
 }
 
-QImage prepareToMap(const QImage& colorImage, const BinaryImage& image) {
-  QImage dst = colorImage;
-  applyMask(dst, image);
-  return dst;
+/**
+ * The class of a pixel has a bit set for each channel darker than its threshold.
+ */
+enum ColorClass : uint8_t {
+  NO_CLASS = 0,
+  BLUE_CLASS = 1,
+  GREEN_CLASS = 2,
+  CYAN_CLASS = GREEN_CLASS | BLUE_CLASS,
+  RED_CLASS = 4,
+  MAGENTA_CLASS = RED_CLASS | BLUE_CLASS,
+  YELLOW_CLASS = RED_CLASS | GREEN_CLASS,
+  BLACK_CLASS = RED_CLASS | GREEN_CLASS | BLUE_CLASS
+};
+
+/**
+ * Builds the histograms of the color channels of \p colorImage with the pixels
+ * outside of \p mask taken as white, as if the mask was applied to the image.
+ */
+void buildChannelHistograms(const QImage& colorImage,
+                            const BinaryImage& mask,
+                            GrayscaleHistogram& redHist,
+                            GrayscaleHistogram& greenHist,
+                            GrayscaleHistogram& blueHist) {
+  const auto* const imgData = reinterpret_cast<const uint32_t*>(colorImage.bits());
+  const int imgStride = colorImage.bytesPerLine() / sizeof(uint32_t);
+  const uint32_t* const maskData = mask.data();
+  const int maskStride = mask.wordsPerLine();
+  const int width = colorImage.width();
+  const int height = colorImage.height();
+  const uint32_t msb = uint32_t(1) << 31;
+
+  std::mutex histMutex;
+  parallelForBands(height, 64, [&](const int yBegin, const int yEnd) {
+    std::vector<int> bandHist(3 * 256, 0);
+    int* const red = bandHist.data();
+    int* const green = red + 256;
+    int* const blue = green + 256;
+    int numMaskedOut = 0;
+
+    const uint32_t* imgLine = imgData + yBegin * imgStride;
+    const uint32_t* maskLine = maskData + yBegin * maskStride;
+    for (int y = yBegin; y < yEnd; ++y) {
+      for (int x = 0; x < width; ++x) {
+        if (!(maskLine[x >> 5] & (msb >> (x & 31)))) {
+          ++numMaskedOut;
+          continue;
+        }
+        const uint32_t pixel = imgLine[x];
+        ++red[(pixel >> 16) & 0xff];
+        ++green[(pixel >> 8) & 0xff];
+        ++blue[pixel & 0xff];
+      }
+      imgLine += imgStride;
+      maskLine += maskStride;
+    }
+    red[0xff] += numMaskedOut;
+    green[0xff] += numMaskedOut;
+    blue[0xff] += numMaskedOut;
+
+    std::lock_guard<std::mutex> guard(histMutex);
+    for (int i = 0; i < 256; ++i) {
+      redHist[i] += red[i];
+      greenHist[i] += green[i];
+      blueHist[i] += blue[i];
+    }
+  });
 }
 
-BinaryImage componentFromChannel(const QImage& colorImage, const RgbChannel channel, const int adjustment) {
-  GrayImage channelImage = extractRgbChannel(colorImage, channel);
-  BinaryThreshold threshold = BinaryThreshold::otsuThreshold(channelImage);
-  BinaryImage component = BinaryImage(channelImage, adjustThreshold(threshold, adjustment));
-  return component;
+/**
+ * Classifies every pixel of \p colorImage in a single pass.
+ * The pixels outside of \p mask get NO_CLASS.
+ */
+std::vector<uint8_t> classifyPixels(const QImage& colorImage,
+                                    const BinaryImage& mask,
+                                    const int redThreshold,
+                                    const int greenThreshold,
+                                    const int blueThreshold) {
+  const auto* const imgData = reinterpret_cast<const uint32_t*>(colorImage.bits());
+  const int imgStride = colorImage.bytesPerLine() / sizeof(uint32_t);
+  const uint32_t* const maskData = mask.data();
+  const int maskStride = mask.wordsPerLine();
+  const int width = colorImage.width();
+  const int height = colorImage.height();
+  const uint32_t msb = uint32_t(1) << 31;
+
+  std::vector<uint8_t> classes(size_t(width) * height);
+  parallelForBands(height, 64, [&](const int yBegin, const int yEnd) {
+    const uint32_t* imgLine = imgData + yBegin * imgStride;
+    const uint32_t* maskLine = maskData + yBegin * maskStride;
+    uint8_t* classLine = classes.data() + size_t(yBegin) * width;
+    for (int y = yBegin; y < yEnd; ++y) {
+      for (int x = 0; x < width; ++x) {
+        const uint32_t pixel = imgLine[x];
+        const int pixelClass = ((int((pixel >> 16) & 0xff) < redThreshold) ? RED_CLASS : NO_CLASS)
+                               | ((int((pixel >> 8) & 0xff) < greenThreshold) ? GREEN_CLASS : NO_CLASS)
+                               | ((int(pixel & 0xff) < blueThreshold) ? BLUE_CLASS : NO_CLASS);
+        classLine[x] = (maskLine[x >> 5] & (msb >> (x & 31))) ? static_cast<uint8_t>(pixelClass) : NO_CLASS;
+      }
+      imgLine += imgStride;
+      maskLine += maskStride;
+      classLine += width;
+    }
+  });
+  return classes;
 }
 
 ConnectivityMap buildMapFromRgb(const BinaryImage& image,
@@ -191,43 +252,21 @@ ConnectivityMap buildMapFromRgb(const BinaryImage& image,
                                 const int redThresholdAdjustment,
                                 const int greenThresholdAdjustment,
                                 const int blueThresholdAdjustment) {
-  QImage imageToMap = prepareToMap(colorImage, image);
-
-  BinaryImage redComponent = componentFromChannel(imageToMap, RED_CHANNEL, redThresholdAdjustment);
-  BinaryImage greenComponent = componentFromChannel(imageToMap, GREEN_CHANNEL, greenThresholdAdjustment);
-  BinaryImage blueComponent = componentFromChannel(imageToMap, BLUE_CHANNEL, blueThresholdAdjustment);
-
-  BinaryImage yellowComponent(redComponent);
-  rasterOp<RopAnd<RopSrc, RopDst>>(yellowComponent, greenComponent);
-  BinaryImage magentaComponent(redComponent);
-  rasterOp<RopAnd<RopSrc, RopDst>>(magentaComponent, blueComponent);
-  BinaryImage cyanComponent(greenComponent);
-  rasterOp<RopAnd<RopSrc, RopDst>>(cyanComponent, blueComponent);
-
-  BinaryImage blackComponent(blueComponent);
-  rasterOp<RopAnd<RopSrc, RopDst>>(blackComponent, yellowComponent);
-
-  rasterOp<RopSubtract<RopDst, RopSrc>>(redComponent, blackComponent);
-  rasterOp<RopSubtract<RopDst, RopSrc>>(greenComponent, blackComponent);
-  rasterOp<RopSubtract<RopDst, RopSrc>>(blueComponent, blackComponent);
-  rasterOp<RopSubtract<RopDst, RopSrc>>(yellowComponent, blackComponent);
-  rasterOp<RopSubtract<RopDst, RopSrc>>(magentaComponent, blackComponent);
-  rasterOp<RopSubtract<RopDst, RopSrc>>(cyanComponent, blackComponent);
-
-  rasterOp<RopSubtract<RopDst, RopSrc>>(redComponent, yellowComponent);
-  rasterOp<RopSubtract<RopDst, RopSrc>>(redComponent, magentaComponent);
-  rasterOp<RopSubtract<RopDst, RopSrc>>(greenComponent, yellowComponent);
-  rasterOp<RopSubtract<RopDst, RopSrc>>(greenComponent, cyanComponent);
-  rasterOp<RopSubtract<RopDst, RopSrc>>(blueComponent, magentaComponent);
-  rasterOp<RopSubtract<RopDst, RopSrc>>(blueComponent, cyanComponent);
-
-  ConnectivityMap segmentsMap = ConnectivityMap(blackComponent, CONN8);
-  segmentsMap.addComponents(yellowComponent, CONN8);
-  segmentsMap.addComponents(magentaComponent, CONN8);
-  segmentsMap.addComponents(cyanComponent, CONN8);
-  segmentsMap.addComponents(redComponent, CONN8);
-  segmentsMap.addComponents(greenComponent, CONN8);
-  segmentsMap.addComponents(blueComponent, CONN8);
+  GrayscaleHistogram redHist;
+  GrayscaleHistogram greenHist;
+  GrayscaleHistogram blueHist;
+  buildChannelHistograms(colorImage, image, redHist, greenHist, blueHist);
+
+  const std::vector<uint8_t> classes
+      = classifyPixels(colorImage, image,
+                       adjustThreshold(BinaryThreshold::otsuThreshold(redHist), redThresholdAdjustment),
+                       adjustThreshold(BinaryThreshold::otsuThreshold(greenHist), greenThresholdAdjustment),
+                       adjustThreshold(BinaryThreshold::otsuThreshold(blueHist), blueThresholdAdjustment));
+
+  // Black components get the lowest labels, then the ones dark in two channels, then in one.
+  const std::vector<uint8_t> classOrder{BLACK_CLASS, YELLOW_CLASS, MAGENTA_CLASS, CYAN_CLASS,
+                                        RED_CLASS,   GREEN_CLASS,  BLUE_CLASS};
+  ConnectivityMap segmentsMap(image.size(), classes.data(), colorImage.width(), classOrder, CONN8);
 
   reduceNoise(segmentsMap, dpi, noiseThreshold);
 
@@ -5,13 +5,252 @@
 
 #include <QDebug>
 #include <QImage>
+#include <algorithm>
 #include <stdexcept>
 
 #include "BinaryImage.h"
 #include "BitOps.h"
 #include "InfluenceMap.h"
+#include "ParallelFor.h"
 
 namespace imageproc {
+namespace {
+/**
+ * A horizontal run of black pixels, with both ends inclusive.
+ */
+struct Run {
+  int first;
+  int last;
+};
+
+
+/**
+ * A horizontal run of pixels of the same class, with both ends inclusive.
+ */
+struct ClassRun {
+  int first;
+  int last;
+  // The position of the class in the labelling order.
+  int rank;
+};
+
+inline bool sameClass(const Run&, const Run&) {
+  return true;
+}
+
+inline bool sameClass(const ClassRun& run1, const ClassRun& run2) {
+  return run1.rank == run2.rank;
+}
+
+
+/**
+ * Returns the bits of a line word where runs of black pixels start or end,
+ * given the pixels preceding and following the word.
+ */
+inline uint32_t runStarts(const uint32_t word, const uint32_t prevWord) {
+  return word & ~((word >> 1) | (prevWord << 31));
+}
+
+inline uint32_t runEnds(const uint32_t word, const uint32_t nextWord) {
+  return word & ~((word << 1) | (nextWord >> 31));
+}
+
+/**
+ * Calls \p func(wordIdx, starts, ends) for every word of a line,
+ * with the pixels past the width of the image taken as white.
+ */
+template <typename Func>
+void forEachLineWord(const uint32_t* line, const int width, Func func) {
+  const int lastWordIdx = (width - 1) >> 5;
+  const uint32_t lastWordMask = ~uint32_t(0) << (31 - ((width - 1) & 31));
+
+  uint32_t prevWord = 0;
+  uint32_t word = (lastWordIdx == 0) ? (line[0] & lastWordMask) : line[0];
+  for (int i = 0; i <= lastWordIdx; ++i) {
+    uint32_t nextWord = 0;
+    if (i + 1 < lastWordIdx) {
+      nextWord = line[i + 1];
+    } else if (i + 1 == lastWordIdx) {
+      nextWord = line[i + 1] & lastWordMask;
+    }
+    func(i, runStarts(word, prevWord), runEnds(word, nextWord));
+    prevWord = word;
+    word = nextWord;
+  }
+}
+
+int countRuns(const uint32_t* line, const int width) {
+  int numRuns = 0;
+  forEachLineWord(line, width, [&numRuns](int, const uint32_t starts, uint32_t) {
+    numRuns += countNonZeroBits(starts);
+  });
+  return numRuns;
+}
+
+void extractRuns(const uint32_t* line, const int width, Run* runs) {
+  const uint32_t msb = uint32_t(1) << 31;
+  Run* runWithoutEnd = runs;
+  forEachLineWord(line, width, [&runs, &runWithoutEnd, msb](const int wordIdx, uint32_t starts, uint32_t ends) {
+    const int offset = wordIdx << 5;
+    while (starts) {
+      const int bit = countMostSignificantZeroes(starts);
+      starts &= ~(msb >> bit);
+      runs->first = offset + bit;
+      ++runs;
+    }
+    while (ends) {
+      const int bit = countMostSignificantZeroes(ends);
+      ends &= ~(msb >> bit);
+      runWithoutEnd->last = offset + bit;
+      ++runWithoutEnd;
+    }
+  });
+}
+
+/**
+ * Calls \p func(first, last, rank) for every run of pixels of the same class
+ * on a line, except for the runs of background classes having negative ranks.
+ */
+template <typename Func>
+void forEachClassRun(const uint8_t* line, const int width, const int* ranks, Func func) {
+  int x = 0;
+  while (x < width) {
+    const int rank = ranks[line[x]];
+    int last = x;
+    while ((last + 1 < width) && (ranks[line[last + 1]] == rank)) {
+      ++last;
+    }
+    if (rank >= 0) {
+      func(x, last, rank);
+    }
+    x = last + 1;
+  }
+}
+
+/**
+ * The roots of the sets are their smallest run indices.
+ */
+class RunSets {
+ public:
+  explicit RunSets(size_t numRuns) : m_parents(numRuns) {
+    for (size_t i = 0; i < numRuns; ++i) {
+      m_parents[i] = static_cast<uint32_t>(i);
+    }
+  }
+
+  uint32_t find(uint32_t run) {
+    while (m_parents[run] != run) {
+      m_parents[run] = m_parents[m_parents[run]];
+      run = m_parents[run];
+    }
+    return run;
+  }
+
+  void unite(const uint32_t run1, const uint32_t run2) {
+    const uint32_t root1 = find(run1);
+    const uint32_t root2 = find(run2);
+    if (root1 < root2) {
+      m_parents[root2] = root1;
+    } else if (root2 < root1) {
+      m_parents[root1] = root2;
+    }
+  }
+
+ private:
+  std::vector<uint32_t> m_parents;
+};
+
+
+/**
+ * Unites the runs of a line with the runs of the same class
+ * on the previous line they touch.
+ */
+template <typename RunType>
+void uniteWithPrevLine(RunSets& sets,
+                       const std::vector<RunType>& runs,
+                       const int prevBegin,
+                       const int prevEnd,
+                       const int begin,
+                       const int end,
+                       const Connectivity conn) {
+  // With 8-connectivity, runs touch diagonally as well.
+  const int gap = (conn == CONN8) ? 1 : 0;
+  int prev = prevBegin;
+  for (int cur = begin; cur < end; ++cur) {
+    while ((prev < prevEnd) && (runs[prev].last + gap < runs[cur].first)) {
+      ++prev;
+    }
+    // Runs of different classes may be adjacent, so a previous line run
+    // may touch the next run on this line as well, and isn't skipped yet.
+    for (int i = prev; (i < prevEnd) && (runs[i].first <= runs[cur].last + gap); ++i) {
+      if (sameClass(runs[i], runs[cur])) {
+        sets.unite(static_cast<uint32_t>(i), static_cast<uint32_t>(cur));
+      }
+    }
+  }
+}
+
+/**
+ * Collects the runs of all the lines and unites the touching ones,
+ * in parallel bands of lines.  \p countLineRuns(y) has to return the number
+ * of runs on line y and \p extractLineRuns(y, runs) has to store them.
+ * On return, lineRuns[y] is the index of the first run on line y.
+ */
+template <typename RunType, typename CountLineRuns, typename ExtractLineRuns>
+RunSets uniteRuns(const int height,
+                  const Connectivity conn,
+                  CountLineRuns countLineRuns,
+                  ExtractLineRuns extractLineRuns,
+                  std::vector<int>& lineRuns,
+                  std::vector<RunType>& runs) {
+  lineRuns.assign(height + 1, 0);
+  parallelForBands(height, 32, [&](const int begin, const int end) {
+    for (int y = begin; y < end; ++y) {
+      lineRuns[y + 1] = countLineRuns(y);
+    }
+  });
+  for (int y = 0; y < height; ++y) {
+    lineRuns[y + 1] += lineRuns[y];
+  }
+
+  runs.resize(lineRuns[height]);
+  RunSets sets(runs.size());
+  std::vector<char> bandStarts(height, 0);
+  parallelForBands(height, 32, [&](const int begin, const int end) {
+    bandStarts[begin] = 1;
+    for (int y = begin; y < end; ++y) {
+      extractLineRuns(y, runs.data() + lineRuns[y]);
+      if (y > begin) {
+        uniteWithPrevLine(sets, runs, lineRuns[y - 1], lineRuns[y], lineRuns[y], lineRuns[y + 1], conn);
+      }
+    }
+  });
+  for (int y = 1; y < height; ++y) {
+    if (bandStarts[y]) {
+      uniteWithPrevLine(sets, runs, lineRuns[y - 1], lineRuns[y], lineRuns[y], lineRuns[y + 1], conn);
+    }
+  }
+  return sets;
+}
+
+template <typename RunType>
+void fillRuns(uint32_t* const map,
+              const int stride,
+              const int height,
+              const std::vector<int>& lineRuns,
+              const std::vector<RunType>& runs,
+              const std::vector<uint32_t>& labels) {
+  parallelForBands(height, 32, [&](const int begin, const int end) {
+    for (int y = begin; y < end; ++y) {
+      uint32_t* const line = map + y * stride;
+      for (int i = lineRuns[y]; i < lineRuns[y + 1]; ++i) {
+        std::fill(line + runs[i].first, line + runs[i].last + 1, labels[i]);
+      }
+    }
+  });
+}
+}  // namespace
+
 const uint32_t ConnectivityMap::BACKGROUND = ~uint32_t(0);
 const uint32_t ConnectivityMap::UNTAGGED_FG = BACKGROUND - 1;
 
@@ -39,28 +278,31 @@ ConnectivityMap::ConnectivityMap(const BinaryImage& image, const Connectivity co
   const int width = m_size.width();
   const int height = m_size.height();
 
-  m_data.resize((width + 2) * (height + 2), BACKGROUND);
+  m_data.resize((width + 2) * (height + 2), 0);
   m_stride = width + 2;
   m_plainData = &m_data[0] + 1 + m_stride;
 
-  uint32_t* dst = m_plainData;
-  const int dstStride = m_stride;
-
-  const uint32_t* src = image.data();
-  const int srcStride = image.wordsPerLine();
+  labelRuns(image, conn);
+}
 
-  const uint32_t msb = uint32_t(1) << 31;
-  for (int y = 0; y < height; ++y) {
-    for (int x = 0; x < width; ++x) {
-      if (src[x >> 5] & (msb >> (x & 31))) {
-        dst[x] = UNTAGGED_FG;
-      }
-    }
-    src += srcStride;
-    dst += dstStride;
+ConnectivityMap::ConnectivityMap(const QSize size,
+                                 const uint8_t* const classes,
+                                 const int classesPerLine,
+                                 const std::vector<uint8_t>& classOrder,
+                                 const Connectivity conn)
+    : m_plainData(nullptr), m_size(size), m_stride(0), m_maxLabel(0) {
+  if (m_size.isEmpty()) {
+    return;
   }
 
-  assignIds(conn);
+  const int width = m_size.width();
+  const int height = m_size.height();
+
+  m_data.resize((width + 2) * (height + 2), 0);
+  m_stride = width + 2;
+  m_plainData = &m_data[0] + 1 + m_stride;
+
+  labelClassRuns(classes, classesPerLine, classOrder, conn);
 }
 
 ConnectivityMap::ConnectivityMap(const ConnectivityMap& other)
@@ -302,6 +544,93 @@ void ConnectivityMap::copyFromInfluenceMap(const InfluenceMap& imap) {
   }
 }
 
+/**
+ * Labels the runs of black pixels of \p image, rather than individual pixels.
+ * Lines are processed in parallel bands: the runs are extracted and the runs
+ * of adjacent lines within a band are united, then the bands are stitched
+ * together.  A component gets labelled by the first of its runs in raster
+ * order, so the labels come out exactly as assignIds() would produce them.
+ */
+void ConnectivityMap::labelRuns(const BinaryImage& image, const Connectivity conn) {
+  const int width = m_size.width();
+  const int height = m_size.height();
+  const uint32_t* const imageData = image.data();
+  const int imageStride = image.wordsPerLine();
+
+  std::vector<int> lineRuns;
+  std::vector<Run> runs;
+  RunSets sets = uniteRuns(
+      height, conn, [&](const int y) { return countRuns(imageData + y * imageStride, width); },
+      [&](const int y, Run* lineRunsData) { extractRuns(imageData + y * imageStride, width, lineRunsData); }, lineRuns,
+      runs);
+
+  std::vector<uint32_t> labels(runs.size());
+  uint32_t nextLabel = 1;
+  for (uint32_t i = 0; i < labels.size(); ++i) {
+    const uint32_t root = sets.find(i);
+    labels[i] = (root == i) ? nextLabel++ : labels[root];
+  }
+
+  fillRuns(m_plainData, m_stride, height, lineRuns, runs, labels);
+
+  m_maxLabel = nextLabel - 1;
+}  // ConnectivityMap::labelRuns
+
+/**
+ * The same as labelRuns(), but with the runs of a class united only with
+ * the runs of that class.  The components of each class are numbered
+ * in raster order, after the components of the classes preceding it.
+ */
+void ConnectivityMap::labelClassRuns(const uint8_t* const classes,
+                                     const int classesPerLine,
+                                     const std::vector<uint8_t>& classOrder,
+                                     const Connectivity conn) {
+  const int width = m_size.width();
+  const int height = m_size.height();
+  const int numClasses = static_cast<int>(classOrder.size());
+
+  int ranks[256];
+  std::fill(ranks, ranks + 256, -1);
+  for (int rank = numClasses - 1; rank >= 0; --rank) {
+    ranks[classOrder[rank]] = rank;
+  }
+
+  std::vector<int> lineRuns;
+  std::vector<ClassRun> runs;
+  RunSets sets = uniteRuns(
+      height, conn,
+      [&](const int y) {
+        int numRuns = 0;
+        forEachClassRun(classes + y * classesPerLine, width, ranks, [&numRuns](int, int, int) { ++numRuns; });
+        return numRuns;
+      },
+      [&](const int y, ClassRun* lineRunsData) {
+        forEachClassRun(classes + y * classesPerLine, width, ranks,
+                        [&lineRunsData](const int first, const int last, const int rank) {
+                          *lineRunsData = ClassRun{first, last, rank};
+                          ++lineRunsData;
+                        });
+      },
+      lineRuns, runs);
+
+  std::vector<uint32_t> labels(runs.size());
+  std::vector<uint32_t> classLabelOffsets(numClasses + 1, 0);
+  for (uint32_t i = 0; i < labels.size(); ++i) {
+    const uint32_t root = sets.find(i);
+    labels[i] = (root == i) ? ++classLabelOffsets[runs[i].rank + 1] : labels[root];
+  }
+  for (int rank = 0; rank < numClasses; ++rank) {
+    classLabelOffsets[rank + 1] += classLabelOffsets[rank];
+  }
+  for (uint32_t i = 0; i < labels.size(); ++i) {
+    labels[i] += classLabelOffsets[runs[i].rank];
+  }
+
+  fillRuns(m_plainData, m_stride, height, lineRuns, runs, labels);
+
+  m_maxLabel = classLabelOffsets[numClasses];
+}  // ConnectivityMap::labelClassRuns
+
 void ConnectivityMap::assignIds(const Connectivity conn) {
   const uint32_t numInitialTags = initialTagging();
   std::vector<uint32_t> table(numInitialTags, 0);
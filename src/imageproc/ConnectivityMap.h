@@ -48,6 +48,10 @@ class ConnectivityMap {
 
   /**
    * \brief Labels components in a binary image.
+   *
+   * Works on runs of black pixels rather than individual pixels,
+   * in parallel bands of lines.  The labels are the same the other
+   * constructors would assign.
    */
   ConnectivityMap(const BinaryImage& image, Connectivity conn);
 
@@ -58,6 +62,21 @@ class ConnectivityMap {
   template <typename T>
   ConnectivityMap(QSize size, const T* data, int unitsPerLine, Connectivity conn);
 
+  /**
+   * \brief Labels components in a plane of pixel classes.
+   *
+   * Neighboring pixels are connected only if they are of the same class.
+   * The classes are labelled one after another, in the order they appear
+   * in \p classOrder, while the classes not appearing there are background.
+   * The labels are the same as those of a map built from a binary image
+   * of the first class and extended by addComponents() with the rest.
+   */
+  ConnectivityMap(QSize size,
+                  const uint8_t* classes,
+                  int classesPerLine,
+                  const std::vector<uint8_t>& classOrder,
+                  Connectivity conn);
+
   ConnectivityMap(const ConnectivityMap& other);
 
   /**
@@ -204,6 +223,13 @@ class ConnectivityMap {
  private:
   void copyFromInfluenceMap(const InfluenceMap& imap);
 
+  void labelRuns(const BinaryImage& image, Connectivity conn);
+
+  void labelClassRuns(const uint8_t* classes,
+                      int classesPerLine,
+                      const std::vector<uint8_t>& classOrder,
+                      Connectivity conn);
+
   void assignIds(Connectivity conn);
 
   uint32_t initialTagging();
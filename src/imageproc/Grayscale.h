@@ -17,6 +17,11 @@ class BinaryImage;
 
 class GrayscaleHistogram {
  public:
+  /**
+   * \brief Constructs a histogram with no pixels counted.
+   */
+  GrayscaleHistogram() = default;
+
   explicit GrayscaleHistogram(const QImage& img);
 
   GrayscaleHistogram(const QImage& img, const BinaryImage& mask);
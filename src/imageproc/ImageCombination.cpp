@@ -10,85 +10,99 @@
 #include <unordered_set>
 
 #include "BinaryImage.h"
+#include "ParallelFor.h"
 
 namespace imageproc {
 namespace impl {
 template <typename MixedPixel>
 void combineImagesMono(QImage& mixedImage, const BinaryImage& foreground) {
-  auto* mixedLine = reinterpret_cast<MixedPixel*>(mixedImage.bits());
+  auto* const mixedData = reinterpret_cast<MixedPixel*>(mixedImage.bits());
   const int mixedStride = mixedImage.bytesPerLine() / sizeof(MixedPixel);
-  const uint32_t* foregroundLine = foreground.data();
+  const uint32_t* const foregroundData = foreground.data();
   const int foregroundStride = foreground.wordsPerLine();
   const int width = mixedImage.width();
   const int height = mixedImage.height();
   const uint32_t msb = uint32_t(1) << 31;
 
-  for (int y = 0; y < height; ++y) {
-    for (int x = 0; x < width; ++x) {
-      if (foregroundLine[x >> 5] & (msb >> (x & 31))) {
-        uint32_t tmp = foregroundLine[x >> 5];
-        tmp >>= (31 - (x & 31));
-        tmp &= uint32_t(1);
-
-        --tmp;
-        tmp |= 0xff000000;
-        mixedLine[x] = static_cast<MixedPixel>(tmp);
+  parallelForBands(height, 16, [&](const int yBegin, const int yEnd) {
+    auto* mixedLine = mixedData + yBegin * mixedStride;
+    const uint32_t* foregroundLine = foregroundData + yBegin * foregroundStride;
+    for (int y = yBegin; y < yEnd; ++y) {
+      for (int x = 0; x < width; ++x) {
+        if (foregroundLine[x >> 5] & (msb >> (x & 31))) {
+          uint32_t tmp = foregroundLine[x >> 5];
+          tmp >>= (31 - (x & 31));
+          tmp &= uint32_t(1);
+
+          --tmp;
+          tmp |= 0xff000000;
+          mixedLine[x] = static_cast<MixedPixel>(tmp);
+        }
       }
+      mixedLine += mixedStride;
+      foregroundLine += foregroundStride;
     }
-    mixedLine += mixedStride;
-    foregroundLine += foregroundStride;
-  }
+  });
 }
 
 template <typename MixedPixel>
 void combineImagesMono(QImage& mixedImage, const BinaryImage& foreground, const BinaryImage& mask) {
-  auto* mixedLine = reinterpret_cast<MixedPixel*>(mixedImage.bits());
+  auto* const mixedData = reinterpret_cast<MixedPixel*>(mixedImage.bits());
   const int mixedStride = mixedImage.bytesPerLine() / sizeof(MixedPixel);
-  const uint32_t* foregroundLine = foreground.data();
+  const uint32_t* const foregroundData = foreground.data();
   const int foregroundStride = foreground.wordsPerLine();
-  const uint32_t* maskLine = mask.data();
+  const uint32_t* const maskData = mask.data();
   const int maskStride = mask.wordsPerLine();
   const int width = mixedImage.width();
   const int height = mixedImage.height();
   const uint32_t msb = uint32_t(1) << 31;
 
-  for (int y = 0; y < height; ++y) {
-    for (int x = 0; x < width; ++x) {
-      if (maskLine[x >> 5] & (msb >> (x & 31))) {
-        uint32_t tmp = foregroundLine[x >> 5];
-        tmp >>= (31 - (x & 31));
-        tmp &= uint32_t(1);
-
-        --tmp;
-        tmp |= 0xff000000;
-        mixedLine[x] = static_cast<MixedPixel>(tmp);
+  parallelForBands(height, 16, [&](const int yBegin, const int yEnd) {
+    auto* mixedLine = mixedData + yBegin * mixedStride;
+    const uint32_t* foregroundLine = foregroundData + yBegin * foregroundStride;
+    const uint32_t* maskLine = maskData + yBegin * maskStride;
+    for (int y = yBegin; y < yEnd; ++y) {
+      for (int x = 0; x < width; ++x) {
+        if (maskLine[x >> 5] & (msb >> (x & 31))) {
+          uint32_t tmp = foregroundLine[x >> 5];
+          tmp >>= (31 - (x & 31));
+          tmp &= uint32_t(1);
+
+          --tmp;
+          tmp |= 0xff000000;
+          mixedLine[x] = static_cast<MixedPixel>(tmp);
+        }
       }
+      mixedLine += mixedStride;
+      foregroundLine += foregroundStride;
+      maskLine += maskStride;
     }
-    mixedLine += mixedStride;
-    foregroundLine += foregroundStride;
-    maskLine += maskStride;
-  }
+  });
 }
 
 template <typename MixedPixel>
 void combineImagesColor(QImage& mixedImage, const QImage& foreground) {
-  auto* mixedLine = reinterpret_cast<MixedPixel*>(mixedImage.bits());
+  auto* const mixedData = reinterpret_cast<MixedPixel*>(mixedImage.bits());
   const int mixedStride = mixedImage.bytesPerLine() / sizeof(MixedPixel);
-  const auto* foregroundLine = reinterpret_cast<const MixedPixel*>(foreground.bits());
+  const auto* const foregroundData = reinterpret_cast<const MixedPixel*>(foreground.bits());
   const int foregroundStride = foreground.bytesPerLine() / sizeof(MixedPixel);
   const int width = mixedImage.width();
   const int height = mixedImage.height();
   const auto msb = uint32_t(0x00ffffff);
 
-  for (int y = 0; y < height; ++y) {
-    for (int x = 0; x < width; ++x) {
-      if ((foregroundLine[x] & msb) != msb) {
-        mixedLine[x] = foregroundLine[x];
+  parallelForBands(height, 16, [&](const int yBegin, const int yEnd) {
+    auto* mixedLine = mixedData + yBegin * mixedStride;
+    const auto* foregroundLine = foregroundData + yBegin * foregroundStride;
+    for (int y = yBegin; y < yEnd; ++y) {
+      for (int x = 0; x < width; ++x) {
+        if ((foregroundLine[x] & msb) != msb) {
+          mixedLine[x] = foregroundLine[x];
+        }
       }
+      mixedLine += mixedStride;
+      foregroundLine += foregroundStride;
     }
-    mixedLine += mixedStride;
-    foregroundLine += foregroundStride;
-  }
+  });
 }
 
 template <typename MixedPixel, typename ForegroundPixel>
@@ -96,9 +110,9 @@ void combineImagesColor(QImage& mixedImage, const QImage& foreground);
 
 template <>
 void combineImagesColor<uint32_t, uint8_t>(QImage& mixedImage, const QImage& foreground) {
-  auto* mixedLine = reinterpret_cast<uint32_t*>(mixedImage.bits());
+  auto* const mixedData = reinterpret_cast<uint32_t*>(mixedImage.bits());
   const int mixedStride = mixedImage.bytesPerLine() / sizeof(uint32_t);
-  const auto* foregroundLine = foreground.bits();
+  const auto* const foregroundData = foreground.bits();
   const int foregroundStride = foreground.bytesPerLine();
   const int width = mixedImage.width();
   const int height = mixedImage.height();
@@ -106,16 +120,20 @@ void combineImagesColor<uint32_t, uint8_t>(QImage& mixedImage, const QImage& for
 
   const QVector<QRgb> foregroundPalette = foreground.colorTable();
 
-  for (int y = 0; y < height; ++y) {
-    for (int x = 0; x < width; ++x) {
-      uint32_t color = foregroundPalette[foregroundLine[x]];
-      if ((color & msb) != msb) {
-        mixedLine[x] = color;
+  parallelForBands(height, 16, [&](const int yBegin, const int yEnd) {
+    auto* mixedLine = mixedData + yBegin * mixedStride;
+    const auto* foregroundLine = foregroundData + yBegin * foregroundStride;
+    for (int y = yBegin; y < yEnd; ++y) {
+      for (int x = 0; x < width; ++x) {
+        uint32_t color = foregroundPalette[foregroundLine[x]];
+        if ((color & msb) != msb) {
+          mixedLine[x] = color;
+        }
       }
+      mixedLine += mixedStride;
+      foregroundLine += foregroundStride;
     }
-    mixedLine += mixedStride;
-    foregroundLine += foregroundStride;
-  }
+  });
 }
 
 void mergePalettes(QVector<uint32_t>& mixedPalette, const QVector<uint32_t>& palette) {
@@ -167,26 +185,31 @@ void combineImagesColor<uint8_t, uint8_t>(QImage& mixedImage, const QImage& fore
 
 template <typename MixedPixel>
 void combineImagesColor(QImage& mixedImage, const QImage& foreground, const BinaryImage& mask) {
-  auto* mixedLine = reinterpret_cast<MixedPixel*>(mixedImage.bits());
+  auto* const mixedData = reinterpret_cast<MixedPixel*>(mixedImage.bits());
   const int mixedStride = mixedImage.bytesPerLine() / sizeof(MixedPixel);
-  const auto* foregroundLine = reinterpret_cast<const MixedPixel*>(foreground.bits());
+  const auto* const foregroundData = reinterpret_cast<const MixedPixel*>(foreground.bits());
   const int foregroundStride = foreground.bytesPerLine() / sizeof(MixedPixel);
-  const uint32_t* maskLine = mask.data();
+  const uint32_t* const maskData = mask.data();
   const int maskStride = mask.wordsPerLine();
   const int width = mixedImage.width();
   const int height = mixedImage.height();
   const uint32_t msb = uint32_t(1) << 31;
 
-  for (int y = 0; y < height; ++y) {
-    for (int x = 0; x < width; ++x) {
-      if (maskLine[x >> 5] & (msb >> (x & 31))) {
-        mixedLine[x] = foregroundLine[x];
+  parallelForBands(height, 16, [&](const int yBegin, const int yEnd) {
+    auto* mixedLine = mixedData + yBegin * mixedStride;
+    const auto* foregroundLine = foregroundData + yBegin * foregroundStride;
+    const uint32_t* maskLine = maskData + yBegin * maskStride;
+    for (int y = yBegin; y < yEnd; ++y) {
+      for (int x = 0; x < width; ++x) {
+        if (maskLine[x >> 5] & (msb >> (x & 31))) {
+          mixedLine[x] = foregroundLine[x];
+        }
       }
+      mixedLine += mixedStride;
+      foregroundLine += foregroundStride;
+      maskLine += maskStride;
     }
-    mixedLine += mixedStride;
-    foregroundLine += foregroundStride;
-    maskLine += maskStride;
-  }
+  });
 }
 
 template <typename MixedPixel, typename ForegroundPixel>
@@ -194,11 +217,11 @@ void combineImagesColor(QImage& mixedImage, const QImage& foreground, const Bina
 
 template <>
 void combineImagesColor<uint32_t, uint8_t>(QImage& mixedImage, const QImage& foreground, const BinaryImage& mask) {
-  auto* mixedLine = reinterpret_cast<uint32_t*>(mixedImage.bits());
+  auto* const mixedData = reinterpret_cast<uint32_t*>(mixedImage.bits());
   const int mixedStride = mixedImage.bytesPerLine() / sizeof(uint32_t);
-  const auto* foregroundLine = foreground.bits();
+  const auto* const foregroundData = foreground.bits();
   const int foregroundStride = foreground.bytesPerLine();
-  const uint32_t* maskLine = mask.data();
+  const uint32_t* const maskData = mask.data();
   const int maskStride = mask.wordsPerLine();
   const int width = mixedImage.width();
   const int height = mixedImage.height();
@@ -206,17 +229,22 @@ void combineImagesColor<uint32_t, uint8_t>(QImage& mixedImage, const QImage& for
 
   const QVector<QRgb> foregroundPalette = foreground.colorTable();
 
-  for (int y = 0; y < height; ++y) {
-    for (int x = 0; x < width; ++x) {
-      if (maskLine[x >> 5] & (msb >> (x & 31))) {
-        uint32_t color = foregroundPalette[foregroundLine[x]];
-        mixedLine[x] = color;
+  parallelForBands(height, 16, [&](const int yBegin, const int yEnd) {
+    auto* mixedLine = mixedData + yBegin * mixedStride;
+    const auto* foregroundLine = foregroundData + yBegin * foregroundStride;
+    const uint32_t* maskLine = maskData + yBegin * maskStride;
+    for (int y = yBegin; y < yEnd; ++y) {
+      for (int x = 0; x < width; ++x) {
+        if (maskLine[x >> 5] & (msb >> (x & 31))) {
+          uint32_t color = foregroundPalette[foregroundLine[x]];
+          mixedLine[x] = color;
+        }
       }
+      mixedLine += mixedStride;
+      foregroundLine += foregroundStride;
+      maskLine += maskStride;
     }
-    mixedLine += mixedStride;
-    foregroundLine += foregroundStride;
-    maskLine += maskStride;
-  }
+  });
 }
 
 template <>
@@ -261,24 +289,28 @@ void combineImagesColor<uint8_t, uint8_t>(QImage& mixedImage, const QImage& fore
 
 template <typename MixedPixel>
 void applyMask(QImage& image, const BinaryImage& bwMask, const BWColor fillingColor = WHITE) {
-  auto* imageLine = reinterpret_cast<MixedPixel*>(image.bits());
+  auto* const imageData = reinterpret_cast<MixedPixel*>(image.bits());
   const int imageStride = image.bytesPerLine() / sizeof(MixedPixel);
-  const uint32_t* bwMaskLine = bwMask.data();
+  const uint32_t* const bwMaskData = bwMask.data();
   const int bwMaskStride = bwMask.wordsPerLine();
   const int width = image.width();
   const int height = image.height();
   const uint32_t msb = uint32_t(1) << 31;
   const auto fillingPixel = static_cast<MixedPixel>((fillingColor == WHITE) ? 0xffffffff : 0x00000000);
 
-  for (int y = 0; y < height; ++y) {
-    for (int x = 0; x < width; ++x) {
-      if (!(bwMaskLine[x >> 5] & (msb >> (x & 31)))) {
-        imageLine[x] = fillingPixel;
+  parallelForBands(height, 16, [&](const int yBegin, const int yEnd) {
+    auto* imageLine = imageData + yBegin * imageStride;
+    const uint32_t* bwMaskLine = bwMaskData + yBegin * bwMaskStride;
+    for (int y = yBegin; y < yEnd; ++y) {
+      for (int x = 0; x < width; ++x) {
+        if (!(bwMaskLine[x >> 5] & (msb >> (x & 31)))) {
+          imageLine[x] = fillingPixel;
+        }
       }
+      imageLine += imageStride;
+      bwMaskLine += bwMaskStride;
     }
-    imageLine += imageStride;
-    bwMaskLine += bwMaskStride;
-  }
+  });
 }
 }  // namespace impl
 
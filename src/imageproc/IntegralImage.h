@@ -59,6 +59,16 @@ class IntegralImage {
    */
   T sum(const QRect& rect) const;
 
+  /**
+   * \brief Returns a row of the underlying table of sums.
+   *
+   * Element x of row y is the sum of values in QRect(0, 0, x, y),
+   * so both x and y go from 0 to width and height inclusive.
+   * That allows computing the sums for all the windows along a line
+   * without the per call overhead of sum().
+   */
+  const T* sumRow(int y) const;
+
  private:
   void init(int width, int height);
 
@@ -138,5 +148,10 @@ inline T IntegralImage<T>::sum(const QRect& rect) const {
   sum -= m_data[preBottom * m_width + preLeft];
   return sum;
 }
+
+template <typename T>
+inline const T* IntegralImage<T>::sumRow(const int y) const {
+  return m_data + y * m_width;
+}
 }  // namespace imageproc
 #endif  // ifndef SCANTAILOR_IMAGEPROC_INTEGRALIMAGE_H_
@@ -0,0 +1,232 @@
+// Copyright (C) 2019  Joseph Artsimovich <joseph.artsimovich@gmail.com>, 4lex4 <4lex49@zoho.com>
+// Use of this source code is governed by the GNU GPLv3 license that can be found in the LICENSE file.
+
+#include "LocalWindowStats.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cmath>
+#include <stdexcept>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#define LOCAL_WINDOW_STATS_SSE2
+#include <emmintrin.h>
+#endif
+
+#if defined(__x86_64__) || defined(__i386__)
+#if defined(__GNUC__) || defined(__clang__)
+#define LOCAL_WINDOW_STATS_AVX
+#define LOCAL_WINDOW_STATS_TARGET_AVX __attribute__((target("avx")))
+#include <immintrin.h>
+#endif
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#define LOCAL_WINDOW_STATS_AVX
+#define LOCAL_WINDOW_STATS_TARGET_AVX
+#include <immintrin.h>
+#include <intrin.h>
+#endif
+
+namespace imageproc {
+namespace {
+std::atomic<bool> simdEnabled(true);
+
+// The kernels below turn window sums into means and, optionally, sums of squares
+// into standard deviations, in place.  All of them do exactly the same floating
+// point operations in the same order, so their results are the same.
+using MeansKernel = void (*)(double rArea, double* sums, int n);
+using DeviationsKernel = void (*)(double rArea, double* sums, double* sqsums, int n);
+
+void meansScalar(const double rArea, double* const sums, const int n) {
+  for (int i = 0; i < n; ++i) {
+    sums[i] *= rArea;
+  }
+}
+
+void deviationsScalar(const double rArea, double* const sums, double* const sqsums, const int n) {
+  for (int i = 0; i < n; ++i) {
+    const double mean = sums[i] * rArea;
+    const double sqmean = sqsums[i] * rArea;
+    sums[i] = mean;
+    sqsums[i] = std::sqrt(std::fabs(sqmean - mean * mean));
+  }
+}
+
+#ifdef LOCAL_WINDOW_STATS_SSE2
+void meansSse2(const double rArea, double* const sums, const int n) {
+  const __m128d r = _mm_set1_pd(rArea);
+  int i = 0;
+  for (; i + 2 <= n; i += 2) {
+    _mm_storeu_pd(sums + i, _mm_mul_pd(_mm_loadu_pd(sums + i), r));
+  }
+  meansScalar(rArea, sums + i, n - i);
+}
+
+void deviationsSse2(const double rArea, double* const sums, double* const sqsums, const int n) {
+  const __m128d r = _mm_set1_pd(rArea);
+  const __m128d signBit = _mm_set1_pd(-0.0);
+  int i = 0;
+  for (; i + 2 <= n; i += 2) {
+    const __m128d mean = _mm_mul_pd(_mm_loadu_pd(sums + i), r);
+    const __m128d sqmean = _mm_mul_pd(_mm_loadu_pd(sqsums + i), r);
+    const __m128d variance = _mm_andnot_pd(signBit, _mm_sub_pd(sqmean, _mm_mul_pd(mean, mean)));
+    _mm_storeu_pd(sums + i, mean);
+    _mm_storeu_pd(sqsums + i, _mm_sqrt_pd(variance));
+  }
+  deviationsScalar(rArea, sums + i, sqsums + i, n - i);
+}
+#endif  // ifdef LOCAL_WINDOW_STATS_SSE2
+
+#ifdef LOCAL_WINDOW_STATS_AVX
+LOCAL_WINDOW_STATS_TARGET_AVX void meansAvx(const double rArea, double* const sums, const int n) {
+  const __m256d r = _mm256_set1_pd(rArea);
+  int i = 0;
+  for (; i + 4 <= n; i += 4) {
+    _mm256_storeu_pd(sums + i, _mm256_mul_pd(_mm256_loadu_pd(sums + i), r));
+  }
+  meansScalar(rArea, sums + i, n - i);
+}
+
+LOCAL_WINDOW_STATS_TARGET_AVX void deviationsAvx(const double rArea,
+                                                 double* const sums,
+                                                 double* const sqsums,
+                                                 const int n) {
+  const __m256d r = _mm256_set1_pd(rArea);
+  const __m256d signBit = _mm256_set1_pd(-0.0);
+  int i = 0;
+  for (; i + 4 <= n; i += 4) {
+    const __m256d mean = _mm256_mul_pd(_mm256_loadu_pd(sums + i), r);
+    const __m256d sqmean = _mm256_mul_pd(_mm256_loadu_pd(sqsums + i), r);
+    const __m256d variance = _mm256_andnot_pd(signBit, _mm256_sub_pd(sqmean, _mm256_mul_pd(mean, mean)));
+    _mm256_storeu_pd(sums + i, mean);
+    _mm256_storeu_pd(sqsums + i, _mm256_sqrt_pd(variance));
+  }
+  deviationsScalar(rArea, sums + i, sqsums + i, n - i);
+}
+
+bool cpuSupportsAvx() {
+#if defined(__GNUC__) || defined(__clang__)
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("avx");
+#else
+  int info[4];
+  __cpuid(info, 1);
+  const bool osxsave = (info[2] & (1 << 27)) != 0;
+  const bool avx = (info[2] & (1 << 28)) != 0;
+  // The OS must also save the YMM registers on context switches.
+  return osxsave && avx && ((_xgetbv(0) & 6) == 6);
+#endif
+}
+#endif  // ifdef LOCAL_WINDOW_STATS_AVX
+
+struct Kernels {
+  MeansKernel means;
+  DeviationsKernel deviations;
+};
+
+Kernels bestKernels() {
+#ifdef LOCAL_WINDOW_STATS_AVX
+  if (cpuSupportsAvx()) {
+    return {&meansAvx, &deviationsAvx};
+  }
+#endif
+#ifdef LOCAL_WINDOW_STATS_SSE2
+  return {&meansSse2, &deviationsSse2};
+#else
+  return {&meansScalar, &deviationsScalar};
+#endif
+}
+
+Kernels activeKernels() {
+  static const Kernels best = bestKernels();
+  if (!simdEnabled.load(std::memory_order_relaxed)) {
+    return {&meansScalar, &deviationsScalar};
+  }
+  return best;
+}
+
+template <typename T>
+void windowSums(const IntegralImage<T>& integral,
+                const int top,
+                const int bottom,
+                const int width,
+                const int windowLeftHalf,
+                const int windowRightHalf,
+                double* const out) {
+  const T* const topRow = integral.sumRow(top);
+  const T* const bottomRow = integral.sumRow(bottom);
+  for (int x = 0; x < width; ++x) {
+    const int left = std::max(0, x - windowLeftHalf);
+    const int right = std::min(width, x + windowRightHalf);  // exclusive
+    const T sum = (bottomRow[right] - topRow[right]) - (bottomRow[left] - topRow[left]);
+    out[x] = static_cast<double>(sum);
+  }
+}
+}  // namespace
+
+LocalWindowStats::LocalWindowStats(const IntegralImage<uint32_t>& integral,
+                                   const IntegralImage<uint64_t>* sqIntegral,
+                                   const QSize& imageSize,
+                                   const QSize& windowSize)
+    : m_integral(integral),
+      m_sqIntegral(sqIntegral),
+      m_width(imageSize.width()),
+      m_height(imageSize.height()),
+      m_windowLeftHalf(windowSize.width() >> 1),
+      m_windowRightHalf(windowSize.width() - m_windowLeftHalf),
+      m_windowLowerHalf(windowSize.height() >> 1),
+      m_windowUpperHalf(windowSize.height() - m_windowLowerHalf) {
+  if (windowSize.isEmpty()) {
+    throw std::invalid_argument("LocalWindowStats: invalid windowSize");
+  }
+}
+
+void LocalWindowStats::computeLine(const int y, double* const means, double* const deviations) const {
+  assert(!deviations || m_sqIntegral);
+
+  const int top = std::max(0, y - m_windowLowerHalf);
+  const int bottom = std::min(m_height, y + m_windowUpperHalf);  // exclusive
+  const int windowHeight = bottom - top;
+
+  windowSums(m_integral, top, bottom, m_width, m_windowLeftHalf, m_windowRightHalf, means);
+  if (deviations) {
+    windowSums(*m_sqIntegral, top, bottom, m_width, m_windowLeftHalf, m_windowRightHalf, deviations);
+  }
+
+  const auto finishScalar = [&](const int begin, const int end, const int windowWidth) {
+    const double rArea = 1.0 / (windowHeight * windowWidth);
+    if (deviations) {
+      deviationsScalar(rArea, means + begin, deviations + begin, end - begin);
+    } else {
+      meansScalar(rArea, means + begin, end - begin);
+    }
+  };
+
+  // The windows in [interiorBegin, interiorEnd) are not clipped horizontally,
+  // so they all have the same area.
+  const int interiorBegin = std::min(m_windowLeftHalf, m_width);
+  const int interiorEnd = std::max(interiorBegin, m_width - m_windowRightHalf + 1);
+
+  for (int x = 0; x < interiorBegin; ++x) {
+    finishScalar(x, x + 1, std::min(m_width, x + m_windowRightHalf));
+  }
+  for (int x = interiorEnd; x < m_width; ++x) {
+    finishScalar(x, x + 1, m_width - std::max(0, x - m_windowLeftHalf));
+  }
+
+  const int interiorSize = interiorEnd - interiorBegin;
+  if (interiorSize > 0) {
+    const Kernels kernels = activeKernels();
+    const double rArea = 1.0 / (windowHeight * (m_windowLeftHalf + m_windowRightHalf));
+    if (deviations) {
+      kernels.deviations(rArea, means + interiorBegin, deviations + interiorBegin, interiorSize);
+    } else {
+      kernels.means(rArea, means + interiorBegin, interiorSize);
+    }
+  }
+}
+
+void setLocalWindowStatsSimdEnabled(const bool enabled) {
+  simdEnabled.store(enabled, std::memory_order_relaxed);
+}
+}  // namespace imageproc
@@ -0,0 +1,70 @@
+// Copyright (C) 2019  Joseph Artsimovich <joseph.artsimovich@gmail.com>, 4lex4 <4lex49@zoho.com>
+// Use of this source code is governed by the GNU GPLv3 license that can be found in the LICENSE file.
+
+#ifndef SCANTAILOR_IMAGEPROC_LOCALWINDOWSTATS_H_
+#define SCANTAILOR_IMAGEPROC_LOCALWINDOWSTATS_H_
+
+#include <QSize>
+#include <cstdint>
+
+#include "IntegralImage.h"
+#include "NonCopyable.h"
+
+namespace imageproc {
+/**
+ * \brief Computes the mean and the standard deviation of the window
+ *        around every pixel, one line at a time.
+ *
+ * The window around pixel (x, y) spans [x - windowSize.width() / 2, x + (windowSize.width() + 1) / 2)
+ * horizontally and likewise vertically, clipped to the image.  The results are exactly the same as
+ * computing them per pixel in double precision from IntegralImage::sum().
+ *
+ * The windows that are not clipped horizontally share the same area, so for them
+ * the floating point part is done with SSE2 or AVX, depending on what the CPU supports.
+ */
+class LocalWindowStats {
+  DECLARE_NON_COPYABLE(LocalWindowStats)
+
+ public:
+  /**
+   * \param integral The integral image of the pixel values.
+   * \param sqIntegral The integral image of the squared pixel values.
+   *        May be null, if deviations are not going to be requested.
+   * \param imageSize The size of the image the integral images were built from.
+   * \param windowSize The window size.  Must not be empty.
+   */
+  LocalWindowStats(const IntegralImage<uint32_t>& integral,
+                   const IntegralImage<uint64_t>* sqIntegral,
+                   const QSize& imageSize,
+                   const QSize& windowSize);
+
+  /**
+   * \brief Computes the statistics for line \p y.
+   *
+   * \param means Receives imageSize.width() window means.
+   * \param deviations Receives imageSize.width() standard deviations.
+   *        Must be null if no squared integral image was provided.
+   */
+  void computeLine(int y, double* means, double* deviations = nullptr) const;
+
+ private:
+  const IntegralImage<uint32_t>& m_integral;
+  const IntegralImage<uint64_t>* m_sqIntegral;
+  int m_width;
+  int m_height;
+  int m_windowLeftHalf;
+  int m_windowRightHalf;
+  int m_windowLowerHalf;
+  int m_windowUpperHalf;
+};
+
+
+/**
+ * \brief Enables or disables the SIMD code paths of LocalWindowStats.
+ *
+ * When disabled, everything is computed with scalar code.
+ * Enabled by default.  Only meant for testing and benchmarking.
+ */
+void setLocalWindowStatsSimdEnabled(bool enabled);
+}  // namespace imageproc
+#endif  // ifndef SCANTAILOR_IMAGEPROC_LOCALWINDOWSTATS_H_
@@ -4,15 +4,25 @@
 #include "Morphology.h"
 
 #include <QDebug>
+#include <algorithm>
+#include <atomic>
 #include <cassert>
 #include <cmath>
+#include <cstring>
 #include <stdexcept>
+#include <vector>
 
 #include "BinaryImage.h"
 #include "GrayImage.h"
 #include "Grayscale.h"
+#include "ParallelFor.h"
 #include "RasterOp.h"
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#define MORPHOLOGY_SSE2
+#include <emmintrin.h>
+#endif
+
 namespace imageproc {
 Brick::Brick(const QSize& size) {
   const int xOrigin = size.width() >> 1;
@@ -368,96 +378,477 @@ void dilateOrErodeBrick(BinaryImage& dst,
   }
 }  // dilateOrErodeBrick
 
+std::atomic<MorphologyBackend> currentMorphologyBackend(MorphologyBackend::WORD_PARALLEL);
+
+struct WordOr {
+  static uint64_t combine(uint64_t w1, uint64_t w2) { return w1 | w2; }
+};
+
+
+struct WordAnd {
+  static uint64_t combine(uint64_t w1, uint64_t w2) { return w1 & w2; }
+};
+
+
+/**
+ * Returns a word of a source line, with the pixels outside of the line
+ * taking the color of the surroundings.
+ */
+inline uint32_t sourceWord(const uint32_t* line,
+                           const int idx,
+                           const int lastWordIdx,
+                           const uint32_t lastWordMask,
+                           const uint32_t surroundings) {
+  if ((idx < 0) || (idx > lastWordIdx)) {
+    return surroundings;
+  }
+  if (idx == lastWordIdx) {
+    return (line[idx] & lastWordMask) | (surroundings & ~lastWordMask);
+  }
+  return line[idx];
+}
+
+/**
+ * Copies the \p area of \p src, given in source image coordinates, into lines of \p wpl
+ * 64-bit words, with the leftmost pixel of a word being its most significant bit.
+ */
+void loadWords(uint64_t* words,
+               const int wpl,
+               const BinaryImage& src,
+               const QRect& area,
+               const BWColor srcSurroundings) {
+  const uint32_t surroundings = (srcSurroundings == BLACK) ? ~uint32_t(0) : 0;
+  const uint64_t surroundings64 = (uint64_t(surroundings) << 32) | surroundings;
+  const uint32_t* const srcData = src.data();
+  const int srcWpl = src.wordsPerLine();
+  const int lastWordIdx = (src.width() - 1) >> 5;
+  const uint32_t lastWordMask = ~uint32_t(0) << (31 - ((src.width() - 1) & 31));
+
+  uint64_t* line = words;
+  for (int y = area.top(); y <= area.bottom(); ++y, line += wpl) {
+    if ((y < 0) || (y >= src.height())) {
+      std::fill(line, line + wpl, surroundings64);
+      continue;
+    }
+
+    const uint32_t* const srcLine = srcData + y * srcWpl;
+    for (int i = 0; i < wpl; ++i) {
+      const int offset = area.left() + (i << 6);
+      const int wordIdx = (offset >= 0) ? (offset >> 5) : -((31 - offset) >> 5);
+      const int shift = offset - wordIdx * 32;
+      const uint64_t w1 = sourceWord(srcLine, wordIdx, lastWordIdx, lastWordMask, surroundings);
+      const uint64_t w2 = sourceWord(srcLine, wordIdx + 1, lastWordIdx, lastWordMask, surroundings);
+      uint64_t word = (w1 << 32) | w2;
+      if (shift != 0) {
+        const uint32_t w3 = sourceWord(srcLine, wordIdx + 2, lastWordIdx, lastWordMask, surroundings);
+        word = (word << shift) | (w3 >> (32 - shift));
+      }
+      line[i] = word;
+    }
+  }
+}
+
+void storeWords(BinaryImage& dst, const uint64_t* words, const int wpl) {
+  uint32_t* dstLine = dst.data();
+  const int dstWpl = dst.wordsPerLine();
+  const int numWords = (dst.width() + 31) >> 5;
+  const uint32_t lastWordMask = ~uint32_t(0) << (31 - ((dst.width() - 1) & 31));
+
+  const uint64_t* line = words;
+  for (int y = dst.height(); y > 0; --y, line += wpl, dstLine += dstWpl) {
+    for (int i = 0; i < numWords; ++i) {
+      const uint64_t word = line[i >> 1];
+      dstLine[i] = static_cast<uint32_t>((i & 1) ? word : (word >> 32));
+    }
+    dstLine[numWords - 1] &= lastWordMask;
+  }
+}
+
+/**
+ * Combines every pixel of a line with the one \p distance pixels to the right of it.
+ * The last word of a line is a guard word, and the pixels that would need anything
+ * from beyond it end up undefined.
+ */
+template <typename Op>
+void combineWithShifted(uint64_t* line, const int wpl, const int distance) {
+  const int wordShift = distance >> 6;
+  const int bitShift = distance & 63;
+  const int end = wpl - wordShift - 1;
+  if (bitShift == 0) {
+    for (int i = 0; i < end; ++i) {
+      line[i] = Op::combine(line[i], line[i + wordShift]);
+    }
+  } else {
+    for (int i = 0; i < end; ++i) {
+      const uint64_t shifted = (line[i + wordShift] << bitShift) | (line[i + wordShift + 1] >> (64 - bitShift));
+      line[i] = Op::combine(line[i], shifted);
+    }
+  }
+}
+
+/**
+ * Combines every line with the one \p distance lines below it.
+ */
+template <typename Op>
+void combineWithLower(uint64_t* words, const int wpl, const int numLines, const int distance) {
+  const size_t lowerOffset = static_cast<size_t>(distance) * wpl;
+  uint64_t* line = words;
+  for (int y = numLines - distance; y > 0; --y, line += wpl) {
+    const uint64_t* const lowerLine = line + lowerOffset;
+    for (int i = 0; i < wpl; ++i) {
+      line[i] = Op::combine(line[i], lowerLine[i]);
+    }
+  }
+}
+
+/**
+ * Makes every pixel the combination of itself and the following \p windowSize - 1 pixels
+ * in a line or a column, by doubling the span that is already combined until
+ * the next doubling would overshoot the window, then combining two overlapping
+ * spans.  The \p combine function is called with a distance in pixels.
+ */
+template <typename Combine>
+void combineWindow(const int windowSize, Combine combine) {
+  int span = 1;
+  for (; (span << 1) <= windowSize; span <<= 1) {
+    combine(span);
+  }
+  if (span < windowSize) {
+    combine(windowSize - span);
+  }
+}
+
+/**
+ * The WORD_PARALLEL implementation of dilateOrErodeBrick().
+ */
+template <typename Op>
+void dilateOrErodeBrickWords(BinaryImage& dst,
+                             const BinaryImage& src,
+                             const Brick& brick,
+                             const QRect& dstArea,
+                             const BWColor srcSurroundings) {
+  // A destination pixel combines the source pixels within the flipped brick around it.
+  // Top-left alignment of the destination area and this one means that a destination
+  // pixel combines the window of brick.width() x brick.height() source pixels
+  // starting at the same position.
+  const QRect collectArea(extendByBrick(dstArea, brick.flipped()));
+  const int wpl = ((collectArea.width() + 63) >> 6) + 1;
+  const int numLines = collectArea.height();
+
+  std::vector<uint64_t> words(static_cast<size_t>(wpl) * numLines);
+  loadWords(words.data(), wpl, src, collectArea, srcSurroundings);
+
+  if (brick.width() > 1) {
+    uint64_t* line = words.data();
+    for (int y = 0; y < numLines; ++y, line += wpl) {
+      combineWindow(brick.width(), [line, wpl](const int distance) { combineWithShifted<Op>(line, wpl, distance); });
+    }
+  }
+  if (brick.height() > 1) {
+    uint64_t* const data = words.data();
+    combineWindow(brick.height(), [data, wpl, numLines](const int distance) {
+      combineWithLower<Op>(data, wpl, numLines, distance);
+    });
+  }
+
+  storeWords(dst, words.data(), wpl);
+}  // dilateOrErodeBrickWords
+
 class Darker {
  public:
   static uint8_t select(uint8_t v1, uint8_t v2) { return std::min(v1, v2); }
+
+#ifdef MORPHOLOGY_SSE2
+  static __m128i select(__m128i v1, __m128i v2) { return _mm_min_epu8(v1, v2); }
+#endif
 };
 
 
 class Lighter {
  public:
   static uint8_t select(uint8_t v1, uint8_t v2) { return std::max(v1, v2); }
+
+#ifdef MORPHOLOGY_SSE2
+  static __m128i select(__m128i v1, __m128i v2) { return _mm_max_epu8(v1, v2); }
+#endif
 };
 
 
+/**
+ * \brief Sets dst[i] to MinOrMax::select(src1[i], src2[i]) for i in [0, len).
+ */
 template <typename MinOrMax>
-void fillExtremumArrayLeftHalf(uint8_t* dst,
-                               const uint8_t* const srcCenter,
-                               const int srcDelta,
-                               const int srcFirstOffset,
-                               const int srcCenterOffset) {
-  const uint8_t* src = srcCenter;
-  uint8_t extremum = *src;
-  *dst = extremum;
-
-  for (int i = srcCenterOffset - 1; i >= srcFirstOffset; --i) {
-    src -= srcDelta;
-    --dst;
-    extremum = MinOrMax::select(extremum, *src);
-    *dst = extremum;
+struct ScalarLines {
+  static void select(uint8_t* const dst, const uint8_t* const src1, const uint8_t* const src2, const int len) {
+    for (int i = 0; i < len; ++i) {
+      dst[i] = MinOrMax::select(src1[i], src2[i]);
+    }
   }
+};
+
+#ifdef MORPHOLOGY_SSE2
+template <typename MinOrMax>
+struct Sse2Lines {
+  static void select(uint8_t* const dst, const uint8_t* const src1, const uint8_t* const src2, const int len) {
+    int i = 0;
+    for (; i + 16 <= len; i += 16) {
+      const __m128i v1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src1 + i));
+      const __m128i v2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src2 + i));
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), MinOrMax::select(v1, v2));
+    }
+    ScalarLines<MinOrMax>::select(dst + i, src1 + i, src2 + i, len - i);
+  }
+};
+#endif  // ifdef MORPHOLOGY_SSE2
+
+/**
+ * \brief The van Herk / Gil-Werman algorithm, applied to whole lines at once.
+ *
+ * Sets each of \p numLines lines of \p dst to the minimum or maximum of source lines
+ * [i + d1, i + d2], where i is the index of the destination line.  All the lines are
+ * \p width pixels long, and \p arrayCenter has to point to the middle line of a buffer
+ * of (d2 - d1) * 2 + 1 lines, \p arrayStride apart.
+ * \par
+ * Destination lines are split into segments of (d2 - d1 + 1) lines.  All the source
+ * ranges of a segment include its center, so each of them is combined from
+ * an extremum of lines above the center and one below it.
+ * \par
+ * Lines are combined with Lines::select(), either ScalarLines or Sse2Lines.
+ */
+template <typename Lines>
+inline void spreadGrayLinesWith(uint8_t* const dstData,
+                                const int dstStride,
+                                const uint8_t* const srcData,
+                                const int srcStride,
+                                const int numLines,
+                                const int width,
+                                const int d1,
+                                const int d2,
+                                uint8_t* const arrayCenter,
+                                const int arrayStride) {
+  const int seLen = d2 - d1 + 1;
+
+  for (int dstSegmentFirst = 0; dstSegmentFirst < numLines; dstSegmentFirst += seLen) {
+    const int dstSegmentLast = std::min(dstSegmentFirst + seLen, numLines) - 1;  // inclusive
+    const int srcSegmentFirst = dstSegmentFirst + d1;
+    const int srcSegmentLast = dstSegmentLast + d2;
+    const int srcSegmentCenter = (srcSegmentFirst + srcSegmentLast) >> 1;
+    const uint8_t* const srcCenterLine = srcData + srcSegmentCenter * srcStride;
+
+    memcpy(arrayCenter, srcCenterLine, width);
+
+    // The lines above the center.
+    const uint8_t* srcLine = srcCenterLine;
+    uint8_t* arrayLine = arrayCenter;
+    for (int i = srcSegmentCenter - 1; i >= srcSegmentFirst; --i) {
+      srcLine -= srcStride;
+      Lines::select(arrayLine - arrayStride, arrayLine, srcLine, width);
+      arrayLine -= arrayStride;
+    }
+
+    // The lines below the center.
+    srcLine = srcCenterLine;
+    arrayLine = arrayCenter;
+    for (int i = srcSegmentCenter + 1; i <= srcSegmentLast; ++i) {
+      srcLine += srcStride;
+      Lines::select(arrayLine + arrayStride, arrayLine, srcLine, width);
+      arrayLine += arrayStride;
+    }
+
+    uint8_t* dstLine = dstData + dstSegmentFirst * dstStride;
+    for (int i = dstSegmentFirst; i <= dstSegmentLast; ++i) {
+      const int srcFirst = i + d1;
+      const int srcLast = i + d2;  // inclusive
+      assert(srcSegmentCenter >= srcFirst);
+      assert(srcSegmentCenter <= srcLast);
+      Lines::select(dstLine, arrayCenter + (srcFirst - srcSegmentCenter) * arrayStride,
+                    arrayCenter + (srcLast - srcSegmentCenter) * arrayStride, width);
+      dstLine += dstStride;
+    }
+  }
+}  // spreadGrayLinesWith
+
+/**
+ * \brief Sets dst[x * dstStride + y] to src[y * srcStride + x] for x in [0, width), y in [0, height).
+ */
+void transposeGrayScalar(const uint8_t* const src,
+                         const int srcStride,
+                         uint8_t* const dst,
+                         const int dstStride,
+                         const int width,
+                         const int height) {
+  for (int y = 0; y < height; ++y) {
+    const uint8_t* const srcLine = src + y * srcStride;
+    for (int x = 0; x < width; ++x) {
+      dst[x * dstStride + y] = srcLine[x];
+    }
+  }
+}
+
+// The kernels below produce exactly the same results.  The SIMD ones only differ
+// in how many pixels they process at once, all of the work being min / max and copying.
+using SpreadLinesKernel = void (*)(uint8_t* dstData,
+                                   int dstStride,
+                                   const uint8_t* srcData,
+                                   int srcStride,
+                                   int numLines,
+                                   int width,
+                                   int d1,
+                                   int d2,
+                                   uint8_t* arrayCenter,
+                                   int arrayStride);
+using TransposeKernel = void (*)(const uint8_t* src, int srcStride, uint8_t* dst, int dstStride, int width, int height);
+
+template <typename MinOrMax>
+void spreadGrayLinesScalar(uint8_t* const dstData,
+                           const int dstStride,
+                           const uint8_t* const srcData,
+                           const int srcStride,
+                           const int numLines,
+                           const int width,
+                           const int d1,
+                           const int d2,
+                           uint8_t* const arrayCenter,
+                           const int arrayStride) {
+  spreadGrayLinesWith<ScalarLines<MinOrMax>>(dstData, dstStride, srcData, srcStride, numLines, width, d1, d2,
+                                             arrayCenter, arrayStride);
 }
 
+#ifdef MORPHOLOGY_SSE2
 template <typename MinOrMax>
-void fillExtremumArrayRightHalf(uint8_t* dst,
-                                const uint8_t* const srcCenter,
-                                const int srcDelta,
-                                const int srcCenterOffset,
-                                const int srcLastOffset) {
-  const uint8_t* src = srcCenter;
-  uint8_t extremum = *src;
-  *dst = extremum;
-
-  for (int i = srcCenterOffset + 1; i <= srcLastOffset; ++i) {
-    src += srcDelta;
-    ++dst;
-    extremum = MinOrMax::select(extremum, *src);
-    *dst = extremum;
+void spreadGrayLinesSse2(uint8_t* const dstData,
+                         const int dstStride,
+                         const uint8_t* const srcData,
+                         const int srcStride,
+                         const int numLines,
+                         const int width,
+                         const int d1,
+                         const int d2,
+                         uint8_t* const arrayCenter,
+                         const int arrayStride) {
+  spreadGrayLinesWith<Sse2Lines<MinOrMax>>(dstData, dstStride, srcData, srcStride, numLines, width, d1, d2,
+                                           arrayCenter, arrayStride);
+}
+
+/**
+ * Transposes 16x16 tiles with SSE2, leaving the partial ones at the right
+ * and the bottom to transposeGrayScalar().  Each of the four rounds interleaves
+ * the bytes of rows i and i + 8 into rows 2i and 2i + 1, which rotates the bits
+ * of the row and column indices by one position, so four of them swap the two.
+ */
+void transposeGraySse2(const uint8_t* const src,
+                       const int srcStride,
+                       uint8_t* const dst,
+                       const int dstStride,
+                       const int width,
+                       const int height) {
+  const int tiledWidth = width & ~15;
+  const int tiledHeight = height & ~15;
+  for (int y = 0; y < tiledHeight; y += 16) {
+    for (int x = 0; x < tiledWidth; x += 16) {
+      __m128i rows[16];
+      for (int i = 0; i < 16; ++i) {
+        rows[i] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + (y + i) * srcStride + x));
+      }
+      for (int round = 0; round < 4; ++round) {
+        __m128i interleaved[16];
+        for (int i = 0; i < 8; ++i) {
+          interleaved[i * 2] = _mm_unpacklo_epi8(rows[i], rows[i + 8]);
+          interleaved[i * 2 + 1] = _mm_unpackhi_epi8(rows[i], rows[i + 8]);
+        }
+        std::copy(interleaved, interleaved + 16, rows);
+      }
+      for (int i = 0; i < 16; ++i) {
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + (x + i) * dstStride + y), rows[i]);
+      }
+    }
   }
+  // The right edge of the tiled rows, then the rows below the tiles.
+  transposeGrayScalar(src + tiledWidth, srcStride, dst + tiledWidth * dstStride, dstStride, width - tiledWidth,
+                      tiledHeight);
+  transposeGrayScalar(src + tiledHeight * srcStride, srcStride, dst + tiledHeight, dstStride, width,
+                      height - tiledHeight);
+}  // transposeGraySse2
+#endif  // ifdef MORPHOLOGY_SSE2
+
+struct GrayKernels {
+  SpreadLinesKernel spreadDarker;
+  SpreadLinesKernel spreadLighter;
+  TransposeKernel transpose;
+};
+
+GrayKernels bestGrayKernels() {
+#ifdef MORPHOLOGY_SSE2
+  return {&spreadGrayLinesSse2<Darker>, &spreadGrayLinesSse2<Lighter>, &transposeGraySse2};
+#else
+  return {&spreadGrayLinesScalar<Darker>, &spreadGrayLinesScalar<Lighter>, &transposeGrayScalar};
+#endif
 }
 
+std::atomic<bool> graySimdEnabled(true);
+
+GrayKernels activeGrayKernels() {
+  static const GrayKernels best = bestGrayKernels();
+  if (!graySimdEnabled.load(std::memory_order_relaxed)) {
+    return {&spreadGrayLinesScalar<Darker>, &spreadGrayLinesScalar<Lighter>, &transposeGrayScalar};
+  }
+  return best;
+}
+
+template <typename MinOrMax>
+SpreadLinesKernel spreadGrayLinesKernel(const GrayKernels& kernels);
+
+template <>
+SpreadLinesKernel spreadGrayLinesKernel<Darker>(const GrayKernels& kernels) {
+  return kernels.spreadDarker;
+}
+
+template <>
+SpreadLinesKernel spreadGrayLinesKernel<Lighter>(const GrayKernels& kernels) {
+  return kernels.spreadLighter;
+}
+
+// The number of lines spreadGrayHorizontal() transposes at once.
+// That's also the minimum number of lines a thread gets.
+const int GRAY_TRANSPOSE_BLOCK = 16;
+// The maximum number of columns spreadGrayVertical() processes at once.
+const int GRAY_STRIPE_WIDTH = 256;
+
 template <typename MinOrMax>
 void spreadGrayHorizontal(GrayImage& dst, const GrayImage& src, const int dy, const int dx1, const int dx2) {
   const int srcStride = src.stride();
   const int dstStride = dst.stride();
-  const uint8_t* srcLine = src.data() + dy * srcStride;
-  uint8_t* dstLine = dst.data();
+  const uint8_t* const srcData = src.data() + dy * srcStride + dx1;
+  uint8_t* const dstData = dst.data();
 
   const int dstWidth = dst.width();
   const int dstHeight = dst.height();
 
   const int seLen = dx2 - dx1 + 1;
+  const int srcWidth = dstWidth + seLen - 1;
 
-  std::vector<uint8_t> minMaxArray(seLen * 2 - 1, 0);
-  uint8_t* const arrayCenter = &minMaxArray[seLen - 1];
-
-  for (int y = 0; y < dstHeight; ++y) {
-    for (int dstSegmentFirst = 0; dstSegmentFirst < dstWidth; dstSegmentFirst += seLen) {
-      const int dstSegmentLast = std::min(dstSegmentFirst + seLen, dstWidth) - 1;  // inclusive
-      const int srcSegmentFirst = dstSegmentFirst + dx1;
-      const int srcSegmentLast = dstSegmentLast + dx2;
-      const int srcSegmentCenter = (srcSegmentFirst + srcSegmentLast) >> 1;
-
-      fillExtremumArrayLeftHalf<MinOrMax>(arrayCenter, srcLine + srcSegmentCenter, 1, srcSegmentFirst,
-                                          srcSegmentCenter);
-
-      fillExtremumArrayRightHalf<MinOrMax>(arrayCenter, srcLine + srcSegmentCenter, 1, srcSegmentCenter,
-                                           srcSegmentLast);
-
-      for (int x = dstSegmentFirst; x <= dstSegmentLast; ++x) {
-        const int srcFirst = x + dx1;
-        const int srcLast = x + dx2;  // inclusive
-        assert(srcSegmentCenter >= srcFirst);
-        assert(srcSegmentCenter <= srcLast);
-        uint8_t v1 = arrayCenter[srcFirst - srcSegmentCenter];
-        uint8_t v2 = arrayCenter[srcLast - srcSegmentCenter];
-        dstLine[x] = MinOrMax::select(v1, v2);
-      }
-    }
+  const GrayKernels kernels(activeGrayKernels());
+  const SpreadLinesKernel spreadLines = spreadGrayLinesKernel<MinOrMax>(kernels);
 
-    srcLine += srcStride;
-    dstLine += dstStride;
-  }
+  // Spreading along a line is inherently sequential, so blocks of lines are
+  // transposed, spread across lines with spreadLines(), then transposed back.
+  const int blockSize = GRAY_TRANSPOSE_BLOCK;
+  parallelForBands(dstHeight, blockSize, [&](const int yBegin, const int yEnd) {
+    std::vector<uint8_t> srcBlock(srcWidth * blockSize);
+    std::vector<uint8_t> dstBlock(dstWidth * blockSize);
+    std::vector<uint8_t> minMaxArray((seLen * 2 - 1) * blockSize);
+
+    for (int blockTop = yBegin; blockTop < yEnd; blockTop += blockSize) {
+      const int numLines = std::min(blockSize, yEnd - blockTop);
+
+      kernels.transpose(srcData + blockTop * srcStride, srcStride, srcBlock.data(), blockSize, srcWidth, numLines);
+
+      spreadLines(dstBlock.data(), blockSize, srcBlock.data(), blockSize, dstWidth, blockSize, 0, seLen - 1,
+                  &minMaxArray[(seLen - 1) * blockSize], blockSize);
+
+      kernels.transpose(dstBlock.data(), blockSize, dstData + blockTop * dstStride, dstStride, numLines, dstWidth);
+    }
+  });
 }  // spreadGrayHorizontal
 
 template <typename MinOrMax>
@@ -485,36 +876,19 @@ void spreadGrayVertical(GrayImage& dst, const GrayImage& src, const int dx, cons
   const int dstHeight = dst.height();
 
   const int seLen = dy2 - dy1 + 1;
+  const SpreadLinesKernel spreadLines = spreadGrayLinesKernel<MinOrMax>(activeGrayKernels());
 
-  std::vector<uint8_t> minMaxArray(seLen * 2 - 1, 0);
-  uint8_t* const arrayCenter = &minMaxArray[seLen - 1];
-
-  for (int x = 0; x < dstWidth; ++x) {
-    for (int dstSegmentFirst = 0; dstSegmentFirst < dstHeight; dstSegmentFirst += seLen) {
-      const int dstSegmentLast = std::min(dstSegmentFirst + seLen, dstHeight) - 1;  // inclusive
-      const int srcSegmentFirst = dstSegmentFirst + dy1;
-      const int srcSegmentLast = dstSegmentLast + dy2;
-      const int srcSegmentCenter = (srcSegmentFirst + srcSegmentLast) >> 1;
-
-      fillExtremumArrayLeftHalf<MinOrMax>(arrayCenter, srcData + x + srcSegmentCenter * srcStride, srcStride,
-                                          srcSegmentFirst, srcSegmentCenter);
-
-      fillExtremumArrayRightHalf<MinOrMax>(arrayCenter, srcData + x + srcSegmentCenter * srcStride, srcStride,
-                                           srcSegmentCenter, srcSegmentLast);
-
-      uint8_t* dst = dstData + x + dstSegmentFirst * dstStride;
-      for (int y = dstSegmentFirst; y <= dstSegmentLast; ++y) {
-        const int srcFirst = y + dy1;
-        const int srcLast = y + dy2;  // inclusive
-        assert(srcSegmentCenter >= srcFirst);
-        assert(srcSegmentCenter <= srcLast);
-        uint8_t v1 = arrayCenter[srcFirst - srcSegmentCenter];
-        uint8_t v2 = arrayCenter[srcLast - srcSegmentCenter];
-        *dst = MinOrMax::select(v1, v2);
-        dst += dstStride;
-      }
+  // Stripes are narrow enough for the extremum array to stay in cache.
+  parallelForBands(dstWidth, GRAY_TRANSPOSE_BLOCK, [&](const int xBegin, const int xEnd) {
+    const int arrayStride = std::min(GRAY_STRIPE_WIDTH, xEnd - xBegin);
+    std::vector<uint8_t> minMaxArray((seLen * 2 - 1) * arrayStride);
+
+    for (int stripeLeft = xBegin; stripeLeft < xEnd; stripeLeft += arrayStride) {
+      const int stripeWidth = std::min(arrayStride, xEnd - stripeLeft);
+      spreadLines(dstData + stripeLeft, dstStride, srcData + stripeLeft, srcStride, dstHeight, stripeWidth, dy1, dy2,
+                  &minMaxArray[(seLen - 1) * arrayStride], arrayStride);
     }
-  }
+  });
 }  // spreadGrayVertical
 
 template <typename MinOrMax>
@@ -651,6 +1025,18 @@ GrayImage dilateOrErodeGray(const GrayImage& src,
 }  // dilateOrErodeGray
 }  // anonymous namespace
 
+void setMorphologyBackend(const MorphologyBackend backend) {
+  currentMorphologyBackend.store(backend, std::memory_order_relaxed);
+}
+
+MorphologyBackend morphologyBackend() {
+  return currentMorphologyBackend.load(std::memory_order_relaxed);
+}
+
+void setGrayMorphologySimdEnabled(const bool enabled) {
+  graySimdEnabled.store(enabled, std::memory_order_relaxed);
+}
+
 BinaryImage dilateBrick(const BinaryImage& src,
                         const Brick& brick,
                         const QRect& dstArea,
@@ -665,9 +1051,13 @@ BinaryImage dilateBrick(const BinaryImage& src,
     throw std::invalid_argument("dilateBrick: dstArea is empty");
   }
 
-  TemplateRasterOp<RopOr<RopSrc, RopDst>> rop;
   BinaryImage dst(dstArea.size());
-  dilateOrErodeBrick(dst, src, brick, dstArea, srcSurroundings, rop, BLACK);
+  if (morphologyBackend() == MorphologyBackend::WORD_PARALLEL) {
+    dilateOrErodeBrickWords<WordOr>(dst, src, brick, dstArea, srcSurroundings);
+  } else {
+    TemplateRasterOp<RopOr<RopSrc, RopDst>> rop;
+    dilateOrErodeBrick(dst, src, brick, dstArea, srcSurroundings, rop, BLACK);
+  }
   return dst;
 }
 
@@ -709,11 +1099,13 @@ BinaryImage erodeBrick(const BinaryImage& src,
     throw std::invalid_argument("erodeBrick: dstArea is empty");
   }
 
-  using Rop = RopAnd<RopSrc, RopDst>;
-
-  TemplateRasterOp<RopAnd<RopSrc, RopDst>> rop;
   BinaryImage dst(dstArea.size());
-  dilateOrErodeBrick(dst, src, brick, dstArea, srcSurroundings, rop, WHITE);
+  if (morphologyBackend() == MorphologyBackend::WORD_PARALLEL) {
+    dilateOrErodeBrickWords<WordAnd>(dst, src, brick, dstArea, srcSurroundings);
+  } else {
+    TemplateRasterOp<RopAnd<RopSrc, RopDst>> rop;
+    dilateOrErodeBrick(dst, src, brick, dstArea, srcSurroundings, rop, WHITE);
+  }
   return dst;
 }
 
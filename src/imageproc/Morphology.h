@@ -87,6 +87,34 @@ class Brick {
 };
 
 
+/**
+ * \brief The implementations of the binary brick operations.
+ *
+ * RASTER_OP spreads pixels by combining shifted copies of the image with rasterOp().
+ * WORD_PARALLEL spreads pixels within a copy of the image stored in 64-bit words,
+ * combining ever wider spans, so that a brick of width W and height H costs
+ * about log2(W) + log2(H) passes over the image.  That's the default one.
+ * Both produce identical results.
+ */
+enum class MorphologyBackend { RASTER_OP, WORD_PARALLEL };
+
+/**
+ * \brief Selects the implementation of dilateBrick(), erodeBrick(), openBrick()
+ *        and closeBrick() for all threads.
+ */
+void setMorphologyBackend(MorphologyBackend backend);
+
+MorphologyBackend morphologyBackend();
+
+/**
+ * \brief Enables or disables the SIMD code paths of the gray dilation and erosion.
+ *
+ * When disabled, everything is computed with scalar code.
+ * Enabled by default.  Only meant for testing and benchmarking.
+ */
+void setGrayMorphologySimdEnabled(bool enabled);
+
+
 /**
  * \brief Turn every black pixel into a brick of black pixels.
  *
@@ -3,13 +3,15 @@
 
 #include "Posterizer.h"
 
+#include <algorithm>
 #include <cassert>
-#include <list>
-#include <set>
+#include <map>
+#include <mutex>
 #include <stdexcept>
-#include <unordered_set>
+#include <vector>
 
 #include "BinaryImage.h"
+#include "ParallelFor.h"
 
 namespace imageproc {
 Posterizer::Posterizer(int level,
@@ -28,31 +30,177 @@ Posterizer::Posterizer(int level,
 }
 
 namespace {
-QVector<QRgb> paletteFromRgb(const QImage& image) {
-  std::unordered_set<uint32_t> colorSet;
+/**
+ * \brief Associates values with the colors of RGB32 and ARGB32 images without hashing.
+ *
+ * Opaque colors are kept in the RGB cube split into 32x32x32 cells, with the values
+ * allocated only for the cells holding the colors actually used, so the close colors
+ * a scan consists of share cache lines.  Colors that aren't opaque are rare,
+ * so they are kept in an ordinary map.
+ */
+template <typename T>
+class ColorCube {
+ public:
+  ColorCube() : m_cellBlocks(NUM_CELLS, NO_BLOCK) {}
+
+  T& operator[](const uint32_t color) {
+    if (!isOpaque(color)) {
+      return m_translucent[color];
+    }
+    const uint32_t cell = cellOf(color);
+    int block = m_cellBlocks[cell];
+    if (block == NO_BLOCK) {
+      block = allocateBlock(cell);
+    }
+    return m_values[block * BLOCK_SIZE + offsetInCell(color)];
+  }
+
+  /**
+   * \return The value of \p color or a default-constructed value for the colors never added.
+   */
+  T value(const uint32_t color) const {
+    if (!isOpaque(color)) {
+      const auto it = m_translucent.find(color);
+      return (it != m_translucent.end()) ? it->second : T();
+    }
+    const int block = m_cellBlocks[cellOf(color)];
+    return (block != NO_BLOCK) ? m_values[block * BLOCK_SIZE + offsetInCell(color)] : T();
+  }
+
+  /**
+   * \brief Adds the values of \p other to the values of the same colors.
+   */
+  void add(const ColorCube& other) {
+    for (size_t i = 0; i < other.m_blockCells.size(); ++i) {
+      const uint32_t cell = other.m_blockCells[i];
+      int block = m_cellBlocks[cell];
+      if (block == NO_BLOCK) {
+        block = allocateBlock(cell);
+      }
+      T* const dst = &m_values[block * BLOCK_SIZE];
+      const T* const src = &other.m_values[i * BLOCK_SIZE];
+      for (uint32_t j = 0; j < BLOCK_SIZE; ++j) {
+        dst[j] += src[j];
+      }
+    }
+    for (const auto& colorAndValue : other.m_translucent) {
+      m_translucent[colorAndValue.first] += colorAndValue.second;
+    }
+  }
+
+  /**
+   * \brief Calls \p func(color, value) for every color having a non-default value.
+   *
+   * The order of the colors doesn't depend on the order they were added in.
+   */
+  template <typename Func>
+  void forEach(Func func) {
+    for (uint32_t cell = 0; cell < NUM_CELLS; ++cell) {
+      const int block = m_cellBlocks[cell];
+      if (block == NO_BLOCK) {
+        continue;
+      }
+      T* const values = &m_values[block * BLOCK_SIZE];
+      for (uint32_t offset = 0; offset < BLOCK_SIZE; ++offset) {
+        if (values[offset] != T()) {
+          func(colorOf(cell, offset), values[offset]);
+        }
+      }
+    }
+    for (auto& colorAndValue : m_translucent) {
+      if (colorAndValue.second != T()) {
+        func(colorAndValue.first, colorAndValue.second);
+      }
+    }
+  }
+
+ private:
+  static constexpr uint32_t NUM_CELLS = 32 * 32 * 32;
+  static constexpr uint32_t BLOCK_SIZE = 8 * 8 * 8;
+  static constexpr int NO_BLOCK = -1;
+
+  static bool isOpaque(const uint32_t color) { return (color >> 24) == 0xff; }
+
+  static uint32_t cellOf(const uint32_t color) {
+    return ((color >> 9) & 0x7c00) | ((color >> 6) & 0x03e0) | ((color >> 3) & 0x001f);
+  }
+
+  static uint32_t offsetInCell(const uint32_t color) {
+    return ((color >> 10) & 0x01c0) | ((color >> 5) & 0x0038) | (color & 0x0007);
+  }
+
+  static uint32_t colorOf(const uint32_t cell, const uint32_t offset) {
+    const uint32_t red = ((cell >> 7) & 0xf8) | (offset >> 6);
+    const uint32_t green = ((cell >> 2) & 0xf8) | ((offset >> 3) & 0x07);
+    const uint32_t blue = ((cell << 3) & 0xf8) | (offset & 0x07);
+    return 0xff000000u | (red << 16) | (green << 8) | blue;
+  }
 
+  int allocateBlock(const uint32_t cell) {
+    const auto block = static_cast<int>(m_blockCells.size());
+    m_blockCells.push_back(cell);
+    m_values.resize(m_values.size() + BLOCK_SIZE, T());
+    m_cellBlocks[cell] = block;
+    return block;
+  }
+
+  std::vector<int> m_cellBlocks;
+  std::vector<uint32_t> m_blockCells;
+  std::vector<T> m_values;
+  std::map<uint32_t, T> m_translucent;
+};
+
+
+struct ColorStatistics {
+  uint32_t color;
+  int count;
+};
+
+/**
+ * Counts the colors of an RGB32 or ARGB32 image, in parallel bands of lines,
+ * each band with a cube of its own.  The cubes are then added together.
+ */
+ColorCube<int> countColors(const QImage& image) {
   const int width = image.width();
   const int height = image.height();
 
-  const auto* imgLine = reinterpret_cast<const uint32_t*>(image.bits());
+  const auto* const imgData = reinterpret_cast<const uint32_t*>(image.bits());
   const int imgStride = image.bytesPerLine() / sizeof(uint32_t);
 
-  for (int y = 0; y < height; ++y) {
-    for (int x = 0; x < width; ++x) {
-      uint32_t color = imgLine[x];
-      colorSet.insert(color);
+  ColorCube<int> counts;
+  std::mutex countsMutex;
+  parallelForBands(height, 64, [&](const int yBegin, const int yEnd) {
+    ColorCube<int> bandCounts;
+    const uint32_t* imgLine = imgData + yBegin * imgStride;
+    for (int y = yBegin; y < yEnd; ++y) {
+      // Runs of the same color, like the ones of the background, are counted at once.
+      int x = 0;
+      while (x < width) {
+        const uint32_t color = imgLine[x];
+        const int runBegin = x;
+        while ((++x < width) && (imgLine[x] == color)) {
+        }
+        bandCounts[color] += x - runBegin;
+      }
+      imgLine += imgStride;
     }
-    imgLine += imgStride;
-  }
 
-  QVector<QRgb> palette((int) (colorSet.size()));
-  std::copy(colorSet.begin(), colorSet.end(), std::back_inserter(palette));
+    std::lock_guard<std::mutex> guard(countsMutex);
+    counts.add(bandCounts);
+  });
+  return counts;
+}
+
+QVector<QRgb> paletteFromRgb(const QImage& image) {
+  ColorCube<int> counts = countColors(image);
+
+  QVector<QRgb> palette;
+  counts.forEach([&palette](const uint32_t color, int) { palette.push_back(color); });
   return palette;
 }
 }  // namespace
 
 QVector<QRgb> Posterizer::buildPalette(const QImage& image) {
-  std::unordered_map<uint32_t, int> paletteMap;
   switch (image.format()) {
     case QImage::Format_Indexed8:
       return image.colorTable();
@@ -85,24 +233,29 @@ QImage Posterizer::convertToIndexed(const QImage& image, const QVector<QRgb>& pa
   const int width = image.width();
   const int height = image.height();
 
-  const auto* imgLine = reinterpret_cast<const uint32_t*>(image.bits());
+  const auto* const imgData = reinterpret_cast<const uint32_t*>(image.bits());
   const int imgStride = image.bytesPerLine() / sizeof(uint32_t);
 
-  uint8_t* dstLine = dst.bits();
+  uint8_t* const dstData = dst.bits();
   const int dstStride = dst.bytesPerLine();
 
-  std::unordered_map<uint32_t, uint8_t> colorToIndex;
+  // The colors missing from the palette get the index of zero.
+  ColorCube<uint8_t> colorToIndex;
   for (int i = 0; i < palette.size(); ++i) {
     colorToIndex[palette[i]] = static_cast<uint8_t>(i);
   }
 
-  for (int y = 0; y < height; ++y) {
-    for (int x = 0; x < width; ++x) {
-      dstLine[x] = colorToIndex[imgLine[x]];
+  parallelForBands(height, 64, [&](const int yBegin, const int yEnd) {
+    const uint32_t* imgLine = imgData + yBegin * imgStride;
+    uint8_t* dstLine = dstData + yBegin * dstStride;
+    for (int y = yBegin; y < yEnd; ++y) {
+      for (int x = 0; x < width; ++x) {
+        dstLine[x] = colorToIndex.value(imgLine[x]);
+      }
+      imgLine += imgStride;
+      dstLine += dstStride;
     }
-    imgLine += imgStride;
-    dstLine += dstStride;
-  }
+  });
 
   dst.setDotsPerMeterX(image.dotsPerMeterX());
   dst.setDotsPerMeterY(image.dotsPerMeterY());
@@ -110,114 +263,83 @@ QImage Posterizer::convertToIndexed(const QImage& image, const QVector<QRgb>& pa
 }
 
 namespace {
-std::unordered_map<uint32_t, int> paletteFromIndexedWithStatistics(const QImage& image) {
-  std::unordered_map<uint32_t, int> palette;
-
+/**
+ * Collects the statistics of the colors in the color table of an indexed image.
+ * \p colorIndices gets the index of the statistics of each color table entry,
+ * or -1 for the entries no pixel refers to.
+ */
+std::vector<ColorStatistics> paletteFromIndexedWithStatistics(const QImage& image, std::vector<int>& colorIndices) {
   const int width = image.width();
   const int height = image.height();
 
   const uint8_t* imgLine = image.bits();
   const int imgStride = image.bytesPerLine();
 
-  QVector<QRgb> colorTable = image.colorTable();
-
+  int indexCounts[256] = {};
   for (int y = 0; y < height; ++y) {
     for (int x = 0; x < width; ++x) {
-      uint8_t colorIndex = imgLine[x];
-      uint32_t color = colorTable[colorIndex];
-      ++palette[color];
+      ++indexCounts[imgLine[x]];
     }
     imgLine += imgStride;
   }
-  return palette;
-}
-
-std::unordered_map<uint32_t, int> paletteFromRgbWithStatistics(const QImage& image) {
-  std::unordered_map<uint32_t, int> palette;
 
-  const int width = image.width();
-  const int height = image.height();
-
-  const auto* imgLine = reinterpret_cast<const uint32_t*>(image.bits());
-  const int imgStride = image.bytesPerLine() / sizeof(uint32_t);
-
-  for (int y = 0; y < height; ++y) {
-    for (int x = 0; x < width; ++x) {
-      uint32_t color = imgLine[x];
-      ++palette[color];
-    }
-    imgLine += imgStride;
+  // A color may appear in the color table more than once.
+  const QVector<QRgb> colorTable = image.colorTable();
+  std::vector<int> entries(colorTable.size());
+  for (int i = 0; i < colorTable.size(); ++i) {
+    entries[i] = i;
   }
-  return palette;
-}
-
-void remapColorsInIndexedImage(QImage& image, const std::unordered_map<uint32_t, uint32_t>& colorMap) {
-  std::unordered_map<uint32_t, uint8_t> colorToIndexMap;
-  uint8_t index = 0;
-  for (const auto& srcAndDstColors : colorMap) {
-    if (colorToIndexMap.find(srcAndDstColors.second) == colorToIndexMap.end()) {
-      colorToIndexMap[srcAndDstColors.second] = index++;
+  std::stable_sort(entries.begin(), entries.end(),
+                   [&colorTable](const int lhs, const int rhs) { return colorTable[lhs] < colorTable[rhs]; });
+
+  std::vector<ColorStatistics> palette;
+  colorIndices.assign(colorTable.size(), 0);
+  for (const int entry : entries) {
+    if (palette.empty() || (palette.back().color != colorTable[entry])) {
+      palette.push_back({colorTable[entry], 0});
     }
+    palette.back().count += indexCounts[entry];
+    colorIndices[entry] = static_cast<int>(palette.size()) - 1;
   }
 
-  {
-    const int width = image.width();
-    const int height = image.height();
-
-    uint8_t* imgLine = image.bits();
-    const int imgStride = image.bytesPerLine();
-
-    QVector<QRgb> colorTable = image.colorTable();
-
-    for (int y = 0; y < height; ++y) {
-      for (int x = 0; x < width; ++x) {
-        uint32_t color = colorTable[imgLine[x]];
-        uint32_t newColor = colorMap.at(color);
-        imgLine[x] = colorToIndexMap[newColor];
-      }
-      imgLine += imgStride;
+  // Keep only the colors actually used, like the pixels would tell.
+  std::vector<int> usedIndices(palette.size(), -1);
+  int numUsed = 0;
+  for (size_t i = 0; i < palette.size(); ++i) {
+    if (palette[i].count > 0) {
+      usedIndices[i] = numUsed;
+      palette[numUsed++] = palette[i];
     }
   }
-
-  QVector<QRgb> newColorTable((int) (colorToIndexMap.size()));
-  for (const auto& colorAndIndex : colorToIndexMap) {
-    newColorTable[colorAndIndex.second] = colorAndIndex.first;
-  }
-
-  image.setColorTable(newColorTable);
-}
-
-void remapColorsInRgbImage(QImage& image, const std::unordered_map<uint32_t, uint32_t>& colorMap) {
-  const int width = image.width();
-  const int height = image.height();
-
-  auto* imgLine = reinterpret_cast<uint32_t*>(image.bits());
-  const int imgStride = image.bytesPerLine() / sizeof(uint32_t);
-
-  for (int y = 0; y < height; ++y) {
-    for (int x = 0; x < width; ++x) {
-      uint32_t color = imgLine[x];
-      imgLine[x] = colorMap.at(color);
-    }
-    imgLine += imgStride;
+  palette.resize(numUsed);
+  for (int& colorIndex : colorIndices) {
+    colorIndex = usedIndices[colorIndex];
   }
+  return palette;
 }
 
-QVector<QRgb> paletteFromColorMap(const std::unordered_map<uint32_t, uint32_t>& colorMap) {
-  std::unordered_set<uint32_t> colorSet;
-  for (const auto& srcAndDstColors : colorMap) {
-    colorSet.insert(srcAndDstColors.second);
-  }
-
-  QVector<QRgb> palette(static_cast<int>(colorSet.size()));
-  std::copy(colorSet.begin(), colorSet.end(), std::back_inserter(palette));
+/**
+ * Collects the statistics of the colors of an RGB32 or ARGB32 image.
+ * \p colorIndices gets the index of the statistics of each color, plus one.
+ */
+std::vector<ColorStatistics> paletteFromRgbWithStatistics(const QImage& image, ColorCube<int>& colorIndices) {
+  colorIndices = countColors(image);
+
+  std::vector<ColorStatistics> palette;
+  colorIndices.forEach([&palette](const uint32_t color, int& countThenIndex) {
+    palette.push_back({color, countThenIndex});
+    countThenIndex = static_cast<int>(palette.size());
+  });
   return palette;
 }
 
-std::unordered_map<uint32_t, uint32_t> normalizePalette(const QImage& image,
-                                                        const std::unordered_map<uint32_t, int>& palette,
-                                                        const int normalizeBlackLevel = 0,
-                                                        const int normalizeWhiteLevel = 255) {
+/**
+ * \return The color each of the colors in \p palette normalizes to.
+ */
+std::vector<uint32_t> normalizePalette(const QImage& image,
+                                       const std::vector<ColorStatistics>& palette,
+                                       const int normalizeBlackLevel = 0,
+                                       const int normalizeWhiteLevel = 255) {
   const int pixelCount = image.width() * image.height();
   const double threshold = 0.0005;  // mustn't be larger than (1 / 256)
 
@@ -228,9 +350,9 @@ std::unordered_map<uint32_t, uint32_t> normalizePalette(const QImage& image,
     int red_hist[256] = {};
     int green_hist[256] = {};
     int blue_hist[256] = {};
-    for (const auto& colorAndStat : palette) {
-      const uint32_t color = colorAndStat.first;
-      const int statistics = colorAndStat.second;
+    for (const ColorStatistics& colorAndStat : palette) {
+      const uint32_t color = colorAndStat.color;
+      const int statistics = colorAndStat.count;
 
       if (color == 0xff000000u) {
         red_hist[normalizeBlackLevel] += statistics;
@@ -267,15 +389,11 @@ std::unordered_map<uint32_t, uint32_t> normalizePalette(const QImage& image,
     assert(maxLevel >= minLevel);
   }
 
-  std::unordered_map<uint32_t, uint32_t> colorToNormalizedMap;
-  for (const auto& colorAndStat : palette) {
-    const uint32_t color = colorAndStat.first;
-    if (color == 0xff000000u) {
-      colorToNormalizedMap[0xff000000u] = 0xff000000u;
-      continue;
-    }
-    if (color == 0xffffffffu) {
-      colorToNormalizedMap[0xffffffffu] = 0xffffffffu;
+  std::vector<uint32_t> normalizedColors(palette.size());
+  for (size_t i = 0; i < palette.size(); ++i) {
+    const uint32_t color = palette[i].color;
+    if ((color == 0xff000000u) || (color == 0xffffffffu)) {
+      normalizedColors[i] = color;
       continue;
     }
 
@@ -286,9 +404,9 @@ std::unordered_map<uint32_t, uint32_t> normalizePalette(const QImage& image,
     normalizedGreen = qBound(0, normalizedGreen, 255);
     normalizedBlue = qBound(0, normalizedBlue, 255);
 
-    colorToNormalizedMap[color] = qRgb(normalizedRed, normalizedGreen, normalizedBlue);
+    normalizedColors[i] = qRgb(normalizedRed, normalizedGreen, normalizedBlue);
   }
-  return colorToNormalizedMap;
+  return normalizedColors;
 }
 
 bool isGray(const QColor& color) {
@@ -312,88 +430,188 @@ void makeGrayBlackOrWhiteInPlace(QRgb& rgb, const QRgb& normalized) {
     }
   }
 }
-}  // namespace
 
-QImage Posterizer::posterize(const QImage& image) const {
-  if ((m_level == 255) && !m_normalize && !m_forceBlackAndWhite) {
-    return image;
+/**
+ * Makes \p colorTable contain every color of \p colorsToIndex once, in ascending order,
+ * and replaces the colors in \p colorsToIndex with their indices there.
+ */
+void buildColorTable(QVector<QRgb>& colorTable, std::vector<uint32_t>& colorsToIndex) {
+  std::vector<uint32_t> colors(colorsToIndex);
+  std::sort(colors.begin(), colors.end());
+  colors.erase(std::unique(colors.begin(), colors.end()), colors.end());
+  for (uint32_t& color : colorsToIndex) {
+    color = static_cast<uint32_t>(std::lower_bound(colors.begin(), colors.end(), color) - colors.begin());
   }
 
-  std::unordered_map<uint32_t, uint32_t> oldToNewColorMap;
-  size_t newColorTableSize;
+  colorTable.clear();
+  colorTable.reserve(static_cast<int>(colors.size()));
+  for (const uint32_t color : colors) {
+    colorTable.push_back(color);
+  }
+}
 
-  {
-    // Get the palette with statistics.
-    std::unordered_map<uint32_t, int> paletteStatMap;
-    switch (image.format()) {
-      case QImage::Format_Indexed8:
-        paletteStatMap = paletteFromIndexedWithStatistics(image);
-        break;
-      case QImage::Format_RGB32:
-      case QImage::Format_ARGB32:
-        paletteStatMap = paletteFromRgbWithStatistics(image);
-        break;
-      default:
-        throw std::invalid_argument("Posterizer: invalid image format");
+void remapColorsInIndexedImage(QImage& image,
+                               const std::vector<int>& colorIndices,
+                               const std::vector<uint32_t>& newColors) {
+  QVector<QRgb> newColorTable;
+  std::vector<uint32_t> newIndices(newColors);
+  buildColorTable(newColorTable, newIndices);
+
+  uint8_t indexMap[256] = {};
+  for (size_t i = 0; i < std::min<size_t>(colorIndices.size(), 256); ++i) {
+    if (colorIndices[i] >= 0) {
+      indexMap[i] = static_cast<uint8_t>(newIndices[colorIndices[i]]);
     }
+  }
 
-    // We have to normalize palette in order posterization to work with pale images.
-    std::unordered_map<uint32_t, uint32_t> colorToNormalizedMap
-        = normalizePalette(image, paletteStatMap, m_normalizeBlackLevel, m_normalizeWhiteLevel);
+  const int width = image.width();
+  const int height = image.height();
 
-    // Build color groups resulted from splitting RGB space
-    std::unordered_map<uint32_t, std::list<uint32_t>> groupMap;
-    const double levelStride = 255.0 / m_level;
-    for (const auto& colorAndStat : paletteStatMap) {
-      const uint32_t color = colorAndStat.first;
-      const uint32_t normalizedColor = colorToNormalizedMap[color];
+  uint8_t* imgLine = image.bits();
+  const int imgStride = image.bytesPerLine();
 
-      const auto redGroupIdx = static_cast<int>(qRed(normalizedColor) / levelStride);
-      const auto blueGroupIdx = static_cast<int>(qGreen(normalizedColor) / levelStride);
-      const auto greenGroupIdx = static_cast<int>(qBlue(normalizedColor) / levelStride);
+  for (int y = 0; y < height; ++y) {
+    for (int x = 0; x < width; ++x) {
+      imgLine[x] = indexMap[imgLine[x]];
+    }
+    imgLine += imgStride;
+  }
 
-      auto group = static_cast<uint32_t>((redGroupIdx << 16) | (greenGroupIdx << 8) | (blueGroupIdx));
+  image.setColorTable(newColorTable);
+}
 
-      groupMap[group].push_back(color);
-    }
+/**
+ * Replaces every color of an RGB32 or ARGB32 image with the new color of its index
+ * in \p colorIndices, producing an indexed image if there are few enough new colors.
+ */
+QImage remapColorsInRgbImage(const QImage& image,
+                             const ColorCube<int>& colorIndices,
+                             const std::vector<uint32_t>& newColors) {
+  const int width = image.width();
+  const int height = image.height();
 
-    // Find the most often occurring color in the group and map the other colors in the group to that.
-    for (const auto& groupAndColors : groupMap) {
-      const std::list<uint32_t>& colors = groupAndColors.second;
-      assert(!colors.empty());
+  const auto* const imgData = reinterpret_cast<const uint32_t*>(image.bits());
+  const int imgStride = image.bytesPerLine() / sizeof(uint32_t);
 
-      uint32_t mostOftenColorInGroup = *colors.begin();
-      for (auto it = ++colors.begin(); it != colors.end(); ++it) {
-        if (paletteStatMap[*it] > paletteStatMap[mostOftenColorInGroup]) {
-          mostOftenColorInGroup = *it;
-        }
-      }
+  QVector<QRgb> newColorTable;
+  std::vector<uint32_t> newIndices(newColors);
+  buildColorTable(newColorTable, newIndices);
 
-      if (m_forceBlackAndWhite) {
-        if (m_normalize) {
-          colorToNormalizedMap[0xff000000u] = 0xff000000u;
-          colorToNormalizedMap[0xffffffffu] = 0xffffffffu;
+  if (newColorTable.size() > 256) {
+    QImage dst(image);
+    auto* const dstData = reinterpret_cast<uint32_t*>(dst.bits());
+    const int dstStride = dst.bytesPerLine() / sizeof(uint32_t);
+
+    parallelForBands(height, 64, [&](const int yBegin, const int yEnd) {
+      uint32_t* dstLine = dstData + yBegin * dstStride;
+      for (int y = yBegin; y < yEnd; ++y) {
+        for (int x = 0; x < width; ++x) {
+          dstLine[x] = newColors[colorIndices.value(dstLine[x]) - 1];
         }
-        makeGrayBlackOrWhiteInPlace(mostOftenColorInGroup, colorToNormalizedMap[mostOftenColorInGroup]);
+        dstLine += dstStride;
       }
+    });
+    return dst;
+  }
 
-      for (const uint32_t& color : colors) {
-        oldToNewColorMap[color] = m_normalize ? colorToNormalizedMap[mostOftenColorInGroup] : mostOftenColorInGroup;
+  QImage dst(image.size(), QImage::Format_Indexed8);
+  dst.setColorTable(newColorTable);
+  uint8_t* const dstData = dst.bits();
+  const int dstStride = dst.bytesPerLine();
+
+  parallelForBands(height, 64, [&](const int yBegin, const int yEnd) {
+    const uint32_t* imgLine = imgData + yBegin * imgStride;
+    uint8_t* dstLine = dstData + yBegin * dstStride;
+    for (int y = yBegin; y < yEnd; ++y) {
+      for (int x = 0; x < width; ++x) {
+        dstLine[x] = static_cast<uint8_t>(newIndices[colorIndices.value(imgLine[x]) - 1]);
       }
+      imgLine += imgStride;
+      dstLine += dstStride;
     }
+  });
 
-    newColorTableSize = groupMap.size();
+  dst.setDotsPerMeterX(image.dotsPerMeterX());
+  dst.setDotsPerMeterY(image.dotsPerMeterY());
+  return dst;
+}
+}  // namespace
+
+QImage Posterizer::posterize(const QImage& image) const {
+  if ((m_level == 255) && !m_normalize && !m_forceBlackAndWhite) {
+    return image;
   }
 
-  QImage dst(image);
-  if (dst.format() == QImage::Format_Indexed8) {
-    remapColorsInIndexedImage(dst, oldToNewColorMap);
-  } else {
-    remapColorsInRgbImage(dst, oldToNewColorMap);
-    if (newColorTableSize <= 256) {
-      return Posterizer::convertToIndexed(dst, paletteFromColorMap(oldToNewColorMap));
+  // Get the palette with statistics.
+  std::vector<ColorStatistics> paletteStats;
+  std::vector<int> tableColorIndices;
+  ColorCube<int> rgbColorIndices;
+  switch (image.format()) {
+    case QImage::Format_Indexed8:
+      paletteStats = paletteFromIndexedWithStatistics(image, tableColorIndices);
+      break;
+    case QImage::Format_RGB32:
+    case QImage::Format_ARGB32:
+      paletteStats = paletteFromRgbWithStatistics(image, rgbColorIndices);
+      break;
+    default:
+      throw std::invalid_argument("Posterizer: invalid image format");
+  }
+
+  // We have to normalize palette in order posterization to work with pale images.
+  const std::vector<uint32_t> normalizedColors
+      = normalizePalette(image, paletteStats, m_normalizeBlackLevel, m_normalizeWhiteLevel);
+
+  // Build color groups resulted from splitting RGB space.  Sorting the colors by group
+  // brings the colors of a group together, in ascending order within the group.
+  std::vector<std::pair<uint32_t, int>> groupedColors(paletteStats.size());
+  const double levelStride = 255.0 / m_level;
+  for (size_t i = 0; i < paletteStats.size(); ++i) {
+    const uint32_t normalizedColor = normalizedColors[i];
+
+    const auto redGroupIdx = static_cast<int>(qRed(normalizedColor) / levelStride);
+    const auto greenGroupIdx = static_cast<int>(qGreen(normalizedColor) / levelStride);
+    const auto blueGroupIdx = static_cast<int>(qBlue(normalizedColor) / levelStride);
+
+    const auto group = static_cast<uint32_t>((redGroupIdx << 16) | (greenGroupIdx << 8) | (blueGroupIdx));
+    groupedColors[i] = {group, static_cast<int>(i)};
+  }
+  std::sort(groupedColors.begin(), groupedColors.end(),
+            [&paletteStats](const std::pair<uint32_t, int>& lhs, const std::pair<uint32_t, int>& rhs) {
+              if (lhs.first != rhs.first) {
+                return lhs.first < rhs.first;
+              }
+              return paletteStats[lhs.second].color < paletteStats[rhs.second].color;
+            });
+
+  // Find the most often occurring color in the group and map the other colors in the group to that.
+  std::vector<uint32_t> newColors(paletteStats.size());
+  auto groupBegin = groupedColors.begin();
+  while (groupBegin != groupedColors.end()) {
+    auto groupEnd = groupBegin + 1;
+    int mostOftenColorIdx = groupBegin->second;
+    for (; (groupEnd != groupedColors.end()) && (groupEnd->first == groupBegin->first); ++groupEnd) {
+      if (paletteStats[groupEnd->second].count > paletteStats[mostOftenColorIdx].count) {
+        mostOftenColorIdx = groupEnd->second;
+      }
+    }
+
+    uint32_t newColor = m_normalize ? normalizedColors[mostOftenColorIdx] : paletteStats[mostOftenColorIdx].color;
+    if (m_forceBlackAndWhite) {
+      makeGrayBlackOrWhiteInPlace(newColor, normalizedColors[mostOftenColorIdx]);
+    }
+
+    for (auto it = groupBegin; it != groupEnd; ++it) {
+      newColors[it->second] = newColor;
     }
+    groupBegin = groupEnd;
   }
-  return dst;
+
+  if (image.format() == QImage::Format_Indexed8) {
+    QImage dst(image);
+    remapColorsInIndexedImage(dst, tableColorIndices, newColors);
+    return dst;
+  }
+  return remapColorsInRgbImage(image, rgbColorIndices, newColors);
 }
 }  // namespace imageproc
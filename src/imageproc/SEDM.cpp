@@ -4,9 +4,13 @@
 
 #include "SEDM.h"
 
+#include <algorithm>
+#include <cstring>
+
 #include "BinaryImage.h"
 #include "ConnectivityMap.h"
 #include "Morphology.h"
+#include "ParallelFor.h"
 #include "RasterOp.h"
 #include "SeedFill.h"
 
@@ -15,65 +19,235 @@ namespace imageproc {
 // It exists to make sure INF_DIST + 1 doesn't overflow.
 const uint32_t SEDM::INF_DIST = ~uint32_t(0) - 1;
 
-SEDM::SEDM() : m_plainData(nullptr), m_size(), m_stride(0) {}
+const uint16_t SEDM16::INF_DIST = ~uint16_t(0);
 
-SEDM::SEDM(const BinaryImage& image, const DistType distType, const Borders borders)
-    : m_plainData(nullptr), m_size(image.size()), m_stride(0) {
-  if (image.isNull()) {
-    return;
+namespace {
+/**
+ * The number of adjacent columns processed together, line by line,
+ * rather than walking down a single column with a stride.
+ */
+const int COLUMN_BLOCK = 64;
+
+const int MIN_ROW_BAND = 16;
+
+/**
+ * Distances stored as they are.
+ */
+struct FullDistances {
+  using Value = uint32_t;
+
+  static constexpr uint32_t INF = ~uint32_t(0) - 1;
+
+  static uint32_t saturate(uint32_t dist) { return dist; }
+};
+
+
+/**
+ * Distances that don't fit 16 bits become INF.
+ */
+struct SaturatedDistances {
+  using Value = uint16_t;
+
+  static constexpr uint16_t INF = ~uint16_t(0);
+
+  static uint16_t saturate(uint32_t dist) { return static_cast<uint16_t>(std::min<uint32_t>(dist, INF)); }
+};
+
+
+template <typename Traits>
+inline uint32_t distSq(const int x1, const int x2, const typename Traits::Value dySq) {
+  if (dySq == Traits::INF) {
+    return SEDM::INF_DIST;
   }
+  const int dx = x1 - x2;
+  const uint32_t dxSq = dx * dx;
+  return dxSq + dySq;
+}
 
-  const int width = m_size.width();
-  const int height = m_size.height();
+/**
+ * Sets the distances of a padded map to zero or INF according to \p image and \p borders.
+ */
+template <typename Traits>
+void initDistances(std::vector<typename Traits::Value>& data,
+                   const BinaryImage& image,
+                   const SEDM::DistType distType,
+                   const SEDM::Borders borders) {
+  using Value = typename Traits::Value;
 
-  m_data.resize((width + 2) * (height + 2), INF_DIST);
-  m_stride = width + 2;
-  m_plainData = &m_data[0] + m_stride + 1;
+  const int width = image.width();
+  const int height = image.height();
+  const int stride = width + 2;
 
-  if (borders & DIST_TO_TOP_BORDER) {
-    memset(&m_data[0], 0, m_stride * sizeof(m_data[0]));
+  data.resize((width + 2) * (height + 2), Traits::INF);
+
+  if (borders & SEDM::DIST_TO_TOP_BORDER) {
+    std::fill(data.begin(), data.begin() + stride, 0);
   }
-  if (borders & DIST_TO_BOTTOM_BORDER) {
-    memset(&m_data[m_data.size() - m_stride], 0, m_stride * sizeof(m_data[0]));
+  if (borders & SEDM::DIST_TO_BOTTOM_BORDER) {
+    std::fill(data.end() - stride, data.end(), 0);
   }
-  if (borders & (DIST_TO_LEFT_BORDER | DIST_TO_RIGHT_BORDER)) {
-    const int last = m_stride - 1;
-    uint32_t* line = &m_data[0];
+  if (borders & (SEDM::DIST_TO_LEFT_BORDER | SEDM::DIST_TO_RIGHT_BORDER)) {
+    const int last = stride - 1;
+    Value* line = &data[0];
     for (int todo = height + 2; todo > 0; --todo) {
-      if (borders & DIST_TO_LEFT_BORDER) {
+      if (borders & SEDM::DIST_TO_LEFT_BORDER) {
         line[0] = 0;
       }
-      if (borders & DIST_TO_RIGHT_BORDER) {
+      if (borders & SEDM::DIST_TO_RIGHT_BORDER) {
         line[last] = 0;
       }
-      line += m_stride;
+      line += stride;
     }
   }
 
-  uint32_t initial_distance[2];
-  if (distType == DIST_TO_WHITE) {
-    initial_distance[0] = 0;         // white
-    initial_distance[1] = INF_DIST;  // black
+  Value initialDistance[2];
+  if (distType == SEDM::DIST_TO_WHITE) {
+    initialDistance[0] = 0;            // white
+    initialDistance[1] = Traits::INF;  // black
   } else {
-    initial_distance[0] = INF_DIST;  // white
-    initial_distance[1] = 0;         // black
+    initialDistance[0] = Traits::INF;  // white
+    initialDistance[1] = 0;            // black
   }
 
-  uint32_t* pDist = m_plainData;
-  const uint32_t* imgLine = image.data();
+  Value* const plainData = &data[0] + stride + 1;
+  const uint32_t* const imgData = image.data();
   const int imgStride = image.wordsPerLine();
-  for (int y = 0; y < height; ++y) {
-    for (int x = 0; x < width; ++x, ++pDist) {
-      uint32_t word = imgLine[x >> 5];
-      word >>= 31 - (x & 31);
-      *pDist = initial_distance[word & 1];
+  parallelForBands(height, MIN_ROW_BAND, [&](const int begin, const int end) {
+    Value* pDist = plainData + begin * stride;
+    const uint32_t* imgLine = imgData + begin * imgStride;
+    for (int y = begin; y < end; ++y) {
+      for (int x = 0; x < width; ++x, ++pDist) {
+        uint32_t word = imgLine[x >> 5];
+        word >>= 31 - (x & 31);
+        *pDist = initialDistance[word & 1];
+      }
+      pDist += 2;
+      imgLine += imgStride;
     }
-    pDist += 2;
-    imgLine += imgStride;
+  });
+}  // initDistances
+
+/**
+ * Computes the vertical distances of a padded map of \p width x \p height cells.
+ *
+ * Columns are independent of each other, so they are split into bands processed
+ * in parallel.  Within a band, blocks of adjacent columns are walked down and up
+ * together, which touches memory line by line rather than a cell per line.
+ */
+template <typename Traits>
+void processColumns(typename Traits::Value* data, const int width, const int height) {
+  using Value = typename Traits::Value;
+
+  parallelForBands(width, COLUMN_BLOCK, [data, width, height](const int begin, const int end) {
+    // (d + 1)^2 = d^2 + 2d + 1
+    uint32_t b[COLUMN_BLOCK];  // 2d + 1 in the above formula.
+
+    for (int blockBegin = begin; blockBegin < end; blockBegin += COLUMN_BLOCK) {
+      const int blockWidth = std::min(COLUMN_BLOCK, end - blockBegin);
+
+      std::fill(b, b + blockWidth, 1);
+      Value* line = data + blockBegin;
+      for (int todo = height - 1; todo > 0; --todo) {
+        const Value* const prevLine = line;
+        line += width;
+        for (int i = 0; i < blockWidth; ++i) {
+          const uint32_t sqd = prevLine[i] + b[i];
+          if (line[i] > sqd) {
+            line[i] = static_cast<Value>(sqd);
+            b[i] += 2;
+          } else {
+            b[i] = 1;
+          }
+        }
+      }
+
+      std::fill(b, b + blockWidth, 1);
+      for (int todo = height - 1; todo > 0; --todo) {
+        const Value* const prevLine = line;
+        line -= width;
+        for (int i = 0; i < blockWidth; ++i) {
+          const uint32_t sqd = prevLine[i] + b[i];
+          if (line[i] > sqd) {
+            line[i] = static_cast<Value>(sqd);
+            b[i] += 2;
+          } else {
+            b[i] = 1;
+          }
+        }
+      }
+    }
+  });
+}  // processColumns
+
+/**
+ * Computes the final distances of a padded map of \p width x \p height cells,
+ * that already went through processColumns().  Lines are processed in parallel.
+ */
+template <typename Traits>
+void processRows(typename Traits::Value* data, const int width, const int height) {
+  using Value = typename Traits::Value;
+
+  parallelForBands(height, MIN_ROW_BAND, [data, width](const int begin, const int end) {
+    std::vector<int> s(width, 0);
+    std::vector<int> t(width, 0);
+    std::vector<Value> rowCopy(width, 0);
+
+    Value* line = data + begin * width;
+    for (int y = begin; y < end; ++y, line += width) {
+      int q = 0;
+      s[0] = 0;
+      t[0] = 0;
+      for (int x = 1; x < width; ++x) {
+        while (q >= 0 && distSq<Traits>(t[q], s[q], line[s[q]]) > distSq<Traits>(t[q], x, line[x])) {
+          --q;
+        }
+
+        if (q < 0) {
+          q = 0;
+          s[0] = x;
+        } else {
+          const int x2 = s[q];
+          if ((line[x] != Traits::INF) && (line[x2] != Traits::INF)) {
+            int w = (x * x + line[x]) - (x2 * x2 + line[x2]);
+            w /= (x - x2) << 1;
+            ++w;
+            if ((unsigned) w < (unsigned) width) {
+              ++q;
+              s[q] = x;
+              t[q] = w;
+            }
+          }
+        }
+      }
+
+      memcpy(&rowCopy[0], line, width * sizeof(*line));
+
+      for (int x = width - 1; x >= 0; --x) {
+        const int x2 = s[q];
+        line[x] = Traits::saturate(distSq<Traits>(x, x2, rowCopy[x2]));
+        if (x == t[q]) {
+          --q;
+        }
+      }
+    }
+  });
+}  // processRows
+}  // namespace
+
+SEDM::SEDM() : m_plainData(nullptr), m_size(), m_stride(0) {}
+
+SEDM::SEDM(const BinaryImage& image, const DistType distType, const Borders borders)
+    : m_plainData(nullptr), m_size(image.size()), m_stride(0) {
+  if (image.isNull()) {
+    return;
   }
 
-  processColumns();
-  processRows();
+  initDistances<FullDistances>(m_data, image, distType, borders);
+  m_stride = m_size.width() + 2;
+  m_plainData = &m_data[0] + m_stride + 1;
+
+  processColumns<FullDistances>(&m_data[0], m_stride, m_size.height() + 2);
+  processRows<FullDistances>(&m_data[0], m_stride, m_size.height() + 2);
 }
 
 SEDM::SEDM(ConnectivityMap& cmap) : m_plainData(nullptr), m_size(cmap.size()), m_stride(0) {
@@ -161,184 +335,116 @@ BinaryImage SEDM::findPeaksDestructive() {
   return peakCandidates;
 }  // SEDM::findPeaksDestructive
 
-inline uint32_t SEDM::distSq(const int x1, const int x2, const uint32_t dySq) {
-  if (dySq == INF_DIST) {
-    return INF_DIST;
-  }
-  const int dx = x1 - x2;
-  const uint32_t dxSq = dx * dx;
-  return dxSq + dySq;
-}
-
-void SEDM::processColumns() {
-  const int width = m_size.width() + 2;
-  const int height = m_size.height() + 2;
-
-  uint32_t* pSqd = &m_data[0];
-  for (int x = 0; x < width; ++x, ++pSqd) {
-    // (d + 1)^2 = d^2 + 2d + 1
-    uint32_t b = 1;  // 2d + 1 in the above formula.
-    for (int todo = height - 1; todo > 0; --todo) {
-      const uint32_t sqd = *pSqd + b;
-      pSqd += width;
-      if (*pSqd > sqd) {
-        *pSqd = sqd;
-        b += 2;
-      } else {
-        b = 1;
-      }
-    }
-
-    b = 1;
-    for (int todo = height - 1; todo > 0; --todo) {
-      const uint32_t sqd = *pSqd + b;
-      pSqd -= width;
-      if (*pSqd > sqd) {
-        *pSqd = sqd;
-        b += 2;
-      } else {
-        b = 1;
-      }
-    }
-  }
-}  // SEDM::processColumns
-
 void SEDM::processColumns(ConnectivityMap& cmap) {
   const int width = m_size.width() + 2;
   const int height = m_size.height() + 2;
 
-  uint32_t* pSqd = &m_data[0];
-  uint32_t* pLabel = cmap.paddedData();
-  for (int x = 0; x < width; ++x, ++pSqd, ++pLabel) {
+  uint32_t* const data = &m_data[0];
+  uint32_t* const labels = cmap.paddedData();
+  // See processColumns() in the anonymous namespace.
+  parallelForBands(width, COLUMN_BLOCK, [data, labels, width, height](const int begin, const int end) {
     // (d + 1)^2 = d^2 + 2d + 1
-    uint32_t b = 1;  // 2d + 1 in the above formula.
-    for (int todo = height - 1; todo > 0; --todo) {
-      const uint32_t sqd = *pSqd + b;
-      pSqd += width;
-      pLabel += width;
-      if (sqd < *pSqd) {
-        *pSqd = sqd;
-        *pLabel = pLabel[-width];
-        b += 2;
-      } else {
-        b = 1;
-      }
-    }
-
-    b = 1;
-    for (int todo = height - 1; todo > 0; --todo) {
-      const uint32_t sqd = *pSqd + b;
-      pSqd -= width;
-      pLabel -= width;
-      if (sqd < *pSqd) {
-        *pSqd = sqd;
-        *pLabel = pLabel[width];
-        b += 2;
-      } else {
-        b = 1;
-      }
-    }
-  }
-}  // SEDM::processColumns
-
-void SEDM::processRows() {
-  const int width = m_size.width() + 2;
-  const int height = m_size.height() + 2;
-
-  std::vector<int> s(width, 0);
-  std::vector<int> t(width, 0);
-  std::vector<uint32_t> rowCopy(width, 0);
-
-  uint32_t* line = &m_data[0];
-  for (int y = 0; y < height; ++y, line += width) {
-    int q = 0;
-    s[0] = 0;
-    t[0] = 0;
-    for (int x = 1; x < width; ++x) {
-      while (q >= 0 && distSq(t[q], s[q], line[s[q]]) > distSq(t[q], x, line[x])) {
-        --q;
-      }
-
-      if (q < 0) {
-        q = 0;
-        s[0] = x;
-      } else {
-        const int x2 = s[q];
-        if ((line[x] != INF_DIST) && (line[x2] != INF_DIST)) {
-          int w = (x * x + line[x]) - (x2 * x2 + line[x2]);
-          w /= (x - x2) << 1;
-          ++w;
-          if ((unsigned) w < (unsigned) width) {
-            ++q;
-            s[q] = x;
-            t[q] = w;
+    uint32_t b[COLUMN_BLOCK];  // 2d + 1 in the above formula.
+
+    for (int blockBegin = begin; blockBegin < end; blockBegin += COLUMN_BLOCK) {
+      const int blockWidth = std::min(COLUMN_BLOCK, end - blockBegin);
+
+      std::fill(b, b + blockWidth, 1);
+      uint32_t* line = data + blockBegin;
+      uint32_t* labelLine = labels + blockBegin;
+      for (int todo = height - 1; todo > 0; --todo) {
+        const uint32_t* const prevLine = line;
+        const uint32_t* const prevLabelLine = labelLine;
+        line += width;
+        labelLine += width;
+        for (int i = 0; i < blockWidth; ++i) {
+          const uint32_t sqd = prevLine[i] + b[i];
+          if (sqd < line[i]) {
+            line[i] = sqd;
+            labelLine[i] = prevLabelLine[i];
+            b[i] += 2;
+          } else {
+            b[i] = 1;
           }
         }
       }
-    }
 
-    memcpy(&rowCopy[0], line, width * sizeof(*line));
-
-    for (int x = width - 1; x >= 0; --x) {
-      const int x2 = s[q];
-      line[x] = distSq(x, x2, rowCopy[x2]);
-      if (x == t[q]) {
-        --q;
+      std::fill(b, b + blockWidth, 1);
+      for (int todo = height - 1; todo > 0; --todo) {
+        const uint32_t* const prevLine = line;
+        const uint32_t* const prevLabelLine = labelLine;
+        line -= width;
+        labelLine -= width;
+        for (int i = 0; i < blockWidth; ++i) {
+          const uint32_t sqd = prevLine[i] + b[i];
+          if (sqd < line[i]) {
+            line[i] = sqd;
+            labelLine[i] = prevLabelLine[i];
+            b[i] += 2;
+          } else {
+            b[i] = 1;
+          }
+        }
       }
     }
-  }
-}  // SEDM::processRows
+  });
+}  // SEDM::processColumns
 
 void SEDM::processRows(ConnectivityMap& cmap) {
   const int width = m_size.width() + 2;
   const int height = m_size.height() + 2;
 
-  std::vector<int> s(width, 0);
-  std::vector<int> t(width, 0);
-  std::vector<uint32_t> rowCopy(width, 0);
-  std::vector<uint32_t> cmapRowCopy(width, 0);
-
-  uint32_t* line = &m_data[0];
-  uint32_t* cmapLine = cmap.paddedData();
-  for (int y = 0; y < height; ++y, line += width, cmapLine += width) {
-    int q = 0;
-    s[0] = 0;
-    t[0] = 0;
-    for (int x = 1; x < width; ++x) {
-      while (q >= 0 && distSq(t[q], s[q], line[s[q]]) > distSq(t[q], x, line[x])) {
-        --q;
-      }
+  uint32_t* const data = &m_data[0];
+  uint32_t* const labels = cmap.paddedData();
+  parallelForBands(height, MIN_ROW_BAND, [data, labels, width](const int begin, const int end) {
+    std::vector<int> s(width, 0);
+    std::vector<int> t(width, 0);
+    std::vector<uint32_t> rowCopy(width, 0);
+    std::vector<uint32_t> cmapRowCopy(width, 0);
+
+    uint32_t* line = data + begin * width;
+    uint32_t* cmapLine = labels + begin * width;
+    for (int y = begin; y < end; ++y, line += width, cmapLine += width) {
+      int q = 0;
+      s[0] = 0;
+      t[0] = 0;
+      for (int x = 1; x < width; ++x) {
+        while (q >= 0
+               && distSq<FullDistances>(t[q], s[q], line[s[q]]) > distSq<FullDistances>(t[q], x, line[x])) {
+          --q;
+        }
 
-      if (q < 0) {
-        q = 0;
-        s[0] = x;
-      } else {
-        const int x2 = s[q];
-        if ((line[x] != INF_DIST) && (line[x2] != INF_DIST)) {
-          int w = (x * x + line[x]) - (x2 * x2 + line[x2]);
-          w /= (x - x2) << 1;
-          ++w;
-          if ((unsigned) w < (unsigned) width) {
-            ++q;
-            s[q] = x;
-            t[q] = w;
+        if (q < 0) {
+          q = 0;
+          s[0] = x;
+        } else {
+          const int x2 = s[q];
+          if ((line[x] != INF_DIST) && (line[x2] != INF_DIST)) {
+            int w = (x * x + line[x]) - (x2 * x2 + line[x2]);
+            w /= (x - x2) << 1;
+            ++w;
+            if ((unsigned) w < (unsigned) width) {
+              ++q;
+              s[q] = x;
+              t[q] = w;
+            }
           }
         }
       }
-    }
 
-    memcpy(&rowCopy[0], line, width * sizeof(*line));
-    memcpy(&cmapRowCopy[0], cmapLine, width * sizeof(*cmapLine));
+      memcpy(&rowCopy[0], line, width * sizeof(*line));
+      memcpy(&cmapRowCopy[0], cmapLine, width * sizeof(*cmapLine));
 
-    for (int x = width - 1; x >= 0; --x) {
-      const int x2 = s[q];
-      line[x] = distSq(x, x2, rowCopy[x2]);
-      cmapLine[x] = cmapRowCopy[x2];
-      if (x == t[q]) {
-        --q;
+      for (int x = width - 1; x >= 0; --x) {
+        const int x2 = s[q];
+        line[x] = distSq<FullDistances>(x, x2, rowCopy[x2]);
+        cmapLine[x] = cmapRowCopy[x2];
+        if (x == t[q]) {
+          --q;
+        }
       }
     }
-  }
+  });
 }  // SEDM::processRows
 
 /*====================== Peak finding stuff goes below ====================*/
@@ -460,4 +566,39 @@ void SEDM::incrementMaskedPadded(const BinaryImage& mask) {
     maskLine += maskWpl;
   }
 }
+
+SEDM16::SEDM16() : m_plainData(nullptr), m_size(), m_stride(0) {}
+
+SEDM16::SEDM16(const BinaryImage& image, const SEDM::DistType distType, const SEDM::Borders borders)
+    : m_plainData(nullptr), m_size(image.size()), m_stride(0) {
+  if (image.isNull()) {
+    return;
+  }
+
+  initDistances<SaturatedDistances>(m_data, image, distType, borders);
+  m_stride = m_size.width() + 2;
+  m_plainData = &m_data[0] + m_stride + 1;
+
+  processColumns<SaturatedDistances>(&m_data[0], m_stride, m_size.height() + 2);
+  processRows<SaturatedDistances>(&m_data[0], m_stride, m_size.height() + 2);
+}
+
+SEDM16::SEDM16(const SEDM16& other)
+    : m_data(other.m_data), m_plainData(nullptr), m_size(other.m_size), m_stride(other.m_stride) {
+  if (!m_size.isEmpty()) {
+    m_plainData = &m_data[0] + m_stride + 1;
+  }
+}
+
+SEDM16& SEDM16::operator=(const SEDM16& other) {
+  SEDM16(other).swap(*this);
+  return *this;
+}
+
+void SEDM16::swap(SEDM16& other) {
+  m_data.swap(other.m_data);
+  std::swap(m_plainData, other.m_plainData);
+  std::swap(m_size, other.m_size);
+  std::swap(m_stride, other.m_stride);
+}
 }  // namespace imageproc
\ No newline at end of file
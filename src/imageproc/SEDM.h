@@ -154,14 +154,8 @@ class SEDM {
   BinaryImage findPeaksDestructive();
 
  private:
-  static uint32_t distSq(int x1, int x2, uint32_t dySq);
-
-  void processColumns();
-
   void processColumns(ConnectivityMap& cmap);
 
-  void processRows();
-
   void processRows(ConnectivityMap& cmap);
 
   BinaryImage findPeakCandidatesNonPadded() const;
@@ -187,6 +181,67 @@ inline void swap(SEDM& o1, SEDM& o2) {
   o1.swap(o2);
 }
 
+
+/**
+ * \brief A squared euclidean distance map with 16-bit cells.
+ *
+ * It's built the same way as SEDM and stores the same distances, except that
+ * squared distances that don't fit 16 bits become INF_DIST.  That makes it
+ * exact for distances under 256 pixels, while taking half the memory and
+ * memory traffic of SEDM.
+ */
+class SEDM16 {
+ public:
+  /**
+   * \brief The infinite distance, which any squared distance that doesn't fit 16 bits becomes.
+   */
+  static const uint16_t INF_DIST;
+
+  /**
+   * \brief Constructs a null distance map.
+   */
+  SEDM16();
+
+  /**
+   * \brief Builds a distance map from a binary image.
+   *
+   * \see SEDM::SEDM(const BinaryImage&, SEDM::DistType, SEDM::Borders)
+   */
+  explicit SEDM16(const BinaryImage& image,
+                  SEDM::DistType distType = SEDM::DIST_TO_WHITE,
+                  SEDM::Borders borders = SEDM::DIST_TO_ALL_BORDERS);
+
+  SEDM16(const SEDM16& other);
+
+  SEDM16& operator=(const SEDM16& other);
+
+  void swap(SEDM16& other);
+
+  QSize size() const { return m_size; }
+
+  /**
+   * \brief Return the number of 16bit words in a line.
+   *
+   * This value is going to be size().width() + 2.
+   */
+  int stride() const { return m_stride; }
+
+  uint16_t* data() { return m_plainData; }
+
+  const uint16_t* data() const { return m_plainData; }
+
+ private:
+  std::vector<uint16_t> m_data;
+  uint16_t* m_plainData;
+  QSize m_size;
+  int m_stride;
+};
+
+
+inline void swap(SEDM16& o1, SEDM16& o2) {
+  o1.swap(o2);
+}
+
 DEFINE_FLAG_OPS(SEDM::Borders)
 }  // namespace imageproc
 #endif  // ifndef SCANTAILOR_IMAGEPROC_SEDM_H_
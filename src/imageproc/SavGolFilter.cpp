@@ -3,9 +3,15 @@
 
 #include "SavGolFilter.h"
 
+#include <QPoint>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
 #include <stdexcept>
+#include <vector>
 
 #include "Grayscale.h"
+#include "ParallelFor.h"
 #include "SavGolKernel.h"
 
 namespace imageproc {
@@ -14,31 +20,192 @@ int calcNumTerms(const int horDegree, const int vertDegree) {
   return (horDegree + 1) * (vertDegree + 1);
 }
 
-class Kernel : public SavGolKernel {
- public:
-  Kernel(const QSize& size, const QPoint& origin, int horDegree, int vertDegree)
-      : SavGolKernel(size, origin, horDegree, vertDegree) {}
+/**
+ * Builds the kernels fitting a polynomial of the given degree to a window
+ * of the given size, one for each position within the window the fitted
+ * polynomial may be evaluated at.
+ *
+ * A polynomial of a higher degree than the window size allows just
+ * reproduces the data, same as the one of the highest degree allowed.
+ */
+std::vector<std::vector<float>> buildKernels1D(const int size, const int degree) {
+  SavGolKernel kernel(QSize(size, 1), QPoint(0, 0), std::min(degree, size - 1), 0);
+  std::vector<std::vector<float>> kernels(size);
+  for (int origin = 0; origin < size; ++origin) {
+    kernel.recalcForOrigin(QPoint(origin, 0));
+    kernels[origin].assign(kernel.data(), kernel.data() + size);
+  }
+  return kernels;
+}
+
+/**
+ * The arithmetic of the common window sizes and degrees, whose kernels are
+ * small enough for it.  The coefficients are stored with 14 fractional bits,
+ * and the results of the horizontal pass with 6, so that both passes multiply
+ * 16-bit numbers into 32-bit sums, which the compiler vectorizes well.
+ */
+struct FixedPointArithmetic {
+  using Coef = int16_t;
+  using Temp = int16_t;
+  using Sum = int32_t;
+
+  static const int COEF_BITS = 14;
+  static const int TEMP_BITS = 6;
+
+  static Coef toCoef(const float coef) { return static_cast<Coef>(std::lround(coef * (1 << COEF_BITS))); }
+
+  static Temp toTemp(const Sum sum) {
+    return static_cast<Temp>((sum + (1 << (COEF_BITS - TEMP_BITS - 1))) >> (COEF_BITS - TEMP_BITS));
+  }
+
+  static int toPixel(const Sum sum) { return (sum + (1 << (COEF_BITS + TEMP_BITS - 1))) >> (COEF_BITS + TEMP_BITS); }
+};
 
-  void convolve(uint8_t* dst, const uint8_t* srcTopLeft, int srcBpl) const;
+struct FloatArithmetic {
+  using Coef = float;
+  using Temp = float;
+  using Sum = float;
+
+  static Coef toCoef(const float coef) { return coef; }
+
+  static Temp toTemp(const Sum sum) { return sum; }
+
+  static int toPixel(const Sum sum) { return static_cast<int>(std::floor(sum + 0.5f)); }
 };
 
+/**
+ * The fixed-point arithmetic works as long as neither the results of the horizontal
+ * pass overflow 16 bits, nor the sums of the vertical pass overflow 32 bits.
+ */
+bool fitsFixedPoint(const std::vector<std::vector<float>>& horKernels,
+                    const std::vector<std::vector<float>>& vertKernels) {
+  const auto maxAbsSum = [](const std::vector<std::vector<float>>& kernels) {
+    int64_t maxSum = 0;
+    for (const std::vector<float>& kernel : kernels) {
+      int64_t sum = 0;
+      for (const float coef : kernel) {
+        sum += std::abs(std::lround(coef * (1 << FixedPointArithmetic::COEF_BITS)));
+      }
+      maxSum = std::max(maxSum, sum);
+    }
+    return maxSum;
+  };
 
-inline void Kernel::convolve(uint8_t* dst, const uint8_t* srcTopLeft, int srcBpl) const {
-  const uint8_t* pSrc = srcTopLeft;
-  const float* pKernel = data();
-  float sum = 0.5;  // For rounding purposes.
-  const int w = width();
-  const int h = height();
+  const int tempShift = FixedPointArithmetic::COEF_BITS - FixedPointArithmetic::TEMP_BITS;
+  const int64_t maxTemp = ((255 * maxAbsSum(horKernels)) >> tempShift) + 1;
+  const int64_t maxSum = maxTemp * maxAbsSum(vertKernels) + (1 << (FixedPointArithmetic::COEF_BITS + tempShift));
+  return (maxTemp <= INT16_MAX) && (maxSum <= INT32_MAX);
+}
 
-  for (int y = 0; y < h; ++y, pSrc += srcBpl) {
-    for (int x = 0; x < w; ++x) {
-      sum += pSrc[x] * *pKernel;
-      ++pKernel;
+template <typename Arithmetic>
+std::vector<std::vector<typename Arithmetic::Coef>> toCoefs(const std::vector<std::vector<float>>& kernels) {
+  std::vector<std::vector<typename Arithmetic::Coef>> coefs(kernels.size());
+  for (size_t i = 0; i < kernels.size(); ++i) {
+    for (const float coef : kernels[i]) {
+      coefs[i].push_back(Arithmetic::toCoef(coef));
     }
   }
+  return coefs;
+}
 
-  const auto val = static_cast<int>(sum);
-  *dst = static_cast<uint8_t>(qBound(0, val, 255));
+/**
+ * Filters the image as the horizontal and vertical passes of the 1D filters,
+ * each pass in parallel bands of lines.  The 2D polynomial being fitted is
+ * a product of a horizontal and a vertical one, so the 2D kernel for any
+ * position within the window is the product of the corresponding 1D kernels.
+ * Near the image edges, the window stays within the image, while the position
+ * the fitted polynomial is evaluated at moves off its center.
+ */
+template <typename Arithmetic>
+void savGolFilterSeparable(const uint8_t* const srcData,
+                           const int srcBpl,
+                           uint8_t* const dstData,
+                           const int dstBpl,
+                           const int width,
+                           const int height,
+                           const std::vector<std::vector<float>>& horKernels,
+                           const std::vector<std::vector<float>>& vertKernels) {
+  using Coef = typename Arithmetic::Coef;
+  using Temp = typename Arithmetic::Temp;
+  using Sum = typename Arithmetic::Sum;
+
+  const std::vector<std::vector<Coef>> horCoefs(toCoefs<Arithmetic>(horKernels));
+  const std::vector<std::vector<Coef>> vertCoefs(toCoefs<Arithmetic>(vertKernels));
+  const int kw = static_cast<int>(horCoefs.size());
+  const int kh = static_cast<int>(vertCoefs.size());
+  const int kLeft = kw / 2;
+  const int kRight = kw - kLeft - 1;
+  const int kTop = kh / 2;
+
+  std::vector<Temp> temp(size_t(width) * height);
+
+  // Horizontal pass.
+  parallelForBands(height, 16, [&](const int yBegin, const int yEnd) {
+    // Local bounds, as the integer sums could otherwise alias the captured ones,
+    // which would keep the compiler from vectorizing the loops.
+    const int xBegin = kLeft;
+    const int xEnd = width - kRight;
+    std::vector<Sum> sums(width);
+    for (int y = yBegin; y < yEnd; ++y) {
+      const uint8_t* const srcLine = srcData + y * srcBpl;
+      Temp* const tempLine = &temp[size_t(y) * width];
+
+      std::fill(sums.begin() + xBegin, sums.begin() + xEnd, Sum());
+      const Coef* const coefs = horCoefs[kLeft].data();
+      for (int i = 0; i < kw; ++i) {
+        const Coef coef = coefs[i];
+        const uint8_t* const src = srcLine + i - xBegin;
+        for (int x = xBegin; x < xEnd; ++x) {
+          sums[x] += src[x] * coef;
+        }
+      }
+      for (int x = xBegin; x < xEnd; ++x) {
+        tempLine[x] = Arithmetic::toTemp(sums[x]);
+      }
+
+      // The edges, where the window is stuck at the image borders.
+      for (int x = 0; x < kLeft; ++x) {
+        Sum sum = Sum();
+        for (int i = 0; i < kw; ++i) {
+          sum += srcLine[i] * horCoefs[x][i];
+        }
+        tempLine[x] = Arithmetic::toTemp(sum);
+      }
+      for (int x = width - kRight; x < width; ++x) {
+        const uint8_t* const src = srcLine + width - kw;
+        const Coef* const edgeCoefs = horCoefs[x - (width - kw)].data();
+        Sum sum = Sum();
+        for (int i = 0; i < kw; ++i) {
+          sum += src[i] * edgeCoefs[i];
+        }
+        tempLine[x] = Arithmetic::toTemp(sum);
+      }
+    }
+  });
+
+  // Vertical pass.
+  parallelForBands(height, 16, [&](const int yBegin, const int yEnd) {
+    const int xEnd = width;
+    std::vector<Sum> sums(width);
+    for (int y = yBegin; y < yEnd; ++y) {
+      const int windowTop = qBound(0, y - kTop, height - kh);
+      const Coef* const coefs = vertCoefs[y - windowTop].data();
+
+      std::fill(sums.begin(), sums.end(), Sum());
+      for (int i = 0; i < kh; ++i) {
+        const Coef coef = coefs[i];
+        const Temp* const tempLine = &temp[size_t(windowTop + i) * width];
+        for (int x = 0; x < xEnd; ++x) {
+          sums[x] += tempLine[x] * coef;
+        }
+      }
+
+      uint8_t* const dstLine = dstData + y * dstBpl;
+      for (int x = 0; x < xEnd; ++x) {
+        dstLine[x] = static_cast<uint8_t>(qBound(0, Arithmetic::toPixel(sums[x]), 255));
+      }
+    }
+  });
 }
 
 QImage savGolFilterGrayToGray(const QImage& src, const QSize& windowSize, const int horDegree, const int vertDegree) {
@@ -53,211 +220,20 @@ QImage savGolFilterGrayToGray(const QImage& src, const QSize& windowSize, const
     return src;
   }
 
-  /*
-   * Consider a 5x5 kernel:
-   * |x|x|T|x|x|
-   * |x|x|T|x|x|
-   * |L|L|C|R|R|
-   * |x|x|B|x|x|
-   * |x|x|B|x|x|
-   */
-
-  // Co-ordinates of the central point (C) of the kernel.
-  const QPoint kCenter(kw / 2, kh / 2);
-
-  // Origin is the current hot spot of the kernel.
-  // Normally it's at kCenter, but sometimes we move
-  // it to other locations to avoid parts of the kernel
-  // from going outside of the image area.
-  QPoint kOrigin;
-
-  // Length of the top segment (T) of the kernel.
-  const int kTop = kCenter.y();
-
-  // Length of the bottom segment (B) of the kernel.
-  const int kBottom = kh - kTop - 1;
-
-  // Length of the left segment (L) of the kernel.
-  const int kLeft = kCenter.x();
-  // Length of the right segment (R) of the kernel.
-  const int kRight = kw - kLeft - 1;
-
-  const uint8_t* const srcData = src.bits();
-  const int srcBpl = src.bytesPerLine();
-
   QImage dst(width, height, QImage::Format_Indexed8);
   dst.setColorTable(createGrayscalePalette());
   if ((width > 0) && (height > 0) && dst.isNull()) {
     throw std::bad_alloc();
   }
 
-  uint8_t* const dstData = dst.bits();
-  const int dstBpl = dst.bytesPerLine();
-  // Top-left corner.
-  const uint8_t* srcLine = srcData;
-  uint8_t* dstLine = dstData;
-  Kernel kernel(windowSize, QPoint(0, 0), horDegree, vertDegree);
-  for (int y = 0; y < kTop; ++y, dstLine += dstBpl) {
-    kOrigin.setY(y);
-    for (int x = 0; x < kLeft; ++x) {
-      kOrigin.setX(x);
-      kernel.recalcForOrigin(kOrigin);
-      kernel.convolve(dstLine + x, srcLine, srcBpl);
-    }
-  }
-
-  // Top area between two corners.
-  kOrigin.setX(kCenter.x());
-  srcLine = srcData - kLeft;
-  dstLine = dstData;
-  for (int y = 0; y < kTop; ++y, dstLine += dstBpl) {
-    kOrigin.setY(y);
-    kernel.recalcForOrigin(kOrigin);
-    for (int x = kLeft; x < width - kRight; ++x) {
-      kernel.convolve(dstLine + x, srcLine + x, srcBpl);
-    }
-  }
-  // Top-right corner.
-  kOrigin.setY(0);
-  srcLine = srcData + width - kw;
-  dstLine = dstData;
-  for (int y = 0; y < kTop; ++y, dstLine += dstBpl) {
-    kOrigin.setX(kCenter.x() + 1);
-    for (int x = width - kRight; x < width; ++x) {
-      kernel.recalcForOrigin(kOrigin);
-      kernel.convolve(dstLine + x, srcLine, srcBpl);
-      kOrigin.rx() += 1;
-    }
-    kOrigin.ry() += 1;
-  }
-  // Central area.
-#if 0
-            // Simple but slow implementation.
-                    kernel.recalcForOrigin(kCenter);
-                    srcLine = srcData - kLeft;
-                    dstLine = dstData + dstBpl * kTop;
-                    for (int y = kTop; y < height - kBottom; ++y) {
-                        for (int x = kLeft; x < width - kRight; ++x) {
-                            kernel.convolve(dstLine + x, srcLine + x, srcBpl);
-                        }
-                        srcLine += srcBpl;
-                        dstLine += dstBpl;
-                    }
-#else
-  // Take advantage of Savitzky-Golay filter being separable.
-  const SavGolKernel horKernel(QSize(windowSize.width(), 1), QPoint(kCenter.x(), 0), horDegree, 0);
-  const SavGolKernel vertKernel(QSize(1, windowSize.height()), QPoint(0, kCenter.y()), 0, vertDegree);
-
-  const int shift = kw - 1;
-
-  // Allocate a 16-byte aligned temporary storage.
-  // That may help the compiler to emit efficient SSE code.
-  const int tempStride = (width - shift + 3) & ~3;
-  AlignedArray<float, 4> tempArray(tempStride * height);
-  // Horizontal pass.
-  srcLine = srcData - shift;
-  float* tempLine = tempArray.data() - shift;
-  for (int y = 0; y < height; ++y) {
-    for (int i = shift; i < width; ++i) {
-      float sum = 0.0f;
-
-      const uint8_t* src = srcLine + i;
-      for (int j = 0; j < kw; ++j) {
-        sum += src[j] * horKernel[j];
-      }
-      tempLine[i] = sum;
-    }
-    tempLine += tempStride;
-    srcLine += srcBpl;
-  }
-  // Vertical pass.
-  dstLine = dstData + kTop * dstBpl + kLeft - shift;
-  tempLine = tempArray.data() - shift;
-  for (int y = kTop; y < height - kBottom; ++y) {
-    for (int i = shift; i < width; ++i) {
-      float sum = 0.0f;
-
-      float* tmp = tempLine + i;
-      for (int j = 0; j < kh; ++j, tmp += tempStride) {
-        sum += *tmp * vertKernel[j];
-      }
-      const auto val = static_cast<int>(sum);
-      dstLine[i] = static_cast<uint8_t>(qBound(0, val, 255));
-    }
-
-    tempLine += tempStride;
-    dstLine += dstBpl;
-  }
-#endif  // if 0
-
-  // Left area between two corners.
-  kOrigin.setX(0);
-  kOrigin.setY(kCenter.y() + 1);
-  for (int x = 0; x < kLeft; ++x) {
-    srcLine = srcData;
-    dstLine = dstData + dstBpl * kTop;
-
-    kernel.recalcForOrigin(kOrigin);
-    for (int y = kTop; y < height - kBottom; ++y) {
-      kernel.convolve(dstLine + x, srcLine, srcBpl);
-      srcLine += srcBpl;
-      dstLine += dstBpl;
-    }
-    kOrigin.rx() += 1;
-  }
-  // Right area between two corners.
-  kOrigin.setX(kCenter.x() + 1);
-  kOrigin.setY(kCenter.y());
-  for (int x = width - kRight; x < width; ++x) {
-    srcLine = srcData + width - kw;
-    dstLine = dstData + dstBpl * kTop;
-
-    kernel.recalcForOrigin(kOrigin);
-    for (int y = kTop; y < height - kBottom; ++y) {
-      kernel.convolve(dstLine + x, srcLine, srcBpl);
-      srcLine += srcBpl;
-      dstLine += dstBpl;
-    }
-    kOrigin.rx() += 1;
-  }
-
-  // Bottom-left corner.
-  kOrigin.setY(kCenter.y() + 1);
-  srcLine = srcData + srcBpl * (height - kh);
-  dstLine = dstData + dstBpl * (height - kBottom);
-  for (int y = height - kBottom; y < height; ++y, dstLine += dstBpl) {
-    for (int x = 0; x < kLeft; ++x) {
-      kOrigin.setX(x);
-      kernel.recalcForOrigin(kOrigin);
-      kernel.convolve(dstLine + x, srcLine, srcBpl);
-    }
-    kOrigin.ry() += 1;
-  }
-
-  // Bottom area between two corners.
-  kOrigin.setX(kCenter.x());
-  kOrigin.setY(kCenter.y() + 1);
-  srcLine = srcData + srcBpl * (height - kh) - kLeft;
-  dstLine = dstData + dstBpl * (height - kBottom);
-  for (int y = height - kBottom; y < height; ++y, dstLine += dstBpl) {
-    kernel.recalcForOrigin(kOrigin);
-    for (int x = kLeft; x < width - kRight; ++x) {
-      kernel.convolve(dstLine + x, srcLine + x, srcBpl);
-    }
-    kOrigin.ry() += 1;
-  }
-  // Bottom-right corner.
-  kOrigin.setY(kCenter.y() + 1);
-  srcLine = srcData + srcBpl * (height - kh) + (width - kw);
-  dstLine = dstData + dstBpl * (height - kBottom);
-  for (int y = height - kBottom; y < height; ++y, dstLine += dstBpl) {
-    kOrigin.setX(kCenter.x() + 1);
-    for (int x = width - kRight; x < width; ++x) {
-      kernel.recalcForOrigin(kOrigin);
-      kernel.convolve(dstLine + x, srcLine, srcBpl);
-      kOrigin.rx() += 1;
-    }
-    kOrigin.ry() += 1;
+  const std::vector<std::vector<float>> horKernels(buildKernels1D(kw, horDegree));
+  const std::vector<std::vector<float>> vertKernels(buildKernels1D(kh, vertDegree));
+  if (fitsFixedPoint(horKernels, vertKernels)) {
+    savGolFilterSeparable<FixedPointArithmetic>(src.bits(), src.bytesPerLine(), dst.bits(), dst.bytesPerLine(), width,
+                                                height, horKernels, vertKernels);
+  } else {
+    savGolFilterSeparable<FloatArithmetic>(src.bits(), src.bytesPerLine(), dst.bits(), dst.bytesPerLine(), width,
+                                           height, horKernels, vertKernels);
   }
   return dst;
 }  // savGolFilterGrayToGray
@@ -5,7 +5,9 @@
 
 #include <QDebug>
 #include <stdexcept>
+#include <vector>
 
+#include "FastQueue.h"
 #include "GrayImage.h"
 #include "SeedFillGeneric.h"
 
@@ -120,6 +122,7 @@ void seedFill8Iteration(BinaryImage& seed, const BinaryImage& mask) {
   // Top to bottom.
   for (int y = 0; y < h; ++y) {
     uint32_t prevWord = 0;
+    uint32_t prevLineWord = 0;  // prevLine[i - 1]
 
     // Make sure offscreen bits area 0.
     seedLine[lastWordIdx] &= lastWordMask;
@@ -127,21 +130,25 @@ void seedFill8Iteration(BinaryImage& seed, const BinaryImage& mask) {
     int i = 0;
     for (; i < lastWordIdx; ++i) {
       const uint32_t mask = maskLine[i];
-      uint32_t word = prevLine[i];
+      const uint32_t prevLineThisWord = prevLine[i];
+      uint32_t word = prevLineThisWord;
       word |= (word << 1) | (word >> 1);
       word |= seedLine[i];
       word |= prevLine[i + 1] >> 31;
+      word |= prevLineWord << 31;
       word |= prevWord << 31;
       word &= mask;
       word = fillWordHorizontally(word, mask);
       seedLine[i] = word;
       prevWord = word;
+      prevLineWord = prevLineThisWord;
     }
     // Last word.
     const uint32_t mask = maskLine[i] & lastWordMask;
     uint32_t word = prevLine[i];
     word |= (word << 1) | (word >> 1);
     word |= seedLine[i];
+    word |= prevLineWord << 31;
     word |= prevWord << 31;
     word &= mask;
     word = fillWordHorizontally(word, mask);
@@ -159,6 +166,7 @@ void seedFill8Iteration(BinaryImage& seed, const BinaryImage& mask) {
   // Bottom to top.
   for (int y = h - 1; y >= 0; --y) {
     uint32_t prevWord = 0;
+    uint32_t prevLineWord = 0;  // prevLine[i + 1]
 
     // Make sure offscreen bits area 0.
     seedLine[lastWordIdx] &= lastWordMask;
@@ -166,15 +174,18 @@ void seedFill8Iteration(BinaryImage& seed, const BinaryImage& mask) {
     int i = lastWordIdx;
     for (; i > 0; --i) {
       const uint32_t mask = maskLine[i];
-      uint32_t word = prevLine[i];
+      const uint32_t prevLineThisWord = prevLine[i];
+      uint32_t word = prevLineThisWord;
       word |= (word << 1) | (word >> 1);
       word |= seedLine[i];
       word |= prevLine[i - 1] << 31;
+      word |= prevLineWord >> 31;
       word |= prevWord >> 31;
       word &= mask;
       word = fillWordHorizontally(word, mask);
       seedLine[i] = word;
       prevWord = word;
+      prevLineWord = prevLineThisWord;
     }
 
     // Last word.
@@ -182,6 +193,7 @@ void seedFill8Iteration(BinaryImage& seed, const BinaryImage& mask) {
     uint32_t word = prevLine[i];
     word |= (word << 1) | (word >> 1);
     word |= seedLine[i];
+    word |= prevLineWord >> 31;
     word |= prevWord >> 31;
     word &= mask;
     word = fillWordHorizontally(word, mask);
@@ -199,6 +211,135 @@ void seedFill8Iteration(BinaryImage& seed, const BinaryImage& mask) {
   }
 }  // seedFill8Iteration
 
+/**
+ * \brief Propagates the seed words of a binary image through a FIFO queue.
+ *
+ * This is the queue phase of Vincent's hybrid algorithm, done a word at a time.
+ * Each queued word spreads its pixels into the adjacent words of its own line
+ * and of the lines above and below it.  Any word that gains pixels as a result
+ * is filled horizontally and queued.
+ */
+class BinarySeedFillQueue {
+ public:
+  BinarySeedFillQueue(BinaryImage& seed, const BinaryImage& mask, const Connectivity connectivity)
+      : m_seedData(seed.data()),
+        m_maskData(mask.data()),
+        m_seedWpl(seed.wordsPerLine()),
+        m_maskWpl(mask.wordsPerLine()),
+        m_height(seed.height()),
+        m_lastWordIdx((seed.width() - 1) >> 5),
+        m_lastWordMask(~uint32_t(0) << (((m_lastWordIdx + 1) << 5) - seed.width())),
+        m_conn8(connectivity == CONN8),
+        m_inQueue(static_cast<size_t>(m_lastWordIdx + 1) * m_height, 0) {}
+
+  /**
+   * \brief Queues the words that can still spread to their neighbors.
+   *
+   * What's not queued here must be final already, which is the case
+   * after a raster and an anti-raster pass.
+   */
+  void pushUnstableWords() {
+    for (int y = 0; y < m_height; ++y) {
+      const uint32_t* seedLine = m_seedData + y * m_seedWpl;
+      for (int i = 0; i <= m_lastWordIdx; ++i) {
+        if (seedLine[i] && canSpread(i, y, seedLine[i])) {
+          push(i, y);
+        }
+      }
+    }
+  }
+
+  void propagate() {
+    while (!m_queue.empty()) {
+      const WordPos pos(m_queue.front());
+      m_queue.pop();
+      m_inQueue[pos.y * (m_lastWordIdx + 1) + pos.idx] = 0;
+
+      const uint32_t word = m_seedData[pos.y * m_seedWpl + pos.idx];
+      spreadTo(pos.idx - 1, pos.y, word >> 31);
+      spreadTo(pos.idx + 1, pos.y, word << 31);
+      for (int y = pos.y - 1; y <= pos.y + 1; y += 2) {
+        if (m_conn8) {
+          spreadTo(pos.idx, y, word | (word << 1) | (word >> 1));
+          spreadTo(pos.idx - 1, y, word >> 31);
+          spreadTo(pos.idx + 1, y, word << 31);
+        } else {
+          spreadTo(pos.idx, y, word);
+        }
+      }
+    }
+  }
+
+ private:
+  struct WordPos {
+    int idx;
+    int y;
+
+    WordPos(int idx_, int y_) : idx(idx_), y(y_) {}
+  };
+
+  uint32_t maskWord(const int idx, const int y) const {
+    const uint32_t mask = m_maskData[y * m_maskWpl + idx];
+    return idx == m_lastWordIdx ? mask & m_lastWordMask : mask;
+  }
+
+  /**
+   * \return The pixels \p bits would add to the word at (\p idx, \p y).
+   */
+  uint32_t gain(const int idx, const int y, const uint32_t bits) const {
+    if ((idx < 0) || (idx > m_lastWordIdx) || (y < 0) || (y >= m_height)) {
+      return 0;
+    }
+    return bits & maskWord(idx, y) & ~m_seedData[y * m_seedWpl + idx];
+  }
+
+  bool canSpread(const int idx, const int y, const uint32_t word) const {
+    if (gain(idx - 1, y, word >> 31) || gain(idx + 1, y, word << 31)) {
+      return true;
+    }
+    for (int ny = y - 1; ny <= y + 1; ny += 2) {
+      if (m_conn8) {
+        if (gain(idx, ny, word | (word << 1) | (word >> 1)) || gain(idx - 1, ny, word >> 31)
+            || gain(idx + 1, ny, word << 31)) {
+          return true;
+        }
+      } else if (gain(idx, ny, word)) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  void spreadTo(const int idx, const int y, const uint32_t bits) {
+    const uint32_t added = gain(idx, y, bits);
+    if (!added) {
+      return;
+    }
+    uint32_t& seedWord = m_seedData[y * m_seedWpl + idx];
+    seedWord = fillWordHorizontally(seedWord | added, maskWord(idx, y));
+    push(idx, y);
+  }
+
+  void push(const int idx, const int y) {
+    uint8_t& inQueue = m_inQueue[y * (m_lastWordIdx + 1) + idx];
+    if (!inQueue) {
+      inQueue = 1;
+      m_queue.push(WordPos(idx, y));
+    }
+  }
+
+  uint32_t* const m_seedData;
+  const uint32_t* const m_maskData;
+  const int m_seedWpl;
+  const int m_maskWpl;
+  const int m_height;
+  const int m_lastWordIdx;
+  const uint32_t m_lastWordMask;
+  const bool m_conn8;
+  std::vector<uint8_t> m_inQueue;
+  FastQueue<WordPos> m_queue;
+};
+
 inline uint8_t lightest(uint8_t lhs, uint8_t rhs) {
   return lhs > rhs ? lhs : rhs;
 }
@@ -402,6 +543,31 @@ BinaryImage seedFill(const BinaryImage& seed, const BinaryImage& mask, const Con
     throw std::invalid_argument("seedFill: seed and mask have different sizes");
   }
 
+  BinaryImage img(seed);
+  if (img.isNull()) {
+    return img;
+  }
+
+  // A raster and an anti-raster pass take care of most of the propagation.
+  // What they couldn't finish is done by the queue, so unlike in
+  // seedFillSlow(), the number of passes doesn't depend on the image.
+  if (connectivity == CONN4) {
+    seedFill4Iteration(img, mask);
+  } else {
+    seedFill8Iteration(img, mask);
+  }
+
+  BinarySeedFillQueue queue(img, mask, connectivity);
+  queue.pushUnstableWords();
+  queue.propagate();
+  return img;
+}
+
+BinaryImage seedFillSlow(const BinaryImage& seed, const BinaryImage& mask, const Connectivity connectivity) {
+  if (seed.size() != mask.size()) {
+    throw std::invalid_argument("seedFillSlow: seed and mask have different sizes");
+  }
+
   BinaryImage prev;
   BinaryImage img(seed);
 
@@ -22,11 +22,20 @@ class GrayImage;
  * \p seed is allowed to contain black pixels that are not in \p mask.
  * They will be ignored and will not appear in the resulting image.
  * \par
- * The underlying code implements Luc Vincent's iterative seed-fill
- * algorithm: http://www.vincent-net.com/luc/papers/93ieeeip_recons.pdf
+ * The underlying code implements Luc Vincent's hybrid seed-fill algorithm,
+ * working on 32-pixel words: http://www.vincent-net.com/luc/papers/93ieeeip_recons.pdf
  */
 BinaryImage seedFill(const BinaryImage& seed, const BinaryImage& mask, Connectivity connectivity);
 
+/**
+ * \brief A slower but more simple implementation of seedFill().
+ *
+ * It repeats raster and anti-raster passes until nothing changes.
+ * This function should not be used for anything but testing the correctness
+ * of seedFill().
+ */
+BinaryImage seedFillSlow(const BinaryImage& seed, const BinaryImage& mask, Connectivity connectivity);
+
 /**
  * \brief Spread darker colors from seed as long as mask allows it.
  *
@@ -5,12 +5,15 @@
 #define SCANTAILOR_IMAGEPROC_SEEDFILLGENERIC_H_
 
 #include <QSize>
+#include <algorithm>
 #include <cassert>
+#include <cstdint>
 #include <vector>
 
 #include "BinaryImage.h"
 #include "Connectivity.h"
 #include "FastQueue.h"
+#include "ParallelFor.h"
 
 namespace imageproc {
 namespace detail {
@@ -113,6 +116,8 @@ void spread4(SpreadOp spreadOp,
     const HTransition ht(hTransitions[pos.x]);
     const VTransition vt(vTransitions[pos.y]);
     uint32_t* const inQueueLine = inQueueData + inQueueStride * pos.y;
+    // It may be changed again by its neighbors, and then it has to be re-queued.
+    inQueueLine[pos.x >> 5] &= ~((uint32_t(1) << 31) >> (pos.x & 31));
     T* seed;
     const T* mask;
 
@@ -158,6 +163,8 @@ void spread8(SpreadOp spreadOp,
     const HTransition ht(hTransitions[pos.x]);
     const VTransition vt(vTransitions[pos.y]);
     uint32_t* const inQueueLine = inQueueData + inQueueStride * pos.y;
+    // It may be changed again by its neighbors, and then it has to be re-queued.
+    inQueueLine[pos.x >> 5] &= ~((uint32_t(1) << 31) >> (pos.x & 31));
     T* seed;
     const T* mask;
 
@@ -203,7 +210,7 @@ void spread8(SpreadOp spreadOp,
 
     // South-Western neighbor.
     seed = pos.seed + (seedStride & vt.southMask) + ht.westDelta;
-    mask = pos.mask + (seedStride & vt.southMask) + ht.westDelta;
+    mask = pos.mask + (maskStride & vt.southMask) + ht.westDelta;
     processNeighbor(spreadOp, maskOp, queue, inQueueLine + (inQueueStride & vt.southMask), thisVal, seed, mask, pos,
                     ht.westDelta, 1 & vt.southMask);
   }
@@ -422,6 +429,63 @@ void seedFill8(SpreadOp spreadOp,
   spread8(spreadOp, maskOp, queue, inQueueData, inQueueStride, &hTransitions[0], &vTransitions[0], seedStride,
           maskStride);
 }  // seedFill8
+
+/**
+ * Images shorter than twice that are filled by a single thread.
+ */
+const int MIN_BAND_HEIGHT = 64;
+
+/**
+ * \brief Finishes a fill that was done independently in horizontal bands.
+ *
+ * Each band is stable on its own, so only the pixels on both sides of band
+ * boundaries may spread any further.  Spreading from them reaches the same
+ * result as filling the whole image at once would.
+ *
+ * \param bandStarts The first line of each band, in increasing order.
+ */
+template <typename T, typename SpreadOp, typename MaskOp>
+void joinBands(SpreadOp spreadOp,
+               MaskOp maskOp,
+               const Connectivity conn,
+               T* const seed,
+               const int seedStride,
+               const QSize size,
+               const T* const mask,
+               const int maskStride,
+               const std::vector<int>& bandStarts) {
+  const int w = size.width();
+  const int h = size.height();
+
+  FastQueue<Position<T>> queue;
+  BinaryImage inQueue(size, WHITE);
+  uint32_t* const inQueueData = inQueue.data();
+  const int inQueueStride = inQueue.wordsPerLine();
+  std::vector<HTransition> hTransitions;
+  std::vector<VTransition> vTransitions;
+  initHorTransitions(hTransitions, w);
+  initVertTransitions(vTransitions, h);
+
+  for (size_t i = 1; i < bandStarts.size(); ++i) {
+    for (int y = bandStarts[i] - 1; y <= bandStarts[i]; ++y) {
+      T* const seedLine = seed + y * seedStride;
+      const T* const maskLine = mask + y * maskStride;
+      uint32_t* const inQueueLine = inQueueData + y * inQueueStride;
+      for (int x = 0; x < w; ++x) {
+        queue.push(Position<T>(seedLine + x, maskLine + x, x, y));
+        inQueueLine[x >> 5] |= (uint32_t(1) << 31) >> (x & 31);
+      }
+    }
+  }
+
+  if (conn == CONN4) {
+    spread4(spreadOp, maskOp, queue, inQueueData, inQueueStride, &hTransitions[0], &vTransitions[0], seedStride,
+            maskStride);
+  } else {
+    spread8(spreadOp, maskOp, queue, inQueueData, inQueueStride, &hTransitions[0], &vTransitions[0], seedStride,
+            maskStride);
+  }
+}  // joinBands
 }  // namespace seed_fill_generic
 }  // namespace detail
 
@@ -449,6 +513,9 @@ void seedFill8(SpreadOp spreadOp,
  * \param mask Pointer to the mask data.
  * \param maskStride The size of a row in the mask buffer, in terms of the number of T objects.
  *
+ * Images tall enough are split into horizontal bands, filled in parallel, and then
+ * joined by spreading across band boundaries.  That doesn't affect the result.
+ *
  * This code is an implementation of the hybrid grayscale restoration algorithm described in:
  * Morphological Grayscale Reconstruction in Image Analysis:
  * Applications and Efficient Algorithms, technical report 91-16, Harvard Robotics Laboratory,
@@ -463,16 +530,46 @@ void seedFillGenericInPlace(SpreadOp spreadOp,
                             QSize size,
                             const T* mask,
                             int maskStride) {
+  using namespace detail::seed_fill_generic;
+
   if (size.isEmpty()) {
     return;
   }
+  assert((conn == CONN4) || (conn == CONN8));
+
+  const int numBands = std::min(parallelForMaxThreads(), size.height() / MIN_BAND_HEIGHT);
+  if (numBands <= 1) {
+    if (conn == CONN4) {
+      seedFill4(spreadOp, maskOp, seed, seedStride, size, mask, maskStride);
+    } else {
+      seedFill8(spreadOp, maskOp, seed, seedStride, size, mask, maskStride);
+    }
+    return;
+  }
 
-  if (conn == CONN4) {
-    detail::seed_fill_generic::seedFill4(spreadOp, maskOp, seed, seedStride, size, mask, maskStride);
-  } else {
-    assert(conn == CONN8);
-    detail::seed_fill_generic::seedFill8(spreadOp, maskOp, seed, seedStride, size, mask, maskStride);
+  // Fill each band as if it was a separate image, then let
+  // the bands spread into each other.
+  std::vector<int> bandStarts(numBands);
+  for (int i = 0; i < numBands; ++i) {
+    bandStarts[i] = static_cast<int>(int64_t(size.height()) * i / numBands);
   }
+
+  parallelForBands(numBands, 1, [&](const int begin, const int end) {
+    for (int i = begin; i < end; ++i) {
+      const int top = bandStarts[i];
+      const int bottom = (i + 1 < numBands) ? bandStarts[i + 1] : size.height();
+      T* const bandSeed = seed + top * seedStride;
+      const T* const bandMask = mask + top * maskStride;
+      const QSize bandSize(size.width(), bottom - top);
+      if (conn == CONN4) {
+        seedFill4(spreadOp, maskOp, bandSeed, seedStride, bandSize, bandMask, maskStride);
+      } else {
+        seedFill8(spreadOp, maskOp, bandSeed, seedStride, bandSize, bandMask, maskStride);
+      }
+    }
+  });
+
+  joinBands(spreadOp, maskOp, conn, seed, seedStride, size, mask, maskStride, bandStarts);
 }
 }  // namespace imageproc
 
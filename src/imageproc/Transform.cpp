@@ -6,10 +6,17 @@
 #include <QDebug>
 #include <cassert>
 #include <stdexcept>
+#include <vector>
 
 #include "BadAllocIfNull.h"
 #include "ColorMixer.h"
 #include "Grayscale.h"
+#include "ParallelFor.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#define TRANSFORM_SSE2
+#include <emmintrin.h>
+#endif
 
 namespace imageproc {
 namespace {
@@ -40,6 +47,331 @@ QSizeF calcSrcUnitSize(const QTransform& xform, const QSizeF& min) {
   return QSizeF(std::max(min32.width(), width), std::max(min32.height(), height));
 }
 
+#ifdef TRANSFORM_SSE2
+/**
+ * \brief Does what ArgbColorMixer<float> does, for all four channels at once.
+ */
+class Sse2ArgbColorMixer {
+ public:
+  using accumType = float;
+  using resultType = uint32_t;
+
+  Sse2ArgbColorMixer() : m_accum(_mm_setzero_ps()) {}
+
+  void add(const uint32_t argb, const float weight) {
+    const __m128i zero = _mm_setzero_si128();
+    // Lanes are (blue, green, red, 1), so the alpha lane accumulates just the alpha weights.
+    __m128i channels = _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(argb), zero), zero);
+    channels = _mm_insert_epi16(channels, 1, 6);
+    const float alphaWeight = float((argb >> 24) & 0xFF) * weight;
+    m_accum = _mm_add_ps(m_accum, _mm_mul_ps(_mm_cvtepi32_ps(channels), _mm_set1_ps(alphaWeight)));
+  }
+
+  uint32_t mix(const float totalWeight) const {
+    assert(totalWeight > 0);
+    alignas(16) float accum[4];
+    _mm_store_ps(accum, m_accum);
+    if (accum[3] == 0.0f) {
+      // A totally transparent color.
+      return 0;
+    }
+
+    const float scale1 = 1.0f / totalWeight;
+    const float scale2 = 1.0f / accum[3];
+    const uint32_t a = uint32_t(0.5f + accum[3] * scale1);
+    const uint32_t r = uint32_t(0.5f + accum[2] * scale2);
+    const uint32_t g = uint32_t(0.5f + accum[1] * scale2);
+    const uint32_t b = uint32_t(0.5f + accum[0] * scale2);
+    return (a << 24) | (r << 16) | (g << 8) | b;
+  }
+
+ private:
+  __m128 m_accum;
+};
+
+using ArgbTransformMixer = Sse2ArgbColorMixer;
+#else
+using ArgbTransformMixer = ArgbColorMixer<float>;
+#endif  // ifdef TRANSFORM_SSE2
+
+/**
+ * \brief Does what RgbColorMixer<uint32_t> does, accumulating red and blue
+ *        in the two halves of a 64-bit integer.
+ *
+ * Each half overflows exactly when the corresponding 32-bit accumulator of
+ * RgbColorMixer<uint32_t> would, so it's no less capable.
+ */
+class PackedRgbColorMixer {
+ public:
+  using accumType = uint32_t;
+  using resultType = uint32_t;
+
+  PackedRgbColorMixer() : m_redBlueAccum(0), m_greenAccum(0) {}
+
+  void add(const uint32_t rgb, const uint32_t weight) {
+    const uint64_t redBlue = (uint64_t((rgb >> 16) & 0xFF) << 32) | (rgb & 0xFF);
+    m_redBlueAccum += redBlue * weight;
+    m_greenAccum += ((rgb >> 8) & 0xFF) * weight;
+  }
+
+  uint32_t mix(const uint32_t totalWeight) const {
+    assert(totalWeight > 0);
+    const uint32_t halfWeight = totalWeight >> 1;
+    const uint32_t r = (uint32_t(m_redBlueAccum >> 32) + halfWeight) / totalWeight;
+    const uint32_t g = (m_greenAccum + halfWeight) / totalWeight;
+    const uint32_t b = (uint32_t(m_redBlueAccum) + halfWeight) / totalWeight;
+    return uint32_t(0xff000000) | (r << 16) | (g << 8) | b;
+  }
+
+ private:
+  uint64_t m_redBlueAccum;
+  uint32_t m_greenAccum;
+};
+
+
+/**
+ * \brief The source image and the parameters shared by all the destination pixels.
+ *
+ * Coordinates with the 32 suffix are in 1/32 of a source pixel.
+ */
+template <typename StorageUnit>
+struct AreaMappingSource {
+  const StorageUnit* data;
+  int stride;
+  int width;
+  int height;
+  int unit32W;
+  int unit32H;
+  StorageUnit outsideColor;
+  int outsideFlags;
+
+  StorageUnit nearestPixel(const int srcLeft, const int srcTop, const int srcRight, const int srcBottom) const {
+    const int srcX = qBound<int>(0, (srcLeft + srcRight) >> 1, width - 1);
+    const int srcY = qBound<int>(0, (srcTop + srcBottom) >> 1, height - 1);
+    return data[srcY * stride + srcX];
+  }
+};
+
+/**
+ * \brief Mixes the source pixels covered by [src32Left, src32Left + unit32W) x [src32Top, src32Top + unit32H).
+ */
+template <typename StorageUnit, typename Mixer>
+inline StorageUnit mapArea(const AreaMappingSource<StorageUnit>& src, int src32Left, int src32Top) {
+  const int sw = src.width;
+  const int sh = src.height;
+  int src32Right = src32Left + src.unit32W;
+  int src32Bottom = src32Top + src.unit32H;
+  int srcLeft = src32Left >> 5;
+  int srcRight = (src32Right - 1) >> 5;  // inclusive
+  int srcTop = src32Top >> 5;
+  int srcBottom = (src32Bottom - 1) >> 5;  // inclusive
+  assert(srcBottom >= srcTop);
+  assert(srcRight >= srcLeft);
+
+  if ((srcBottom < 0) || (srcRight < 0) || (srcLeft >= sw) || (srcTop >= sh)) {
+    // Completely outside of src image.
+    if (src.outsideFlags & OutsidePixels::COLOR) {
+      return src.outsideColor;
+    }
+    return src.nearestPixel(srcLeft, srcTop, srcRight, srcBottom);
+  }
+
+  if ((srcLeft >= 0) && (srcTop >= 0) && (srcRight - srcLeft <= 1) && (srcBottom - srcTop <= 1)
+      && (srcLeft + 1 < sw) && (srcTop + 1 < sh)) {
+    // The common case of rotation and upscaling: a dst pixel maps to at most
+    // 2x2 src pixels, all of them inside the src image.  It's the same as
+    // the generic code below, minus the branches.
+    const StorageUnit* srcLine = &src.data[srcTop * src.stride + srcLeft];
+    if ((srcLeft == srcRight) && (srcTop == srcBottom)) {
+      return srcLine[0];
+    }
+
+    const unsigned leftFraction = (srcLeft == srcRight) ? src.unit32W : 32 - (src32Left & 31);
+    const unsigned rightFraction = src.unit32W - leftFraction;
+    const unsigned topFraction = (srcTop == srcBottom) ? src.unit32H : 32 - (src32Top & 31);
+    const unsigned bottomFraction = src.unit32H - topFraction;
+
+    Mixer mixer;
+    mixer.add(srcLine[0], topFraction * leftFraction);
+    mixer.add(srcLine[1], topFraction * rightFraction);
+    srcLine += src.stride;
+    mixer.add(srcLine[0], bottomFraction * leftFraction);
+    mixer.add(srcLine[1], bottomFraction * rightFraction);
+    return mixer.mix(src.unit32W * src.unit32H);
+  }
+
+  /*
+   * Note that (intval / 32) is not the same as (intval >> 5).
+   * The former rounds towards zero, while the latter rounds towards
+   * negative infinity.
+   * Likewise, (intval % 32) is not the same as (intval & 31).
+   * The following expression:
+   * topFraction = 32 - (src32Top & 31);
+   * works correctly with both positive and negative src32Top.
+   */
+
+  unsigned backgroundArea = 0;
+
+  if (srcTop < 0) {
+    const unsigned topFraction = 32 - (src32Top & 31);
+    const unsigned horFraction = src32Right - src32Left;
+    backgroundArea += topFraction * horFraction;
+    const unsigned fullPixelsVer = -1 - srcTop;
+    backgroundArea += horFraction * (fullPixelsVer << 5);
+    srcTop = 0;
+    src32Top = 0;
+  }
+  if (srcBottom >= sh) {
+    const unsigned bottomFraction = src32Bottom - (srcBottom << 5);
+    const unsigned horFraction = src32Right - src32Left;
+    backgroundArea += bottomFraction * horFraction;
+    const unsigned fullPixelsVer = srcBottom - sh;
+    backgroundArea += horFraction * (fullPixelsVer << 5);
+    srcBottom = sh - 1;     // inclusive
+    src32Bottom = sh << 5;  // exclusive
+  }
+  if (srcLeft < 0) {
+    const unsigned leftFraction = 32 - (src32Left & 31);
+    const unsigned vertFraction = src32Bottom - src32Top;
+    backgroundArea += leftFraction * vertFraction;
+    const unsigned fullPixelsHor = -1 - srcLeft;
+    backgroundArea += vertFraction * (fullPixelsHor << 5);
+    srcLeft = 0;
+    src32Left = 0;
+  }
+  if (srcRight >= sw) {
+    const unsigned rightFraction = src32Right - (srcRight << 5);
+    const unsigned vertFraction = src32Bottom - src32Top;
+    backgroundArea += rightFraction * vertFraction;
+    const unsigned fullPixelsHor = srcRight - sw;
+    backgroundArea += vertFraction * (fullPixelsHor << 5);
+    srcRight = sw - 1;     // inclusive
+    src32Right = sw << 5;  // exclusive
+  }
+  assert(srcBottom >= srcTop);
+  assert(srcRight >= srcLeft);
+
+  Mixer mixer;
+  if (src.outsideFlags & OutsidePixels::WEAK) {
+    backgroundArea = 0;
+  } else {
+    assert(src.outsideFlags & OutsidePixels::COLOR);
+    mixer.add(src.outsideColor, backgroundArea);
+  }
+
+  const unsigned leftFraction = 32 - (src32Left & 31);
+  const unsigned topFraction = 32 - (src32Top & 31);
+  const unsigned rightFraction = src32Right - (srcRight << 5);
+  const unsigned bottomFraction = src32Bottom - (srcBottom << 5);
+
+  assert(leftFraction + rightFraction + (srcRight - srcLeft - 1) * 32
+         == static_cast<unsigned>(src32Right - src32Left));
+  assert(topFraction + bottomFraction + (srcBottom - srcTop - 1) * 32
+         == static_cast<unsigned>(src32Bottom - src32Top));
+
+  const unsigned srcArea = (src32Bottom - src32Top) * (src32Right - src32Left);
+  if (srcArea == 0) {
+    if ((src.outsideFlags & OutsidePixels::COLOR)) {
+      return src.outsideColor;
+    }
+    return src.nearestPixel(srcLeft, srcTop, srcRight, srcBottom);
+  }
+
+  const int srcStride = src.stride;
+  const StorageUnit* srcLine = &src.data[srcTop * srcStride];
+
+  if (srcTop == srcBottom) {
+    if (srcLeft == srcRight) {
+      // dst pixel maps to a single src pixel
+      const StorageUnit c = srcLine[srcLeft];
+      if (backgroundArea == 0) {
+        // common case optimization
+        return c;
+      }
+      mixer.add(c, srcArea);
+    } else {
+      // dst pixel maps to a horizontal line of src pixels
+      const unsigned vertFraction = src32Bottom - src32Top;
+      const unsigned leftArea = vertFraction * leftFraction;
+      const unsigned middleArea = vertFraction << 5;
+      const unsigned rightArea = vertFraction * rightFraction;
+
+      mixer.add(srcLine[srcLeft], leftArea);
+
+      for (int sx = srcLeft + 1; sx < srcRight; ++sx) {
+        mixer.add(srcLine[sx], middleArea);
+      }
+
+      mixer.add(srcLine[srcRight], rightArea);
+    }
+  } else if (srcLeft == srcRight) {
+    // dst pixel maps to a vertical line of src pixels
+    const unsigned horFraction = src32Right - src32Left;
+    const unsigned topArea = horFraction * topFraction;
+    const unsigned middleArea = horFraction << 5;
+    const unsigned bottomArea = horFraction * bottomFraction;
+
+    srcLine += srcLeft;
+    mixer.add(*srcLine, topArea);
+
+    srcLine += srcStride;
+
+    for (int sy = srcTop + 1; sy < srcBottom; ++sy) {
+      mixer.add(*srcLine, middleArea);
+      srcLine += srcStride;
+    }
+
+    mixer.add(*srcLine, bottomArea);
+  } else {
+    // dst pixel maps to a block of src pixels
+    const unsigned topArea = topFraction << 5;
+    const unsigned bottomArea = bottomFraction << 5;
+    const unsigned leftArea = leftFraction << 5;
+    const unsigned rightArea = rightFraction << 5;
+    const unsigned topleftArea = topFraction * leftFraction;
+    const unsigned toprightArea = topFraction * rightFraction;
+    const unsigned bottomleftArea = bottomFraction * leftFraction;
+    const unsigned bottomrightArea = bottomFraction * rightFraction;
+
+    // process the top-left corner
+    mixer.add(srcLine[srcLeft], topleftArea);
+
+    // process the top line (without corners)
+    for (int sx = srcLeft + 1; sx < srcRight; ++sx) {
+      mixer.add(srcLine[sx], topArea);
+    }
+
+    // process the top-right corner
+    mixer.add(srcLine[srcRight], toprightArea);
+
+    srcLine += srcStride;
+    // process middle lines
+    for (int sy = srcTop + 1; sy < srcBottom; ++sy) {
+      mixer.add(srcLine[srcLeft], leftArea);
+
+      for (int sx = srcLeft + 1; sx < srcRight; ++sx) {
+        mixer.add(srcLine[sx], 32 * 32);
+      }
+
+      mixer.add(srcLine[srcRight], rightArea);
+
+      srcLine += srcStride;
+    }
+
+    // process bottom-left corner
+    mixer.add(srcLine[srcLeft], bottomleftArea);
+
+    // process the bottom line (without corners)
+    for (int sx = srcLeft + 1; sx < srcRight; ++sx) {
+      mixer.add(srcLine[sx], bottomArea);
+    }
+
+    // process the bottom-right corner
+    mixer.add(srcLine[srcRight], bottomrightArea);
+  }
+  return mixer.mix(srcArea + backgroundArea);
+}  // mapArea
+
 template <typename StorageUnit, typename Mixer>
 static void transformGeneric(const StorageUnit* const srcData,
                              const int srcStride,
@@ -51,13 +383,9 @@ static void transformGeneric(const StorageUnit* const srcData,
                              const StorageUnit outsideColor,
                              const int outsideFlags,
                              const QSizeF& minMappingArea) {
-  const int sw = srcSize.width();
-  const int sh = srcSize.height();
   const int dw = dstRect.width();
   const int dh = dstRect.height();
 
-  StorageUnit* dstLine = dstData;
-
   QTransform invXform;
   invXform.translate(dstRect.x(), dstRect.y());
   invXform *= xform.inverted();
@@ -67,218 +395,60 @@ static void transformGeneric(const StorageUnit* const srcData,
   // sy32 = dy*invXform.m22() + dx*invXform.m12() + invXform.dy();
 
   const QSizeF src32UnitSize(calcSrcUnitSize(invXform, minMappingArea));
-  const int src32UnitW = std::max<int>(1, qRound(src32UnitSize.width()));
-  const int src32UnitH = std::max<int>(1, qRound(src32UnitSize.height()));
-
-  for (int dy = 0; dy < dh; ++dy, dstLine += dstStride) {
-    const double fDyCenter = dy + 0.5;
-    const double fSx32Base = fDyCenter * invXform.m21() + invXform.dx();
-    const double fSy32Base = fDyCenter * invXform.m22() + invXform.dy();
-
+  AreaMappingSource<StorageUnit> src;
+  src.data = srcData;
+  src.stride = srcStride;
+  src.width = srcSize.width();
+  src.height = srcSize.height();
+  src.unit32W = std::max<int>(1, qRound(src32UnitSize.width()));
+  src.unit32H = std::max<int>(1, qRound(src32UnitSize.height()));
+  src.outsideColor = outsideColor;
+  src.outsideFlags = outsideFlags;
+
+  // Rows are independent of each other.  Source coordinates are calculated
+  // the same way for every pixel, so the way rows are split into bands
+  // doesn't affect the result.
+  const int minBandSize = 16;
+
+  if ((invXform.m12() == 0.0) && (invXform.m21() == 0.0)) {
+    // Pure scaling and translation: a source column depends only on
+    // the destination column, so it's calculated once per column.
+    std::vector<int> src32Lefts(dw);
     for (int dx = 0; dx < dw; ++dx) {
-      const double fDxCenter = dx + 0.5;
-      const double fSx32Center = fSx32Base + fDxCenter * invXform.m11();
-      const double fSy32Center = fSy32Base + fDxCenter * invXform.m12();
-      int src32Left = (int) fSx32Center - (src32UnitW >> 1);
-      int src32Top = (int) fSy32Center - (src32UnitH >> 1);
-      int src32Right = src32Left + src32UnitW;
-      int src32Bottom = src32Top + src32UnitH;
-      int srcLeft = src32Left >> 5;
-      int srcRight = (src32Right - 1) >> 5;  // inclusive
-      int srcTop = src32Top >> 5;
-      int srcBottom = (src32Bottom - 1) >> 5;  // inclusive
-      assert(srcBottom >= srcTop);
-      assert(srcRight >= srcLeft);
-
-      if ((srcBottom < 0) || (srcRight < 0) || (srcLeft >= sw) || (srcTop >= sh)) {
-        // Completely outside of src image.
-        if (outsideFlags & OutsidePixels::COLOR) {
-          dstLine[dx] = outsideColor;
-        } else {
-          const int srcX = qBound<int>(0, (srcLeft + srcRight) >> 1, sw - 1);
-          const int srcY = qBound<int>(0, (srcTop + srcBottom) >> 1, sh - 1);
-          dstLine[dx] = srcData[srcY * srcStride + srcX];
-        }
-        continue;
-      }
-
-      /*
-       * Note that (intval / 32) is not the same as (intval >> 5).
-       * The former rounds towards zero, while the latter rounds towards
-       * negative infinity.
-       * Likewise, (intval % 32) is not the same as (intval & 31).
-       * The following expression:
-       * topFraction = 32 - (src32Top & 31);
-       * works correctly with both positive and negative src32Top.
-       */
-
-      unsigned backgroundArea = 0;
-
-      if (srcTop < 0) {
-        const unsigned topFraction = 32 - (src32Top & 31);
-        const unsigned horFraction = src32Right - src32Left;
-        backgroundArea += topFraction * horFraction;
-        const unsigned fullPixelsVer = -1 - srcTop;
-        backgroundArea += horFraction * (fullPixelsVer << 5);
-        srcTop = 0;
-        src32Top = 0;
-      }
-      if (srcBottom >= sh) {
-        const unsigned bottomFraction = src32Bottom - (srcBottom << 5);
-        const unsigned horFraction = src32Right - src32Left;
-        backgroundArea += bottomFraction * horFraction;
-        const unsigned fullPixelsVer = srcBottom - sh;
-        backgroundArea += horFraction * (fullPixelsVer << 5);
-        srcBottom = sh - 1;     // inclusive
-        src32Bottom = sh << 5;  // exclusive
-      }
-      if (srcLeft < 0) {
-        const unsigned leftFraction = 32 - (src32Left & 31);
-        const unsigned vertFraction = src32Bottom - src32Top;
-        backgroundArea += leftFraction * vertFraction;
-        const unsigned fullPixelsHor = -1 - srcLeft;
-        backgroundArea += vertFraction * (fullPixelsHor << 5);
-        srcLeft = 0;
-        src32Left = 0;
-      }
-      if (srcRight >= sw) {
-        const unsigned rightFraction = src32Right - (srcRight << 5);
-        const unsigned vertFraction = src32Bottom - src32Top;
-        backgroundArea += rightFraction * vertFraction;
-        const unsigned fullPixelsHor = srcRight - sw;
-        backgroundArea += vertFraction * (fullPixelsHor << 5);
-        srcRight = sw - 1;     // inclusive
-        src32Right = sw << 5;  // exclusive
-      }
-      assert(srcBottom >= srcTop);
-      assert(srcRight >= srcLeft);
-
-      Mixer mixer;
-      if (outsideFlags & OutsidePixels::WEAK) {
-        backgroundArea = 0;
-      } else {
-        assert(outsideFlags & OutsidePixels::COLOR);
-        mixer.add(outsideColor, backgroundArea);
-      }
+      const double fSx32Center = invXform.dx() + (dx + 0.5) * invXform.m11();
+      src32Lefts[dx] = (int) fSx32Center - (src.unit32W >> 1);
+    }
 
-      const unsigned leftFraction = 32 - (src32Left & 31);
-      const unsigned topFraction = 32 - (src32Top & 31);
-      const unsigned rightFraction = src32Right - (srcRight << 5);
-      const unsigned bottomFraction = src32Bottom - (srcBottom << 5);
-
-      assert(leftFraction + rightFraction + (srcRight - srcLeft - 1) * 32
-             == static_cast<unsigned>(src32Right - src32Left));
-      assert(topFraction + bottomFraction + (srcBottom - srcTop - 1) * 32
-             == static_cast<unsigned>(src32Bottom - src32Top));
-
-      const unsigned srcArea = (src32Bottom - src32Top) * (src32Right - src32Left);
-      if (srcArea == 0) {
-        if ((outsideFlags & OutsidePixels::COLOR)) {
-          dstLine[dx] = outsideColor;
-        } else {
-          const int srcX = qBound<int>(0, (srcLeft + srcRight) >> 1, sw - 1);
-          const int srcY = qBound<int>(0, (srcTop + srcBottom) >> 1, sh - 1);
-          dstLine[dx] = srcData[srcY * srcStride + srcX];
+    parallelForBands(dh, minBandSize, [&](const int yBegin, const int yEnd) {
+      StorageUnit* dstLine = dstData + yBegin * dstStride;
+      for (int dy = yBegin; dy < yEnd; ++dy, dstLine += dstStride) {
+        const double fSy32Center = invXform.dy() + (dy + 0.5) * invXform.m22();
+        const int src32Top = (int) fSy32Center - (src.unit32H >> 1);
+        for (int dx = 0; dx < dw; ++dx) {
+          dstLine[dx] = mapArea<StorageUnit, Mixer>(src, src32Lefts[dx], src32Top);
         }
-        continue;
       }
+    });
+    return;
+  }
 
-      const StorageUnit* srcLine = &srcData[srcTop * srcStride];
-
-      if (srcTop == srcBottom) {
-        if (srcLeft == srcRight) {
-          // dst pixel maps to a single src pixel
-          const StorageUnit c = srcLine[srcLeft];
-          if (backgroundArea == 0) {
-            // common case optimization
-            dstLine[dx] = c;
-            continue;
-          }
-          mixer.add(c, srcArea);
-        } else {
-          // dst pixel maps to a horizontal line of src pixels
-          const unsigned vertFraction = src32Bottom - src32Top;
-          const unsigned leftArea = vertFraction * leftFraction;
-          const unsigned middleArea = vertFraction << 5;
-          const unsigned rightArea = vertFraction * rightFraction;
-
-          mixer.add(srcLine[srcLeft], leftArea);
-
-          for (int sx = srcLeft + 1; sx < srcRight; ++sx) {
-            mixer.add(srcLine[sx], middleArea);
-          }
-
-          mixer.add(srcLine[srcRight], rightArea);
-        }
-      } else if (srcLeft == srcRight) {
-        // dst pixel maps to a vertical line of src pixels
-        const unsigned horFraction = src32Right - src32Left;
-        const unsigned topArea = horFraction * topFraction;
-        const unsigned middleArea = horFraction << 5;
-        const unsigned bottomArea = horFraction * bottomFraction;
-
-        srcLine += srcLeft;
-        mixer.add(*srcLine, topArea);
-
-        srcLine += srcStride;
-
-        for (int sy = srcTop + 1; sy < srcBottom; ++sy) {
-          mixer.add(*srcLine, middleArea);
-          srcLine += srcStride;
-        }
-
-        mixer.add(*srcLine, bottomArea);
-      } else {
-        // dst pixel maps to a block of src pixels
-        const unsigned topArea = topFraction << 5;
-        const unsigned bottomArea = bottomFraction << 5;
-        const unsigned leftArea = leftFraction << 5;
-        const unsigned rightArea = rightFraction << 5;
-        const unsigned topleftArea = topFraction * leftFraction;
-        const unsigned toprightArea = topFraction * rightFraction;
-        const unsigned bottomleftArea = bottomFraction * leftFraction;
-        const unsigned bottomrightArea = bottomFraction * rightFraction;
-
-        // process the top-left corner
-        mixer.add(srcLine[srcLeft], topleftArea);
-
-        // process the top line (without corners)
-        for (int sx = srcLeft + 1; sx < srcRight; ++sx) {
-          mixer.add(srcLine[sx], topArea);
-        }
-
-        // process the top-right corner
-        mixer.add(srcLine[srcRight], toprightArea);
-
-        srcLine += srcStride;
-        // process middle lines
-        for (int sy = srcTop + 1; sy < srcBottom; ++sy) {
-          mixer.add(srcLine[srcLeft], leftArea);
-
-          for (int sx = srcLeft + 1; sx < srcRight; ++sx) {
-            mixer.add(srcLine[sx], 32 * 32);
-          }
-
-          mixer.add(srcLine[srcRight], rightArea);
-
-          srcLine += srcStride;
-        }
-
-        // process bottom-left corner
-        mixer.add(srcLine[srcLeft], bottomleftArea);
-
-        // process the bottom line (without corners)
-        for (int sx = srcLeft + 1; sx < srcRight; ++sx) {
-          mixer.add(srcLine[sx], bottomArea);
-        }
-
-        // process the bottom-right corner
-        mixer.add(srcLine[srcRight], bottomrightArea);
+  parallelForBands(dh, minBandSize, [&](const int yBegin, const int yEnd) {
+    StorageUnit* dstLine = dstData + yBegin * dstStride;
+    for (int dy = yBegin; dy < yEnd; ++dy, dstLine += dstStride) {
+      const double fDyCenter = dy + 0.5;
+      const double fSx32Base = fDyCenter * invXform.m21() + invXform.dx();
+      const double fSy32Base = fDyCenter * invXform.m22() + invXform.dy();
+
+      for (int dx = 0; dx < dw; ++dx) {
+        const double fDxCenter = dx + 0.5;
+        const double fSx32Center = fSx32Base + fDxCenter * invXform.m11();
+        const double fSy32Center = fSy32Base + fDxCenter * invXform.m12();
+        const int src32Left = (int) fSx32Center - (src.unit32W >> 1);
+        const int src32Top = (int) fSy32Center - (src.unit32H >> 1);
+        dstLine[dx] = mapArea<StorageUnit, Mixer>(src, src32Left, src32Top);
       }
-
-      dstLine[dx] = mixer.mix(srcArea + backgroundArea);
     }
-  }
+  });
 }  // transformGeneric
 
 template <typename ImageT>
@@ -334,8 +504,7 @@ QImage transform(const QImage& src,
         QImage dst(dstRect.size(), QImage::Format_RGB32);
         badAllocIfNull(dst);
 
-        using AccumType = uint32_t;
-        transformGeneric<uint32_t, RgbColorMixer<AccumType>>(
+        transformGeneric<uint32_t, PackedRgbColorMixer>(
             (const uint32_t*) srcRgb32.bits(), srcRgb32.bytesPerLine() / 4, srcRgb32.size(), (uint32_t*) dst.bits(),
             dst.bytesPerLine() / 4, xform, dstRect, outsidePixels.rgb(), outsidePixels.flags(), minMappingArea);
 
@@ -347,8 +516,7 @@ QImage transform(const QImage& src,
         QImage dst(dstRect.size(), QImage::Format_ARGB32);
         badAllocIfNull(dst);
 
-        using AccumType = float;
-        transformGeneric<uint32_t, ArgbColorMixer<AccumType>>(
+        transformGeneric<uint32_t, ArgbTransformMixer>(
             (const uint32_t*) srcArgb32.bits(), srcArgb32.bytesPerLine() / 4, srcArgb32.size(), (uint32_t*) dst.bits(),
             dst.bytesPerLine() / 4, xform, dstRect, outsidePixels.rgba(), outsidePixels.flags(), minMappingArea);
 
@@ -28,6 +28,7 @@
 
 #include "GrayImage.h"
 #include "IntegralImage.h"
+#include "ParallelFor.h"
 
 namespace imageproc {
 
@@ -74,37 +75,42 @@ void wienerFilterInPlace(GrayImage& image, QSize const& window_size, double cons
   int const window_left_half = window_size.width() >> 1;
   int const window_right_half = window_size.width() - window_left_half;
 
-  image_line = image.data();
-  for (int y = 0; y < h; ++y) {
-    int const top = ((y - window_lower_half) < 0) ? 0 : (y - window_lower_half);
-    int const bottom = ((y + window_upper_half) < h) ? (y + window_upper_half) : h;  // exclusive
+  // The windows of different bands overlap, but they are only read from
+  // the integral images, so each band only writes its own lines.
+  uint8_t* const image_data = image.data();
+  parallelForBands(h, 16, [&](int const y_begin, int const y_end) {
+    uint8_t* line = image_data + y_begin * image_stride;
+    for (int y = y_begin; y < y_end; ++y) {
+      int const top = ((y - window_lower_half) < 0) ? 0 : (y - window_lower_half);
+      int const bottom = ((y + window_upper_half) < h) ? (y + window_upper_half) : h;  // exclusive
 
-    for (int x = 0; x < w; ++x) {
-      int const left = ((x - window_left_half) < 0) ? 0 : (x - window_left_half);
-      int const right = ((x + window_right_half) < w) ? (x + window_right_half) : w;  // exclusive
-      int const area = (bottom - top) * (right - left);
-      assert(area > 0);  // because window_size > 0 and w > 0 and h > 0
-
-      QRect const rect(left, top, right - left, bottom - top);
-      double const window_sum = integral_image.sum(rect);
-      double const window_sqsum = integral_sqimage.sum(rect);
-
-      double const r_area = 1.0 / area;
-      double const mean = window_sum * r_area;
-      double const sqmean = window_sqsum * r_area;
-      double const variance = sqmean - mean * mean;
-
-      if (variance > 1e-6) {
-        double const src_pixel = (double) image_line[x];
-        double const dst_pixel = mean
-                                 + (src_pixel - mean)
-                                       * (((variance - noise_variance) < 0.0) ? 0.0 : (variance - noise_variance))
-                                       / variance;
-        image_line[x] = (uint8_t) ((dst_pixel < 0.0) ? 0.0 : ((dst_pixel < 255.0) ? dst_pixel : 255.0));
+      for (int x = 0; x < w; ++x) {
+        int const left = ((x - window_left_half) < 0) ? 0 : (x - window_left_half);
+        int const right = ((x + window_right_half) < w) ? (x + window_right_half) : w;  // exclusive
+        int const area = (bottom - top) * (right - left);
+        assert(area > 0);  // because window_size > 0 and w > 0 and h > 0
+
+        QRect const rect(left, top, right - left, bottom - top);
+        double const window_sum = integral_image.sum(rect);
+        double const window_sqsum = integral_sqimage.sum(rect);
+
+        double const r_area = 1.0 / area;
+        double const mean = window_sum * r_area;
+        double const sqmean = window_sqsum * r_area;
+        double const variance = sqmean - mean * mean;
+
+        if (variance > 1e-6) {
+          double const src_pixel = (double) line[x];
+          double const dst_pixel = mean
+                                   + (src_pixel - mean)
+                                         * (((variance - noise_variance) < 0.0) ? 0.0 : (variance - noise_variance))
+                                         / variance;
+          line[x] = (uint8_t) ((dst_pixel < 0.0) ? 0.0 : ((dst_pixel < 255.0) ? dst_pixel : 255.0));
+        }
       }
+      line += image_stride;
     }
-    image_line += image_stride;
-  }
+  });
 }
 
 QImage wienerColorFilter(QImage const& image, QSize const& window_size, double const coef) {
@@ -124,36 +130,41 @@ void wienerColorFilterInPlace(QImage& image, QSize const& window_size, double co
   if (coef > 0.0) {
     int const w = image.width();
     int const h = image.height();
-    uint8_t* image_line = (uint8_t*) image.bits();
+    uint8_t* const image_data = (uint8_t*) image.bits();
     int const image_bpl = image.bytesPerLine();
     unsigned int const cnum = image_bpl / w;
 
     GrayImage gray = GrayImage(image);
-    uint8_t* gray_line = gray.data();
+    uint8_t const* const gray_data = gray.data();
     int const gray_bpl = gray.stride();
     GrayImage wiener(wienerFilter(gray, window_size, 255.0 * coef));
-    uint8_t* wiener_line = wiener.data();
+    uint8_t const* const wiener_data = wiener.data();
     int const wiener_bpl = wiener.stride();
 
-    for (int y = 0; y < h; ++y) {
-      for (int x = 0; x < w; ++x) {
-        float const origin = gray_line[x];
-        float color = wiener_line[x];
-
-        float const colscale = (color + 1.0f) / (origin + 1.0f);
-        float const coldelta = color - origin * colscale;
-        for (unsigned int c = 0; c < cnum; ++c) {
-          int const indx = x * cnum + c;
-          float origcol = image_line[indx];
-          float val = origcol * colscale + coldelta;
-          val = (val < 0.0f) ? 0.0f : (val < 255.0f) ? val : 255.0f;
-          image_line[indx] = (uint8_t) (val + 0.5f);
+    parallelForBands(h, 16, [&](int const y_begin, int const y_end) {
+      uint8_t* image_line = image_data + y_begin * image_bpl;
+      uint8_t const* gray_line = gray_data + y_begin * gray_bpl;
+      uint8_t const* wiener_line = wiener_data + y_begin * wiener_bpl;
+      for (int y = y_begin; y < y_end; ++y) {
+        for (int x = 0; x < w; ++x) {
+          float const origin = gray_line[x];
+          float color = wiener_line[x];
+
+          float const colscale = (color + 1.0f) / (origin + 1.0f);
+          float const coldelta = color - origin * colscale;
+          for (unsigned int c = 0; c < cnum; ++c) {
+            int const indx = x * cnum + c;
+            float origcol = image_line[indx];
+            float val = origcol * colscale + coldelta;
+            val = (val < 0.0f) ? 0.0f : (val < 255.0f) ? val : 255.0f;
+            image_line[indx] = (uint8_t) (val + 0.5f);
+          }
         }
+        image_line += image_bpl;
+        gray_line += gray_bpl;
+        wiener_line += wiener_bpl;
       }
-      image_line += image_bpl;
-      gray_line += gray_bpl;
-      wiener_line += wiener_bpl;
-    }
+    });
   }
 }
 
@@ -3,6 +3,8 @@
 
 #include <Binarize.h>
 #include <BinaryImage.h>
+#include <LocalWindowStats.h>
+#include <ParallelFor.h>
 
 #include <QImage>
 #include <QSize>
@@ -15,6 +17,55 @@ namespace tests {
 using namespace utils;
 
 BOOST_AUTO_TEST_SUITE(BinarizeTestSuite)
+
+namespace {
+template <typename Binarizer>
+void checkParallelMatchesSerial(const Binarizer& binarize) {
+  const QImage img(randomGrayImage(203, 317));
+
+  setParallelForEnabled(false);
+  const BinaryImage serial(binarize(img));
+  setParallelForEnabled(true);
+  const BinaryImage parallel(binarize(img));
+
+  BOOST_CHECK(serial == parallel);
+}
+
+template <typename Binarizer>
+void checkSimdMatchesScalar(const Binarizer& binarize) {
+  const QImage img(randomGrayImage(203, 317));
+
+  setLocalWindowStatsSimdEnabled(false);
+  const BinaryImage scalar(binarize(img));
+  setLocalWindowStatsSimdEnabled(true);
+  const BinaryImage simd(binarize(img));
+
+  BOOST_CHECK(scalar == simd);
+}
+}  // namespace
+
+BOOST_AUTO_TEST_CASE(test_parallel_matches_serial) {
+  const QSize window(31, 31);
+  checkParallelMatchesSerial([&](const QImage& img) { return binarizeSauvola(img, window); });
+  checkParallelMatchesSerial([&](const QImage& img) { return binarizeWolf(img, window); });
+  checkParallelMatchesSerial([&](const QImage& img) { return binarizeFox(img, window); });
+  checkParallelMatchesSerial([&](const QImage& img) { return binarizeWindow(img, window); });
+  checkParallelMatchesSerial([&](const QImage& img) { return binarizeBradley(img, window); });
+  checkParallelMatchesSerial([&](const QImage& img) { return binarizeGrad(img, window); });
+  checkParallelMatchesSerial([&](const QImage& img) { return binarizeEdgeDiv(img, window, 0.5, 0.5); });
+}
+
+BOOST_AUTO_TEST_CASE(test_simd_matches_scalar) {
+  const QSize window(31, 17);
+  checkSimdMatchesScalar([&](const QImage& img) { return binarizeSauvola(img, window); });
+  checkSimdMatchesScalar([&](const QImage& img) { return binarizeWolf(img, window); });
+  checkSimdMatchesScalar([&](const QImage& img) { return binarizeFox(img, window); });
+  checkSimdMatchesScalar([&](const QImage& img) { return binarizeWindow(img, window); });
+  checkSimdMatchesScalar([&](const QImage& img) { return binarizeBradley(img, window); });
+  checkSimdMatchesScalar([&](const QImage& img) { return binarizeGrad(img, window); });
+  checkSimdMatchesScalar([&](const QImage& img) { return binarizeEdgeDiv(img, window, 0.5, 0.5); });
+}
+
 #if 0
             BOOST_AUTO_TEST_CASE(test) {
                 QImage img("test.png");
@@ -0,0 +1,147 @@
+// Copyright (C) 2019  Joseph Artsimovich <joseph.artsimovich@gmail.com>, 4lex4 <4lex49@zoho.com>
+// Use of this source code is governed by the GNU GPLv3 license that can be found in the LICENSE file.
+
+#include <BinaryImage.h>
+#include <ConnectivityMap.h>
+
+#include <boost/test/unit_test.hpp>
+#include <cstdlib>
+#include <vector>
+
+#include "Utils.h"
+
+namespace imageproc {
+namespace tests {
+using namespace utils;
+
+namespace {
+BinaryImage randomImage(const int width, const int height, const int blackPercent) {
+  BinaryImage img(width, height, WHITE);
+  for (int y = 0; y < height; ++y) {
+    for (int x = 0; x < width; ++x) {
+      if (rand() % 100 < blackPercent) {
+        img.setPixel(x, y, BLACK);
+      }
+    }
+  }
+  return img;
+}
+
+/**
+ * Labels the image with the pixel-based algorithm, which the constructor taking
+ * arbitrary pixel data uses.
+ */
+ConnectivityMap pixelLabelled(const BinaryImage& img, const Connectivity conn) {
+  std::vector<uint8_t> pixels(img.width() * img.height());
+  for (int y = 0; y < img.height(); ++y) {
+    for (int x = 0; x < img.width(); ++x) {
+      pixels[y * img.width() + x] = (img.getPixel(x, y) == BLACK) ? 1 : 0;
+    }
+  }
+  return ConnectivityMap(img.size(), pixels.data(), img.width(), conn);
+}
+
+bool sameMaps(const ConnectivityMap& map1, const ConnectivityMap& map2) {
+  if ((map1.size() != map2.size()) || (map1.maxLabel() != map2.maxLabel())) {
+    return false;
+  }
+  const int paddedWidth = map1.size().width() + 2;
+  const int paddedHeight = map1.size().height() + 2;
+  for (int y = 0; y < paddedHeight; ++y) {
+    for (int x = 0; x < paddedWidth; ++x) {
+      if (map1.paddedData()[y * map1.stride() + x] != map2.paddedData()[y * map2.stride() + x]) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+}  // namespace
+
+BOOST_AUTO_TEST_SUITE(ConnectivityMapTestSuite)
+
+BOOST_AUTO_TEST_CASE(test_small_image) {
+  static const int inp[] = {1, 1, 0, 0, 1,  //
+                            0, 1, 0, 1, 0,  //
+                            0, 0, 1, 0, 0,  //
+                            1, 0, 0, 0, 1};
+
+  static const uint32_t labels4[] = {1, 1, 0, 0, 2,  //
+                                     0, 1, 0, 3, 0,  //
+                                     0, 0, 4, 0, 0,  //
+                                     5, 0, 0, 0, 6};
+
+  static const uint32_t labels8[] = {1, 1, 0, 0, 1,  //
+                                     0, 1, 0, 1, 0,  //
+                                     0, 0, 1, 0, 0,  //
+                                     2, 0, 0, 0, 3};
+
+  const BinaryImage img(makeBinaryImage(inp, 5, 4));
+  const ConnectivityMap map4(img, CONN4);
+  const ConnectivityMap map8(img, CONN8);
+  BOOST_REQUIRE_EQUAL(map4.maxLabel(), 6u);
+  BOOST_REQUIRE_EQUAL(map8.maxLabel(), 3u);
+  for (int y = 0; y < 4; ++y) {
+    for (int x = 0; x < 5; ++x) {
+      BOOST_CHECK_EQUAL(map4.data()[y * map4.stride() + x], labels4[y * 5 + x]);
+      BOOST_CHECK_EQUAL(map8.data()[y * map8.stride() + x], labels8[y * 5 + x]);
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE(test_same_as_pixel_labelling) {
+  srand(1);
+  for (int i = 0; i < 100; ++i) {
+    const BinaryImage img(randomImage(1 + rand() % 130, 1 + rand() % 90, rand() % 100));
+    BOOST_CHECK(sameMaps(ConnectivityMap(img, CONN4), pixelLabelled(img, CONN4)));
+    BOOST_CHECK(sameMaps(ConnectivityMap(img, CONN8), pixelLabelled(img, CONN8)));
+  }
+}
+
+BOOST_AUTO_TEST_CASE(test_same_as_pixel_labelling_on_many_bands) {
+  // Tall enough to be split into many bands, with components crossing them.
+  srand(2);
+  const BinaryImage img(randomImage(300, 2000, 45));
+  BOOST_CHECK(sameMaps(ConnectivityMap(img, CONN4), pixelLabelled(img, CONN4)));
+  BOOST_CHECK(sameMaps(ConnectivityMap(img, CONN8), pixelLabelled(img, CONN8)));
+}
+
+BOOST_AUTO_TEST_CASE(test_class_plane_same_as_added_components) {
+  srand(3);
+  for (int i = 0; i < 100; ++i) {
+    const int width = 1 + rand() % 130;
+    const int height = 1 + rand() % ((i % 10 == 0) ? 600 : 90);
+    const int numClasses = 1 + rand() % 8;
+    std::vector<uint8_t> classes(width * height);
+    for (size_t j = 0; j < classes.size(); ++j) {
+      // Runs of a class, so components of different classes touch.
+      classes[j] = ((j > 0) && (rand() % 2)) ? classes[j - 1] : static_cast<uint8_t>(rand() % numClasses);
+    }
+    std::vector<uint8_t> classOrder;
+    for (int cls = numClasses - 1; cls >= 0; --cls) {
+      if (rand() % 3) {
+        classOrder.push_back(static_cast<uint8_t>(cls));
+      }
+    }
+
+    for (const Connectivity conn : {CONN4, CONN8}) {
+      ConnectivityMap expected(QSize(width, height));
+      for (const uint8_t cls : classOrder) {
+        BinaryImage layer(width, height, WHITE);
+        for (int y = 0; y < height; ++y) {
+          for (int x = 0; x < width; ++x) {
+            if (classes[y * width + x] == cls) {
+              layer.setPixel(x, y, BLACK);
+            }
+          }
+        }
+        expected.addComponents(layer, conn);
+      }
+      BOOST_CHECK(sameMaps(ConnectivityMap(QSize(width, height), classes.data(), width, classOrder, conn), expected));
+    }
+  }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+}  // namespace tests
+}  // namespace imageproc
@@ -0,0 +1,82 @@
+// Copyright (C) 2019  Joseph Artsimovich <joseph.artsimovich@gmail.com>, 4lex4 <4lex49@zoho.com>
+// Use of this source code is governed by the GNU GPLv3 license that can be found in the LICENSE file.
+
+#include <IntegralImage.h>
+#include <LocalWindowStats.h>
+
+#include <QImage>
+#include <QRect>
+#include <boost/test/unit_test.hpp>
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "Utils.h"
+
+namespace imageproc {
+namespace tests {
+using namespace utils;
+
+BOOST_AUTO_TEST_SUITE(LocalWindowStatsTestSuite)
+
+namespace {
+void checkMatchesPerPixelComputation(const int width, const int height, const QSize& windowSize) {
+  const QImage img(randomGrayImage(width, height));
+
+  IntegralImage<uint32_t> integral(width, height);
+  IntegralImage<uint64_t> sqIntegral(width, height);
+  for (int y = 0; y < height; ++y) {
+    const uint8_t* line = img.scanLine(y);
+    integral.beginRow();
+    sqIntegral.beginRow();
+    for (int x = 0; x < width; ++x) {
+      integral.push(line[x]);
+      sqIntegral.push(uint64_t(line[x]) * line[x]);
+    }
+  }
+
+  const LocalWindowStats stats(integral, &sqIntegral, QSize(width, height), windowSize);
+  const int windowLowerHalf = windowSize.height() >> 1;
+  const int windowLeftHalf = windowSize.width() >> 1;
+
+  std::vector<double> means(width);
+  std::vector<double> deviations(width);
+  std::vector<double> meansOnly(width);
+  bool allMatch = true;
+  for (int y = 0; y < height; ++y) {
+    stats.computeLine(y, means.data(), deviations.data());
+    stats.computeLine(y, meansOnly.data());
+    const int top = std::max(0, y - windowLowerHalf);
+    const int bottom = std::min(height, y + windowSize.height() - windowLowerHalf);
+    for (int x = 0; x < width; ++x) {
+      const int left = std::max(0, x - windowLeftHalf);
+      const int right = std::min(width, x + windowSize.width() - windowLeftHalf);
+      const QRect rect(left, top, right - left, bottom - top);
+      const double rArea = 1.0 / (rect.width() * rect.height());
+      const double mean = integral.sum(rect) * rArea;
+      const double sqmean = sqIntegral.sum(rect) * rArea;
+      const double deviation = std::sqrt(std::fabs(sqmean - mean * mean));
+      // The deviations may differ in the last bits, if the compiler fuses the operations above.
+      allMatch = allMatch && (means[x] == mean) && (meansOnly[x] == mean)
+                 && (std::fabs(deviations[x] - deviation) < 1e-5);
+    }
+  }
+  BOOST_CHECK(allMatch);
+}
+}  // namespace
+
+BOOST_AUTO_TEST_CASE(test_matches_per_pixel_computation) {
+  for (const bool simd : {false, true}) {
+    setLocalWindowStatsSimdEnabled(simd);
+    checkMatchesPerPixelComputation(103, 37, QSize(15, 9));
+    checkMatchesPerPixelComputation(64, 64, QSize(1, 1));
+    checkMatchesPerPixelComputation(40, 20, QSize(8, 6));
+    // Windows larger than the image.
+    checkMatchesPerPixelComputation(7, 5, QSize(31, 31));
+  }
+  setLocalWindowStatsSimdEnabled(true);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+}  // namespace tests
+}  // namespace imageproc
@@ -5,11 +5,15 @@
 #include <BinaryImage.h>
 #include <GrayImage.h>
 #include <Morphology.h>
+#include <ParallelFor.h>
 
 #include <QImage>
 #include <QPoint>
+#include <QRect>
 #include <QSize>
+#include <algorithm>
 #include <boost/test/unit_test.hpp>
+#include <cstdlib>
 
 #include "Utils.h"
 
@@ -17,6 +21,71 @@ namespace imageproc {
 namespace tests {
 using namespace utils;
 
+namespace {
+BinaryImage sparseRandomImage(const int width, const int height, const int blackPercent) {
+  BinaryImage img(width, height, WHITE);
+  for (int y = 0; y < height; ++y) {
+    for (int x = 0; x < width; ++x) {
+      if (rand() % 100 < blackPercent) {
+        img.setPixel(x, y, BLACK);
+      }
+    }
+  }
+  return img;
+}
+
+class BackendSelection {
+ public:
+  explicit BackendSelection(MorphologyBackend backend) : m_previous(morphologyBackend()) {
+    setMorphologyBackend(backend);
+  }
+
+  ~BackendSelection() { setMorphologyBackend(m_previous); }
+
+ private:
+  MorphologyBackend m_previous;
+};
+
+
+template <typename Operation>
+bool backendsAgree(Operation operation) {
+  BinaryImage rasterOpResult;
+  {
+    BackendSelection selection(MorphologyBackend::RASTER_OP);
+    rasterOpResult = operation();
+  }
+  BackendSelection selection(MorphologyBackend::WORD_PARALLEL);
+  return operation() == rasterOpResult;
+}
+
+/**
+ * Each pixel of the result is the darkest (if \p dilate) or the lightest pixel
+ * of src(p - b) for b in \p brick, with pixels outside of \p src being \p surroundings.
+ */
+GrayImage naiveDilateOrErodeGray(const GrayImage& src,
+                                 const Brick& brick,
+                                 const QRect& dstArea,
+                                 const uint8_t surroundings,
+                                 const bool dilate) {
+  GrayImage dst(dstArea.size());
+  for (int y = 0; y < dstArea.height(); ++y) {
+    for (int x = 0; x < dstArea.width(); ++x) {
+      uint8_t extremum = dilate ? 0xff : 0x00;
+      for (int by = brick.minY(); by <= brick.maxY(); ++by) {
+        for (int bx = brick.minX(); bx <= brick.maxX(); ++bx) {
+          const QPoint srcPos(dstArea.left() + x - bx, dstArea.top() + y - by);
+          const uint8_t pixel
+              = src.rect().contains(srcPos) ? src.data()[srcPos.y() * src.stride() + srcPos.x()] : surroundings;
+          extremum = dilate ? std::min(extremum, pixel) : std::max(extremum, pixel);
+        }
+      }
+      dst.data()[y * dst.stride() + x] = extremum;
+    }
+  }
+  return dst;
+}
+}  // namespace
+
 BOOST_AUTO_TEST_SUITE(MorphologyTestSuite)
 
 BOOST_AUTO_TEST_CASE(test_dilate_1x1) {
@@ -672,6 +741,71 @@ BOOST_AUTO_TEST_CASE(test_hmr_1) {
   BOOST_CHECK(hitMissReplace(img, BLACK, pattern, 3, 3) == control);
 }
 
+BOOST_AUTO_TEST_CASE(test_backends_agree) {
+  srand(1);
+  for (int i = 0; i < 200; ++i) {
+    const BinaryImage img(sparseRandomImage(1 + rand() % 150, 1 + rand() % 100, rand() % 15));
+    const QSize size(1 + rand() % ((i % 4 == 0) ? 80 : 12), 1 + rand() % ((i % 5 == 0) ? 80 : 12));
+    const Brick brick(size, QPoint(rand() % (size.width() + 4) - 2, rand() % (size.height() + 4) - 2));
+    const QRect dstArea(rand() % 40 - 20, rand() % 40 - 20, 1 + rand() % 170, 1 + rand() % 120);
+    const BWColor surroundings = (rand() & 1) ? BLACK : WHITE;
+
+    BOOST_CHECK(backendsAgree([&]() { return dilateBrick(img, brick, dstArea, surroundings); }));
+    BOOST_CHECK(backendsAgree([&]() { return erodeBrick(img, brick, dstArea, surroundings); }));
+    BOOST_CHECK(backendsAgree([&]() { return openBrick(img, size, dstArea, surroundings); }));
+    BOOST_CHECK(backendsAgree([&]() { return closeBrick(img, size, dstArea, surroundings); }));
+  }
+}
+
+BOOST_AUTO_TEST_CASE(test_backends_agree_on_content_box_bricks) {
+  srand(2);
+  const BinaryImage img(sparseRandomImage(700, 900, 3));
+  for (const QSize& size : {QSize(200, 14), QSize(14, 300), QSize(200, 1), QSize(1, 200), QSize(50, 10)}) {
+    for (const BWColor surroundings : {WHITE, BLACK}) {
+      BOOST_CHECK(backendsAgree([&]() { return openBrick(img, size, surroundings); }));
+      BOOST_CHECK(backendsAgree([&]() { return closeBrick(img, size, surroundings); }));
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE(test_gray_random_vs_naive) {
+  srand(5);
+  const GrayImage img(randomGrayImage(83, 57));
+  const Brick bricks[] = {Brick(QSize(3, 3)), Brick(QSize(7, 4)), Brick(QSize(1, 9)), Brick(QSize(12, 1)),
+                          Brick(QSize(35, 35)), Brick(QSize(5, 3), QPoint(-2, 4))};
+  const QRect dstAreas[] = {img.rect(), img.rect().adjusted(5, -3, -7, 9), QRect(-20, 10, 150, 30)};
+
+  for (const bool simd : {false, true}) {
+    setGrayMorphologySimdEnabled(simd);
+    for (const bool parallel : {false, true}) {
+      setParallelForEnabled(parallel);
+      for (const Brick& brick : bricks) {
+        for (const QRect& dstArea : dstAreas) {
+          BOOST_CHECK(dilateGray(img, brick, dstArea, 7) == naiveDilateOrErodeGray(img, brick, dstArea, 7, true));
+          BOOST_CHECK(erodeGray(img, brick, dstArea, 2) == naiveDilateOrErodeGray(img, brick, dstArea, 2, false));
+        }
+      }
+    }
+  }
+  setParallelForEnabled(true);
+}
+
+BOOST_AUTO_TEST_CASE(test_gray_simd_matches_scalar) {
+  srand(6);
+  // Large enough for several 16x16 transposition tiles and for whole stripes of the vertical pass.
+  const GrayImage img(randomGrayImage(613, 347));
+  const Brick bricks[] = {Brick(QSize(35, 35)), Brick(QSize(2, 17)), Brick(QSize(40, 3), QPoint(7, -5))};
+  for (const Brick& brick : bricks) {
+    const QRect dstArea(img.rect().adjusted(-9, 4, 13, -21));
+    setGrayMorphologySimdEnabled(false);
+    const GrayImage dilatedScalar(dilateGray(img, brick, dstArea, 7));
+    const GrayImage erodedScalar(erodeGray(img, brick, dstArea, 2));
+    setGrayMorphologySimdEnabled(true);
+    BOOST_CHECK(dilateGray(img, brick, dstArea, 7) == dilatedScalar);
+    BOOST_CHECK(erodeGray(img, brick, dstArea, 2) == erodedScalar);
+  }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 }  // namespace tests
 }  // namespace imageproc
\ No newline at end of file
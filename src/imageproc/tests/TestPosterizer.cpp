@@ -0,0 +1,125 @@
+// Copyright (C) 2019  Joseph Artsimovich <joseph.artsimovich@gmail.com>, 4lex4 <4lex49@zoho.com>
+// Use of this source code is governed by the GNU GPLv3 license that can be found in the LICENSE file.
+
+#include <Posterizer.h>
+
+#include <QImage>
+#include <boost/test/unit_test.hpp>
+#include <cstdlib>
+#include <set>
+#include <vector>
+
+namespace imageproc {
+namespace tests {
+namespace {
+/**
+ * An image made of the given colors, with runs of the same color in it.
+ */
+QImage randomColorImage(const int width, const int height, const std::vector<QRgb>& colors, QImage::Format format) {
+  QImage image(width, height, format);
+  for (int y = 0; y < height; ++y) {
+    QRgb color = colors[rand() % colors.size()];
+    for (int x = 0; x < width; ++x) {
+      if (rand() % 3 != 0) {
+        color = colors[rand() % colors.size()];
+      }
+      image.setPixel(x, y, color);
+    }
+  }
+  return image;
+}
+
+std::vector<QRgb> randomColors(const int numColors, const bool translucent) {
+  std::vector<QRgb> colors;
+  for (int i = 0; i < numColors; ++i) {
+    const int alpha = (translucent && (rand() % 4 == 0)) ? rand() % 256 : 255;
+    colors.push_back(qRgba(rand() % 256, rand() % 256, rand() % 256, alpha));
+  }
+  return colors;
+}
+
+std::set<QRgb> imageColors(const QImage& image) {
+  std::set<QRgb> colors;
+  for (int y = 0; y < image.height(); ++y) {
+    for (int x = 0; x < image.width(); ++x) {
+      colors.insert(image.pixel(x, y));
+    }
+  }
+  return colors;
+}
+}  // namespace
+
+BOOST_AUTO_TEST_SUITE(PosterizerTestSuite)
+
+BOOST_AUTO_TEST_CASE(test_palette_has_every_color_once) {
+  srand(1);
+  for (const QImage::Format format : {QImage::Format_RGB32, QImage::Format_ARGB32}) {
+    const QImage image(randomColorImage(97, 300, randomColors(400, format == QImage::Format_ARGB32), format));
+    const QVector<QRgb> palette(Posterizer::buildPalette(image));
+    const std::set<QRgb> paletteColors(palette.begin(), palette.end());
+    BOOST_CHECK_EQUAL(paletteColors.size(), size_t(palette.size()));
+    BOOST_CHECK(paletteColors == imageColors(image));
+  }
+}
+
+BOOST_AUTO_TEST_CASE(test_convert_to_indexed_keeps_colors) {
+  srand(2);
+  const QImage image(randomColorImage(70, 130, randomColors(256, true), QImage::Format_ARGB32));
+  const QImage indexed(Posterizer::convertToIndexed(image));
+  BOOST_REQUIRE_EQUAL(indexed.format(), QImage::Format_Indexed8);
+  for (int y = 0; y < image.height(); ++y) {
+    for (int x = 0; x < image.width(); ++x) {
+      BOOST_REQUIRE_EQUAL(indexed.pixel(x, y), image.pixel(x, y));
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE(test_group_takes_most_frequent_color) {
+  // With 4 levels, the dark grays fall into one group and white into another.
+  QImage image(30, 10, QImage::Format_RGB32);
+  for (int y = 0; y < image.height(); ++y) {
+    for (int x = 0; x < image.width(); ++x) {
+      QRgb color = 0xffffffffu;
+      if (x < 10) {
+        color = qRgb(10, 10, 10);
+      } else if (x < 15) {
+        color = qRgb(20, 20, 20);
+      }
+      image.setPixel(x, y, color);
+    }
+  }
+
+  const QImage posterized(Posterizer(4).posterize(image));
+  BOOST_REQUIRE_EQUAL(posterized.format(), QImage::Format_Indexed8);
+  BOOST_CHECK_EQUAL(posterized.colorCount(), 2);
+  for (int y = 0; y < image.height(); ++y) {
+    for (int x = 0; x < image.width(); ++x) {
+      BOOST_CHECK_EQUAL(posterized.pixel(x, y), (x < 15) ? qRgb(10, 10, 10) : 0xffffffffu);
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE(test_indexed_image_keeps_colors_when_groups_are_single) {
+  srand(3);
+  QImage image(40, 40, QImage::Format_Indexed8);
+  // The same color twice in the table, and an entry no pixel refers to.
+  image.setColorTable({qRgb(0, 0, 0), qRgb(200, 30, 30), qRgb(0, 0, 0), qRgb(30, 30, 200), qRgb(30, 200, 30)});
+  for (int y = 0; y < image.height(); ++y) {
+    for (int x = 0; x < image.width(); ++x) {
+      image.setPixel(x, y, rand() % 4);
+    }
+  }
+
+  const QImage posterized(Posterizer(4).posterize(image));
+  BOOST_REQUIRE_EQUAL(posterized.format(), QImage::Format_Indexed8);
+  BOOST_CHECK_EQUAL(posterized.colorCount(), 3);
+  for (int y = 0; y < image.height(); ++y) {
+    for (int x = 0; x < image.width(); ++x) {
+      BOOST_CHECK_EQUAL(posterized.pixel(x, y), image.pixel(x, y));
+    }
+  }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+}  // namespace tests
+}  // namespace imageproc
@@ -3,11 +3,14 @@
 
 #include <BWColor.h>
 #include <BinaryImage.h>
+#include <ParallelFor.h>
 #include <SEDM.h>
 
 #include <QImage>
+#include <algorithm>
 #include <boost/test/unit_test.hpp>
 #include <cmath>
+#include <cstdlib>
 #include <iostream>
 
 #include "Utils.h"
@@ -57,6 +60,136 @@ BOOST_AUTO_TEST_CASE(test1) {
   BOOST_CHECK(verifySEDM(sedm, out));
 }
 
+namespace {
+BinaryImage randomImage(const int width, const int height, const int blackPercent) {
+  BinaryImage img(width, height, WHITE);
+  for (int y = 0; y < height; ++y) {
+    for (int x = 0; x < width; ++x) {
+      if (rand() % 100 < blackPercent) {
+        img.setPixel(x, y, BLACK);
+      }
+    }
+  }
+  return img;
+}
+
+/**
+ * Computes the map by measuring the distance to every target pixel, including
+ * the enabled borders, which lie just outside the image.
+ */
+std::vector<uint32_t> bruteForceSEDM(const BinaryImage& img,
+                                     const SEDM::DistType distType,
+                                     const SEDM::Borders borders) {
+  const int width = img.width();
+  const int height = img.height();
+  const BWColor targetColor = (distType == SEDM::DIST_TO_WHITE) ? WHITE : BLACK;
+
+  auto isTarget = [&](const int x, const int y) {
+    if (((y < 0) && (borders & SEDM::DIST_TO_TOP_BORDER)) || ((y >= height) && (borders & SEDM::DIST_TO_BOTTOM_BORDER))
+        || ((x < 0) && (borders & SEDM::DIST_TO_LEFT_BORDER))
+        || ((x >= width) && (borders & SEDM::DIST_TO_RIGHT_BORDER))) {
+      return true;
+    }
+    if ((x < 0) || (y < 0) || (x >= width) || (y >= height)) {
+      return false;
+    }
+    return img.getPixel(x, y) == targetColor;
+  };
+
+  std::vector<uint32_t> distances(width * height, SEDM::INF_DIST);
+  for (int y = 0; y < height; ++y) {
+    for (int x = 0; x < width; ++x) {
+      for (int ty = -1; ty <= height; ++ty) {
+        for (int tx = -1; tx <= width; ++tx) {
+          if (isTarget(tx, ty)) {
+            const uint32_t dist = (tx - x) * (tx - x) + (ty - y) * (ty - y);
+            distances[y * width + x] = std::min(distances[y * width + x], dist);
+          }
+        }
+      }
+    }
+  }
+  return distances;
+}
+
+bool sameSEDM(const SEDM& sedm1, const SEDM& sedm2) {
+  if (sedm1.size() != sedm2.size()) {
+    return false;
+  }
+  for (int y = 0; y < sedm1.size().height(); ++y) {
+    const uint32_t* line1 = sedm1.data() + y * sedm1.stride();
+    const uint32_t* line2 = sedm2.data() + y * sedm2.stride();
+    if (!std::equal(line1, line1 + sedm1.size().width(), line2)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/**
+ * Checks that \p sedm16 holds the distances of \p sedm, with those not fitting
+ * 16 bits being SEDM16::INF_DIST.
+ */
+bool saturatedSEDM(const SEDM16& sedm16, const SEDM& sedm) {
+  if (sedm16.size() != sedm.size()) {
+    return false;
+  }
+  for (int y = 0; y < sedm.size().height(); ++y) {
+    const uint16_t* line16 = sedm16.data() + y * sedm16.stride();
+    const uint32_t* line = sedm.data() + y * sedm.stride();
+    for (int x = 0; x < sedm.size().width(); ++x) {
+      if (line16[x] != std::min<uint32_t>(line[x], SEDM16::INF_DIST)) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+}  // namespace
+
+BOOST_AUTO_TEST_CASE(test_matches_brute_force) {
+  srand(1);
+  for (int i = 0; i < 200; ++i) {
+    const BinaryImage img(randomImage(1 + rand() % 40, 1 + rand() % 40, rand() % 100));
+    const auto distType = (i % 2 == 0) ? SEDM::DIST_TO_WHITE : SEDM::DIST_TO_BLACK;
+    const auto borders = static_cast<SEDM::Borders>(rand() % 16);
+
+    const SEDM sedm(img, distType, borders);
+    BOOST_REQUIRE(verifySEDM(sedm, bruteForceSEDM(img, distType, borders).data()));
+    BOOST_REQUIRE(saturatedSEDM(SEDM16(img, distType, borders), sedm));
+  }
+}
+
+BOOST_AUTO_TEST_CASE(test_16bit_saturates_long_distances) {
+  // The only white pixels are in the leftmost column, so the distances grow past 16 bits.
+  BinaryImage img(700, 90, BLACK);
+  for (int y = 0; y < img.height(); y += 30) {
+    img.setPixel(0, y, WHITE);
+  }
+
+  const SEDM sedm(img, SEDM::DIST_TO_WHITE, SEDM::DIST_TO_NO_BORDERS);
+  const SEDM16 sedm16(img, SEDM::DIST_TO_WHITE, SEDM::DIST_TO_NO_BORDERS);
+  BOOST_CHECK(saturatedSEDM(sedm16, sedm));
+  BOOST_CHECK_EQUAL(sedm16.data()[255], 255 * 255);
+  BOOST_CHECK_EQUAL(sedm16.data()[256], SEDM16::INF_DIST);
+}
+
+BOOST_AUTO_TEST_CASE(test_parallel_matches_serial) {
+  srand(2);
+  const BinaryImage img(randomImage(1100, 700, 2));
+
+  setParallelForEnabled(false);
+  const SEDM serial(img, SEDM::DIST_TO_BLACK, SEDM::DIST_TO_ALL_BORDERS);
+  const SEDM16 serial16(img, SEDM::DIST_TO_BLACK, SEDM::DIST_TO_ALL_BORDERS);
+  setParallelForEnabled(true);
+  const SEDM parallel(img, SEDM::DIST_TO_BLACK, SEDM::DIST_TO_ALL_BORDERS);
+  const SEDM16 parallel16(img, SEDM::DIST_TO_BLACK, SEDM::DIST_TO_ALL_BORDERS);
+
+  BOOST_CHECK(sameSEDM(serial, parallel));
+  BOOST_CHECK(saturatedSEDM(serial16, serial));
+  BOOST_CHECK(saturatedSEDM(parallel16, serial));
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 }  // namespace tests
 }  // namespace imageproc
\ No newline at end of file
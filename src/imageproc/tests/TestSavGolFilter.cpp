@@ -0,0 +1,103 @@
+// Copyright (C) 2019  Joseph Artsimovich <joseph.artsimovich@gmail.com>, 4lex4 <4lex49@zoho.com>
+// Use of this source code is governed by the GNU GPLv3 license that can be found in the LICENSE file.
+
+#include <GrayImage.h>
+#include <SavGolFilter.h>
+#include <SavGolKernel.h>
+
+#include <QImage>
+#include <QPoint>
+#include <algorithm>
+#include <boost/test/unit_test.hpp>
+#include <cmath>
+#include <cstdlib>
+
+namespace imageproc {
+namespace tests {
+namespace {
+GrayImage randomGrayImage(const int width, const int height) {
+  GrayImage image(QSize(width, height));
+  for (int y = 0; y < height; ++y) {
+    uint8_t* const line = image.data() + y * image.stride();
+    for (int x = 0; x < width; ++x) {
+      line[x] = static_cast<uint8_t>(rand() % 256);
+    }
+  }
+  return image;
+}
+
+/**
+ * Fits the polynomial with the 2D kernel for every pixel, keeping
+ * the window within the image, as the definition of the filter goes.
+ */
+GrayImage savGolFilterReference(const GrayImage& src, const QSize& windowSize, int horDegree, int vertDegree) {
+  const int width = src.width();
+  const int height = src.height();
+  const int kw = windowSize.width();
+  const int kh = windowSize.height();
+
+  SavGolKernel kernel(windowSize, QPoint(0, 0), horDegree, vertDegree);
+  GrayImage dst(src.size());
+  for (int y = 0; y < height; ++y) {
+    const int top = qBound(0, y - kh / 2, height - kh);
+    for (int x = 0; x < width; ++x) {
+      const int left = qBound(0, x - kw / 2, width - kw);
+      kernel.recalcForOrigin(QPoint(x - left, y - top));
+
+      double sum = 0.0;
+      for (int ky = 0; ky < kh; ++ky) {
+        const uint8_t* const srcLine = src.data() + (top + ky) * src.stride() + left;
+        for (int kx = 0; kx < kw; ++kx) {
+          sum += kernel[ky * kw + kx] * srcLine[kx];
+        }
+      }
+      dst.data()[y * dst.stride() + x] = static_cast<uint8_t>(qBound(0, static_cast<int>(std::floor(sum + 0.5)), 255));
+    }
+  }
+  return dst;
+}
+
+int maxDifference(const GrayImage& lhs, const GrayImage& rhs) {
+  int maxDiff = 0;
+  for (int y = 0; y < lhs.height(); ++y) {
+    const uint8_t* const lhsLine = lhs.data() + y * lhs.stride();
+    const uint8_t* const rhsLine = rhs.data() + y * rhs.stride();
+    for (int x = 0; x < lhs.width(); ++x) {
+      maxDiff = std::max(maxDiff, std::abs(lhsLine[x] - rhsLine[x]));
+    }
+  }
+  return maxDiff;
+}
+}  // namespace
+
+BOOST_AUTO_TEST_SUITE(SavGolFilterTestSuite)
+
+BOOST_AUTO_TEST_CASE(test_same_as_2d_kernel) {
+  srand(1);
+  const int settings[][3] = {{5, 3, 3}, {7, 4, 4}, {11, 4, 4}, {11, 2, 2}, {9, 8, 8}, {3, 0, 2}};
+  for (const auto& setting : settings) {
+    const QSize windowSize(setting[0], setting[0] + 2);
+    const GrayImage image(randomGrayImage(37 + rand() % 20, 29 + rand() % 20));
+    const GrayImage filtered(savGolFilter(image, windowSize, setting[1], setting[2]));
+    BOOST_REQUIRE(filtered.size() == image.size());
+    BOOST_CHECK_LE(maxDifference(filtered, savGolFilterReference(image, windowSize, setting[1], setting[2])), 1);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(test_flat_image_stays_flat) {
+  GrayImage image(QSize(40, 30));
+  image.fill(137);
+  const GrayImage filtered(savGolFilter(image, QSize(7, 7), 4, 4));
+  BOOST_CHECK_EQUAL(maxDifference(filtered, image), 0);
+}
+
+BOOST_AUTO_TEST_CASE(test_window_larger_than_image) {
+  srand(2);
+  const GrayImage image(randomGrayImage(5, 20));
+  const GrayImage filtered(savGolFilter(image, QSize(7, 7), 4, 4));
+  BOOST_CHECK_EQUAL(maxDifference(filtered, image), 0);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+}  // namespace tests
+}  // namespace imageproc
@@ -5,6 +5,8 @@
 #include <BinaryImage.h>
 #include <Connectivity.h>
 #include <Grayscale.h>
+#include <ParallelFor.h>
+#include <RasterOp.h>
 #include <SeedFill.h>
 
 #include <QImage>
@@ -81,6 +83,51 @@ BOOST_AUTO_TEST_CASE(test_regression_4) {
   BOOST_REQUIRE(seedFill(seed, mask, CONN4) == fill);
 }
 
+BOOST_AUTO_TEST_CASE(test_diagonal_across_words) {
+  int seed_data[70 * 2] = {0};
+  int mask_data[70 * 2] = {0};
+
+  mask_data[31] = 1;
+  mask_data[70 + 32] = 1;
+
+  const BinaryImage mask(makeBinaryImage(mask_data, 70, 2));
+
+  seed_data[31] = 1;
+  BOOST_CHECK(seedFill(makeBinaryImage(seed_data, 70, 2), mask, CONN8) == mask);
+  BOOST_CHECK(seedFillSlow(makeBinaryImage(seed_data, 70, 2), mask, CONN8) == mask);
+
+  seed_data[31] = 0;
+  seed_data[70 + 32] = 1;
+  BOOST_CHECK(seedFill(makeBinaryImage(seed_data, 70, 2), mask, CONN8) == mask);
+  BOOST_CHECK(seedFillSlow(makeBinaryImage(seed_data, 70, 2), mask, CONN8) == mask);
+}
+
+BOOST_AUTO_TEST_CASE(test_binary_random) {
+  for (int i = 0; i < 200; ++i) {
+    const int width = 1 + rand() % 100;
+    const int height = 1 + rand() % 40;
+    // A sparse seed and a dense mask, so that fills have to go a long way.
+    BinaryImage seed(randomBinaryImage(width, height));
+    rasterOp<RopAnd<RopSrc, RopDst>>(seed, randomBinaryImage(width, height));
+    rasterOp<RopAnd<RopSrc, RopDst>>(seed, randomBinaryImage(width, height));
+    BinaryImage mask(randomBinaryImage(width, height));
+    rasterOp<RopOr<RopSrc, RopDst>>(mask, randomBinaryImage(width, height));
+
+    for (const Connectivity connectivity : {CONN4, CONN8}) {
+      const BinaryImage fillNew(seedFill(seed, mask, connectivity));
+      const BinaryImage fillOld(seedFillSlow(seed, mask, connectivity));
+      if (fillNew != fillOld) {
+        BOOST_ERROR("fillNew != fillOld at iteration " << i);
+        dumpBinaryImage(seed, "seed");
+        dumpBinaryImage(mask, "mask");
+        dumpBinaryImage(fillOld, "fillOld");
+        dumpBinaryImage(fillNew, "fillNew");
+        return;
+      }
+    }
+  }
+}
+
 BOOST_AUTO_TEST_CASE(test_gray4_random) {
   for (int i = 0; i < 200; ++i) {
     const GrayImage seed(randomGrayImage(5, 5));
@@ -115,6 +162,24 @@ BOOST_AUTO_TEST_CASE(test_gray8_random) {
   }
 }
 
+BOOST_AUTO_TEST_CASE(test_gray_random_large) {
+  // Tall enough to be filled in parallel bands, and large enough for pixels
+  // to be changed again after they were taken off the queue.
+  for (int i = 0; i < 10; ++i) {
+    const GrayImage seed(randomGrayImage(120, 180));
+    const GrayImage mask(randomGrayImage(120, 180));
+    for (const Connectivity connectivity : {CONN4, CONN8}) {
+      const GrayImage fillOld(seedFillGraySlow(seed, mask, connectivity));
+      setParallelForEnabled(false);
+      const GrayImage fillSerial(seedFillGray(seed, mask, connectivity));
+      setParallelForEnabled(true);
+      const GrayImage fillParallel(seedFillGray(seed, mask, connectivity));
+      BOOST_REQUIRE(fillSerial == fillOld);
+      BOOST_REQUIRE(fillParallel == fillOld);
+    }
+  }
+}
+
 BOOST_AUTO_TEST_CASE(test_gray_vs_binary) {
   for (int i = 0; i < 200; ++i) {
     const BinaryImage binSeed(randomBinaryImage(5, 5));
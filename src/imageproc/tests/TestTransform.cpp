@@ -1,11 +1,16 @@
 // Copyright (C) 2019  Joseph Artsimovich <joseph.artsimovich@gmail.com>, 4lex4 <4lex49@zoho.com>
 // Use of this source code is governed by the GNU GPLv3 license that can be found in the LICENSE file.
 
+#include <ColorMixer.h>
 #include <Grayscale.h>
+#include <ParallelFor.h>
 #include <Transform.h>
 
 #include <QImage>
+#include <QPolygonF>
 #include <QSize>
+#include <QTransform>
+#include <algorithm>
 #include <boost/test/unit_test.hpp>
 #include <cmath>
 #include <cstdint>
@@ -17,6 +22,169 @@ namespace imageproc {
 namespace tests {
 using namespace utils;
 
+namespace {
+/**
+ * The area mapping of transform() for a single destination pixel, done the
+ * obvious way: each source pixel is mixed in with the area of its overlap
+ * with the footprint of the destination pixel, in 1/32 pixel units, and
+ * the parts of the footprint outside of the source image with the outside color,
+ * unless it's a weak one.
+ */
+template <typename StorageUnit, typename Mixer>
+StorageUnit mapAreaReference(const StorageUnit* const srcData,
+                             const int srcStride,
+                             const QSize srcSize,
+                             const int src32Left,
+                             const int src32Top,
+                             const int unit32W,
+                             const int unit32H,
+                             const StorageUnit outsideColor,
+                             const int outsideFlags) {
+  const int src32Right = src32Left + unit32W;
+  const int src32Bottom = src32Top + unit32H;
+  const int srcLeft = src32Left >> 5;
+  const int srcRight = (src32Right - 1) >> 5;  // inclusive
+  const int srcTop = src32Top >> 5;
+  const int srcBottom = (src32Bottom - 1) >> 5;  // inclusive
+  const auto overlap = [&](const int sx, const int sy) {
+    const int width = std::min(src32Right, (sx + 1) * 32) - std::max(src32Left, sx * 32);
+    const int height = std::min(src32Bottom, (sy + 1) * 32) - std::max(src32Top, sy * 32);
+    return static_cast<unsigned>(width * height);
+  };
+  const auto inside = [&](const int sx, const int sy) {
+    return (sx >= 0) && (sy >= 0) && (sx < srcSize.width()) && (sy < srcSize.height());
+  };
+
+  unsigned insideArea = 0;
+  unsigned outsideArea = 0;
+  int numInside = 0;
+  StorageUnit insidePixel = StorageUnit();
+  for (int sy = srcTop; sy <= srcBottom; ++sy) {
+    for (int sx = srcLeft; sx <= srcRight; ++sx) {
+      if (inside(sx, sy)) {
+        insideArea += overlap(sx, sy);
+        insidePixel = srcData[sy * srcStride + sx];
+        ++numInside;
+      } else {
+        outsideArea += overlap(sx, sy);
+      }
+    }
+  }
+
+  if (numInside == 0) {
+    if (outsideFlags & OutsidePixels::COLOR) {
+      return outsideColor;
+    }
+    const int srcX = qBound(0, (srcLeft + srcRight) >> 1, srcSize.width() - 1);
+    const int srcY = qBound(0, (srcTop + srcBottom) >> 1, srcSize.height() - 1);
+    return srcData[srcY * srcStride + srcX];
+  }
+  if (outsideFlags & OutsidePixels::WEAK) {
+    outsideArea = 0;
+  }
+  if ((numInside == 1) && (outsideArea == 0)) {
+    // A single source pixel is taken as it is, even a transparent one.
+    return insidePixel;
+  }
+
+  Mixer mixer;
+  if (!(outsideFlags & OutsidePixels::WEAK)) {
+    mixer.add(outsideColor, outsideArea);
+  }
+  for (int sy = std::max(srcTop, 0); sy <= std::min(srcBottom, srcSize.height() - 1); ++sy) {
+    for (int sx = std::max(srcLeft, 0); sx <= std::min(srcRight, srcSize.width() - 1); ++sx) {
+      mixer.add(srcData[sy * srcStride + sx], overlap(sx, sy));
+    }
+  }
+  return mixer.mix(insideArea + outsideArea);
+}
+
+/**
+ * The footprint of a destination pixel spans the source extents of the centers
+ * of its edges, but no less than the default minimum mapping area.
+ */
+template <typename StorageUnit, typename Mixer>
+void transformReference(const StorageUnit* const srcData,
+                        const int srcStride,
+                        const QSize srcSize,
+                        StorageUnit* const dstData,
+                        const int dstStride,
+                        const QTransform& xform,
+                        const QRect& dstRect,
+                        const StorageUnit outsideColor,
+                        const int outsideFlags) {
+  QTransform invXform;
+  invXform.translate(dstRect.x(), dstRect.y());
+  invXform *= xform.inverted();
+  invXform *= QTransform().scale(32.0, 32.0);
+
+  QPolygonF edgeCenters;
+  edgeCenters << QPointF(0.5, 0.0) << QPointF(1.0, 0.5) << QPointF(0.5, 1.0) << QPointF(0.0, 0.5);
+  const QRectF extents(invXform.map(edgeCenters).boundingRect());
+  const int unit32W = std::max(1, qRound(std::max(0.9 * 32.0, extents.width())));
+  const int unit32H = std::max(1, qRound(std::max(0.9 * 32.0, extents.height())));
+
+  for (int dy = 0; dy < dstRect.height(); ++dy) {
+    const double fSx32Base = (dy + 0.5) * invXform.m21() + invXform.dx();
+    const double fSy32Base = (dy + 0.5) * invXform.m22() + invXform.dy();
+    for (int dx = 0; dx < dstRect.width(); ++dx) {
+      const int src32Left = static_cast<int>(fSx32Base + (dx + 0.5) * invXform.m11()) - (unit32W >> 1);
+      const int src32Top = static_cast<int>(fSy32Base + (dx + 0.5) * invXform.m12()) - (unit32H >> 1);
+      dstData[dy * dstStride + dx] = mapAreaReference<StorageUnit, Mixer>(
+          srcData, srcStride, srcSize, src32Left, src32Top, unit32W, unit32H, outsideColor, outsideFlags);
+    }
+  }
+}
+
+QImage transformReference(const QImage& src,
+                          const QTransform& xform,
+                          const QRect& dstRect,
+                          const OutsidePixels outsidePixels) {
+  QImage dst(dstRect.size(), src.format());
+  const auto* const srcData = reinterpret_cast<const uint32_t*>(src.bits());
+  auto* const dstData = reinterpret_cast<uint32_t*>(dst.bits());
+  if (src.format() == QImage::Format_ARGB32) {
+    transformReference<uint32_t, ArgbColorMixer<float>>(srcData, src.bytesPerLine() / 4, src.size(), dstData,
+                                                        dst.bytesPerLine() / 4, xform, dstRect, outsidePixels.rgba(),
+                                                        outsidePixels.flags());
+  } else {
+    transformReference<uint32_t, RgbColorMixer<uint32_t>>(srcData, src.bytesPerLine() / 4, src.size(), dstData,
+                                                          dst.bytesPerLine() / 4, xform, dstRect, outsidePixels.rgb(),
+                                                          outsidePixels.flags());
+  }
+  return dst;
+}
+
+GrayImage transformToGrayReference(const GrayImage& src,
+                                   const QTransform& xform,
+                                   const QRect& dstRect,
+                                   const OutsidePixels outsidePixels) {
+  GrayImage dst(dstRect.size());
+  transformReference<uint8_t, GrayColorMixer<unsigned>>(src.data(), src.stride(), src.size(), dst.data(),
+                                                        dst.stride(), xform, dstRect, outsidePixels.grayLevel(),
+                                                        outsidePixels.flags());
+  return dst;
+}
+
+/**
+ * The largest difference between the corresponding channels of two 32-bit images.
+ */
+int maxChannelDifference(const QImage& lhs, const QImage& rhs) {
+  int maxDiff = 0;
+  for (int y = 0; y < lhs.height(); ++y) {
+    const auto* const lhsLine = reinterpret_cast<const QRgb*>(lhs.constScanLine(y));
+    const auto* const rhsLine = reinterpret_cast<const QRgb*>(rhs.constScanLine(y));
+    for (int x = 0; x < lhs.width(); ++x) {
+      for (int shift = 0; shift < 32; shift += 8) {
+        const int diff = std::abs(int((lhsLine[x] >> shift) & 0xff) - int((rhsLine[x] >> shift) & 0xff));
+        maxDiff = std::max(maxDiff, diff);
+      }
+    }
+  }
+  return maxDiff;
+}
+}  // namespace
+
 BOOST_AUTO_TEST_SUITE(TransformTestSuite)
 
 BOOST_AUTO_TEST_CASE(test_null_image) {
@@ -45,6 +213,105 @@ BOOST_AUTO_TEST_CASE(test_random_image) {
   BOOST_CHECK(transformToGray(img, nullXform, img.rect(), outsidePixels) == img);
 }
 
+BOOST_AUTO_TEST_CASE(test_parallel_matches_serial) {
+  srand(3);
+  QImage rgb(333, 257, QImage::Format_RGB32);
+  QImage argb(333, 257, QImage::Format_ARGB32);
+  for (int y = 0; y < rgb.height(); ++y) {
+    auto* rgbLine = reinterpret_cast<QRgb*>(rgb.scanLine(y));
+    auto* argbLine = reinterpret_cast<QRgb*>(argb.scanLine(y));
+    for (int x = 0; x < rgb.width(); ++x) {
+      rgbLine[x] = qRgb(rand() % 256, rand() % 256, rand() % 256);
+      argbLine[x] = qRgba(rand() % 256, rand() % 256, rand() % 256, rand() % 256);
+    }
+  }
+
+  QTransform rotation;
+  rotation.rotate(7.5);
+  QTransform scaling;
+  scaling.scale(0.37, 1.6);
+  const OutsidePixels outsidePixels(OutsidePixels::assumeColor(Qt::white));
+
+  for (const QTransform& xform : {rotation, scaling}) {
+    const QRect dstRect(xform.mapRect(QRectF(rgb.rect())).toAlignedRect().adjusted(-5, -5, 5, 5));
+    for (const QImage& src : {rgb, argb}) {
+      setParallelForEnabled(false);
+      const QImage serial(transform(src, xform, dstRect, outsidePixels));
+      const GrayImage serialGray(transformToGray(src, xform, dstRect, outsidePixels));
+      setParallelForEnabled(true);
+      BOOST_CHECK(transform(src, xform, dstRect, outsidePixels) == serial);
+      BOOST_CHECK(transformToGray(src, xform, dstRect, outsidePixels) == serialGray);
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE(test_same_as_reference) {
+  srand(4);
+  GrayImage gray(QSize(97, 83));
+  QImage rgb(gray.width(), gray.height(), QImage::Format_RGB32);
+  QImage argb(gray.width(), gray.height(), QImage::Format_ARGB32);
+  for (int y = 0; y < gray.height(); ++y) {
+    uint8_t* const grayLine = gray.data() + y * gray.stride();
+    auto* const rgbLine = reinterpret_cast<QRgb*>(rgb.scanLine(y));
+    auto* const argbLine = reinterpret_cast<QRgb*>(argb.scanLine(y));
+    for (int x = 0; x < gray.width(); ++x) {
+      grayLine[x] = static_cast<uint8_t>(rand() % 256);
+      rgbLine[x] = qRgb(rand() % 256, rand() % 256, rand() % 256);
+      // Some of the pixels are fully transparent.
+      argbLine[x] = qRgba(rand() % 256, rand() % 256, rand() % 256, std::max(0, rand() % 300 - 44));
+    }
+  }
+
+  QTransform rotation;
+  rotation.rotate(7.5);
+  QTransform rotationAndScaling;
+  rotationAndScaling.rotate(-33.0);
+  rotationAndScaling.scale(1.3, 0.8);
+  QTransform upscaling;
+  upscaling.scale(2.5, 1.75);
+  QTransform downscaling;
+  downscaling.translate(3.25, -1.5);
+  downscaling.scale(0.37, 0.21);
+  const OutsidePixels outsidePixelsModes[]
+      = {OutsidePixels::assumeColor(QColor(90, 90, 90)), OutsidePixels::assumeWeakColor(QColor(200, 200, 200)),
+         OutsidePixels::assumeWeakNearest()};
+
+  for (const QTransform& xform : {rotation, rotationAndScaling, upscaling, downscaling}) {
+    const QRect dstRect(xform.mapRect(QRectF(gray.rect())).toAlignedRect().adjusted(-5, -5, 5, 5));
+    for (const OutsidePixels& outsidePixels : outsidePixelsModes) {
+      const GrayImage expectedGray(transformToGrayReference(gray, xform, dstRect, outsidePixels));
+      BOOST_CHECK(transformToGray(gray, xform, dstRect, outsidePixels) == expectedGray);
+      BOOST_CHECK(GrayImage(transform(gray, xform, dstRect, outsidePixels)) == expectedGray);
+
+      const QImage rgbResult(transform(rgb, xform, dstRect, outsidePixels));
+      BOOST_REQUIRE(rgbResult.format() == QImage::Format_RGB32);
+      BOOST_CHECK_EQUAL(maxChannelDifference(rgbResult, transformReference(rgb, xform, dstRect, outsidePixels)), 0);
+
+      // The floating point sums may get rounded differently in SSE2 registers.
+      const QImage argbResult(transform(argb, xform, dstRect, outsidePixels));
+      BOOST_REQUIRE(argbResult.format() == QImage::Format_ARGB32);
+      BOOST_CHECK_LE(maxChannelDifference(argbResult, transformReference(argb, xform, dstRect, outsidePixels)), 1);
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE(test_scaling_keeps_flat_color) {
+  QImage img(60, 40, QImage::Format_RGB32);
+  img.fill(qRgb(10, 200, 70));
+  QTransform xform;
+  xform.scale(2.5, 0.75);
+
+  const QRect dstRect(xform.mapRect(QRectF(img.rect())).toRect());
+  const QImage scaled(transform(img, xform, dstRect, OutsidePixels::assumeColor(Qt::black)));
+  BOOST_REQUIRE(scaled.size() == dstRect.size());
+  for (int y = 0; y < scaled.height(); ++y) {
+    const auto* line = reinterpret_cast<const QRgb*>(scaled.constScanLine(y));
+    for (int x = 0; x < scaled.width(); ++x) {
+      BOOST_REQUIRE_EQUAL(line[x], qRgb(10, 200, 70));
+    }
+  }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 }  // namespace tests
 }  // namespace imageproc
\ No newline at end of file